@@ -0,0 +1,31 @@
+deps_config := \
+	mem/Kconfig \
+	platform/Kconfig.toolchain \
+	platform/esp8266/Kconfig \
+	platform/avr8/Kconfig \
+	platform/x86/Kconfig \
+	platform/unix/Kconfig \
+	platform/msp430/Kconfig \
+	platform/arm/frdm/Kconfig \
+	platform/arm/stm32/Kconfig \
+	platform/arm/ti/Kconfig \
+	platform/arm/Kconfig \
+	platform/Kconfig \
+	drivers/net/Kconfig \
+	drivers/graphics/Kconfig \
+	drivers/Kconfig \
+	fs/Kconfig \
+	usb/Kconfig \
+	net/Kconfig \
+	js/modules/Kconfig \
+	js/builtins/Kconfig \
+	js/Kconfig \
+	apps/Kconfig \
+	boards/Kconfig \
+	Kconfig
+
+_gate_build_ut/auto.conf: \
+	$(deps_config)
+
+
+$(deps_config): ;
@@ -0,0 +1,46 @@
+/*
+ *
+ * Automatically generated file; DO NOT EDIT.
+ * TinkerPal Configuration
+ *
+ */
+#define CONFIG_PLAT_HAS_GCC 1
+#define CONFIG_LINUX_ETH 1
+#define CONFIG_ETHERNET 1
+#define CONFIG_ARP_TABLE_SIZE 8
+#define CONFIG_NET_ESP8266 1
+#define CONFIG_APP_UNIT_TESTS 1
+#define CONFIG_TINKERPAL 1
+#define CONFIG_GCC 1
+#define CONFIG_ARP 1
+#define CONFIG_TCP 1
+#define CONFIG_UDP 1
+#define CONFIG_NET_DEBUG 1
+#define CONFIG_MALLOC 1
+#define CONFIG_ETHERIF 1
+#define CONFIG_PLAT_HAS_MALLOC 1
+#define CONFIG_NET_RX_BATCH 4
+#define CONFIG_NET_ESP8266_LINK_RX_BUF_SIZE 1536
+#define CONFIG_TCP_TX_BUFFER_SIZE 1024
+#define CONFIG_PLAT_HAS_SERIAL 1
+#define CONFIG_UNIX 1
+#define CONFIG_NETIF_INET 1
+#define CONFIG_MEM_CACHE 1
+#define CONFIG_CLI_SYNTAX_HIGHLIGHTING 1
+#define CONFIG_NET 1
+#define CONFIG_PACKET 1
+#define CONFIG_NET_PACKET_POOL_SIZE 6
+#define CONFIG_PLATFORM_EMULATION 1
+#define CONFIG_NET_ESP8266_LINK_TX_BUF_SIZE 512
+#define CONFIG_PLAT_IDLE_SLEEP 1
+#define CONFIG_UDP_RX_QUEUE_LEN 4
+#define CONFIG_EVENT_LOOP_STATS 1
+#define CONFIG_IPV4 1
+#define CONFIG_EVENT_TIMER_SLACK_MS 0
+#define CONFIG_TCP_RX_BUFFER_SIZE 1024
+#define CONFIG_CLI 1
+#define CONFIG_NET_ESP8266_RX_CHUNK_SIZE 128
+#define CONFIG_ICMP 1
+#define CONFIG_NET_PACKET_SIZE 1518
+#define CONFIG_DHCP_CLIENT 1
+#define CONFIG_CLI_BUFFER_SIZE 512
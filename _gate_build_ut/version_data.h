@@ -0,0 +1,8 @@
+/* Automatically generated version file, DO NOT MANUALLY EDIT */
+#ifndef __TINKERPAL_VERSION_DATA_H___
+#define __TINKERPAL_VERSION_DATA_H___
+#define TINKERPAL_VERSION "0.1.3"
+#define TINKERPAL_MAJOR_VERSION 0
+#define TINKERPAL_MINOR_VERSION 1
+#define TINKERPAL_PATCH_VERSION 3
+#endif
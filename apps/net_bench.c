@@ -0,0 +1,361 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdlib.h> /* atoi */
+#include <string.h> /* strlen */
+#include "util/debug.h"
+#include "util/tp_misc.h"
+#include "util/event.h"
+#include "platform/platform.h"
+#include "net/net.h"
+#include "platform/unix/linux_eth.h"
+#include "apps/app.h"
+
+/* Benchmarks the native stack over a tap or veth device. The peer is
+ * expected to answer pings and to run a UDP echo service, e.g.:
+ * socat UDP-LISTEN:7,fork PIPE
+ * Each result is printed as a single line JSON object.
+ */
+
+#define BENCH_PING_COUNT 100
+#define BENCH_PING_PAYLOAD 56
+#define BENCH_PING_ID 0x7462
+#define BENCH_UDP_COUNT 1000
+#define BENCH_UDP_SIZE 64
+#define BENCH_UDP_WINDOW 4
+#define BENCH_TIMEOUT_MS 1000
+#define BENCH_SETTLE_MS 300
+
+typedef enum {
+    BENCH_PING = 0,
+    BENCH_UDP_TX = 1,
+    BENCH_UDP_ECHO = 2,
+    BENCH_UDP_BURST = 3,
+    BENCH_DONE = 4,
+} bench_stage_t;
+
+static const int bursts[] = { 4, 8, 16, 32 };
+
+static struct {
+    netif_t *netif;
+    ipv4_info_t ip_info;
+    u32 peer;
+    u16 port;
+    int sock;
+    bench_stage_t stage;
+    int timer_id;
+    u64 start;
+    /* Ping */
+    u16 seq;
+    int replies;
+    int lost;
+    u32 rtt[BENCH_PING_COUNT];
+    /* UDP */
+    int sent;
+    int received;
+    int errors;
+    u32 tx_pps;
+    int burst;
+} bench = { .sock = -1, .timer_id = -1 };
+
+static char udp_buf[BENCH_UDP_SIZE];
+
+static void bench_stage_start(event_t *e, u32 id, u64 timestamp);
+static void bench_timeout(event_t *e, u32 id, u64 timestamp);
+
+static event_t stage_start_event = { .trigger = bench_stage_start };
+static event_t timeout_event = { .trigger = bench_timeout };
+
+static u64 bench_now_us(void)
+{
+    u32 sec, usec;
+
+    platform_get_time_from_boot(&sec, &usec);
+    return (u64)sec * 1000000 + usec;
+}
+
+static void bench_timer_set(int ms, event_t *e)
+{
+    if (bench.timer_id >= 0)
+        event_timer_del(bench.timer_id);
+    bench.timer_id = event_timer_set(ms, e);
+}
+
+static void bench_next_stage(void)
+{
+    bench.stage++;
+    bench_timer_set(BENCH_SETTLE_MS, &stage_start_event);
+}
+
+static u32 bench_pps(int count)
+{
+    u64 elapsed = bench_now_us() - bench.start;
+
+    return elapsed ? (u32)((u64)count * 1000000 / elapsed) : 0;
+}
+
+static void ping_report(void)
+{
+    int i, j, n = bench.replies;
+    u32 *rtt = bench.rtt, tmp;
+
+    for (i = 1; i < n; i++)
+    {
+        for (tmp = rtt[i], j = i; j > 0 && rtt[j - 1] > tmp; j--)
+            rtt[j] = rtt[j - 1];
+        rtt[j] = tmp;
+    }
+
+    if (!n)
+    {
+        tp_out("{\"bench\":\"icmp_rtt\",\"count\":%d,\"lost\":%d}\n",
+            BENCH_PING_COUNT, bench.lost);
+        return;
+    }
+
+    tp_out("{\"bench\":\"icmp_rtt\",\"count\":%d,\"lost\":%d,\"size\":%d,"
+        "\"min_us\":%u,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,"
+        "\"max_us\":%u}\n", BENCH_PING_COUNT, bench.lost, BENCH_PING_PAYLOAD,
+        rtt[0], rtt[(n - 1) * 50 / 100], rtt[(n - 1) * 90 / 100],
+        rtt[(n - 1) * 99 / 100], rtt[n - 1]);
+}
+
+/* Sequence 1 warms up the ARP cache and is not measured */
+static void ping_send(void)
+{
+    if (bench.seq == BENCH_PING_COUNT + 1)
+    {
+        ping_report();
+        bench_next_stage();
+        return;
+    }
+
+    bench.seq++;
+    bench.start = bench_now_us();
+    bench_timer_set(BENCH_TIMEOUT_MS, &timeout_event);
+    icmp_echo_xmit(netif_to_etherif(bench.netif), bench.peer, BENCH_PING_ID,
+        bench.seq, BENCH_PING_PAYLOAD);
+}
+
+static void ping_reply(etherif_t *ethif, u32 src_addr, u16 id, u16 seq)
+{
+    u32 rtt = (u32)(bench_now_us() - bench.start);
+
+    if (bench.stage != BENCH_PING || src_addr != bench.peer ||
+        id != BENCH_PING_ID || seq != bench.seq)
+    {
+        return;
+    }
+
+    if (seq > 1)
+        bench.rtt[bench.replies++] = rtt;
+    ping_send();
+}
+
+static int udp_send(void)
+{
+    if (netif_udp_sendto(bench.netif, bench.sock, bench.peer, bench.port,
+        udp_buf, sizeof(udp_buf)) < 0)
+    {
+        bench.errors++;
+        return -1;
+    }
+
+    bench.sent++;
+    return 0;
+}
+
+static void udp_counters_reset(void)
+{
+    bench.sent = bench.received = bench.errors = 0;
+    bench.start = bench_now_us();
+}
+
+static void udp_echo_report(void)
+{
+    tp_out("{\"bench\":\"udp_echo\",\"count\":%d,\"size\":%d,\"window\":%d,"
+        "\"received\":%d,\"errors\":%d,\"pps\":%u}\n", bench.sent,
+        BENCH_UDP_SIZE, BENCH_UDP_WINDOW, bench.received, bench.errors,
+        bench_pps(bench.received));
+}
+
+static void udp_burst_report(void)
+{
+    int lost = bursts[bench.burst] - bench.received;
+
+    tp_out("{\"bench\":\"udp_burst\",\"burst\":%d,\"size\":%d,\"sent\":%d,"
+        "\"received\":%d,\"errors\":%d,\"drop_permille\":%d}\n",
+        bursts[bench.burst], BENCH_UDP_SIZE, bench.sent, bench.received,
+        bench.errors, lost * 1000 / bursts[bench.burst]);
+}
+
+static void udp_burst_send(void)
+{
+    int i;
+
+    udp_counters_reset();
+    for (i = 0; i < bursts[bench.burst]; i++)
+        udp_send();
+    bench_timer_set(BENCH_SETTLE_MS, &timeout_event);
+}
+
+static void udp_data_avail(event_t *e, u32 id, u64 timestamp)
+{
+    u32 ip;
+    u16 port;
+
+    while (netif_udp_recvfrom(bench.netif, bench.sock, udp_buf,
+        sizeof(udp_buf), &ip, &port) >= 0)
+    {
+        if (ip != bench.peer || port != bench.port)
+            continue;
+
+        bench.received++;
+        if (bench.stage != BENCH_UDP_ECHO)
+            continue;
+
+        if (bench.received == BENCH_UDP_COUNT)
+        {
+            udp_echo_report();
+            bench_next_stage();
+            return;
+        }
+
+        /* Keep the window full, losses are detected by the stall timer */
+        bench_timer_set(BENCH_TIMEOUT_MS, &timeout_event);
+        if (bench.sent < BENCH_UDP_COUNT)
+            udp_send();
+    }
+}
+
+static event_t udp_data_avail_event = { .trigger = udp_data_avail };
+
+static void bench_timeout(event_t *e, u32 id, u64 timestamp)
+{
+    bench.timer_id = -1;
+    switch (bench.stage)
+    {
+    case BENCH_PING:
+        if (bench.seq > 1)
+            bench.lost++;
+        ping_send();
+        break;
+    case BENCH_UDP_TX:
+        tp_out("{\"bench\":\"udp_tx\",\"count\":%d,\"size\":%d,"
+            "\"errors\":%d,\"pps\":%u,\"echoed\":%d}\n", BENCH_UDP_COUNT,
+            BENCH_UDP_SIZE, bench.errors, bench.tx_pps, bench.received);
+        bench_next_stage();
+        break;
+    case BENCH_UDP_ECHO:
+        udp_echo_report();
+        bench_next_stage();
+        break;
+    case BENCH_UDP_BURST:
+        udp_burst_report();
+        if (++bench.burst < ARRAY_SIZE(bursts))
+            udp_burst_send();
+        else
+            bench_next_stage();
+        break;
+    default:
+        break;
+    }
+}
+
+static void bench_stage_start(event_t *e, u32 id, u64 timestamp)
+{
+    int i;
+
+    bench.timer_id = -1;
+    switch (bench.stage)
+    {
+    case BENCH_PING:
+        ping_send();
+        break;
+    case BENCH_UDP_TX:
+        /* Transmit path only, echoes mostly overflow the socket queue */
+        udp_counters_reset();
+        for (i = 0; i < BENCH_UDP_COUNT; i++)
+            udp_send();
+        /* Reported once the echoes settle */
+        bench.tx_pps = bench_pps(bench.sent);
+        bench_timer_set(BENCH_SETTLE_MS, &timeout_event);
+        break;
+    case BENCH_UDP_ECHO:
+        udp_counters_reset();
+        for (i = 0; i < BENCH_UDP_WINDOW; i++)
+            udp_send();
+        bench_timer_set(BENCH_TIMEOUT_MS, &timeout_event);
+        break;
+    case BENCH_UDP_BURST:
+        bench.burst = 0;
+        udp_burst_send();
+        break;
+    case BENCH_DONE:
+        icmp_echo_reply_handler_set(NULL);
+        netif_tcp_disconnect(bench.netif, bench.sock);
+        netif_sock_events_clear(bench.netif, bench.sock);
+        netif_free(bench.netif);
+        break;
+    }
+}
+
+void app_start(int argc, char *argv[])
+{
+    u32 ip;
+
+    tp_out("TinkerPal Application - Net Benchmark\n");
+
+    if (argc != 4 && argc != 5)
+    {
+        tp_crit("Usage: %s <network interface> <local ip> <peer ip> "
+            "[udp echo port]\n", argv[0]);
+    }
+
+    if (!(ip = ip_addr_parse(argv[2], strlen(argv[2]))) ||
+        !(bench.peer = ip_addr_parse(argv[3], strlen(argv[3]))))
+    {
+        tp_crit("Invalid IP address\n");
+    }
+
+    bench.port = argc == 5 ? atoi(argv[4]) : 7;
+
+    if (!(bench.netif = linux_eth_new(argv[1])))
+        tp_crit("Failed to open %s\n", argv[1]);
+
+    /* Static configuration, the peer is on a /24 and routes the rest */
+    bench.ip_info.ip = ip;
+    bench.ip_info.netmask = 0xffffff00;
+    bench.ip_info.router = bench.peer;
+    etherif_ipv4_info_set(netif_to_etherif(bench.netif), &bench.ip_info);
+
+    if ((bench.sock = netif_udp_bind(bench.netif, 0)) < 0)
+        tp_crit("Failed to bind UDP socket\n");
+
+    netif_sock_on_event_set(bench.netif, bench.sock,
+        NETIF_SOCK_EVENT_DATA_AVAIL, &udp_data_avail_event);
+    icmp_echo_reply_handler_set(ping_reply);
+    bench.stage = BENCH_PING;
+    bench_timer_set(0, &stage_start_event);
+}
@@ -0,0 +1,127 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h> /* memcpy */
+#include "util/debug.h"
+#include "util/tp_misc.h"
+#include "platform/platform.h"
+#include "net/net_utils.h"
+#include "apps/app.h"
+
+#define BENCH_MS 200
+
+/* The original 16 bit at a time loop, for comparison. It requires aligned
+ * buffers.
+ */
+static u16 net_csum_16(u16 *addr, u16 byte_len)
+{
+    u32 sum = 0;
+
+    for (; byte_len > 1; byte_len -= 2)
+        sum += *addr++;
+
+    if (byte_len)
+        sum += *(u8 *)addr;
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return (u16)~sum;
+}
+
+typedef enum {
+    BENCH_CSUM_16 = 0,
+    BENCH_CSUM = 1,
+    BENCH_COPY_THEN_CSUM = 2,
+    BENCH_CSUM_COPY = 3,
+} bench_t;
+
+static const char *bench_names[] = {
+    [BENCH_CSUM_16] = "16 bit loop",
+    [BENCH_CSUM] = "net_csum",
+    [BENCH_COPY_THEN_CSUM] = "memcpy + net_csum",
+    [BENCH_CSUM_COPY] = "net_csum_copy",
+};
+
+static u8 src[1500 + 1], dst[1500 + 1];
+static volatile u16 sink;
+
+/* Returns KB/s */
+static u32 bench_run(bench_t bench, u8 *buf, int len)
+{
+    u64 start = platform_get_ticks_from_boot(), elapsed;
+    u32 iters = 0;
+    int i;
+
+    do
+    {
+        for (i = 0; i < 64; i++)
+        {
+            switch (bench)
+            {
+            case BENCH_CSUM_16:
+                sink = net_csum_16((u16 *)buf, len);
+                break;
+            case BENCH_CSUM:
+                sink = net_csum((u16 *)buf, len);
+                break;
+            case BENCH_COPY_THEN_CSUM:
+                memcpy(dst, buf, len);
+                sink = net_csum((u16 *)dst, len);
+                break;
+            case BENCH_CSUM_COPY:
+                sink = net_csum_fold(net_csum_copy(dst, buf, len, 0));
+                break;
+            }
+        }
+        iters += 64;
+        elapsed = platform_get_ticks_from_boot() - start;
+    } while (elapsed < BENCH_MS);
+
+    return (u32)((u64)iters * len / elapsed);
+}
+
+void app_start(int argc, char *argv[])
+{
+    static const int lens[] = { 20, 64, 576, 1500 };
+    bench_t bench;
+    int i;
+
+    tp_out("TinkerPal Application - Net Checksum Benchmark\n");
+
+    for (i = 0; i < sizeof(src); i++)
+        src[i] = i * 7;
+
+    for (i = 0; i < ARRAY_SIZE(lens); i++)
+    {
+        tp_out("%d bytes:\n", lens[i]);
+        tp_out("  %s: %u KB/s aligned\n", bench_names[BENCH_CSUM_16],
+            bench_run(BENCH_CSUM_16, src, lens[i]));
+        for (bench = BENCH_CSUM; bench <= BENCH_CSUM_COPY; bench++)
+        {
+            tp_out("  %s: %u KB/s aligned, %u KB/s unaligned\n",
+                bench_names[bench], bench_run(bench, src, lens[i]),
+                bench_run(bench, src + 1, lens[i]));
+        }
+    }
+}
@@ -0,0 +1,65 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/tstr.h"
+#include "util/debug.h"
+#include "fs/vfs.h"
+#include "js/js_eval.h"
+#include "js/js_snapshot.h"
+#include "apps/app.h"
+
+/* Evaluate the given files and save the resulting heap, to be restored at
+ * boot by targets configured with CONFIG_JS_SNAPSHOT_BOOT
+ */
+void app_start(int argc, char *argv[])
+{
+    tstr_t code, file, image;
+    int i;
+    
+    if (argc < 3)
+        tp_crit("Usage %s <snapshot> <file>...\n", argv[0]);
+
+    for (i = 2; i < argc; i++)
+    {
+        tstr_init(&file, argv[i], strlen(argv[i]), 0);
+        if (vfs_file_read(&code, &file, VFS_FLAGS_ANY_FS))
+            tp_crit("Error reading file %s\n", argv[i]);
+
+        if (js_eval_rank(code))
+            tp_crit("Invalid code, cannot execute\n");
+
+        js_eval_noret(&code);
+        tstr_free(&code);
+    }
+
+    if (js_snapshot_save(&image))
+        tp_crit("Failed to save snapshot\n");
+
+    tstr_init(&file, argv[1], strlen(argv[1]), 0);
+    if (vfs_file_write(&image, &file))
+        tp_crit("Error writing snapshot %s\n", argv[1]);
+
+    tp_out("Saved snapshot %s, %d bytes\n", argv[1], image.len);
+    tstr_free(&image);
+}
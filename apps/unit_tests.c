@@ -25,6 +25,31 @@
 #include "main/console.h"
 #include "util/history.h"
 #include "util/tp_misc.h"
+#ifdef CONFIG_NET
+#include "net/net_utils.h"
+#endif
+#ifdef CONFIG_BLOCK_CACHE
+#include "drivers/block/block.h"
+#endif
+#ifdef CONFIG_TCP
+#include "net/tcp.h"
+#include "net/ipv4.h"
+#include "util/event.h"
+#include "platform/platform.h"
+#endif
+#if defined(CONFIG_NET_ESP8266) && defined(CONFIG_PLATFORM_EMULATION)
+#include "drivers/net/esp8266.h"
+#include "drivers/serial/serial.h"
+#include "platform/platform.h"
+#include "platform/unix/sim.h"
+#include "platform/unix/unix.h"
+#include "util/event.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#define ESP8266_TEST
+#endif
 
 static history_t *history;
 static char test_buf[CONFIG_CLI_BUFFER_SIZE];
@@ -90,8 +115,815 @@ static int history_test(void)
     return rc;
 }
 
+#ifdef CONFIG_NET
+/* Straightforward RFC 1071 sum, in network order */
+static u16 net_csum_ref(const u8 *buf, int len)
+{
+    u32 sum = 0;
+
+    for (; len > 1; len -= 2, buf += 2)
+        sum += buf[0] << 8 | buf[1];
+    if (len)
+        sum += buf[0] << 8;
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return htons((u16)~sum);
+}
+
+static int net_csum_test(void)
+{
+    static u8 buf[256 + 8], copy[256 + 8];
+    u8 *p, hdr[20];
+    u32 seed = 0x1234567, old, new;
+    int rc = 0, rc2 = 0, i, off, len;
+    u16 csum;
+
+    console_printf("Starting Net Checksum Unit Test\n");
+
+    for (i = 0; i < sizeof(buf); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = seed >> 16;
+    }
+
+    console_printf("net_csum() alignment test: ");
+    for (off = 0; off < 8 && !rc2; off++)
+    {
+        for (len = 0; len <= 256 && !rc2; len++)
+        {
+            p = buf + off;
+            csum = net_csum_ref(p, len);
+            rc2 = net_csum((u16 *)p, len) != csum ||
+                net_csum_fold(net_csum_partial(p, len & ~1,
+                net_csum_partial(p + (len & ~1), len & 1, 0))) != csum ||
+                net_csum_fold(net_csum_copy(copy + 7 - off, p, len, 0)) !=
+                csum || memcmp(copy + 7 - off, p, len);
+        }
+    }
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    console_printf("net_csum_update test: ");
+    memcpy(hdr, buf, sizeof(hdr));
+    csum = net_csum((u16 *)hdr, sizeof(hdr));
+    old = hdr[8] << 8 | hdr[9];
+    hdr[8]--; /* TTL */
+    csum = net_csum_update16(csum, htons(old), htons(hdr[8] << 8 | hdr[9]));
+    rc2 = csum != net_csum((u16 *)hdr, sizeof(hdr));
+    memcpy(&old, hdr + 12, 4);
+    new = htonl(0x0a090002);
+    memcpy(hdr + 12, &new, 4);
+    csum = net_csum_update32(csum, old, new);
+    rc2 |= csum != net_csum((u16 *)hdr, sizeof(hdr));
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    console_printf("Net Checksum Unit Test: %s\n", rc ? "Fail" : "Pass");
+    return rc;
+}
+#endif
+
+#ifdef CONFIG_BLOCK_CACHE
+#define BLOCK_TEST_SECTOR 100
+#define BLOCK_TEST_COUNT (CONFIG_BLOCK_CACHE_SECTORS + 4)
+
+static u8 block_test_data[BLOCK_TEST_COUNT][BLOCK_SECTOR_SIZE];
+static u8 block_test_buf[BLOCK_TEST_COUNT][BLOCK_SECTOR_SIZE];
+
+static void block_test_fill(u8 seed)
+{
+    int i, j;
+
+    for (i = 0; i < BLOCK_TEST_COUNT; i++)
+    {
+        for (j = 0; j < BLOCK_SECTOR_SIZE; j++)
+            block_test_data[i][j] = seed + i * 3 + j;
+    }
+}
+
+static int block_test_cmp(const char *what)
+{
+    if (!memcmp(block_test_data, block_test_buf, sizeof(block_test_buf)))
+        return 0;
+
+    console_printf("%s: data mismatch\n", what);
+    return -1;
+}
+
+static int block_cache_test(void)
+{
+    block_cache_stats_t stats;
+    int rc = 0, rc2, i;
+
+    console_printf("Starting Block Cache Unit Test\n");
+
+    if (block_init())
+    {
+        console_printf("Block Cache Unit Test: no block device\n");
+        return -1;
+    }
+
+    console_printf("write back test: ");
+    block_cache_stats_reset();
+    block_test_fill(1);
+    for (i = 0; i < BLOCK_TEST_COUNT; i++)
+        block_write(block_test_data[i], BLOCK_TEST_SECTOR + i, 1);
+    block_ioctl(BLOCK_IOCTL_SYNC, NULL);
+    block_cache_stats_get(&stats);
+    /* A full cache of dirty sectors is written in a single command */
+    rc2 = stats.written != BLOCK_TEST_COUNT || stats.writes !=
+        (BLOCK_TEST_COUNT + CONFIG_BLOCK_CACHE_SECTORS - 1) /
+        CONFIG_BLOCK_CACHE_SECTORS;
+    block_dev_read(block_test_buf[0], BLOCK_TEST_SECTOR, BLOCK_TEST_COUNT);
+    rc2 |= block_test_cmp("device");
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    console_printf("read test: ");
+    block_init();
+    block_cache_stats_reset();
+    for (i = 0; i < BLOCK_TEST_COUNT; i++)
+        block_read(block_test_buf[i], BLOCK_TEST_SECTOR + i, 1);
+    rc2 = block_test_cmp("single");
+    block_cache_stats_get(&stats);
+#if CONFIG_BLOCK_CACHE_READ_AHEAD > 1 && CONFIG_BLOCK_CACHE_SECTORS > 1
+    /* Sequential misses are read ahead */
+    rc2 |= stats.reads >= BLOCK_TEST_COUNT - 1;
+#endif
+    memset(block_test_buf, 0, sizeof(block_test_buf));
+    block_read(block_test_buf[0], BLOCK_TEST_SECTOR, BLOCK_TEST_COUNT);
+    rc2 |= block_test_cmp("multi");
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    console_printf("coherency test: ");
+    block_test_fill(7);
+    block_write(block_test_data[1], BLOCK_TEST_SECTOR + 1, 1);
+    block_read(block_test_buf[0], BLOCK_TEST_SECTOR, BLOCK_TEST_COUNT);
+    rc2 = memcmp(block_test_buf[1], block_test_data[1], BLOCK_SECTOR_SIZE);
+    block_write(block_test_data[0], BLOCK_TEST_SECTOR, BLOCK_TEST_COUNT);
+    block_ioctl(BLOCK_IOCTL_SYNC, NULL);
+    for (i = 0; i < BLOCK_TEST_COUNT; i++)
+        block_read(block_test_buf[i], BLOCK_TEST_SECTOR + i, 1);
+    rc2 |= block_test_cmp("cache");
+    block_dev_read(block_test_buf[0], BLOCK_TEST_SECTOR, BLOCK_TEST_COUNT);
+    rc2 |= block_test_cmp("device");
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    console_printf("Block Cache Unit Test: %s\n", rc ? "Fail" : "Pass");
+    return rc;
+}
+#endif
+
+#ifdef CONFIG_TCP
+/* TCP against a scripted peer on a loopback Ethernet interface. Our frames
+ * are captured as they are sent, the peer's are queued as received frames.
+ */
+#define TCP_TEST_IP 0x0a000001
+#define TCP_TEST_PEER_IP 0x0a000002
+#define TCP_TEST_PORT 80
+#define TCP_TEST_FRAME_SIZE 256
+#define TCP_TEST_RX_FRAMES 4
+#define TCP_TEST_SEGS 16
+
+typedef struct {
+    u8 flags;
+    u32 seq;
+    u32 ack;
+    u16 window;
+    u16 len;
+} tcp_test_seg_t;
+
+static struct {
+    etherif_t ethif;
+    u8 rx[TCP_TEST_RX_FRAMES][TCP_TEST_FRAME_SIZE];
+    int rx_len[TCP_TEST_RX_FRAMES];
+    int rx_head, rx_count;
+    tcp_test_seg_t segs[TCP_TEST_SEGS];
+    int seg_head, seg_count;
+    u16 peer_port;
+} tcp_test_ctx;
+
+static const eth_mac_t tcp_test_mac = { .mac = { 2, 0, 0, 0, 0, 1 } };
+static const eth_mac_t tcp_test_peer_mac = { .mac = { 2, 0, 0, 0, 0, 2 } };
+static ipv4_info_t tcp_test_ipv4_info = {
+    .ip = TCP_TEST_IP,
+    .netmask = 0xffffff00,
+};
+
+static u8 *tcp_test_rx_frame(int len)
+{
+    int slot;
+
+    tp_assert(tcp_test_ctx.rx_count < TCP_TEST_RX_FRAMES);
+    slot = (tcp_test_ctx.rx_head + tcp_test_ctx.rx_count++) % TCP_TEST_RX_FRAMES;
+    tcp_test_ctx.rx_len[slot] = len;
+    memset(tcp_test_ctx.rx[slot], 0, len);
+    return tcp_test_ctx.rx[slot];
+}
+
+static void tcp_test_arp_reply(const arp_packet_t *req)
+{
+    eth_hdr_t *eth = (eth_hdr_t *)tcp_test_rx_frame(sizeof(eth_hdr_t) +
+        sizeof(arp_packet_t));
+    arp_packet_t *arp = (arp_packet_t *)(eth + 1);
+
+    eth->dst = tcp_test_mac;
+    eth->src = tcp_test_peer_mac;
+    eth->eth_type = htons(ETHER_PROTOCOL_ARP);
+    *arp = *req;
+    arp->oper = htons(2);
+    arp->sha = tcp_test_peer_mac;
+    arp->spa = req->tpa;
+    arp->tha = req->sha;
+    arp->tpa = req->spa;
+    etherif_packet_received(&tcp_test_ctx.ethif);
+}
+
+/* Send a segment from the peer, mss < 0 for no MSS option */
+static void tcp_test_inject(u8 flags, u32 seq, u32 ack, u16 window, int mss)
+{
+    int opt_len = mss < 0 ? 0 : 4, tcp_len = sizeof(tcp_hdr_t) + opt_len;
+    eth_hdr_t *eth = (eth_hdr_t *)tcp_test_rx_frame(sizeof(eth_hdr_t) +
+        sizeof(ip_hdr_t) + tcp_len);
+    ip_hdr_t *iph = (ip_hdr_t *)(eth + 1);
+    tcp_hdr_t *tcph = (tcp_hdr_t *)(iph + 1);
+    u8 *opt = (u8 *)(tcph + 1);
+    struct __attribute__((packed)) {
+        u32 src_addr, dst_addr;
+        u8 zero, protocol;
+        u16 length;
+    } ph;
+
+    eth->dst = tcp_test_mac;
+    eth->src = tcp_test_peer_mac;
+    eth->eth_type = htons(ETHER_PROTOCOL_IP);
+
+    iph->ver = 4;
+    iph->ihl = 5;
+    iph->tot_len = htons(sizeof(ip_hdr_t) + tcp_len);
+    iph->ttl = 64;
+    iph->protocol = IP_PROTOCOL_TCP;
+    iph->src_addr = htonl(TCP_TEST_PEER_IP);
+    iph->dst_addr = htonl(TCP_TEST_IP);
+    iph->checksum = net_csum((u16 *)iph, sizeof(ip_hdr_t));
+
+    tcph->src_port = htons(tcp_test_ctx.peer_port);
+    tcph->dst_port = htons(TCP_TEST_PORT);
+    tcph->seq = htonl(seq);
+    tcph->ack = htonl(ack);
+    tcph->data_off = tcp_len / 4;
+    tcph->flags = flags;
+    tcph->window = htons(window);
+    if (opt_len)
+    {
+        opt[0] = 2; /* MSS */
+        opt[1] = 4;
+        opt[2] = mss >> 8;
+        opt[3] = mss & 0xff;
+    }
+
+    ph.src_addr = iph->src_addr;
+    ph.dst_addr = iph->dst_addr;
+    ph.zero = 0;
+    ph.protocol = IP_PROTOCOL_TCP;
+    ph.length = htons(tcp_len);
+    tcph->checksum = net_csum_fold(net_csum_partial(tcph, tcp_len,
+        net_csum_partial(&ph, sizeof(ph), 0)));
+
+    etherif_packet_received(&tcp_test_ctx.ethif);
+}
+
+static int tcp_test_link_status(etherif_t *ethif)
+{
+    return 1;
+}
+
+static void tcp_test_mac_addr_get(etherif_t *ethif, eth_mac_t *mac)
+{
+    *mac = tcp_test_mac;
+}
+
+static int tcp_test_packet_recv(etherif_t *ethif, u8 *buf, int size)
+{
+    int slot = tcp_test_ctx.rx_head, len;
+
+    if (!tcp_test_ctx.rx_count)
+        return -1;
+
+    len = MIN(size, tcp_test_ctx.rx_len[slot]);
+    memcpy(buf, tcp_test_ctx.rx[slot], len);
+    tcp_test_ctx.rx_head = (slot + 1) % TCP_TEST_RX_FRAMES;
+    tcp_test_ctx.rx_count--;
+    return len;
+}
+
+static int tcp_test_packet_pending(etherif_t *ethif)
+{
+    return tcp_test_ctx.rx_count;
+}
+
+static void tcp_test_packet_xmit(etherif_t *ethif, u8 *buf, int size)
+{
+    eth_hdr_t *eth = (eth_hdr_t *)buf;
+    ip_hdr_t *iph = (ip_hdr_t *)(eth + 1);
+    tcp_hdr_t *tcph = (tcp_hdr_t *)(iph + 1);
+    tcp_test_seg_t *seg;
+
+    if (eth->eth_type == htons(ETHER_PROTOCOL_ARP))
+    {
+        tcp_test_arp_reply((arp_packet_t *)(eth + 1));
+        return;
+    }
+
+    if (eth->eth_type != htons(ETHER_PROTOCOL_IP) ||
+        iph->protocol != IP_PROTOCOL_TCP)
+    {
+        return;
+    }
+
+    tp_assert(tcp_test_ctx.seg_count < TCP_TEST_SEGS);
+    seg = &tcp_test_ctx.segs[(tcp_test_ctx.seg_head + tcp_test_ctx.seg_count++) %
+        TCP_TEST_SEGS];
+    seg->flags = tcph->flags;
+    seg->seq = ntohl(tcph->seq);
+    seg->ack = ntohl(tcph->ack);
+    seg->window = ntohs(tcph->window);
+    seg->len = ntohs(iph->tot_len) - sizeof(ip_hdr_t) - tcph->data_off * 4;
+}
+
+static void tcp_test_free(etherif_t *ethif)
+{
+}
+
+static const etherif_ops_t tcp_test_ops = {
+    .link_status = tcp_test_link_status,
+    .mac_addr_get = tcp_test_mac_addr_get,
+    .packet_recv = tcp_test_packet_recv,
+    .packet_pending = tcp_test_packet_pending,
+    .packet_xmit = tcp_test_packet_xmit,
+    .free = tcp_test_free,
+};
+
+static void tcp_test_tick(event_t *e, u32 resource_id, u64 timestamp)
+{
+}
+
+/* Keeps the event loop from sleeping past our deadlines */
+static event_t tcp_test_tick_evt = { .trigger = tcp_test_tick };
+
+/* Run the event loop until we send a segment or ms pass */
+static tcp_test_seg_t *tcp_test_next(int ms)
+{
+    u64 end = platform_get_ticks_from_boot() + ms;
+    tcp_test_seg_t *seg;
+
+    while (!tcp_test_ctx.seg_count && platform_get_ticks_from_boot() < end)
+        event_loop_single(NULL);
+
+    if (!tcp_test_ctx.seg_count)
+        return NULL;
+
+    seg = &tcp_test_ctx.segs[tcp_test_ctx.seg_head];
+    tcp_test_ctx.seg_head = (tcp_test_ctx.seg_head + 1) % TCP_TEST_SEGS;
+    tcp_test_ctx.seg_count--;
+    return seg;
+}
+
+static int tcp_test_expect(const char *what, u8 flags, u32 seq, u16 len,
+    int ms)
+{
+    tcp_test_seg_t *seg = tcp_test_next(ms);
+
+    if (!seg)
+    {
+        console_printf("%s: no segment\n", what);
+        return -1;
+    }
+
+    if (seg->flags != flags || seg->seq != seq || seg->len != len)
+    {
+        console_printf("%s: flags %x seq %u len %d, expected %x %u %d\n",
+            what, seg->flags, seg->seq, seg->len, flags, seq, len);
+        return -1;
+    }
+    return 0;
+}
+
+static int tcp_test_accept(int listen_sock, u16 peer_port, u32 peer_seq,
+    int mss, u32 *iss)
+{
+    tcp_test_seg_t *seg;
+    int sock = -1;
+
+    tcp_test_ctx.peer_port = peer_port;
+    tcp_test_inject(0x02, peer_seq, 0, 1024, mss); /* SYN */
+    if (!(seg = tcp_test_next(100)) || seg->flags != 0x12 ||
+        seg->ack != peer_seq + 1)
+    {
+        console_printf("no SYN ACK\n");
+        return -1;
+    }
+
+    *iss = seg->seq;
+    tcp_test_inject(0x10, peer_seq + 1, *iss + 1, 1024, -1);
+    while (sock < 0 && !tcp_test_next(20))
+        sock = tcp_accept(&tcp_test_ctx.ethif, listen_sock);
+    return sock;
+}
+
+static int tcp_test(void)
+{
+    const u32 p = 1000; /* Peer ISS */
+    etherif_t *ethif = &tcp_test_ctx.ethif;
+    int rc = 0, rc2, tick_id, listen_sock, sock, i;
+    char data[100] = {};
+    tcp_test_seg_t *seg;
+    u32 iss;
+
+    console_printf("Starting TCP Unit Test\n");
+
+    memset(&tcp_test_ctx, 0, sizeof(tcp_test_ctx));
+    etherif_construct(ethif, "tcp_test", &tcp_test_ops);
+    etherif_ipv4_info_set(ethif, &tcp_test_ipv4_info);
+    tick_id = event_timer_set_period(10, &tcp_test_tick_evt);
+    listen_sock = tcp_listen(ethif, TCP_TEST_PORT);
+
+    /* A zero MSS is ignored, otherwise nothing could be sent */
+    console_printf("zero MSS test: ");
+    sock = tcp_test_accept(listen_sock, 4000, p, 0, &iss);
+    rc2 = sock < 0 || tcp_write(ethif, sock, data, 100) != 100 ||
+        tcp_test_expect("data", 0x18, iss + 1, 100, 100);
+    /* Immediate ACKs bring the RTO down to its minimum */
+    tcp_test_inject(0x10, p + 1, iss + 101, 1024, -1);
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+    if (rc2)
+        goto Exit;
+
+    console_printf("retransmission test: ");
+    tcp_write(ethif, sock, data, 50);
+    rc2 = tcp_test_expect("data", 0x18, iss + 101, 50, 100) ||
+        tcp_test_expect("retransmit", 0x18, iss + 101, 50, 1000);
+    /* Close the window */
+    tcp_test_inject(0x10, p + 1, iss + 151, 0, -1);
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    /* Probing goes on past the retry limit while the peer answers */
+    console_printf("zero window test: ");
+    tcp_write(ethif, sock, data, 10);
+    /* One probe more than TCP allows retransmissions */
+    for (i = 0, rc2 = 0; i < 7 && !rc2; i++)
+    {
+        rc2 = tcp_test_expect("probe", 0x10, iss + 151, 1, 20000);
+        tcp_test_inject(0x10, p + 1, iss + 151, 0, -1);
+    }
+    /* The window opens, taking in the probe */
+    tcp_test_inject(0x10, p + 1, iss + 152, 1024, -1);
+    rc2 |= tcp_test_expect("data", 0x18, iss + 152, 9, 100);
+    tcp_test_inject(0x10, p + 1, iss + 161, 1024, -1);
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    console_printf("passive close test: ");
+    tcp_test_inject(0x11, p + 1, iss + 161, 1024, -1); /* FIN */
+    rc2 = tcp_test_expect("FIN ACK", 0x10, iss + 161, 0, 100);
+    tcp_close(ethif, sock);
+    rc2 |= tcp_test_expect("FIN", 0x11, iss + 161, 0, 100);
+    tcp_test_inject(0x10, p + 2, iss + 162, 1024, -1);
+    tcp_test_next(20);
+    /* The connection is gone */
+    tcp_test_inject(0x10, p + 2, iss + 162, 1024, -1);
+    rc2 |= tcp_test_expect("reset", 0x04, iss + 162, 0, 100);
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    console_printf("active close test: ");
+    sock = tcp_test_accept(listen_sock, 4001, p, -1, &iss);
+    rc2 = sock < 0;
+    tcp_close(ethif, sock);
+    rc2 |= tcp_test_expect("FIN", 0x11, iss + 1, 0, 100);
+    tcp_test_inject(0x10, p + 1, iss + 2, 1024, -1); /* FIN_WAIT_2 */
+    rc2 |= tcp_test_next(20) != NULL;
+    tcp_test_inject(0x11, p + 1, iss + 2, 1024, -1); /* TIME_WAIT */
+    rc2 |= tcp_test_expect("FIN ACK", 0x10, iss + 2, 0, 100);
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    /* A retransmitted SYN means our SYN ACK was lost */
+    console_printf("SYN retransmission test: ");
+    tcp_test_ctx.peer_port = 4003;
+    tcp_test_inject(0x02, p, 0, 1024, -1);
+    rc2 = !(seg = tcp_test_next(100)) || seg->flags != 0x12;
+    iss = seg ? seg->seq : 0;
+    tcp_test_inject(0x02, p, 0, 1024, -1);
+    rc2 |= tcp_test_expect("SYN ACK", 0x12, iss, 0, 100);
+    tcp_test_inject(0x04, p + 1, 0, 1024, -1);
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    /* A half open connection is reset when closed */
+    console_printf("connecting close test: ");
+    tcp_test_ctx.peer_port = 4002;
+    sock = tcp_connect(ethif, TCP_TEST_PEER_IP, tcp_test_ctx.peer_port);
+    rc2 = sock < 0 || !(seg = tcp_test_next(100)) || seg->flags != 0x02;
+    iss = seg ? seg->seq : 0;
+    tcp_close(ethif, sock);
+    rc2 |= tcp_test_expect("reset", 0x04, iss + 1, 0, 100);
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+Exit:
+    tcp_close(ethif, listen_sock);
+    event_timer_del(tick_id);
+    etherif_destruct(ethif);
+    console_printf("TCP Unit Test: %s\n", rc ? "Fail" : "Pass");
+    return rc;
+}
+#endif
+
+#ifdef ESP8266_TEST
+/* The driver against an emulated module on the other end of a socket pair */
+#define ESP8266_TEST_IP 0x0a000005
+
+static struct {
+    int fd; /* Module side */
+    char buf[128];
+    int len;
+    int send_left; /* CIPSEND payload still expected */
+    int sent, closes, listens;
+    int ready, connected, data_avail;
+} esp8266_test_ctx;
+
+static void esp8266_test_reply(const char *s)
+{
+    if (write(esp8266_test_ctx.fd, s, strlen(s)) != strlen(s))
+        console_printf("esp8266 test: short write\n");
+}
+
+static void esp8266_test_cmd(const char *cmd)
+{
+    char reply[32];
+    int link, len;
+
+    if (!strcmp(cmd, "AT+RST"))
+        esp8266_test_reply("ready\r\n");
+    else if (!strcmp(cmd, "AT+CWMODE=1"))
+        esp8266_test_reply("no change\r\n");
+    else if (!strcmp(cmd, "AT+CIFSR"))
+        esp8266_test_reply("AT+CIFSR\r\r\n10.0.0.5\r\n");
+    else if (sscanf(cmd, "AT+CIPSTART=%d", &link) == 1)
+    {
+        sprintf(reply, "%d,CONNECT\r\nOK\r\n", link);
+        esp8266_test_reply(reply);
+    }
+    else if (sscanf(cmd, "AT+CIPSEND=%d,%d", &link, &len) == 2)
+    {
+        esp8266_test_ctx.send_left = len;
+        esp8266_test_reply(">");
+    }
+    else if (sscanf(cmd, "AT+CIPCLOSE=%d", &link) == 1)
+    {
+        esp8266_test_ctx.closes++;
+        sprintf(reply, "%d,CLOSED\r\nOK\r\n", link);
+        esp8266_test_reply(reply);
+    }
+    else
+    {
+        if (!strncmp(cmd, "AT+CIPSERVER=", 13))
+            esp8266_test_ctx.listens++;
+        esp8266_test_reply("OK\r\n");
+    }
+}
+
+/* Answers whatever the driver sent so far */
+static void esp8266_test_module(void)
+{
+    char *end;
+    int len;
+
+    len = read(esp8266_test_ctx.fd, esp8266_test_ctx.buf +
+        esp8266_test_ctx.len, sizeof(esp8266_test_ctx.buf) - 1 -
+        esp8266_test_ctx.len);
+    if (len > 0)
+        esp8266_test_ctx.len += len;
+
+    for (;;)
+    {
+        char *buf = esp8266_test_ctx.buf;
+
+        if (esp8266_test_ctx.send_left)
+        {
+            len = MIN(esp8266_test_ctx.len, esp8266_test_ctx.send_left);
+            esp8266_test_ctx.send_left -= len;
+            esp8266_test_ctx.sent += len;
+            if (!esp8266_test_ctx.send_left)
+                esp8266_test_reply("SEND OK\r\n");
+        }
+        else
+        {
+            /* Commands are terminated by '\r', some with a trailing NUL */
+            buf[esp8266_test_ctx.len] = '\0';
+            if (!(end = memchr(buf, '\r', esp8266_test_ctx.len)))
+                break;
+
+            *end = '\0';
+            esp8266_test_cmd(buf);
+            len = end + 1 - buf;
+            if (len < esp8266_test_ctx.len && !buf[len])
+                len++;
+        }
+
+        if (!len)
+            break;
+        esp8266_test_ctx.len -= len;
+        memmove(buf, buf + len, esp8266_test_ctx.len);
+    }
+}
+
+static void esp8266_test_tick(event_t *e, u32 resource_id, u64 timestamp)
+{
+    esp8266_test_module();
+}
+
+static event_t esp8266_test_tick_evt = { .trigger = esp8266_test_tick };
+
+static void esp8266_test_ready(event_t *e, u32 resource_id, u64 timestamp)
+{
+    esp8266_test_ctx.ready = 1;
+}
+
+static void esp8266_test_connected(event_t *e, u32 resource_id,
+    u64 timestamp)
+{
+    esp8266_test_ctx.connected = 1;
+}
+
+static void esp8266_test_data_avail(event_t *e, u32 resource_id,
+    u64 timestamp)
+{
+    esp8266_test_ctx.data_avail = 1;
+}
+
+static event_t esp8266_test_ready_evt = { .trigger = esp8266_test_ready };
+static event_t esp8266_test_connected_evt = {
+    .trigger = esp8266_test_connected
+};
+static event_t esp8266_test_data_avail_evt = {
+    .trigger = esp8266_test_data_avail
+};
+
+/* Run the event loop until *flag is set or ms pass */
+static int esp8266_test_run(int *flag, int ms)
+{
+    u64 end = platform_get_ticks_from_boot() + ms;
+
+    while ((!flag || !*flag) && platform_get_ticks_from_boot() < end)
+        event_loop_single(NULL);
+    return flag && !*flag;
+}
+
+static int esp8266_test_accept(netif_t *netif, int listen_sock)
+{
+    u64 end = platform_get_ticks_from_boot() + 100;
+    int sock;
+
+    while ((sock = netif_tcp_accept(netif, listen_sock)) < 0 &&
+        platform_get_ticks_from_boot() < end)
+    {
+        event_loop_single(NULL);
+    }
+    return sock;
+}
+
+static int esp8266_test(void)
+{
+    esp8266_params_t params = {};
+    int rc = 0, rc2, fds[2], id, tick_id, i, sock, listen_sock;
+    netif_t *netif;
+    char buf[8];
+
+    console_printf("Starting ESP8266 Unit Test\n");
+
+    memset(&esp8266_test_ctx, 0, sizeof(esp8266_test_ctx));
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) ||
+        (id = unix_sim_event_id_alloc()) < 0)
+    {
+        console_printf("ESP8266 Unit Test: Fail\n");
+        return -1;
+    }
+
+    unix_set_nonblock(fds[0]);
+    unix_set_nonblock(fds[1]);
+    unix_sim_add_fd_event_to_map(id, fds[0], fds[0]);
+    esp8266_test_ctx.fd = fds[1];
+    tick_id = event_timer_set_period(10, &esp8266_test_tick_evt);
+
+    params.serial_port = UART_RES(id);
+    netif = esp8266_new(&params);
+    netif_on_event_set(netif, NETIF_EVENT_READY, &esp8266_test_ready_evt);
+    netif_on_event_set(netif, NETIF_EVENT_IPV4_CONNECTED,
+        &esp8266_test_connected_evt);
+
+    console_printf("bring up test: ");
+    rc2 = esp8266_test_run(&esp8266_test_ctx.ready, 8000);
+    if (!rc2)
+    {
+        netif_ip_connect(netif);
+        rc2 = esp8266_test_run(&esp8266_test_ctx.connected, 8000) ||
+            netif_ip_addr_get(netif) != ESP8266_TEST_IP;
+    }
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+    if (rc2)
+        goto Exit;
+
+    /* Listen toggles collapse into the latest setting */
+    console_printf("listen test: ");
+    for (i = 0; i < 20; i++)
+    {
+        listen_sock = netif_tcp_listen(netif, 80);
+        netif_tcp_disconnect(netif, listen_sock);
+    }
+    listen_sock = netif_tcp_listen(netif, 80);
+    esp8266_test_run(NULL, 100);
+    rc2 = listen_sock < 0 || esp8266_test_ctx.listens > 2;
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    /* Data that arrived before the accept is announced after it */
+    console_printf("accept test: ");
+    esp8266_test_reply("0,CONNECT\r\n+IPD,0,5:hello");
+    sock = esp8266_test_accept(netif, listen_sock);
+    rc2 = sock != 0;
+    if (!rc2)
+    {
+        netif_sock_on_event_set(netif, sock, NETIF_SOCK_EVENT_DATA_AVAIL,
+            &esp8266_test_data_avail_evt);
+        rc2 = esp8266_test_run(&esp8266_test_ctx.data_avail, 100) ||
+            netif_tcp_read(netif, sock, buf, sizeof(buf)) != 5 ||
+            memcmp(buf, "hello", 5);
+    }
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    /* A send and a close on every link at once */
+    console_printf("all links test: ");
+    rc2 = 0;
+    for (i = 1; i < 5; i++)
+        rc2 |= netif_tcp_connect(netif, 0x0a000002, 1000 + i) != i;
+    esp8266_test_run(NULL, 200);
+    for (i = 0; i < 5; i++)
+    {
+        rc2 |= netif_tcp_write(netif, i, "bye", 3) != 3;
+        netif_tcp_disconnect(netif, i);
+    }
+    esp8266_test_run(NULL, 500);
+    rc2 |= esp8266_test_ctx.sent != 15 || esp8266_test_ctx.closes != 5;
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+    /* Nothing of the driver may run once freed */
+    console_printf("free test: ");
+    esp8266_test_reply("2,CONNECT\r\n+IPD,2,2:hi");
+    rc2 = esp8266_test_accept(netif, listen_sock) != 2;
+    netif_free(netif);
+    netif = NULL;
+    esp8266_test_reply("+IPD,2,2:hi");
+    esp8266_test_run(NULL, 50);
+    console_printf("%s\n", rc2 ? "Fail" : "Pass");
+    rc |= rc2;
+
+Exit:
+    if (netif)
+        netif_free(netif);
+    event_timer_del(tick_id);
+    unix_sim_remove_fd_event_from_map(id);
+    unix_sim_event_id_free(id);
+    close(fds[0]);
+    close(fds[1]);
+    console_printf("ESP8266 Unit Test: %s\n", rc ? "Fail" : "Pass");
+    return rc;
+}
+#endif
+
 void app_start(int argc, char *argv[])
 {
     console_printf("Application - Unit Tests\n");
     history_test();
+#ifdef CONFIG_NET
+    net_csum_test();
+#endif
+#ifdef CONFIG_BLOCK_CACHE
+    block_cache_test();
+#endif
+#ifdef CONFIG_TCP
+    tcp_test();
+#endif
+#ifdef ESP8266_TEST
+    esp8266_test();
+#endif
 }
@@ -35,12 +35,15 @@
 #define BLOCK_DISK_STATUS_NO_DISK 0x02
 #define BLOCK_DISK_STATUS_PROTECTED 0x04
 
+#define BLOCK_SECTOR_SIZE 512
+
 #ifdef CONFIG_MMC
 #include "drivers/mmc/mmc.h"
 #endif
 #include "platform/platform.h"
+#include "util/tp_types.h"
 
-static inline int block_init(void)
+static inline int block_dev_init(void)
 {
 #ifdef CONFIG_MMC
     return mmc_spi_disk_init();
@@ -51,7 +54,7 @@ static inline int block_init(void)
     return -1;
 }
 
-static inline int block_status(void)
+static inline int block_dev_status(void)
 {
 #ifdef CONFIG_MMC
     return mmc_spi_disk_status();
@@ -62,7 +65,7 @@ static inline int block_status(void)
     return -1;
 }
 
-static inline int block_ioctl(int cmd, void *buf)
+static inline int block_dev_ioctl(int cmd, void *buf)
 {
 #ifdef CONFIG_MMC
     return mmc_spi_disk_ioctl(cmd, buf);
@@ -73,7 +76,7 @@ static inline int block_ioctl(int cmd, void *buf)
     return -1;
 }
 
-static inline int block_read(unsigned char *buf, int sector, int count)
+static inline int block_dev_read(unsigned char *buf, int sector, int count)
 {
 #ifdef CONFIG_MMC
     return mmc_spi_disk_read(buf, sector, count);
@@ -84,7 +87,7 @@ static inline int block_read(unsigned char *buf, int sector, int count)
     return -1;
 }
 
-static inline int block_write(const unsigned char *buf, int sector, int count)
+static inline int block_dev_write(const unsigned char *buf, int sector, int count)
 {
 #ifdef CONFIG_MMC
     return mmc_spi_disk_write(buf, sector, count);
@@ -95,4 +98,51 @@ static inline int block_write(const unsigned char *buf, int sector, int count)
     return -1;
 }
 
+#ifdef CONFIG_BLOCK_CACHE
+
+typedef struct {
+    u32 hits; /* Sectors read from the cache */
+    u32 misses; /* Sectors read from the device */
+    u32 reads; /* Device read commands */
+    u32 writes; /* Device write commands */
+    u32 written; /* Sectors written to the device */
+} block_cache_stats_t;
+
+int block_init(void);
+int block_ioctl(int cmd, void *buf);
+int block_read(unsigned char *buf, int sector, int count);
+int block_write(const unsigned char *buf, int sector, int count);
+
+void block_cache_stats_get(block_cache_stats_t *stats);
+void block_cache_stats_reset(void);
+
+#else
+
+static inline int block_init(void)
+{
+    return block_dev_init();
+}
+
+static inline int block_ioctl(int cmd, void *buf)
+{
+    return block_dev_ioctl(cmd, buf);
+}
+
+static inline int block_read(unsigned char *buf, int sector, int count)
+{
+    return block_dev_read(buf, sector, count);
+}
+
+static inline int block_write(const unsigned char *buf, int sector, int count)
+{
+    return block_dev_write(buf, sector, count);
+}
+
+#endif
+
+static inline int block_status(void)
+{
+    return block_dev_status();
+}
+
 #endif
@@ -0,0 +1,429 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/debug.h"
+#include "drivers/block/block.h"
+#include <string.h> /* memcpy */
+
+#define CACHE_SECTORS CONFIG_BLOCK_CACHE_SECTORS
+#define NO_SECTOR (-1)
+
+typedef struct {
+    int sector;
+    u32 stamp; /* Larger is more recently used */
+    int dirty;
+} cache_slot_t;
+
+/* Slot data is kept apart from the slot headers so that slots holding
+ * consecutive sectors can be transferred with a single device command.
+ */
+static cache_slot_t slots[CACHE_SECTORS];
+static u8 slot_data[CACHE_SECTORS][BLOCK_SECTOR_SIZE];
+static u32 lru_clock;
+static u32 sector_count;
+static int next_sector = NO_SECTOR;
+static block_cache_stats_t stats;
+
+static int dev_read(u8 *buf, int sector, int count)
+{
+    stats.reads++;
+    return block_dev_read(buf, sector, count);
+}
+
+static int dev_write(const u8 *buf, int sector, int count)
+{
+    stats.writes++;
+    stats.written += count;
+    return block_dev_write(buf, sector, count);
+}
+
+static void slot_touch(int i)
+{
+    slots[i].stamp = ++lru_clock;
+}
+
+static int slot_find(int sector)
+{
+    int i;
+
+    for (i = 0; i < CACHE_SECTORS; i++)
+    {
+        if (slots[i].sector == sector)
+            return i;
+    }
+    return -1;
+}
+
+static int slot_lru(void)
+{
+    int i, lru = 0;
+
+    for (i = 0; i < CACHE_SECTORS; i++)
+    {
+        if (slots[i].sector == NO_SECTOR)
+            return i;
+
+        if (slots[i].stamp < slots[lru].stamp)
+            lru = i;
+    }
+    return lru;
+}
+
+static void slot_swap(int a, int b)
+{
+    cache_slot_t tmp_slot;
+    u8 tmp[32];
+    int i;
+
+    tmp_slot = slots[a];
+    slots[a] = slots[b];
+    slots[b] = tmp_slot;
+
+    for (i = 0; i < BLOCK_SECTOR_SIZE; i += sizeof(tmp))
+    {
+        memcpy(tmp, &slot_data[a][i], sizeof(tmp));
+        memcpy(&slot_data[a][i], &slot_data[b][i], sizeof(tmp));
+        memcpy(&slot_data[b][i], tmp, sizeof(tmp));
+    }
+}
+
+static inline u32 slot_order(int i)
+{
+    /* Unused slots go last */
+    return (u32)slots[i].sector;
+}
+
+/* Order the slots by sector so that runs of consecutive sectors are
+ * contiguous in memory. The cache is small, a selection sort keeps the
+ * number of data swaps down.
+ */
+static void cache_sort(void)
+{
+    int i, j, min;
+
+    for (i = 0; i < CACHE_SECTORS - 1; i++)
+    {
+        min = i;
+        for (j = i + 1; j < CACHE_SECTORS; j++)
+        {
+            if (slot_order(j) < slot_order(min))
+                min = j;
+        }
+        if (min != i)
+            slot_swap(i, min);
+    }
+}
+
+static int cache_flush(void)
+{
+    int i, j, last, rc = 0;
+
+    for (i = 0; i < CACHE_SECTORS && !slots[i].dirty; i++);
+    if (i == CACHE_SECTORS)
+        return 0;
+
+    cache_sort();
+
+    for (i = 0; i < CACHE_SECTORS; i = last + 1)
+    {
+        last = i;
+        if (!slots[i].dirty)
+            continue;
+
+        /* Clean sectors in between are rewritten as is rather than
+         * splitting the run into several commands.
+         */
+        for (j = i + 1; j < CACHE_SECTORS &&
+            slots[j].sector == slots[j - 1].sector + 1; j++)
+        {
+            if (slots[j].dirty)
+                last = j;
+        }
+
+        if (dev_write(slot_data[i], slots[i].sector, last - i + 1))
+        {
+            tp_err("block cache: failed writing sectors %d-%d\n",
+                slots[i].sector, slots[last].sector);
+            rc = -1;
+            continue;
+        }
+
+        for (j = i; j <= last; j++)
+            slots[j].dirty = 0;
+    }
+    return rc;
+}
+
+/* Returns a clean slot that may be reused for a new sector */
+static int slot_evict(void)
+{
+    int i = slot_lru();
+
+    if (slots[i].dirty)
+    {
+        /* Write back everything now, the writes are coalesced */
+        if (cache_flush())
+            return -1;
+
+        /* Slots have moved */
+        i = slot_lru();
+    }
+    slots[i].sector = NO_SECTOR;
+    return i;
+}
+
+static void cache_invalidate(void)
+{
+    int i;
+
+    for (i = 0; i < CACHE_SECTORS; i++)
+    {
+        slots[i].sector = NO_SECTOR;
+        slots[i].dirty = 0;
+    }
+    next_sector = NO_SECTOR;
+}
+
+#if CONFIG_BLOCK_CACHE_READ_AHEAD > 1
+/* Read sector along with the sectors that follow it into consecutive
+ * slots. Returns the slot holding sector or -1 if read ahead is not
+ * possible.
+ */
+static int cache_read_ahead(int sector)
+{
+    int count = CONFIG_BLOCK_CACHE_READ_AHEAD, i, j, start;
+    u32 oldest, best = 0;
+
+    if (count > CACHE_SECTORS)
+        count = CACHE_SECTORS;
+    if (sector_count && count > (int)sector_count - sector)
+        count = (int)sector_count - sector;
+
+    /* Don't duplicate sectors that are already cached */
+    for (i = 1; i < count; i++)
+    {
+        if (slot_find(sector + i) != -1)
+        {
+            count = i;
+            break;
+        }
+    }
+    if (count < 2)
+        return -1;
+
+    /* Pick the least recently used window of slots */
+    for (;;)
+    {
+        start = -1;
+        for (i = 0; i + count <= CACHE_SECTORS; i++)
+        {
+            oldest = 0;
+            for (j = i; j < i + count; j++)
+            {
+                if (slots[j].sector != NO_SECTOR && slots[j].stamp > oldest)
+                    oldest = slots[j].stamp;
+            }
+            if (start == -1 || oldest < best)
+            {
+                best = oldest;
+                start = i;
+            }
+        }
+
+        for (i = start; i < start + count && !slots[i].dirty; i++);
+        if (i == start + count)
+            break;
+
+        /* Write back, then look for a window again as slots have moved */
+        if (cache_flush())
+            return -1;
+    }
+
+    for (i = start; i < start + count; i++)
+        slots[i].sector = NO_SECTOR;
+
+    if (dev_read(slot_data[start], sector, count))
+        return -1;
+
+    for (i = 0; i < count; i++)
+    {
+        slots[start + i].sector = sector + i;
+        slot_touch(start + i);
+    }
+    return start;
+}
+#endif
+
+static int cache_read_one(u8 *buf, int sector)
+{
+    int i;
+
+    if ((i = slot_find(sector)) != -1)
+    {
+        stats.hits++;
+        goto Exit;
+    }
+
+    stats.misses++;
+
+#if CONFIG_BLOCK_CACHE_READ_AHEAD > 1
+    if (sector == next_sector && (i = cache_read_ahead(sector)) != -1)
+        goto Exit;
+#endif
+
+    if ((i = slot_evict()) == -1 || dev_read(slot_data[i], sector, 1))
+        return -1;
+
+    slots[i].sector = sector;
+
+Exit:
+    slot_touch(i);
+    memcpy(buf, slot_data[i], BLOCK_SECTOR_SIZE);
+    return 0;
+}
+
+static int cache_read_many(u8 *buf, int sector, int count)
+{
+    int first = NO_SECTOR, last = NO_SECTOR, i, s;
+
+    /* A single command covers the uncached sectors, cached ones found in
+     * between are overwritten below as they may be dirty.
+     */
+    for (s = sector; s < sector + count; s++)
+    {
+        if (slot_find(s) != -1)
+            continue;
+
+        if (first == NO_SECTOR)
+            first = s;
+        last = s;
+    }
+
+    if (first != NO_SECTOR)
+    {
+        if (dev_read(buf + (first - sector) * BLOCK_SECTOR_SIZE, first,
+            last - first + 1))
+        {
+            return -1;
+        }
+    }
+
+    for (s = sector; s < sector + count; s++)
+    {
+        if ((i = slot_find(s)) == -1)
+        {
+            stats.misses++;
+            continue;
+        }
+
+        stats.hits++;
+        memcpy(buf + (s - sector) * BLOCK_SECTOR_SIZE, slot_data[i],
+            BLOCK_SECTOR_SIZE);
+    }
+    return 0;
+}
+
+int block_read(unsigned char *buf, int sector, int count)
+{
+    int rc;
+
+    if (count == 1)
+        rc = cache_read_one(buf, sector);
+    else
+        rc = cache_read_many(buf, sector, count);
+
+    next_sector = rc ? NO_SECTOR : sector + count;
+    return rc;
+}
+
+int block_write(const unsigned char *buf, int sector, int count)
+{
+    int i, s;
+
+    if (count == 1)
+    {
+        /* Write back, the sector reaches the device on sync or eviction */
+        if ((i = slot_find(sector)) == -1)
+        {
+            if ((i = slot_evict()) == -1)
+                return -1;
+
+            slots[i].sector = sector;
+        }
+
+        memcpy(slot_data[i], buf, BLOCK_SECTOR_SIZE);
+        slots[i].dirty = 1;
+        slot_touch(i);
+        return 0;
+    }
+
+    /* Bulk writes go straight to the device, keep cached copies current */
+    if (dev_write(buf, sector, count))
+        return -1;
+
+    for (s = sector; s < sector + count; s++)
+    {
+        if ((i = slot_find(s)) == -1)
+            continue;
+
+        memcpy(slot_data[i], buf + (s - sector) * BLOCK_SECTOR_SIZE,
+            BLOCK_SECTOR_SIZE);
+        slots[i].dirty = 0;
+    }
+    return 0;
+}
+
+int block_ioctl(int cmd, void *buf)
+{
+    if (cmd == BLOCK_IOCTL_SYNC && cache_flush())
+        return -1;
+
+    return block_dev_ioctl(cmd, buf);
+}
+
+int block_init(void)
+{
+    int rc;
+
+    /* Nothing is dirty before the first initialization */
+    cache_flush();
+    cache_invalidate();
+
+    if ((rc = block_dev_init()))
+        return rc;
+
+    sector_count = 0;
+    block_dev_ioctl(BLOCK_IOCTL_GET_SECTOR_COUNT, &sector_count);
+    return 0;
+}
+
+void block_cache_stats_get(block_cache_stats_t *s)
+{
+    *s = stats;
+}
+
+void block_cache_stats_reset(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
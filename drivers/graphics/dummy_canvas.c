@@ -36,6 +36,18 @@ static void dummy_canvas_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
     tp_out("%s: (%d,%d) = %d\n", __func__, x, y, val);
 }
 
+static void dummy_canvas_fill_rect(canvas_t *c, const canvas_rect_t *r,
+    u16 val)
+{
+    tp_out("%s: (%d,%d)-(%d,%d) = %d\n", __func__, r->x0, r->y0, r->x1,
+        r->y1, val);
+}
+
+static void dummy_canvas_flush(canvas_t *c, const canvas_rect_t *r)
+{
+    tp_out("%s: (%d,%d)-(%d,%d)\n", __func__, r->x0, r->y0, r->x1, r->y1);
+}
+
 static void dummy_canvas_flip(canvas_t *c)
 {
     tp_out("%s\n", __func__);
@@ -49,6 +61,8 @@ static void dummy_canvas_fill(canvas_t *c, u16 val)
 static const canvas_ops_t dummy_canvas_ops = {
     .pixel_set = dummy_canvas_pixel_set,
     .fill = dummy_canvas_fill,
+    .fill_rect = dummy_canvas_fill_rect,
+    .flush = dummy_canvas_flush,
     .flip = dummy_canvas_flip,
 };
 
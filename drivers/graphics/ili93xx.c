@@ -32,6 +32,21 @@
 #define BL(i) ((i)->params.backlight)
 #define TRNS(i) ((i)->params.trns)
 
+#define WIDTH 240
+#define HEIGHT 320
+
+/* Registers common to the supported controllers */
+#define ILI93XX_ENTRY_MODE 0x03
+#define ILI93XX_ENTRY_MODE_AM (1<<3) /* Vertical address update */
+#define ILI93XX_ENTRY_MODE_ID (3<<4) /* Address increment */
+#define ILI93XX_HADDR_SET 0x20
+#define ILI93XX_VADDR_SET 0x21
+#define ILI93XX_GRAM_WRITE 0x22
+#define ILI93XX_HSTART 0x50
+#define ILI93XX_HEND 0x51
+#define ILI93XX_VSTART 0x52
+#define ILI93XX_VEND 0x53
+
 typedef struct {
     canvas_t canvas;
     ili93xx_params_t params;
@@ -178,20 +193,95 @@ static int chip_init(ili93xx_t *i)
         else
             ili93xx_reg_write(i, (u8)sequence->cmd, sequence->data);
     }
+
+    /* Block writes fill windows left to right, top to bottom */
+    ili93xx_reg_write(i, ILI93XX_ENTRY_MODE,
+        (ili93xx_reg_read(i, ILI93XX_ENTRY_MODE) & ~ILI93XX_ENTRY_MODE_AM) |
+        ILI93XX_ENTRY_MODE_ID);
     return 0;
 }
 
+/* Start a GRAM write at (x, y) */
+static void ili93xx_gram_write(ili93xx_t *i, u16 x, u16 y)
+{
+    ili93xx_reg_write(i, ILI93XX_HADDR_SET, x);
+    ili93xx_reg_write(i, ILI93XX_VADDR_SET, y);
+    ili93xx_write_cmd(i, ILI93XX_GRAM_WRITE);
+}
+
+static void ili93xx_window_set(ili93xx_t *i, u16 x0, u16 y0, u16 x1, u16 y1)
+{
+    ili93xx_reg_write(i, ILI93XX_HSTART, x0);
+    ili93xx_reg_write(i, ILI93XX_HEND, x1);
+    ili93xx_reg_write(i, ILI93XX_VSTART, y0);
+    ili93xx_reg_write(i, ILI93XX_VEND, y1);
+    ili93xx_gram_write(i, x0, y0);
+}
+
+static void ili93xx_window_reset(ili93xx_t *i)
+{
+    ili93xx_reg_write(i, ILI93XX_HSTART, 0);
+    ili93xx_reg_write(i, ILI93XX_HEND, WIDTH - 1);
+    ili93xx_reg_write(i, ILI93XX_VSTART, 0);
+    ili93xx_reg_write(i, ILI93XX_VEND, HEIGHT - 1);
+}
+
 static void ili93xx_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
 {
     ili93xx_t *i = ILI93XX_FROM_CANVAS(c);
 
-    ili93xx_reg_write(i, 0x20, x);
-    ili93xx_reg_write(i, 0x21, y);
-    ili93xx_reg_write(i, 0x22, val);
+    ili93xx_gram_write(i, x, y);
+    ili93xx_write_data(i, val);
+}
+
+static void ili93xx_fill_rect(canvas_t *c, const canvas_rect_t *r, u16 val)
+{
+    ili93xx_t *i = ILI93XX_FROM_CANVAS(c);
+    u32 n = (u32)(r->x1 - r->x0) * (r->y1 - r->y0);
+
+    ili93xx_window_set(i, r->x0, r->y0, r->x1 - 1, r->y1 - 1);
+    while (n--)
+        ili93xx_write_data(i, val);
+    ili93xx_window_reset(i);
+}
+
+static void ili93xx_write_span(canvas_t *c, u16 x, u16 y, u16 n,
+    const u16 *pixels)
+{
+    ili93xx_t *i = ILI93XX_FROM_CANVAS(c);
+
+    /* The address moves right on its own, no window needed */
+    ili93xx_gram_write(i, x, y);
+    while (n--)
+        ili93xx_write_data(i, *pixels++);
+}
+
+static void ili93xx_blit(canvas_t *c, u16 x, u16 y, const canvas_bitmap_t *b,
+    u16 fg, u16 bg)
+{
+    ili93xx_t *i = ILI93XX_FROM_CANVAS(c);
+    int bx, by;
+
+    ili93xx_window_set(i, x, y, x + b->width - 1, y + b->height - 1);
+    for (by = 0; by < b->height; by++)
+    {
+        for (bx = 0; bx < b->width; bx++)
+            ili93xx_write_data(i, canvas_bitmap_pixel(b, bx, by) ? fg : bg);
+    }
+    ili93xx_window_reset(i);
+}
+
+static void ili93xx_fill(canvas_t *c, u16 val)
+{
+    ili93xx_fill_rect(c, &(canvas_rect_t){ .x1 = WIDTH, .y1 = HEIGHT }, val);
 }
 
 static const canvas_ops_t ili93xx_ops = {
     .pixel_set = ili93xx_pixel_set,
+    .fill = ili93xx_fill,
+    .fill_rect = ili93xx_fill_rect,
+    .write_span = ili93xx_write_span,
+    .blit = ili93xx_blit,
 };
 
 canvas_t *ili93xx_new(const ili93xx_params_t *params)
@@ -203,8 +293,8 @@ canvas_t *ili93xx_new(const ili93xx_params_t *params)
 
     gpio_digital_write(BL(i), 1);
 
-    i->canvas.width = 240;
-    i->canvas.height = 320;
+    i->canvas.width = WIDTH;
+    i->canvas.height = HEIGHT;
     i->canvas.ops = &ili93xx_ops;
     return &i->canvas;
 }
@@ -108,13 +108,19 @@ static void pcd8544_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
         screen->shadow[page * LCD_WIDTH + x] &= ~line_bit;
 }
 
-static void pcd8544_flip(canvas_t *c)
+static void pcd8544_flush(canvas_t *c, const canvas_rect_t *r)
 {
     pcd8544_t *screen = container_of(c, pcd8544_t, canvas);
-    u8 page;
-
-    for (page = 0; page < (LCD_HEIGHT >> 3); page++)
-        pcd8544_write(screen, 0, screen->shadow + page * LCD_WIDTH, LCD_WIDTH);
+    u8 page, addr[2];
+
+    for (page = r->y0 >> 3; page <= (r->y1 - 1) >> 3; page++)
+    {
+        addr[0] = PCD8544_SET_Y_ADDR | page;
+        addr[1] = PCD8544_SET_X_ADDR | r->x0;
+        pcd8544_write(screen, 1, addr, sizeof(addr));
+        pcd8544_write(screen, 0, screen->shadow + page * LCD_WIDTH + r->x0,
+            r->x1 - r->x0);
+    }
 }
 
 static void pcd8544_fill(canvas_t *c, u16 val)
@@ -127,7 +133,7 @@ static void pcd8544_fill(canvas_t *c, u16 val)
 static const canvas_ops_t pcd8544_ops = {
     .pixel_set = pcd8544_pixel_set,
     .fill = pcd8544_fill,
-    .flip = pcd8544_flip,
+    .flush = pcd8544_flush,
 };
 
 canvas_t *pcd8544_new(const pcd8544_params_t *params)
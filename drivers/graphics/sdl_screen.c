@@ -43,9 +43,8 @@ static void render_timer_trigger(event_t *e, u32 resource_id, u64 timestamp)
 {
     sdl_screen_t *screen = container_of(e, sdl_screen_t, render_timer);
 
-    /* Update screen */
-    SDL_UpdateRect(screen->surface, 0, 0, screen->params.width,
-        screen->params.height);
+    /* Update the areas drawn since the last frame */
+    canvas_flip(&screen->canvas);
 }
 
 static void sdl_screen_init(sdl_screen_t *screen)
@@ -71,13 +70,9 @@ static void sdl_screen_init(sdl_screen_t *screen)
     event_timer_set_period(1000/30, &screen->render_timer);
 }
 
-static void sdl_screen_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
+static u16 bgr(u16 val)
 {
-    sdl_screen_t *screen = container_of(c, sdl_screen_t, canvas);
-    u16 *ptr = (u16 *)screen->surface->pixels, bgr_val;
-    int lineoffset;
-
-    lineoffset = y * (screen->surface->pitch / 2);
+    u16 bgr_val;
 
     /* SDL works in BGR mode. Swap values here.
      * XXX: this could be better done by swapping the SDL palette 
@@ -85,12 +80,72 @@ static void sdl_screen_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
     bgr_val = (val & COLOR_BLUE) >> COLOR_BLUE_SHIFT;
     bgr_val |= val & COLOR_GREEN;
     bgr_val |= (val & COLOR_RED) << COLOR_BLUE_SHIFT;
+    return bgr_val;
+}
+
+static u16 *surface_pixel(sdl_screen_t *screen, u16 x, u16 y)
+{
+    return (u16 *)screen->surface->pixels + y * (screen->surface->pitch / 2) +
+        x;
+}
+
+static void sdl_screen_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
+{
+    sdl_screen_t *screen = container_of(c, sdl_screen_t, canvas);
+
+    *surface_pixel(screen, x, y) = bgr(val);
+}
+
+static void sdl_screen_fill_rect(canvas_t *c, const canvas_rect_t *r, u16 val)
+{
+    sdl_screen_t *screen = container_of(c, sdl_screen_t, canvas);
+    SDL_Rect rect = { .x = r->x0, .y = r->y0, .w = r->x1 - r->x0,
+        .h = r->y1 - r->y0 };
+
+    SDL_FillRect(screen->surface, &rect, bgr(val));
+}
+
+static void sdl_screen_write_span(canvas_t *c, u16 x, u16 y, u16 n,
+    const u16 *pixels)
+{
+    sdl_screen_t *screen = container_of(c, sdl_screen_t, canvas);
+    u16 *ptr = surface_pixel(screen, x, y);
+
+    while (n--)
+        *ptr++ = bgr(*pixels++);
+}
+
+static void sdl_screen_blit(canvas_t *c, u16 x, u16 y,
+    const canvas_bitmap_t *b, u16 fg, u16 bg)
+{
+    sdl_screen_t *screen = container_of(c, sdl_screen_t, canvas);
+    int bx, by;
+    u16 *ptr;
+
+    fg = bgr(fg);
+    bg = bgr(bg);
+    for (by = 0; by < b->height; by++)
+    {
+        ptr = surface_pixel(screen, x, y + by);
+        for (bx = 0; bx < b->width; bx++)
+            *ptr++ = canvas_bitmap_pixel(b, bx, by) ? fg : bg;
+    }
+}
+
+static void sdl_screen_flush(canvas_t *c, const canvas_rect_t *r)
+{
+    sdl_screen_t *screen = container_of(c, sdl_screen_t, canvas);
 
-    ptr[lineoffset + x] = bgr_val;
+    SDL_UpdateRect(screen->surface, r->x0, r->y0, r->x1 - r->x0,
+        r->y1 - r->y0);
 }
 
 static const canvas_ops_t sdl_screen_ops = {
     .pixel_set = sdl_screen_pixel_set,
+    .fill_rect = sdl_screen_fill_rect,
+    .write_span = sdl_screen_write_span,
+    .blit = sdl_screen_blit,
+    .flush = sdl_screen_flush,
 };
 
 canvas_t *sdl_screen_new(const sdl_screen_params_t *params)
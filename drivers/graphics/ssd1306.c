@@ -38,10 +38,6 @@ typedef struct {
     ssd1306_params_t params;
     canvas_t canvas;
     u8 shadow[WIDTH * (HEIGHT / 8)];
-    u8 min_ca;
-    u8 max_ca;
-    u8 min_pa;
-    u8 max_pa;
 } ssd1306_t;
 
 #define SSD1306_DISPLAY_OFF 0xae
@@ -112,71 +108,93 @@ static void chip_init(ssd1306_t *screen)
     ssd1306_write(screen, 1, ssd1306_init_seq, ARRAY_SIZE(ssd1306_init_seq));
 }
 
-static void ssd1306_window_set(ssd1306_t *screen)
+static void ssd1306_window_set(ssd1306_t *screen, u8 min_ca, u8 max_ca,
+    u8 min_pa, u8 max_pa)
 {
     u8 cmd[6];
 
     cmd[0] = SSD1306_SET_COL_ADDR;
-    cmd[1] = screen->min_ca;
-    cmd[2] = screen->max_ca;
+    cmd[1] = min_ca;
+    cmd[2] = max_ca;
     cmd[3] = SSD1306_SET_PAGE_ADDR;
-    cmd[4] = screen->min_pa;
-    cmd[5] = screen->max_pa;
+    cmd[4] = min_pa;
+    cmd[5] = max_pa;
     ssd1306_write(screen, 1, cmd, sizeof(cmd));
 }
 
-static void ssd1306_window_update(ssd1306_t *screen, u8 ca, u8 pa)
+static void shadow_set(ssd1306_t *screen, u16 x, u16 y, u16 val)
 {
-    if (ca < screen->min_ca)
-        screen->min_ca = ca;
-    if (ca > screen->max_ca)
-        screen->max_ca = ca;
-    if (pa < screen->min_pa)
-        screen->min_pa = pa;
-    if (pa > screen->max_pa)
-        screen->max_pa = pa;
+    u8 page, line_bit;
+
+    page = y >> 3; /* Each 8 vertical lines are one byte */
+    line_bit = 1 << (y & 0x07);
+
+    if (val)
+        screen->shadow[page * WIDTH + x] |= line_bit;
+    else
+        screen->shadow[page * WIDTH + x] &= ~line_bit;
 }
 
-static void ssd1306_window_reset(ssd1306_t *screen)
+static void ssd1306_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
 {
-    screen->min_pa = HEIGHT >> 3;
-    screen->max_pa = 0;
-    screen->min_ca = WIDTH;
-    screen->max_ca = 0;
+    shadow_set(container_of(c, ssd1306_t, canvas), x, y, val);
 }
 
-static void ssd1306_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
+static void ssd1306_fill_rect(canvas_t *c, const canvas_rect_t *r, u16 val)
 {
     ssd1306_t *screen = container_of(c, ssd1306_t, canvas);
-    u8 page, line_bit;
+    u8 page, mask, *p, *end;
+    u16 y0, y1;
 
-    page = y >> 3; /* Each 8 vertical lines are one byte */
-    line_bit = 1 << (y & 0x07);
+    /* Whole bytes of each page the rectangle covers */
+    for (page = r->y0 >> 3; page <= (r->y1 - 1) >> 3; page++)
+    {
+        y0 = MAX(r->y0, page << 3) & 0x07;
+        y1 = MIN(r->y1, (page + 1) << 3) - (page << 3);
+        mask = (0xff << y0) & (0xff >> (8 - y1));
+
+        end = screen->shadow + page * WIDTH + r->x1;
+        for (p = end - (r->x1 - r->x0); p < end; p++)
+            *p = val ? *p | mask : *p & ~mask;
+    }
+}
 
-    ssd1306_window_update(screen, x, page);
+static void ssd1306_write_span(canvas_t *c, u16 x, u16 y, u16 n,
+    const u16 *pixels)
+{
+    ssd1306_t *screen = container_of(c, ssd1306_t, canvas);
 
-    /* Set shadow */
-    if (val)
-        screen->shadow[page * WIDTH + x] |= line_bit;
-    else
-        screen->shadow[page * WIDTH + x] &= ~line_bit;
+    while (n--)
+        shadow_set(screen, x++, y, *pixels++);
 }
 
-#define WIN_WIDTH(s) ((s)->max_ca - (s)->min_ca + 1)
-#define WIN_PAGE_HEIGHT(s) ((s)->max_pa - (s)->min_pa + 1)
-#define WIN_POS(s, pa) (((pa) + (s)->min_pa) * WIDTH + (s)->min_ca)
-static void ssd1306_flip(canvas_t *c)
+static void ssd1306_blit(canvas_t *c, u16 x, u16 y, const canvas_bitmap_t *b,
+    u16 fg, u16 bg)
 {
     ssd1306_t *screen = container_of(c, ssd1306_t, canvas);
-    int i;
+    int bx, by;
 
-    ssd1306_window_set(screen);
-    for (i = 0; i < WIN_PAGE_HEIGHT(screen); i++)
+    for (by = 0; by < b->height; by++)
     {
-        ssd1306_write(screen, 0, screen->shadow + WIN_POS(screen, i),
-            WIN_WIDTH(screen));
+        for (bx = 0; bx < b->width; bx++)
+        {
+            shadow_set(screen, x + bx, y + by,
+                canvas_bitmap_pixel(b, bx, by) ? fg : bg);
+        }
+    }
+}
+
+static void ssd1306_flush(canvas_t *c, const canvas_rect_t *r)
+{
+    ssd1306_t *screen = container_of(c, ssd1306_t, canvas);
+    u8 page, min_pa = r->y0 >> 3, max_pa = (r->y1 - 1) >> 3;
+
+    ssd1306_window_set(screen, r->x0, r->x1 - 1, min_pa, max_pa);
+    for (page = min_pa; page <= max_pa; page++)
+    {
+        ssd1306_write(screen, 0, screen->shadow + page * WIDTH + r->x0,
+            r->x1 - r->x0);
     }
-    ssd1306_window_reset(screen);
 }
 
 static void ssd1306_fill(canvas_t *c, u16 val)
@@ -184,16 +202,15 @@ static void ssd1306_fill(canvas_t *c, u16 val)
     ssd1306_t *screen = container_of(c, ssd1306_t, canvas);
 
     memset(screen->shadow, val ? 0xff : 0, sizeof(screen->shadow));
-    screen->min_pa = 0;
-    screen->max_pa = (HEIGHT >> 3) - 1;
-    screen->min_ca = 0;
-    screen->max_ca = WIDTH - 1;
 }
 
 static const canvas_ops_t ssd1306_ops = {
     .pixel_set = ssd1306_pixel_set,
     .fill = ssd1306_fill,
-    .flip = ssd1306_flip,
+    .fill_rect = ssd1306_fill_rect,
+    .write_span = ssd1306_write_span,
+    .blit = ssd1306_blit,
+    .flush = ssd1306_flush,
 };
 
 canvas_t *ssd1306_new(const ssd1306_params_t *params)
@@ -204,8 +221,6 @@ canvas_t *ssd1306_new(const ssd1306_params_t *params)
 
     chip_init(screen);
 
-    ssd1306_window_reset(screen);
-
     screen->canvas.width = WIDTH;
     screen->canvas.height = HEIGHT;
     screen->canvas.ops = &ssd1306_ops;
@@ -96,42 +96,101 @@ static void chip_init(ssd1329_t *screen)
         ssd1329_write(screen, 1, cmd + 1, *cmd);
 }
 
-static void ssd1329_set_address(ssd1329_t *screen, u8 min_x, u8 max_x,
-    u8 min_y, u8 max_y)
+static void ssd1329_set_address(ssd1329_t *screen, u8 min_row, u8 max_row,
+    u8 min_col, u8 max_col)
 {
-    ssd1329_write(screen, 1, (u8 []){ 0x15, min_y, max_y }, 3);
-    ssd1329_write(screen, 1, (u8 []){ 0x75, min_x, max_x }, 3);
+    ssd1329_write(screen, 1, (u8 []){ 0x15, min_col, max_col }, 3);
+    ssd1329_write(screen, 1, (u8 []){ 0x75, min_row, max_row }, 3);
 }
 
-static void ssd1329_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
+#define SHADOW_CELL(screen, x, y) \
+    ((screen)->shadow + (y) * (WIDTH / 2) + (x) / 2)
+
+static void shadow_set(ssd1329_t *screen, u16 x, u16 y, u16 val)
 {
-    ssd1329_t *screen = container_of(c, ssd1329_t, canvas);
-    u8 cell;
+    u8 *cell = SHADOW_CELL(screen, x, y);
 
     val &= 0xf;
 
-    /* Set shadow */
-    cell = screen->shadow[y * WIDTH + x / 2];
     if (x & 1)
     {
-        cell &= ~0xf;
-        cell |= val;
+        *cell &= ~0xf;
+        *cell |= val;
     }
     else
     {
-        cell &= ~0xf0;
-        cell |= val << 4;
+        *cell &= ~0xf0;
+        *cell |= val << 4;
+    }
+}
+
+/* Draw a shadow area on screen in a single window write */
+static void shadow_update(ssd1329_t *screen, u16 x0, u16 y0, u16 x1, u16 y1)
+{
+    u16 y;
+
+    ssd1329_set_address(screen, y0, y1 - 1, x0 / 2, (x1 - 1) / 2);
+    for (y = y0; y < y1; y++)
+    {
+        ssd1329_write(screen, 0, SHADOW_CELL(screen, x0, y),
+            (x1 - 1) / 2 - x0 / 2 + 1);
+    }
+}
+
+static void ssd1329_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
+{
+    ssd1329_t *screen = container_of(c, ssd1329_t, canvas);
+
+    shadow_set(screen, x, y, val);
+    shadow_update(screen, x, y, x + 1, y + 1);
+}
+
+static void ssd1329_fill_rect(canvas_t *c, const canvas_rect_t *r, u16 val)
+{
+    ssd1329_t *screen = container_of(c, ssd1329_t, canvas);
+    u16 x, y;
+
+    for (y = r->y0; y < r->y1; y++)
+    {
+        for (x = r->x0; x < r->x1; x++)
+            shadow_set(screen, x, y, val);
     }
-    screen->shadow[y * WIDTH + x / 2] = cell;
+    shadow_update(screen, r->x0, r->y0, r->x1, r->y1);
+}
+
+static void ssd1329_write_span(canvas_t *c, u16 x, u16 y, u16 n,
+    const u16 *pixels)
+{
+    ssd1329_t *screen = container_of(c, ssd1329_t, canvas);
+    u16 i;
+
+    for (i = 0; i < n; i++)
+        shadow_set(screen, x + i, y, pixels[i]);
+    shadow_update(screen, x, y, x + n, y + 1);
+}
 
-    ssd1329_set_address(screen, y, y, x / 2, x / 2);
+static void ssd1329_blit(canvas_t *c, u16 x, u16 y, const canvas_bitmap_t *b,
+    u16 fg, u16 bg)
+{
+    ssd1329_t *screen = container_of(c, ssd1329_t, canvas);
+    int bx, by;
 
-    /* Draw on screen */
-    ssd1329_write(screen, 0, &cell, 1);
+    for (by = 0; by < b->height; by++)
+    {
+        for (bx = 0; bx < b->width; bx++)
+        {
+            shadow_set(screen, x + bx, y + by,
+                canvas_bitmap_pixel(b, bx, by) ? fg : bg);
+        }
+    }
+    shadow_update(screen, x, y, x + b->width, y + b->height);
 }
 
 static const canvas_ops_t ssd1329_ops = {
     .pixel_set = ssd1329_pixel_set,
+    .fill_rect = ssd1329_fill_rect,
+    .write_span = ssd1329_write_span,
+    .blit = ssd1329_blit,
 };
 
 canvas_t *ssd1329_new(const ssd1329_params_t *params)
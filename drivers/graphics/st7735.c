@@ -37,6 +37,10 @@
 typedef struct {
     st7735_params_t params;
     canvas_t canvas;
+#ifdef CONFIG_ST7735_FRAMEBUFFER
+    /* Pixels in the byte order sent to the controller */
+    u8 fb[LCD_WIDTH * LCD_HEIGHT * 2];
+#endif
 } st7735_t;
 
 static st7735_t g_st7735_screen;
@@ -147,20 +151,121 @@ static void st7735_set_window(st7735_t *screen, u8 x0, u8 y0, u8 x1, u8 y1)
     DO_CMD(screen, ST7735_RAMWR);
 }
 
-static void st7735_fill_window(st7735_t *screen, int n, u16 val)
+#ifdef CONFIG_ST7735_FRAMEBUFFER
+
+#define FB_PIXEL(screen, x, y) ((screen)->fb + ((y) * LCD_WIDTH + (x)) * 2)
+
+static inline void fb_pixel_set(u8 *p, u16 val)
+{
+    p[0] = val >> 8;
+    p[1] = val & 0xff;
+}
+
+static void st7735_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
+{
+    st7735_t *screen = container_of(c, st7735_t, canvas);
+
+    fb_pixel_set(FB_PIXEL(screen, x, y), val);
+}
+
+static void st7735_fill(canvas_t *c, u16 val)
+{
+    st7735_t *screen = container_of(c, st7735_t, canvas);
+    int i;
+
+    for (i = 0; i < sizeof(screen->fb); i += 2)
+        fb_pixel_set(screen->fb + i, val);
+}
+
+static void st7735_fill_rect(canvas_t *c, const canvas_rect_t *r, u16 val)
 {
+    st7735_t *screen = container_of(c, st7735_t, canvas);
+    u16 x, y;
+
+    for (y = r->y0; y < r->y1; y++)
+    {
+        u8 *p = FB_PIXEL(screen, r->x0, y);
+
+        for (x = r->x0; x < r->x1; x++, p += 2)
+            fb_pixel_set(p, val);
+    }
+}
+
+static void st7735_write_span(canvas_t *c, u16 x, u16 y, u16 n,
+    const u16 *pixels)
+{
+    st7735_t *screen = container_of(c, st7735_t, canvas);
+    u8 *p = FB_PIXEL(screen, x, y);
+
+    for (; n--; p += 2)
+        fb_pixel_set(p, *pixels++);
+}
+
+static void st7735_blit(canvas_t *c, u16 x, u16 y, const canvas_bitmap_t *b,
+    u16 fg, u16 bg)
+{
+    st7735_t *screen = container_of(c, st7735_t, canvas);
+    int bx, by;
+
+    for (by = 0; by < b->height; by++)
+    {
+        u8 *p = FB_PIXEL(screen, x, y + by);
+
+        for (bx = 0; bx < b->width; bx++, p += 2)
+            fb_pixel_set(p, canvas_bitmap_pixel(b, bx, by) ? fg : bg);
+    }
+}
+
+/* A single window write of the damaged pixels, instead of a window per
+ * drawing operation.
+ */
+static void st7735_flush(canvas_t *c, const canvas_rect_t *r)
+{
+    st7735_t *screen = container_of(c, st7735_t, canvas);
+    int y;
+
+    st7735_set_window(screen, r->x0, r->y0, r->x1 - 1, r->y1 - 1);
+
     gpio_digital_write(screen->params.cs, 0);
     gpio_digital_write(screen->params.cd, 1);
 
-    while (n--)
+    for (y = r->y0; y < r->y1; y++)
     {
-        spi_send(screen->params.spi_port, val >> 8);
-        spi_send(screen->params.spi_port, val & 0xff);
+        spi_send_mult(screen->params.spi_port,
+            screen->fb + (y * LCD_WIDTH + r->x0) * 2, (r->x1 - r->x0) * 2);
     }
 
     gpio_digital_write(screen->params.cs, 1);
 }
 
+static const canvas_ops_t st7735_ops = {
+    .pixel_set = st7735_pixel_set,
+    .fill = st7735_fill,
+    .fill_rect = st7735_fill_rect,
+    .write_span = st7735_write_span,
+    .blit = st7735_blit,
+    .flush = st7735_flush,
+};
+
+#else
+
+static void st7735_send_pixel(st7735_t *screen, u16 val)
+{
+    spi_send(screen->params.spi_port, val >> 8);
+    spi_send(screen->params.spi_port, val & 0xff);
+}
+
+static void st7735_fill_window(st7735_t *screen, int n, u16 val)
+{
+    gpio_digital_write(screen->params.cs, 0);
+    gpio_digital_write(screen->params.cd, 1);
+
+    while (n--)
+        st7735_send_pixel(screen, val);
+
+    gpio_digital_write(screen->params.cs, 1);
+}
+
 static void st7735_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
 {
     st7735_t *screen = container_of(c, st7735_t, canvas);
@@ -196,13 +301,62 @@ static void st7735_fill(canvas_t *c, u16 val)
     st7735_fill_window(screen, w * h, val);
 }
 
+static void st7735_fill_rect(canvas_t *c, const canvas_rect_t *r, u16 val)
+{
+    st7735_t *screen = container_of(c, st7735_t, canvas);
+
+    st7735_set_window(screen, r->x0, r->y0, r->x1 - 1, r->y1 - 1);
+    st7735_fill_window(screen, (r->x1 - r->x0) * (r->y1 - r->y0), val);
+}
+
+static void st7735_write_span(canvas_t *c, u16 x, u16 y, u16 n,
+    const u16 *pixels)
+{
+    st7735_t *screen = container_of(c, st7735_t, canvas);
+
+    st7735_set_window(screen, x, y, x + n - 1, y);
+
+    gpio_digital_write(screen->params.cs, 0);
+    gpio_digital_write(screen->params.cd, 1);
+
+    while (n--)
+        st7735_send_pixel(screen, *pixels++);
+
+    gpio_digital_write(screen->params.cs, 1);
+}
+
+static void st7735_blit(canvas_t *c, u16 x, u16 y, const canvas_bitmap_t *b,
+    u16 fg, u16 bg)
+{
+    st7735_t *screen = container_of(c, st7735_t, canvas);
+    int bx, by;
+
+    st7735_set_window(screen, x, y, x + b->width - 1, y + b->height - 1);
+
+    gpio_digital_write(screen->params.cs, 0);
+    gpio_digital_write(screen->params.cd, 1);
+
+    for (by = 0; by < b->height; by++)
+    {
+        for (bx = 0; bx < b->width; bx++)
+            st7735_send_pixel(screen, canvas_bitmap_pixel(b, bx, by) ? fg : bg);
+    }
+
+    gpio_digital_write(screen->params.cs, 1);
+}
+
 static const canvas_ops_t st7735_ops = {
     .pixel_set = st7735_pixel_set,
     .hline = st7735_hline,
     .vline = st7735_vline,
     .fill = st7735_fill,
+    .fill_rect = st7735_fill_rect,
+    .write_span = st7735_write_span,
+    .blit = st7735_blit,
 };
 
+#endif
+
 canvas_t *st7735_new(const st7735_params_t *params)
 {
     st7735_t *screen = &g_st7735_screen;
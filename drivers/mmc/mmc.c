@@ -403,7 +403,12 @@ int mmc_spi_disk_read(u8 *buf, int sector, int count)
             goto Exit;
 
         /* Do the actual reading */
-        while (count-- && !rcvr_datablock(buf += 512, 512));
+        do
+        {
+            if (rcvr_datablock(buf, 512))
+                break;
+            buf += 512;
+        } while (--count);
 
         send_cmd_stop_transmission();
     }
@@ -453,7 +458,12 @@ int mmc_spi_disk_write(const u8 *buf, int sector, int count)
             goto Exit;
 
         /* WRITE_MULTIPLE_BLOCK */
-        while (count-- && !xmit_datablock(buf += 512, 0xFC));
+        do
+        {
+            if (xmit_datablock(buf, 0xFC))
+                break;
+            buf += 512;
+        } while (--count);
 
         /* STOP_TRAN token */
         if (xmit_datablock(0, 0xFD))
@@ -327,7 +327,10 @@ typedef struct {
     resource_t cs;
     resource_t intr;
     u8 bank;
+    u8 pkt_cnt; /* Frames known to be waiting, EPKTCNT shadow */
+    u8 pktie_masked;
     u16 next_pkt_ptr;
+    eth_mac_t mac;
 } enc28j60_t;
 
 #define ETHIF_TO_ENC28J60(x) container_of(x, enc28j60_t, ethif)
@@ -372,9 +375,9 @@ static void write_op(enc28j60_t *e, u8 op, u8 addr, u8 data)
 
 static void bank_select(enc28j60_t *e, u8 addr)
 {
-    u8 bank = REG_BANK(addr), reg = REG(addr);
+    u8 bank = REG_BANK(addr), reg = REG(addr), cur = e->bank;
 
-    if (e->bank == bank)
+    if (cur == bank)
         return;
 
     if (reg >= EIE && reg <= ECON1)
@@ -383,8 +386,14 @@ static void bank_select(enc28j60_t *e, u8 addr)
         return;
     }
 
-    write_op(e, ENC28J60_OPCODE_BFC, ECON1, BSEL0 | BSEL1);
-    write_op(e, ENC28J60_OPCODE_BFS, ECON1, bank);
+    if (cur > (BSEL0 | BSEL1))
+        cur = BSEL0 | BSEL1; /* Unknown, clear both bits */
+
+    /* Only touch the bits that differ from the current bank */
+    if (cur & ~bank)
+        write_op(e, ENC28J60_OPCODE_BFC, ECON1, cur & ~bank);
+    if (bank & ~cur)
+        write_op(e, ENC28J60_OPCODE_BFS, ECON1, bank & ~cur);
 
     e->bank = bank;
 }
@@ -493,6 +502,7 @@ static void erxrdpt_set(enc28j60_t *e, u16 addr)
 static void rx_buf_init(enc28j60_t *e, u16 start, u16 end)
 {
     e->next_pkt_ptr = start;
+    e->pkt_cnt = 0;
     ctrl_wreg_write(e, ERXSTL, start);
     ctrl_wreg_write(e, ERXNDL, end);
     erxrdpt_set(e, start);
@@ -500,6 +510,8 @@ static void rx_buf_init(enc28j60_t *e, u16 start, u16 end)
 
 static void mac_addr_conf(enc28j60_t *e, u8 mac[6])
 {
+    /* Keep a copy, the address is needed for every transmitted frame */
+    memcpy(e->mac.mac, mac, sizeof(e->mac.mac));
     ctrl_reg_write(e, MAADR0, mac[5]);
     ctrl_reg_write(e, MAADR1, mac[4]);
     ctrl_reg_write(e, MAADR2, mac[3]);
@@ -510,14 +522,7 @@ static void mac_addr_conf(enc28j60_t *e, u8 mac[6])
 
 static void enc28j60_mac_addr_get(etherif_t *ethif, eth_mac_t *mac)
 {
-    enc28j60_t *e = ETHIF_TO_ENC28J60(ethif);
-
-    mac->mac[5] = ctrl_reg_read(e, MAADR0);
-    mac->mac[4] = ctrl_reg_read(e, MAADR1);
-    mac->mac[3] = ctrl_reg_read(e, MAADR2);
-    mac->mac[2] = ctrl_reg_read(e, MAADR3);
-    mac->mac[1] = ctrl_reg_read(e, MAADR4);
-    mac->mac[0] = ctrl_reg_read(e, MAADR5);
+    *mac = ETHIF_TO_ENC28J60(ethif)->mac;
 }
 
 static void chip_init(enc28j60_t *e)
@@ -574,7 +579,25 @@ static void packet_complete(enc28j60_t *e)
     erxrdpt_set(e, e->next_pkt_ptr);
     /* Indicate packet processing is complete */
     ctrl_reg_bits_set(e, ECON2, PKTDEC);
-    ctrl_reg_bits_set(e, EIE, PKTIE); /* Unmask packet received interrupt */
+    e->pkt_cnt--;
+    if (e->pktie_masked)
+    {
+        /* Unmask packet received interrupt once per batch. Frames left
+         * pending keep PKTIF set, so the interrupt fires again.
+         */
+        ctrl_reg_bits_set(e, EIE, PKTIE);
+        e->pktie_masked = 0;
+    }
+}
+
+static int enc28j60_packet_pending(etherif_t *ethif)
+{
+    enc28j60_t *e = ETHIF_TO_ENC28J60(ethif);
+
+    /* Only go to the chip once the frames counted so far were consumed */
+    if (!e->pkt_cnt)
+        e->pkt_cnt = ctrl_reg_read(e, EPKTCNT);
+    return e->pkt_cnt;
 }
 
 static int enc28j60_packet_recv(etherif_t *ethif, u8 *buf, int size)
@@ -583,6 +606,9 @@ static int enc28j60_packet_recv(etherif_t *ethif, u8 *buf, int size)
     u8 header[6];
     u16 stat, packet_length;
 
+    if (!enc28j60_packet_pending(ethif))
+        return 0;
+
     ctrl_wreg_write(e, ERDPTL, e->next_pkt_ptr);
 
     cs_low(e);
@@ -597,6 +623,7 @@ static int enc28j60_packet_recv(etherif_t *ethif, u8 *buf, int size)
     if (!(stat & RX_STAT_OK))
     {
         tp_info("Invalid packet received\n");
+        size = 0;
         goto Exit;
     }
 
@@ -674,6 +701,7 @@ static void enc28j60_isr(event_t *ev, u32 resource_id, u64 timestamp)
     {
         ctrl_reg_bits_clear(e, EIR, PKTIF); /* Ack interrupt */
         ctrl_reg_bits_clear(e, EIE, PKTIE); /* Mask packet received interrupt */
+        e->pktie_masked = 1;
         packet_received(e);
     }
 
@@ -697,6 +725,7 @@ static const etherif_ops_t enc28j60_etherif_ops = {
     .link_status = enc28j60_link_status,
     .mac_addr_get = enc28j60_mac_addr_get,
     .packet_recv = enc28j60_packet_recv,
+    .packet_pending = enc28j60_packet_pending,
     .packet_xmit = enc28j60_packet_xmit,
     .free = enc28j60_free,
 };
@@ -710,6 +739,8 @@ netif_t *enc28j60_new(const enc28j60_params_t *params)
     e->intr = params->intr;
     e->irq_event.trigger = enc28j60_isr;
     e->bank = 255; /* make sure bank is selected on the first register access */
+    e->pkt_cnt = 0;
+    e->pktie_masked = 0;
     etherif_construct(&e->ethif, "ENC28J60", &enc28j60_etherif_ops);
 
     spi_init(e->spi_port);
@@ -38,6 +38,51 @@ typedef struct {
     int len;
 } matched_str_t;
 
+/* Link IDs of AT+CIPMUX=1 double as netif socket indices. The listening
+ * socket follows them.
+ */
+#define ESP8266_MAX_LINKS 5
+#define ESP8266_LISTEN_SOCK ESP8266_MAX_LINKS
+#define ESP8266_CMD_TIMEOUT 5000
+
+typedef enum {
+    LINK_FREE = 0,
+    LINK_CONNECTING = 1,
+    LINK_CONNECTED = 2,
+    LINK_CLOSED = 3, /* By the peer, buffered data can still be read */
+    LINK_CLOSING = 4,
+} esp8266_link_state_t;
+
+typedef struct {
+    esp8266_link_state_t state;
+    int accept_pending;
+    u8 cmds_pending; /* Bit per esp8266_cmd_type_t awaiting issue */
+    u32 ip; /* IP in host order */
+    u16 port;
+    char *rbuf;
+    int rbuf_len;
+    char *wbuf;
+    int wbuf_len;
+} esp8266_link_t;
+
+typedef enum {
+    ESP8266_CMD_CONNECT = 0,
+    ESP8266_CMD_SEND = 1,
+    ESP8266_CMD_CLOSE = 2,
+    ESP8266_CMD_LISTEN = 3,
+} esp8266_cmd_type_t;
+
+typedef struct {
+    esp8266_cmd_type_t type;
+    int link;
+} esp8266_cmd_t;
+
+typedef enum {
+    RX_LINE = 0,
+    RX_IPD_HDR = 1,
+    RX_IPD_DATA = 2,
+} esp8266_rx_state_t;
+
 typedef struct esp8266_t esp8266_t;
 struct esp8266_t {
     netif_t netif;
@@ -46,18 +91,30 @@ struct esp8266_t {
     void (*func)(esp8266_t *e);
     const char *func_name;
     u32 our_ip;
-    /* Socket */
-    u32 ip; /* IP in host order */
-    u16 port;
-    int tcp_connected;
-    int data_ready_count_tmp;
-    int data_ready_count;
-    int write_count;
-    char *write_buf;
+    /* Links */
+    esp8266_link_t links[ESP8266_MAX_LINKS];
+    u16 listen_port;
+    int listening;
+    /* AT commands, pending ones are kept per link and issued one at a time */
+    esp8266_cmd_t cmd; /* In flight */
+    int listen_pending;
+    int cmd_link_next; /* Links are served round robin from here */
+    int cmd_in_flight;
+    int cmd_send_len; /* Bytes of an in flight CIPSEND */
+    int cmd_prompt; /* CIPSEND waits for the '>' prompt */
+    int cmd_timer_id;
+    int data_avail_timer_id;
+    /* Response parser */
+    esp8266_rx_state_t rx_state;
+    char rx_buf[CONFIG_NET_ESP8266_RX_CHUNK_SIZE];
+    char rx_line[16];
+    int rx_line_len;
+    int ipd_link;
+    int ipd_left;
+    int ipd_field;
+    int ipd_dropped;
     /* Events */
-    event_t timeout_evt;
     int timeout_evt_id;
-    event_t serial_in_evt;
     /* Match context */
 #define NUM_MATCHED_STRS 2
     matched_str_t matched_strs[NUM_MATCHED_STRS];
@@ -69,6 +126,16 @@ struct esp8266_t {
     int read_line_status;
 };
 
+/* Events are allocated separately as deleted events are freed later on,
+ * possibly after the device itself.
+ */
+typedef struct {
+    event_t e;
+    esp8266_t *esp8266;
+} esp8266_event_t;
+
+#define to_esp8266(evt) container_of(evt, esp8266_event_t, e)->esp8266
+
 esp8266_t *netif_to_esp8266(netif_t *netif);
 
 /* Set of ugly macros that probably defy all programming best practices.
@@ -108,25 +175,45 @@ esp8266_t *netif_to_esp8266(netif_t *netif);
 } while(0)
 
 /* Helper functions */
-static void esp8266_wait_for_data(esp8266_t *e);
+static void esp8266_links_start(esp8266_t *e);
+
+static void esp8266_event_free(event_t *evt)
+{
+    tfree(container_of(evt, esp8266_event_t, e));
+}
+
+static event_t *esp8266_event_new(esp8266_t *e,
+    void (*trigger)(event_t *evt, u32 id, u64 timestamp))
+{
+    esp8266_event_t *ev = tmalloc_type(esp8266_event_t);
+
+    ev->e = (event_t){ .trigger = trigger, .free = esp8266_event_free };
+    ev->esp8266 = e;
+    return &ev->e;
+}
+
+static int esp8266_timer_new(esp8266_t *e, int ms,
+    void (*trigger)(event_t *evt, u32 id, u64 timestamp))
+{
+    return event_timer_set(ms, esp8266_event_new(e, trigger));
+}
 
 static inline void esp8266_serial_in_watch_set(esp8266_t *e,
     void (*cb)(event_t *evt, u32 id, u64 timestamp))
 {
-    e->serial_in_evt = (event_t){ .trigger = cb };
-    event_watch_set(e->params.serial_port, &e->serial_in_evt);
+    event_watch_set(e->params.serial_port, esp8266_event_new(e, cb));
 }
 
 static inline void esp8266_serial_in_watch_del(esp8266_t *e)
 {
     event_watch_del_by_resource(e->params.serial_port);
-    e->serial_in_evt = (event_t){};
 }
 
 static void esp8266_timeout_trigger(event_t *evt, u32 id, u64 timestamp)
 {
-    esp8266_t *e = container_of(evt, esp8266_t, timeout_evt);
+    esp8266_t *e = to_esp8266(evt);
 
+    e->timeout_evt_id = -1;
     tp_err("esp8266: timed out on %s. state %d\n", e->func_name, e->state);
     esp8266_serial_in_watch_del(e);
     sm_reset(e);
@@ -134,8 +221,9 @@ static void esp8266_timeout_trigger(event_t *evt, u32 id, u64 timestamp)
 
 static void esp8266_sleep_trigger(event_t *evt, u32 id, u64 timestamp)
 {
-    esp8266_t *e = container_of(evt, esp8266_t, timeout_evt);
+    esp8266_t *e = to_esp8266(evt);
 
+    e->timeout_evt_id = -1;
     e->func(e);
 }
 
@@ -147,8 +235,7 @@ static inline void esp8266_timeout_set(esp8266_t *e, int timeout,
         e->timeout_evt_id = -1;
         return;
     }
-    e->timeout_evt = (event_t){ .trigger = trigger };
-    e->timeout_evt_id = event_timer_set(timeout, &e->timeout_evt);
+    e->timeout_evt_id = esp8266_timer_new(e, timeout, trigger);
 }
 
 static inline void esp8266_timeout_del(esp8266_t *e)
@@ -205,7 +292,7 @@ again:
 
 static void esp8266_match_trigger(event_t *evt, u32 id, u64 timestamp)
 {
-    esp8266_t *e = container_of(evt, esp8266_t, serial_in_evt);
+    esp8266_t *e = to_esp8266(evt);
     char buf[30];
     int len, i, matched_idx;
 
@@ -247,16 +334,9 @@ static void esp8266_match(esp8266_t *e, const char *matches[],
     e->match_read_size = match_step_size;
 }
 
-static void esp8266_gen_trigger(event_t *evt, u32 id, u64 timestamp)
-{
-    esp8266_t *e = container_of(evt, esp8266_t, serial_in_evt);
-
-    e->func(e);
-}
-
 static void esp8266_read_line_trigger(event_t *evt, u32 id, u64 timestamp)
 {
-    esp8266_t *e = container_of(evt, esp8266_t, serial_in_evt);
+    esp8266_t *e = to_esp8266(evt);
     int remaining = sizeof(e->line_buf) - e->line_buf_count;
 
     if (!remaining)
@@ -308,7 +388,7 @@ static void esp8266_ip_connect(esp8266_t *e)
     AT_PRINTF(e, "AT+CWJAP=\"%s\",\"%s\"", SSID, PSK);
     MATCH(e, "OK");
     sm_wait(e, 2000);
-    AT_MATCH(e, "AT+CIPMUX=0", "OK");
+    AT_MATCH(e, "AT+CIPMUX=1", "OK");
     sm_wait(e, 100);
     AT(e, "AT+CIFSR");
     _MATCH(e, "AT+CIFSR\r\r\n", 1);
@@ -324,6 +404,7 @@ static void esp8266_ip_connect(esp8266_t *e)
     tp_debug("Got IP [%d] %s", e->line_buf_count, e->line_buf);
     e->our_ip = ip_addr_parse(e->line_buf, e->line_buf_count - 2);
     sm_sleep(e, 5000);
+    esp8266_links_start(e);
     netif_event_trigger(&e->netif, NETIF_EVENT_IPV4_CONNECTED);
     sm_uninit(e);
 }
@@ -337,91 +418,515 @@ static int esp8266_netif_ip_connect(netif_t *netif)
 {
     esp8266_t *e = netif_to_esp8266(netif);
 
+    esp8266_serial_in_watch_del(e);
     sm_reset(e);
     esp8266_ip_connect(e);
     return 0;
 }
 
-static void _esp8266_wait_for_data(esp8266_t *e)
+/* Multiplexed links (AT+CIPMUX=1).
+ * A single parser consumes all module output: +IPD payloads are demultiplexed
+ * into per link receive buffers and "<id>,CONNECT"/"<id>,CLOSED" are
+ * tracked at any time. AT commands are kept pending per link and issued back
+ * to back, so a send on one link never holds off reception on another.
+ */
+static void esp8266_cmd_next(esp8266_t *e);
+
+static esp8266_link_t *esp8266_link_get(esp8266_t *e, int sock)
 {
-    sm_init(e, _esp8266_wait_for_data);
-    esp8266_match(e, (const char *[]){"+IPD,", "Unlink"}, 2, 1);
-    sm_wait(e, 0);
-    if (e->matched_idx == 1)
+    if (sock < 0 || sock >= ESP8266_MAX_LINKS ||
+        e->links[sock].state == LINK_FREE)
     {
-        e->tcp_connected = 0;
-        netif_event_trigger(&e->netif, NETIF_EVENT_TCP_DISCONNECTED);
-        esp8266_wait_for_data(e);
+        return NULL;
+    }
+
+    return &e->links[sock];
+}
+
+static void esp8266_link_open(esp8266_link_t *link, esp8266_link_state_t state)
+{
+    link->state = state;
+    link->accept_pending = 0;
+    link->cmds_pending = 0;
+    link->rbuf = tmalloc(CONFIG_NET_ESP8266_LINK_RX_BUF_SIZE, "esp8266 rbuf");
+    link->rbuf_len = 0;
+    link->wbuf = tmalloc(CONFIG_NET_ESP8266_LINK_TX_BUF_SIZE, "esp8266 wbuf");
+    link->wbuf_len = 0;
+}
+
+static void esp8266_link_free(esp8266_link_t *link)
+{
+    if (link->state == LINK_FREE)
         return;
+
+    tfree(link->rbuf);
+    tfree(link->wbuf);
+    link->rbuf = link->wbuf = NULL;
+    link->cmds_pending = 0;
+    link->state = LINK_FREE;
+}
+
+/* Pending commands of a kind collapse into one. Sends carry whatever is in
+ * the link's buffer when issued and listen applies the current setting.
+ */
+static void esp8266_cmd_push(esp8266_t *e, esp8266_cmd_type_t type, int link)
+{
+    if (type == ESP8266_CMD_LISTEN)
+        e->listen_pending = 1;
+    else
+        e->links[link].cmds_pending |= 1 << type;
+    esp8266_cmd_next(e);
+}
+
+static int esp8266_cmd_pick(esp8266_t *e, esp8266_cmd_t *cmd)
+{
+    esp8266_cmd_type_t type;
+    int i, l;
+
+    if (e->listen_pending)
+    {
+        e->listen_pending = 0;
+        *cmd = (esp8266_cmd_t){ .type = ESP8266_CMD_LISTEN };
+        return 0;
     }
 
-    e->data_ready_count = e->data_ready_count_tmp = 0;
-    esp8266_serial_in_watch_set(e, esp8266_gen_trigger);
-    while(1)
+    for (i = 0; i < ESP8266_MAX_LINKS; i++)
     {
-        char c;
+        esp8266_link_t *link;
 
-        sm_wait(e, 0);
-        if (e->data_ready_count)
-        {
-            netif_event_trigger(&e->netif, NETIF_EVENT_TCP_DATA_AVAIL);
+        l = (e->cmd_link_next + i) % ESP8266_MAX_LINKS;
+        link = &e->links[l];
+        if (!link->cmds_pending)
             continue;
+
+        /* Connect, then send, then close */
+        for (type = ESP8266_CMD_CONNECT; !(link->cmds_pending & (1 << type));
+            type++);
+        link->cmds_pending &= ~(1 << type);
+        e->cmd_link_next = (l + 1) % ESP8266_MAX_LINKS;
+        *cmd = (esp8266_cmd_t){ .type = type, .link = l };
+        return 0;
+    }
+
+    return -1;
+}
+
+static void esp8266_cmd_done(esp8266_t *e, int status)
+{
+    /* Callbacks may issue the next command */
+    esp8266_cmd_t cmd = e->cmd;
+    esp8266_link_t *link = &e->links[cmd.link];
+
+    if (e->cmd_timer_id >= 0)
+    {
+        event_timer_del(e->cmd_timer_id);
+        e->cmd_timer_id = -1;
+    }
+
+    e->cmd_in_flight = 0;
+
+    switch (cmd.type)
+    {
+    case ESP8266_CMD_CONNECT:
+        if (link->state != LINK_CONNECTING)
+            break;
+
+        if (status)
+        {
+            link->state = LINK_CLOSED;
+            netif_sock_disconnected(&e->netif, cmd.link);
+            break;
         }
 
-        /* Parse available data count */
-        if ((esp8266_read(e, &c, 1)) != 1)
-            continue;
+        link->state = LINK_CONNECTED;
+        netif_sock_event_trigger(&e->netif, cmd.link,
+            NETIF_SOCK_EVENT_CONNECTED);
+        break;
+    case ESP8266_CMD_SEND:
+        if (status)
+            tp_err("esp8266: send on link %d failed\n", cmd.link);
+
+        /* Failed data is dropped, the link is most likely gone */
+        link->wbuf_len -= e->cmd_send_len;
+        memmove(link->wbuf, link->wbuf + e->cmd_send_len, link->wbuf_len);
+        if (link->state != LINK_CONNECTED)
+            break;
+
+        if (link->wbuf_len)
+            link->cmds_pending |= 1 << ESP8266_CMD_SEND;
+        netif_sock_event_trigger(&e->netif, cmd.link,
+            NETIF_SOCK_EVENT_WRITABLE);
+        break;
+    case ESP8266_CMD_CLOSE:
+        esp8266_link_free(link);
+        break;
+    case ESP8266_CMD_LISTEN:
+        if (status)
+            tp_err("esp8266: failed to set up server\n");
+        break;
+    }
+
+    esp8266_cmd_next(e);
+}
+
+static void esp8266_cmd_timeout(event_t *evt, u32 id, u64 timestamp)
+{
+    esp8266_t *e = to_esp8266(evt);
+
+    tp_err("esp8266: command %d on link %d timed out\n",
+        e->cmd.type, e->cmd.link);
+    e->cmd_timer_id = -1;
+    esp8266_cmd_done(e, -1);
+}
+
+static void esp8266_cmd_next(esp8266_t *e)
+{
+    esp8266_cmd_t *cmd = &e->cmd;
+    esp8266_link_t *link;
+
+    if (e->cmd_in_flight || esp8266_cmd_pick(e, cmd))
+        return;
+
+    link = &e->links[cmd->link];
+    e->cmd_in_flight = 1;
+    e->cmd_timer_id = esp8266_timer_new(e, ESP8266_CMD_TIMEOUT,
+        esp8266_cmd_timeout);
+
+    switch (cmd->type)
+    {
+    case ESP8266_CMD_CONNECT:
+        AT_PRINTF(e, "AT+CIPSTART=%d,\"TCP\",\"%s\",%d", cmd->link,
+            ip_addr_serialize(link->ip), link->port);
+        break;
+    case ESP8266_CMD_SEND:
+        /* Data written from now on waits for the next send */
+        e->cmd_send_len = link->wbuf_len;
+        e->cmd_prompt = 1;
+        AT_PRINTF(e, "AT+CIPSEND=%d,%d", cmd->link, e->cmd_send_len);
+        break;
+    case ESP8266_CMD_CLOSE:
+        AT_PRINTF(e, "AT+CIPCLOSE=%d", cmd->link);
+        break;
+    case ESP8266_CMD_LISTEN:
+        if (e->listening)
+            AT_PRINTF(e, "AT+CIPSERVER=1,%d", e->listen_port);
+        else
+            AT(e, "AT+CIPSERVER=0");
+        break;
+    }
+}
+
+static void esp8266_data_avail_trigger(event_t *evt, u32 id, u64 timestamp)
+{
+    esp8266_t *e = to_esp8266(evt);
+    int sock;
+
+    e->data_avail_timer_id = -1;
+    for (sock = 0; sock < ESP8266_MAX_LINKS; sock++)
+    {
+        esp8266_link_t *link = &e->links[sock];
 
-        if (c == ':')
+        if (link->state != LINK_FREE && !link->accept_pending &&
+            link->rbuf_len)
         {
-            e->data_ready_count = e->data_ready_count_tmp;
-            continue;
+            netif_sock_event_trigger(&e->netif, sock,
+                NETIF_SOCK_EVENT_DATA_AVAIL);
         }
+    }
+}
+
+static void esp8266_link_connect_ind(esp8266_t *e, int id)
+{
+    esp8266_link_t *link = &e->links[id];
+
+    /* Our own connections complete with the CIPSTART response */
+    if (link->state != LINK_FREE)
+        return;
+
+    esp8266_link_open(link, LINK_CONNECTED);
+    link->accept_pending = 1;
+    netif_sock_event_trigger(&e->netif, ESP8266_LISTEN_SOCK,
+        NETIF_SOCK_EVENT_ACCEPT);
+}
+
+static void esp8266_link_closed_ind(esp8266_t *e, int id)
+{
+    esp8266_link_t *link = &e->links[id];
+
+    if (link->state != LINK_CONNECTED)
+        return;
+
+    if (link->accept_pending)
+    {
+        esp8266_link_free(link);
+        return;
+    }
+
+    link->state = LINK_CLOSED;
+    netif_sock_disconnected(&e->netif, id);
+}
+
+typedef enum {
+    RESP_OK = 0,
+    RESP_ERROR = 1,
+    RESP_SEND_OK = 2,
+    RESP_LINK_CONNECT = 3,
+    RESP_LINK_CLOSED = 4,
+} esp8266_resp_t;
+
+typedef struct {
+    const char *str;
+    u8 len;
+    u8 link_prefix; /* Preceded by "<id>," */
+    esp8266_resp_t resp;
+} esp8266_resp_match_t;
+
+#define RESP_MATCH(s, prefix, r) { s, sizeof(s) - 1, prefix, r }
+
+/* Module output is line based, so a line is looked up as a whole instead
+ * of feeding each character to a matcher per candidate response.
+ */
+static const esp8266_resp_match_t esp8266_resps[] = {
+    RESP_MATCH("OK", 0, RESP_OK),
+    RESP_MATCH("no change", 0, RESP_OK),
+    RESP_MATCH("ERROR", 0, RESP_ERROR),
+    RESP_MATCH("SEND FAIL", 0, RESP_ERROR),
+    RESP_MATCH("SEND OK", 0, RESP_SEND_OK),
+    RESP_MATCH("CONNECT", 1, RESP_LINK_CONNECT),
+    RESP_MATCH("CLOSED", 1, RESP_LINK_CLOSED),
+    RESP_MATCH("CONNECT FAIL", 1, RESP_LINK_CLOSED),
+};
+
+static void esp8266_line_process(esp8266_t *e, const char *line, int len)
+{
+    const esp8266_resp_match_t *m;
+    int link = -1;
+
+    if (len > 2 && line[0] >= '0' && line[0] < '0' + ESP8266_MAX_LINKS &&
+        line[1] == ',')
+    {
+        link = line[0] - '0';
+        line += 2;
+        len -= 2;
+    }
 
-        if (c < '0' || c > '9')
+    for (m = esp8266_resps; m < esp8266_resps + ARRAY_SIZE(esp8266_resps);
+        m++)
+    {
+        if (m->len == len && m->link_prefix == (link >= 0) &&
+            !memcmp(m->str, line, len))
+        {
+            break;
+        }
+    }
+
+    if (m == esp8266_resps + ARRAY_SIZE(esp8266_resps))
+        return;
+
+    switch (m->resp)
+    {
+    case RESP_LINK_CONNECT:
+        esp8266_link_connect_ind(e, link);
+        return;
+    case RESP_LINK_CLOSED:
+        esp8266_link_closed_ind(e, link);
+        return;
+    default:
+        break;
+    }
+
+    if (!e->cmd_in_flight)
+        return;
+
+    if (m->resp == RESP_ERROR)
+        esp8266_cmd_done(e, -1);
+    else if (m->resp == RESP_SEND_OK ||
+        e->cmd.type != ESP8266_CMD_SEND)
+    {
+        /* CIPSEND is acknowledged before the data is sent */
+        esp8266_cmd_done(e, 0);
+    }
+}
+
+static void esp8266_ipd_done(esp8266_t *e)
+{
+    esp8266_link_t *link = &e->links[e->ipd_link];
+
+    e->rx_state = RX_LINE;
+    if (e->ipd_dropped)
+    {
+        tp_err("esp8266: link %d receive buffer full, dropped %d\n",
+            e->ipd_link, e->ipd_dropped);
+    }
+
+    if (link->state == LINK_CONNECTED && !link->accept_pending &&
+        link->rbuf_len)
+    {
+        netif_sock_event_trigger(&e->netif, e->ipd_link,
+            NETIF_SOCK_EVENT_DATA_AVAIL);
+    }
+}
+
+/* Returns the link receive buffer room for the current +IPD payload */
+static int esp8266_ipd_room(esp8266_t *e)
+{
+    esp8266_link_t *link = &e->links[e->ipd_link];
+
+    if (link->state != LINK_CONNECTED)
+        return 0;
+
+    return MIN(e->ipd_left,
+        CONFIG_NET_ESP8266_LINK_RX_BUF_SIZE - link->rbuf_len);
+}
+
+/* Consumes up to len payload bytes, returns the number consumed */
+static int esp8266_ipd_copy(esp8266_t *e, const char *buf, int len)
+{
+    esp8266_link_t *link = &e->links[e->ipd_link];
+    int stored;
+
+    len = MIN(len, e->ipd_left);
+    stored = MIN(len, esp8266_ipd_room(e));
+    memcpy(link->rbuf + link->rbuf_len, buf, stored);
+    link->rbuf_len += stored;
+    e->ipd_dropped += len - stored;
+    if (!(e->ipd_left -= len))
+        esp8266_ipd_done(e);
+    return len;
+}
+
+static void esp8266_rx_char(esp8266_t *e, char c)
+{
+    switch (e->rx_state)
+    {
+    case RX_IPD_HDR:
+        /* +IPD,<link>,<len>: */
+        if (c >= '0' && c <= '9')
+        {
+            if (e->ipd_field)
+                e->ipd_left = e->ipd_left * 10 + c - '0';
+            else
+                e->ipd_link = e->ipd_link * 10 + c - '0';
+            break;
+        }
+
+        if (c == ',' && !e->ipd_field++)
+            break;
+
+        if (c != ':' || e->ipd_field != 1 || e->ipd_link >= ESP8266_MAX_LINKS)
         {
             tp_err("esp8266: malformed IPD header\n");
-            esp8266_wait_for_data(e);
-            return;
+            e->rx_state = RX_LINE;
+            break;
         }
 
-        e->data_ready_count_tmp = e->data_ready_count_tmp * 10 + c - '0';
+        e->ipd_dropped = 0;
+        e->rx_state = RX_IPD_DATA;
+        if (!e->ipd_left)
+            esp8266_ipd_done(e);
+        break;
+    default:
+        if (c == '\r')
+            break;
+
+        if (c == '\n')
+        {
+            int len = e->rx_line_len;
+
+            e->rx_line_len = 0;
+            esp8266_line_process(e, e->rx_line, len);
+            break;
+        }
+
+        /* The CIPSEND prompt is not followed by a line break */
+        if (c == '>' && !e->rx_line_len && e->cmd_prompt)
+        {
+            e->cmd_prompt = 0;
+            serial_write(e->params.serial_port, e->links[e->cmd.link].wbuf,
+                e->cmd_send_len);
+            break;
+        }
+
+        if (c == ' ' && !e->rx_line_len)
+            break;
+
+        if (e->rx_line_len < sizeof(e->rx_line))
+            e->rx_line[e->rx_line_len++] = c;
+
+        if (e->rx_line_len == 5 && !memcmp(e->rx_line, "+IPD,", 5))
+        {
+            e->rx_line_len = 0;
+            e->ipd_link = e->ipd_left = e->ipd_field = 0;
+            e->rx_state = RX_IPD_HDR;
+        }
+        break;
     }
-    sm_uninit(e);
 }
 
-static void esp8266_wait_for_data(esp8266_t *e)
+static void esp8266_rx_trigger(event_t *evt, u32 id, u64 timestamp)
 {
-    sm_reset(e);
-    _esp8266_wait_for_data(e);
+    esp8266_t *e = to_esp8266(evt);
+    char *p = e->rx_buf;
+    int len, room;
+
+    /* Payload is read straight into the link's buffer */
+    if (e->rx_state == RX_IPD_DATA && (room = esp8266_ipd_room(e)))
+    {
+        esp8266_link_t *link = &e->links[e->ipd_link];
+
+        len = esp8266_read(e, link->rbuf + link->rbuf_len, room);
+        if (len <= 0)
+            return;
+
+        link->rbuf_len += len;
+        if (!(e->ipd_left -= len))
+            esp8266_ipd_done(e);
+        return;
+    }
+
+    len = esp8266_read(e, e->rx_buf, sizeof(e->rx_buf));
+    while (len > 0)
+    {
+        int n = 1;
+
+        if (e->rx_state == RX_IPD_DATA)
+            n = esp8266_ipd_copy(e, p, len);
+        else
+            esp8266_rx_char(e, *p);
+
+        p += n;
+        len -= n;
+    }
 }
 
-static void esp8266_tcp_connect(esp8266_t *e)
+static void esp8266_links_reset(esp8266_t *e)
 {
-    sm_init(e, esp8266_tcp_connect);
-    AT_PRINTF(e, "AT+CIPSTART=\"TCP\",\"%s\",%d", ip_addr_serialize(e->ip),
-        e->port);
-    MATCH(e, "Linked");
-    sm_wait(e, 5000);
-    e->tcp_connected = 1;
-    netif_event_trigger(&e->netif, NETIF_EVENT_L4_CONNECTED);
-    esp8266_wait_for_data(e);
-    sm_uninit(e);
+    int i;
+
+    if (e->cmd_timer_id >= 0)
+        event_timer_del(e->cmd_timer_id);
+    e->cmd_timer_id = -1;
+    e->cmd_in_flight = e->cmd_prompt = e->listen_pending = 0;
+
+    for (i = 0; i < ESP8266_MAX_LINKS; i++)
+        esp8266_link_free(&e->links[i]);
+    e->listening = 0;
 }
 
-static void esp8266_tcp_disconnect(esp8266_t *e)
+static void esp8266_links_start(esp8266_t *e)
 {
-    sm_init(e, esp8266_tcp_disconnect);
-    AT_MATCH(e, "AT+CIPCLOSE", "OK");
-    sm_wait(e, 5000);
-    tp_out("Disconnected\n");
-    sm_uninit(e);
+    esp8266_links_reset(e);
+    e->rx_state = RX_LINE;
+    e->rx_line_len = 0;
+    esp8266_serial_in_watch_set(e, esp8266_rx_trigger);
 }
 
 static int esp8266_netif_proto_connect(netif_t *netif, u8 proto, void *params)
 {
     esp8266_t *e = netif_to_esp8266(netif);
     tcp_udp_connect_params_t *conn = params;
+    esp8266_link_t *link;
+    int sock;
 
     if (proto != IP_PROTOCOL_TCP)
     {
@@ -429,83 +934,148 @@ static int esp8266_netif_proto_connect(netif_t *netif, u8 proto, void *params)
         return -1;
     }
 
-    if (e->tcp_connected)
+    for (sock = 0; sock < ESP8266_MAX_LINKS; sock++)
+    {
+        if (e->links[sock].state == LINK_FREE)
+            break;
+    }
+
+    if (sock == ESP8266_MAX_LINKS)
     {
-        tp_err("esp8266: TCP already connected\n");
+        tp_err("esp8266: no free links\n");
         return -1;
     }
 
-    e->ip = conn->ip;
-    e->port = conn->port;
-    sm_reset(e);
-    esp8266_tcp_connect(e);
-    return 0;
+    link = &e->links[sock];
+    esp8266_link_open(link, LINK_CONNECTING);
+    link->ip = conn->ip;
+    link->port = conn->port;
+    esp8266_cmd_push(e, ESP8266_CMD_CONNECT, sock);
+    return sock;
 }
 
-static int esp8266_netif_tcp_read(netif_t *netif, char *buf, int size)
+static int esp8266_netif_tcp_read(netif_t *netif, int sock, char *buf,
+    int size)
 {
     esp8266_t *e = netif_to_esp8266(netif);
+    esp8266_link_t *link = esp8266_link_get(e, sock);
     int len;
 
-    if (!e->tcp_connected)
+    if (!link || (link->state != LINK_CONNECTED &&
+        link->state != LINK_CLOSED))
     {
         tp_err("esp8266 read: TCP not connected\n");
         return -1;
     }
 
-    if (!e->data_ready_count)
-        return 0;
-
-    len = MIN(size, e->data_ready_count);
-    len = esp8266_read(e, buf, len);
-    e->data_ready_count -= len;
-    if (!e->data_ready_count)
-        esp8266_wait_for_data(e);
+    if (!link->rbuf_len)
+        return link->state == LINK_CLOSED ? -1 : 0;
+
+    len = MIN(size, link->rbuf_len);
+    memcpy(buf, link->rbuf, len);
+    link->rbuf_len -= len;
+    memmove(link->rbuf, link->rbuf + len, link->rbuf_len);
+    /* Readers may take less than an +IPD worth at a time, keep them
+     * notified until the buffer is drained.
+     */
+    if (link->rbuf_len && link->state == LINK_CONNECTED)
+    {
+        netif_sock_event_trigger(&e->netif, sock,
+            NETIF_SOCK_EVENT_DATA_AVAIL);
+    }
     return len;
 }
 
-static void esp8266_tcp_write(esp8266_t *e)
-{
-    sm_init(e, esp8266_tcp_write);
-    AT_PRINTF(e, "AT+CIPSEND=%d", e->write_count);
-    MATCH(e, ">");
-    sm_wait(e, 1000);
-    serial_write(e->params.serial_port, e->write_buf, e->write_count);
-    esp8266_wait_for_data(e);
-    sm_uninit(e);
-}
-
-static int esp8266_netif_tcp_write(netif_t *netif, char *buf, int size)
+static int esp8266_netif_tcp_write(netif_t *netif, int sock, char *buf,
+    int size)
 {
     esp8266_t *e = netif_to_esp8266(netif);
+    esp8266_link_t *link = esp8266_link_get(e, sock);
+    int len;
 
-    if (!e->tcp_connected)
+    if (!link || link->state != LINK_CONNECTED)
     {
         tp_err("esp8266 write: TCP not connected\n");
         return -1;
     }
-    e->write_buf = buf;
-    e->write_count = size;
-    sm_reset(e);
-    esp8266_tcp_write(e);
-    return 0;
+
+    /* Writes are coalesced until the link's queued send is issued */
+    len = MIN(size, CONFIG_NET_ESP8266_LINK_TX_BUF_SIZE - link->wbuf_len);
+    memcpy(link->wbuf + link->wbuf_len, buf, len);
+    link->wbuf_len += len;
+    if (len)
+        esp8266_cmd_push(e, ESP8266_CMD_SEND, sock);
+    return len;
 }
 
-static int esp8266_netif_disconnect(netif_t *netif)
+static int esp8266_netif_disconnect(netif_t *netif, int sock)
 {
     esp8266_t *e = netif_to_esp8266(netif);
+    esp8266_link_t *link;
 
-    if (!e->tcp_connected)
+    if (sock == ESP8266_LISTEN_SOCK)
     {
-        /* TCP already disconnected. Nothing more to do */
+        if (e->listening)
+        {
+            e->listening = 0;
+            esp8266_cmd_push(e, ESP8266_CMD_LISTEN, 0);
+        }
         return 0;
     }
 
-    sm_reset(e);
-    esp8266_tcp_disconnect(e);
+    if (!(link = esp8266_link_get(e, sock)) || link->state == LINK_CLOSING)
+        return 0;
+
+    /* The link is released once the module is done with it */
+    link->state = LINK_CLOSING;
+    esp8266_cmd_push(e, ESP8266_CMD_CLOSE, sock);
     return 0;
 }
 
+static int esp8266_netif_tcp_listen(netif_t *netif, u16 port)
+{
+    esp8266_t *e = netif_to_esp8266(netif);
+
+    /* The module runs a single server */
+    if (e->listening)
+        return -1;
+
+    e->listening = 1;
+    e->listen_port = port;
+    esp8266_cmd_push(e, ESP8266_CMD_LISTEN, 0);
+    return ESP8266_LISTEN_SOCK;
+}
+
+static int esp8266_netif_tcp_accept(netif_t *netif, int sock)
+{
+    esp8266_t *e = netif_to_esp8266(netif);
+    int i;
+
+    if (sock != ESP8266_LISTEN_SOCK)
+        return -1;
+
+    for (i = 0; i < ESP8266_MAX_LINKS; i++)
+    {
+        esp8266_link_t *link = &e->links[i];
+
+        if (link->state == LINK_FREE || !link->accept_pending)
+            continue;
+
+        link->accept_pending = 0;
+        /* Data that arrived before the accept is announced once the
+         * caller had a chance to listen for it.
+         */
+        if (link->rbuf_len && e->data_avail_timer_id < 0)
+        {
+            e->data_avail_timer_id = esp8266_timer_new(e, 0,
+                esp8266_data_avail_trigger);
+        }
+        return i;
+    }
+
+    return -1;
+}
+
 static u32 esp8266_netif_ip_addr_get(netif_t *netif)
 {
     esp8266_t *e = netif_to_esp8266(netif);
@@ -517,6 +1087,11 @@ static void esp8266_netif_free(netif_t *netif)
 {
     esp8266_t *e = netif_to_esp8266(netif);
 
+    esp8266_links_reset(e);
+    if (e->data_avail_timer_id >= 0)
+        event_timer_del(e->data_avail_timer_id);
+    esp8266_timeout_del(e);
+    esp8266_serial_in_watch_del(e);
     netif_unregister(netif);
     tfree(e);
 }
@@ -530,6 +1105,8 @@ static const netif_ops_t esp8266_netif_ops = {
     .tcp_read = esp8266_netif_tcp_read,
     .tcp_write = esp8266_netif_tcp_write,
     .disconnect = esp8266_netif_disconnect,
+    .tcp_listen = esp8266_netif_tcp_listen,
+    .tcp_accept = esp8266_netif_tcp_accept,
     .ip_addr_get = esp8266_netif_ip_addr_get,
     .free = esp8266_netif_free,
 };
@@ -544,9 +1121,12 @@ netif_t *esp8266_new(const esp8266_params_t *params)
 {
     esp8266_t *e = tmalloc_type(esp8266_t);
 
+    memset(e, 0, sizeof(*e));
     e->params = *params;
+    e->cmd_timer_id = -1;
+    e->data_avail_timer_id = -1;
+    e->timeout_evt_id = -1;
     sm_reset(e);
-    e->tcp_connected = 0;
     netif_register(&e->netif, "ESP8266 Wi-Fi to Serial Bridge",
         &esp8266_netif_ops);
     esp8266_init(e);
@@ -73,6 +73,7 @@ typedef u16 resource_t;
 #define SERIAL_RESOURCE_ID_BASE 0x02
 #define SPI_RESOURCE_ID_BASE 0x03
 #define NETIF_RESOURCE_ID_BASE 0x04
+#define NETIF_SOCK_RESOURCE_ID_BASE 0x05
 #define I2C_RESOURCE_ID_BASE 0x08
 
 #endif
@@ -117,6 +117,11 @@ void serial_event_signal(int u)
     event_watch_signal(UART_RES(u));
 }
 
+void serial_tx_event_trigger(int u)
+{
+    event_watch_trigger(UART_TX_RES(u));
+}
+
 static const serial_driver_t *get_serial_driver(resource_t id)
 {
     if (RES_BASE(id) != SERIAL_RESOURCE_ID_BASE)
@@ -31,8 +31,11 @@
 
 #define SERIAL_UART_MAJ 0
 #define SERIAL_USB_MAJ 1
+#define SERIAL_UART_TX_MAJ 2
 
 #define UART_RES(u) RES(SERIAL_RESOURCE_ID_BASE, SERIAL_UART_MAJ, u)
+/* Triggered when the UART can accept more data, if supported */
+#define UART_TX_RES(u) RES(SERIAL_RESOURCE_ID_BASE, SERIAL_UART_TX_MAJ, u)
 #define USB_RES RES(SERIAL_RESOURCE_ID_BASE, SERIAL_USB_MAJ, 0)
 
 int serial_read(resource_t id, char *buf, int size);
@@ -40,6 +40,7 @@ typedef struct {
 /* Used by the platform to set/test serial events */
 void serial_event_trigger(int u);
 void serial_event_signal(int u);
+void serial_tx_event_trigger(int u);
 
 #ifdef CONFIG_BUFFERED_SERIAL
 
@@ -23,25 +23,115 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "util/debug.h"
+#include "util/tp_misc.h"
+#include "mem/tmalloc.h"
 #include "fs/vfs.h"
 #include "fs/builtin_fs/builtin_fs.h"
+#ifdef CONFIG_BUILTIN_FS_COMPRESS
+#include "util/lzss.h"
+#endif
 
 extern const builtin_fs_file_t builtin_fs_files[];
+extern const int builtin_fs_files_num;
 
-static int builtin_fs_file_read(tstr_t *content, tstr_t *file_name)
+typedef struct {
+    vfs_file_t file;
+#ifdef CONFIG_BUILTIN_FS_COMPRESS
+    lzss_stream_t lz;
+    char window[CONFIG_BUILTIN_FS_COMPRESS_WINDOW];
+#endif
+    const char *data;
+    int len;
+    int pos;
+} builtin_fs_handle_t;
+
+#define to_builtin_fs_handle(f) container_of(f, builtin_fs_handle_t, file)
+
+static int name_cmp(const char *name, const tstr_t *s)
 {
-    const builtin_fs_file_t *f;
+    int i;
+
+    for (i = 0; i < s->len && name[i]; i++)
+    {
+        if (name[i] != tstr_peek(s, i))
+            return (unsigned char)name[i] - (unsigned char)tstr_peek(s, i);
+    }
+
+    if (i < s->len)
+        return -1;
+
+    return name[i] ? 1 : 0;
+}
+
+/* Files are sorted by name. A name without an extension matches the first
+ * file with that base name, e.g. "assert" matches "assert.js".
+ */
+static const builtin_fs_file_t *builtin_fs_lookup(tstr_t *file_name)
+{
+    int lo = 0, hi = builtin_fs_files_num, mid, len = file_name->len;
+    const char *name;
+
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if (name_cmp(builtin_fs_files[mid].name, file_name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    /* Names starting with file_name follow */
+    for (; lo < builtin_fs_files_num; lo++)
+    {
+        name = builtin_fs_files[lo].name;
+        if (strncmp(name, TPTR(file_name), len) || strlen(name) < len)
+            break;
+
+        if (!name[len] || (name[len] == '.' && !strchr(name + len + 1, '.')))
+            return &builtin_fs_files[lo];
+    }
+
+    tp_err("Builtin FS: File %S not found\n", file_name);
+    return NULL;
+}
+
+#ifdef CONFIG_BUILTIN_FS_COMPRESS
+/* Returns the plain text size, or -1 if it exceeds max */
+static int builtin_fs_plain_size(const char *data, u32 max)
+{
+    u32 size = lzss_size(data);
 
-    for (f = builtin_fs_files; f->name && tstr_cmp_str(file_name, f->name);
-        f++);
-    if (!f->name)
+    if (size > max)
     {
-        tp_err("Builtin FS: File %S not found\n", file_name);
+        tp_err("Builtin FS: File too large\n");
         return -1;
     }
 
+    return size;
+}
+#endif
+
+static int builtin_fs_file_read(tstr_t *content, tstr_t *file_name)
+{
+    const builtin_fs_file_t *f;
+#ifdef CONFIG_BUILTIN_FS_COMPRESS
+    int len;
+#endif
+
+    if (!(f = builtin_fs_lookup(file_name)))
+        return VFS_ERR_NOT_FOUND;
+
+#ifdef CONFIG_BUILTIN_FS_COMPRESS
+    /* tstr lengths are 16 bit */
+    if ((len = builtin_fs_plain_size(*f->content, (u16)~0)) < 0)
+        return -1;
+
+    tstr_init_alloc_data(content, len);
+    lzss_decompress(TPTR(content), *f->content);
+#else
     /* No need to dup the tstr as it is builtin */
     tstr_init(content, *f->content, strlen(*f->content), 0);
+#endif
     return 0;
 }
 
@@ -50,6 +140,93 @@ static int builtin_fs_file_write(tstr_t *content, tstr_t *file_name)
     return -1; /* Builtin FS is read only */
 }
     
+static vfs_file_t *builtin_fs_open(tstr_t *file_name, int flags)
+{
+    const builtin_fs_file_t *f;
+    builtin_fs_handle_t *h;
+#ifdef CONFIG_BUILTIN_FS_COMPRESS
+    int len;
+#endif
+
+    if (flags & (VFS_O_WRITE | VFS_O_CREATE | VFS_O_APPEND))
+        return NULL; /* Builtin FS is read only */
+
+    if (!(f = builtin_fs_lookup(file_name)))
+        return NULL;
+
+#ifdef CONFIG_BUILTIN_FS_COMPRESS
+    if ((len = builtin_fs_plain_size(*f->content, ~0U >> 1)) < 0)
+        return NULL;
+#endif
+
+    h = tmalloc_type(builtin_fs_handle_t);
+    h->data = *f->content;
+#ifdef CONFIG_BUILTIN_FS_COMPRESS
+    h->len = len;
+    lzss_stream_init(&h->lz, h->data, h->window,
+        CONFIG_BUILTIN_FS_COMPRESS_WINDOW);
+#else
+    h->len = strlen(*f->content);
+#endif
+    h->pos = 0;
+    return &h->file;
+}
+
+static int builtin_fs_read(vfs_file_t *file, char *buf, int len)
+{
+    builtin_fs_handle_t *h = to_builtin_fs_handle(file);
+
+#ifdef CONFIG_BUILTIN_FS_COMPRESS
+    len = lzss_stream_read(&h->lz, buf, len);
+#else
+    if (len > h->len - h->pos)
+        len = h->len - h->pos;
+
+    memcpy(buf, h->data + h->pos, len);
+#endif
+    h->pos += len;
+    return len;
+}
+
+static int builtin_fs_seek(vfs_file_t *file, int offset, int whence)
+{
+    builtin_fs_handle_t *h = to_builtin_fs_handle(file);
+
+    if (whence == VFS_SEEK_CUR)
+        offset += h->pos;
+    else if (whence == VFS_SEEK_END)
+        offset += h->len;
+
+    if (offset < 0 || offset > h->len)
+        return -1;
+
+#ifdef CONFIG_BUILTIN_FS_COMPRESS
+    /* The stream only goes forward, seeking back decodes from the start */
+    if (offset < h->pos)
+    {
+        lzss_stream_init(&h->lz, h->data, h->window,
+            CONFIG_BUILTIN_FS_COMPRESS_WINDOW);
+        h->pos = 0;
+    }
+
+    while (h->pos < offset)
+    {
+        char skip[32];
+        int len = offset - h->pos;
+
+        if (len > sizeof(skip))
+            len = sizeof(skip);
+        h->pos += lzss_stream_read(&h->lz, skip, len);
+    }
+#endif
+    return h->pos = offset;
+}
+
+static void builtin_fs_close(vfs_file_t *file)
+{
+    tfree(to_builtin_fs_handle(file));
+}
+
 static int builtin_fs_readdir(tstr_t *path, readdir_cb_t cb, void *ctx)
 {
     const builtin_fs_file_t *f;
@@ -84,4 +261,8 @@ const fs_t builtin_fs = {
     .file_read = builtin_fs_file_read,
     .file_write = builtin_fs_file_write,
     .readdir = builtin_fs_readdir,
+    .open = builtin_fs_open,
+    .read = builtin_fs_read,
+    .seek = builtin_fs_seek,
+    .close = builtin_fs_close,
 };
@@ -25,6 +25,7 @@
 #include "platform/platform.h"
 #include "util/debug.h"
 #include "util/tstr.h"
+#include "util/tp_misc.h"
 #include "mem/tmalloc.h"
 #include "drivers/block/block.h"
 #include "fs/vfs.h"
@@ -98,13 +99,17 @@ static int fat_file_read(tstr_t *content, tstr_t *file_name)
     FIL fp = {};
     FILINFO info;
     char *file_n = NULL;
+    FRESULT res;
     int rc = -1;
 
     file_n = tstr_to_strz(file_name);
 
-    if (f_stat(file_n, &info) != FR_OK)
+    res = f_stat(file_n, &info);
+    if (res != FR_OK)
     {
         /* Silently fail, this may have been a sweep in search of the file */
+        if (res == FR_NO_FILE || res == FR_NO_PATH)
+            rc = VFS_ERR_NOT_FOUND;
         goto Exit;
     }
 
@@ -175,6 +180,96 @@ Exit:
     return rc;
 }
 
+typedef struct {
+    vfs_file_t file;
+    FIL fp;
+} fat_file_t;
+
+#define to_fat_file(f) container_of(f, fat_file_t, file)
+
+static vfs_file_t *fat_open(tstr_t *file_name, int flags)
+{
+    fat_file_t *f;
+    char *file_n;
+    BYTE mode = 0;
+    FRESULT res;
+
+    if (flags & VFS_O_READ)
+        mode |= FA_READ;
+    if (flags & (VFS_O_WRITE | VFS_O_APPEND))
+        mode |= FA_WRITE;
+    if (flags & VFS_O_CREATE)
+        mode |= FA_CREATE_ALWAYS;
+    else if (flags & VFS_O_APPEND)
+        mode |= FA_OPEN_ALWAYS;
+    else
+        mode |= FA_OPEN_EXISTING;
+
+    f = tmalloc_type(fat_file_t);
+    memset(&f->fp, 0, sizeof(f->fp));
+    file_n = tstr_to_strz(file_name);
+    res = f_open(&f->fp, file_n, mode);
+    tfree(file_n);
+    if (res != FR_OK)
+        goto Error;
+
+    if ((flags & VFS_O_APPEND) && f_lseek(&f->fp, f_size(&f->fp)) != FR_OK)
+    {
+        f_close(&f->fp);
+        goto Error;
+    }
+
+    return &f->file;
+
+Error:
+    tfree(f);
+    return NULL;
+}
+
+static int fat_read(vfs_file_t *file, char *buf, int len)
+{
+    UINT br;
+
+    if (f_read(&to_fat_file(file)->fp, buf, len, &br) != FR_OK)
+        return -1;
+
+    return br;
+}
+
+static int fat_write(vfs_file_t *file, const char *buf, int len)
+{
+    UINT bw;
+
+    if (f_write(&to_fat_file(file)->fp, buf, len, &bw) != FR_OK)
+        return -1;
+
+    return bw;
+}
+
+static int fat_seek(vfs_file_t *file, int offset, int whence)
+{
+    FIL *fp = &to_fat_file(file)->fp;
+    long pos = offset;
+
+    if (whence == VFS_SEEK_CUR)
+        pos += f_tell(fp);
+    else if (whence == VFS_SEEK_END)
+        pos += f_size(fp);
+
+    if (pos < 0 || f_lseek(fp, pos) != FR_OK)
+        return -1;
+
+    return f_tell(fp);
+}
+
+static void fat_close(vfs_file_t *file)
+{
+    fat_file_t *f = to_fat_file(file);
+
+    f_close(&f->fp);
+    tfree(f);
+}
+
 static int fat_readdir(tstr_t *path, readdir_cb_t cb, void *ctx)
 {
     FRESULT res;
@@ -217,6 +312,16 @@ static int fat_readdir(tstr_t *path, readdir_cb_t cb, void *ctx)
     return res == FR_OK ? 0 : -1;
 }
 
+static int fat_unlink(tstr_t *file_name)
+{
+    char *file_n = tstr_to_strz(file_name);
+    FRESULT res;
+
+    res = f_unlink(file_n);
+    tfree(file_n);
+    return res == FR_OK ? 0 : -1;
+}
+
 static void fat_init(void)
 {
     f_mount(&g_fatfs, "0" , 1);
@@ -225,6 +330,8 @@ static void fat_init(void)
 static void fat_uninit(void)
 {
     f_mount(NULL, "0", 1);
+    /* Write back anything still held by the block layer */
+    block_ioctl(BLOCK_IOCTL_SYNC, NULL);
 }
 
 const fs_t fat_fs = {
@@ -234,4 +341,10 @@ const fs_t fat_fs = {
     .file_read = fat_file_read,
     .file_write = fat_file_write,
     .readdir = fat_readdir,
+    .unlink = fat_unlink,
+    .open = fat_open,
+    .read = fat_read,
+    .write = fat_write,
+    .seek = fat_seek,
+    .close = fat_close,
 };
@@ -26,9 +26,31 @@
 #include "js/js_obj.h"
 #include "js/js_utils.h"
 #include "js/jsapi_decl.h"
+#include "util/tp_misc.h"
+#include "js/js_event.h"
+#include "mem/tmalloc.h"
 #include "fs/vfs.h"
+#include "fs/vfs_async.h"
+#ifdef CONFIG_BLOCK_CACHE
+#include "drivers/block/block.h"
+#endif
 
 #define Sexception_path_not_found S("Exception: Path not found")
+#define Sexception_invalid_fd S("Exception: Invalid file descriptor")
+#define Sexception_io S("Exception: I/O error")
+
+#define Shits S("hits")
+#define Smisses S("misses")
+#define Sreads S("reads")
+#define Swrites S("writes")
+#define Swritten S("written")
+
+#define JS_FS_MAX_OPEN_FILES 8
+
+static struct {
+    vfs_file_t *file;
+    int pending; /* Async requests in flight */
+} open_files[JS_FS_MAX_OPEN_FILES];
 
 int do_read_file_sync(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
 {
@@ -113,3 +135,458 @@ Exit:
     tstr_free(&path);
     return rc;
 }
+
+int do_unlink_sync(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    tstr_t path;
+    int rc;
+
+    if (argc != 2)
+        return js_invalid_args(ret);
+
+    path = obj_get_str(argv[1]);
+
+    if (vfs_unlink(&path))
+    {
+        rc = throw_exception(ret, &Sexception_path_not_found);
+        goto Exit;
+    }
+
+    *ret = UNDEF;
+    rc = 0;
+
+Exit:
+    tstr_free(&path);
+    return rc;
+}
+
+/* Descriptors with async requests in flight may only queue more requests */
+#define FD_ALLOW_BUSY 0x1
+
+static int fd_get(obj_t **ret, obj_t *o, int *fd, int flags)
+{
+    if (!is_num(o))
+        return throw_exception(ret, &Sexception_invalid_fd);
+
+    *fd = obj_get_int(o);
+    if (*fd < 0 || *fd >= JS_FS_MAX_OPEN_FILES || !open_files[*fd].file)
+        return throw_exception(ret, &Sexception_invalid_fd);
+
+    if (open_files[*fd].pending && !(flags & FD_ALLOW_BUSY))
+        return throw_exception(ret, &S("Exception: File busy"));
+
+    return 0;
+}
+
+static int open_flags_parse(tstr_t *flags)
+{
+    static const struct {
+        const char *str;
+        int flags;
+    } modes[] = {
+        { "r", VFS_O_READ },
+        { "r+", VFS_O_READ | VFS_O_WRITE },
+        { "w", VFS_O_WRITE | VFS_O_CREATE },
+        { "w+", VFS_O_READ | VFS_O_WRITE | VFS_O_CREATE },
+        { "a", VFS_O_APPEND },
+        { "a+", VFS_O_READ | VFS_O_APPEND },
+    };
+    int i;
+
+    for (i = 0; i < ARRAY_SIZE(modes); i++)
+    {
+        if (!tstr_cmp_str(flags, modes[i].str))
+            return modes[i].flags;
+    }
+
+    return -1;
+}
+
+int do_open_sync(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    tstr_t path, flags_str = S("r");
+    int fd, flags;
+
+    if (argc != 2 && argc != 3)
+        return js_invalid_args(ret);
+
+    if (argc == 3)
+        flags_str = obj_get_str(argv[2]);
+
+    flags = open_flags_parse(&flags_str);
+    tstr_free(&flags_str);
+    if (flags < 0)
+        return js_invalid_args(ret);
+
+    for (fd = 0; fd < JS_FS_MAX_OPEN_FILES && open_files[fd].file; fd++);
+    if (fd == JS_FS_MAX_OPEN_FILES)
+        return throw_exception(ret, &S("Exception: Too many open files"));
+
+    path = obj_get_str(argv[1]);
+    open_files[fd].file = vfs_open(&path, flags);
+    tstr_free(&path);
+    if (!open_files[fd].file)
+        return throw_exception(ret, &Sexception_path_not_found);
+
+    *ret = num_new_int(fd);
+    return 0;
+}
+
+/* Locate the bytes backing an ArrayBuffer or a typed array */
+static int buffer_get(obj_t *o, char **buf, int *len)
+{
+    if (is_array_buffer(o))
+    {
+        tstr_t *t = &to_array_buffer(o)->value;
+
+        *buf = TPTR(t);
+        *len = t->len;
+        return 0;
+    }
+
+    if (is_array_buffer_view(o))
+    {
+        array_buffer_view_t *v = to_array_buffer_view(o);
+        int shift = v->flags & ABV_SHIFT_MASK;
+
+        *buf = TPTR(&v->array_buffer->value) + (v->offset << shift);
+        *len = v->length << shift;
+        return 0;
+    }
+
+    return -1;
+}
+
+int do_read_sync(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    char *buf;
+    int fd, len, rc;
+
+    if (argc != 3 && argc != 4)
+        return js_invalid_args(ret);
+
+    if ((rc = fd_get(ret, argv[1], &fd, 0)))
+        return rc;
+
+    if (buffer_get(argv[2], &buf, &len))
+        return js_invalid_args(ret);
+
+    if (argc == 4)
+    {
+        int max = obj_get_int(argv[3]);
+
+        if (max < 0)
+            return js_invalid_args(ret);
+        if (max < len)
+            len = max;
+    }
+
+    if ((rc = vfs_read(open_files[fd].file, buf, len)) < 0)
+        return throw_exception(ret, &Sexception_io);
+
+    *ret = num_new_int(rc);
+    return 0;
+}
+
+int do_write_sync(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    vfs_file_t *file;
+    char *buf;
+    int fd, len, rc;
+
+    if (argc != 3)
+        return js_invalid_args(ret);
+
+    if ((rc = fd_get(ret, argv[1], &fd, 0)))
+        return rc;
+
+    file = open_files[fd].file;
+    if (!buffer_get(argv[2], &buf, &len))
+        rc = vfs_write(file, buf, len);
+    else
+    {
+        tstr_t data = obj_get_str(argv[2]);
+
+        rc = vfs_write(file, TPTR(&data), data.len);
+        len = data.len;
+        tstr_free(&data);
+    }
+
+    if (rc != len)
+        return throw_exception(ret, &Sexception_io);
+
+    *ret = num_new_int(rc);
+    return 0;
+}
+
+int do_seek_sync(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    int fd, whence = VFS_SEEK_SET, pos, rc;
+
+    if (argc != 3 && argc != 4)
+        return js_invalid_args(ret);
+
+    if ((rc = fd_get(ret, argv[1], &fd, 0)))
+        return rc;
+
+    if (argc == 4)
+        whence = obj_get_int(argv[3]);
+
+    pos = vfs_seek(open_files[fd].file, obj_get_int(argv[2]), whence);
+    if (pos < 0)
+        return throw_exception(ret, &Sexception_io);
+
+    *ret = num_new_int(pos);
+    return 0;
+}
+
+int do_close_sync(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    int fd, rc;
+
+    if (argc != 2)
+        return js_invalid_args(ret);
+
+    if ((rc = fd_get(ret, argv[1], &fd, 0)))
+        return rc;
+
+    vfs_close(open_files[fd].file);
+    open_files[fd].file = NULL;
+    *ret = UNDEF;
+    return 0;
+}
+
+#ifdef CONFIG_VFS_ASYNC
+
+typedef struct {
+    vfs_async_req_t req;
+    event_t *cb; /* Holds the callback and keeps the buffer object alive */
+    int fd; /* -1 if the file is owned by the request */
+    tstr_t data;
+} js_fs_req_t;
+
+#define Sdata S("data")
+
+/* Release the file first, so that the callback sees the data flushed */
+static void js_fs_req_file_release(js_fs_req_t *r)
+{
+    if (r->fd >= 0)
+        open_files[r->fd].pending--;
+    else
+        vfs_close(r->req.file);
+}
+
+static void js_fs_req_free(js_fs_req_t *r)
+{
+    js_event_free(r->cb);
+    tstr_free(&r->data);
+    tfree(r);
+}
+
+static void js_fs_req_drop(vfs_async_req_t *req)
+{
+    js_fs_req_t *r = container_of(req, js_fs_req_t, req);
+
+    js_fs_req_file_release(r);
+    js_fs_req_free(r);
+}
+
+/* Calls cb(err, result) and frees the request, consumes result */
+static void js_fs_req_callback(js_fs_req_t *r, int failed, obj_t *result)
+{
+    obj_t *o, *this, *func, *argv[3];
+
+    js_fs_req_file_release(r);
+
+    argv[0] = func = js_event_get_func(r->cb);
+    argv[1] = failed ? string_new(Sexception_io) : UNDEF;
+    argv[2] = result;
+    this = js_event_get_this(r->cb);
+
+    function_call(&o, this, 3, argv);
+
+    obj_put(func);
+    obj_put(this);
+    obj_put(o);
+    obj_put(argv[1]);
+    obj_put(result);
+    js_fs_req_free(r);
+}
+
+static js_fs_req_t *js_fs_req_new(obj_t *this, obj_t *cb, int op, int fd,
+    vfs_file_t *file, void (*complete)(vfs_async_req_t *req, int rc))
+{
+    js_fs_req_t *r = tmalloc_type(js_fs_req_t);
+
+    r->req.file = file;
+    r->req.op = op;
+    r->req.complete = complete;
+    r->req.free = js_fs_req_drop;
+    r->cb = js_event_new(cb, this, NULL);
+    r->fd = fd;
+    r->data = S("");
+    if (fd >= 0)
+        open_files[fd].pending++;
+    return r;
+}
+
+/* Point the request at the bytes of a string or a buffer object */
+static void js_fs_req_data_set(js_fs_req_t *r, obj_t *data)
+{
+    if (!buffer_get(data, &r->req.buf, &r->req.len))
+    {
+        /* The request refers to the buffer memory, keep it alive */
+        obj_set_property(js_event_obj(r->cb), Sdata, data);
+        return;
+    }
+
+    r->data = obj_get_str(data);
+    r->req.buf = TPTR(&r->data);
+    r->req.len = r->data.len;
+}
+
+static void read_file_complete(vfs_async_req_t *req, int rc)
+{
+    js_fs_req_t *r = container_of(req, js_fs_req_t, req);
+    obj_t *result = UNDEF;
+
+    if (rc == req->len)
+    {
+        result = string_new(r->data);
+        r->data = S("");
+    }
+
+    js_fs_req_callback(r, rc != req->len, result);
+}
+
+int do_read_file(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    vfs_file_t *file;
+    js_fs_req_t *r;
+    tstr_t path;
+    int size;
+
+    if (argc != 3 || !is_function(argv[2]))
+        return js_invalid_args(ret);
+
+    path = obj_get_str(argv[1]);
+    file = vfs_open(&path, VFS_O_READ);
+    tstr_free(&path);
+    if (!file)
+        return throw_exception(ret, &Sexception_path_not_found);
+
+    if ((size = vfs_seek(file, 0, VFS_SEEK_END)) < 0 ||
+        vfs_seek(file, 0, VFS_SEEK_SET))
+    {
+        vfs_close(file);
+        return throw_exception(ret, &Sexception_io);
+    }
+
+    r = js_fs_req_new(this, argv[2], VFS_ASYNC_READ, -1, file,
+        read_file_complete);
+    tstr_init_alloc_data(&r->data, size);
+    r->req.buf = TPTR(&r->data);
+    r->req.len = size;
+    vfs_async_submit(&r->req);
+
+    *ret = UNDEF;
+    return 0;
+}
+
+static void write_file_complete(vfs_async_req_t *req, int rc)
+{
+    js_fs_req_t *r = container_of(req, js_fs_req_t, req);
+
+    js_fs_req_callback(r, rc != req->len, UNDEF);
+}
+
+int do_write_file(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    vfs_file_t *file;
+    js_fs_req_t *r;
+    tstr_t path;
+
+    if (argc != 4 || !is_function(argv[3]))
+        return js_invalid_args(ret);
+
+    path = obj_get_str(argv[1]);
+    file = vfs_open(&path, VFS_O_WRITE | VFS_O_CREATE);
+    tstr_free(&path);
+    if (!file)
+        return throw_exception(ret, &Sexception_path_not_found);
+
+    r = js_fs_req_new(this, argv[3], VFS_ASYNC_WRITE, -1, file,
+        write_file_complete);
+    js_fs_req_data_set(r, argv[2]);
+    vfs_async_submit(&r->req);
+
+    *ret = UNDEF;
+    return 0;
+}
+
+static void fd_io_complete(vfs_async_req_t *req, int rc)
+{
+    js_fs_req_t *r = container_of(req, js_fs_req_t, req);
+
+    js_fs_req_callback(r, rc < 0, rc < 0 ? UNDEF : num_new_int(rc));
+}
+
+static int fd_io(obj_t **ret, obj_t *this, int argc, obj_t *argv[], int op)
+{
+    js_fs_req_t *r;
+    int fd, rc;
+
+    if (argc != 4 || !is_function(argv[3]))
+        return js_invalid_args(ret);
+
+    if ((rc = fd_get(ret, argv[1], &fd, FD_ALLOW_BUSY)))
+        return rc;
+
+    if (op == VFS_ASYNC_READ && !is_array_buffer(argv[2]) &&
+        !is_array_buffer_view(argv[2]))
+    {
+        return js_invalid_args(ret);
+    }
+
+    r = js_fs_req_new(this, argv[3], op, fd, open_files[fd].file,
+        fd_io_complete);
+    js_fs_req_data_set(r, argv[2]);
+    vfs_async_submit(&r->req);
+
+    *ret = UNDEF;
+    return 0;
+}
+
+int do_read(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    return fd_io(ret, this, argc, argv, VFS_ASYNC_READ);
+}
+
+int do_write(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    return fd_io(ret, this, argc, argv, VFS_ASYNC_WRITE);
+}
+
+#endif
+
+#ifdef CONFIG_BLOCK_CACHE
+int do_get_cache_stats(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    block_cache_stats_t stats;
+
+    if (argc > 2)
+        return js_invalid_args(ret);
+
+    block_cache_stats_get(&stats);
+    if (argc == 2 && obj_true(argv[1]))
+        block_cache_stats_reset();
+
+    *ret = object_new();
+    obj_set_property_int(*ret, Shits, stats.hits);
+    obj_set_property_int(*ret, Smisses, stats.misses);
+    obj_set_property_int(*ret, Sreads, stats.reads);
+    obj_set_property_int(*ret, Swrites, stats.writes);
+    obj_set_property_int(*ret, Swritten, stats.written);
+    return 0;
+}
+#endif
@@ -0,0 +1,112 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/debug.h"
+#include "js/js_obj.h"
+#include "js/js_utils.h"
+#include "js/jsapi_decl.h"
+#include "fs/kv_store.h"
+
+#define Sexception_kv_store S("Exception: Key-value store error")
+
+#define Skeys S("keys")
+#define Slive S("live")
+#define Sdead S("dead")
+#define Sfree S("free")
+#define Scompactions S("compactions")
+
+int do_kv_get(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    tstr_t key, value;
+
+    if (argc != 2)
+        return js_invalid_args(ret);
+
+    key = obj_get_str(argv[1]);
+    *ret = kv_store_get(&value, &key) ? UNDEF : string_new(value);
+    tstr_free(&key);
+    return 0;
+}
+
+int do_kv_put(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    tstr_t key, value;
+    int rc;
+
+    if (argc != 3)
+        return js_invalid_args(ret);
+
+    key = obj_get_str(argv[1]);
+    value = obj_get_str(argv[2]);
+
+    if (kv_store_put(&key, &value))
+    {
+        rc = throw_exception(ret, &Sexception_kv_store);
+        goto Exit;
+    }
+
+    *ret = UNDEF;
+    rc = 0;
+
+Exit:
+    tstr_free(&key);
+    tstr_free(&value);
+    return rc;
+}
+
+int do_kv_delete(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    tstr_t key;
+
+    if (argc != 2)
+        return js_invalid_args(ret);
+
+    key = obj_get_str(argv[1]);
+    *ret = kv_store_delete(&key) ? FALSE : TRUE;
+    tstr_free(&key);
+    return 0;
+}
+
+int do_kv_close(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    kv_store_close();
+    *ret = UNDEF;
+    return 0;
+}
+
+int do_kv_get_stats(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    kv_store_stats_t stats;
+
+    if (kv_store_stats_get(&stats))
+        return throw_exception(ret, &Sexception_kv_store);
+
+    *ret = object_new();
+    obj_set_property_int(*ret, Skeys, stats.keys);
+    obj_set_property_int(*ret, Slive, stats.live);
+    obj_set_property_int(*ret, Sdead, stats.dead);
+    obj_set_property_int(*ret, Sfree, stats.free);
+    obj_set_property_int(*ret, Scompactions, stats.compactions);
+    return 0;
+}
@@ -0,0 +1,816 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h>
+#include "util/debug.h"
+#include "util/event.h"
+#include "util/tp_misc.h"
+#include "mem/tmalloc.h"
+#include "fs/kv_store.h"
+#ifdef CONFIG_KV_STORE_BACKEND_BLOCK
+#include "drivers/block/block.h"
+#else
+#include "fs/vfs.h"
+#endif
+
+/* Log structured store. The storage is split into segments, written in
+ * turns for wear leveling. Records are appended to the head segment, the
+ * oldest segment is reclaimed by moving its live records to the head.
+ *
+ * Segment header: magic (32 bit), sequence (32 bit), crc (32 bit).
+ * Record: key length (16 bit), value length (16 bit, KV_TOMBSTONE for
+ * deletes), crc (32 bit), key, value.
+ *
+ * Record crcs are seeded with the segment sequence, so stale records left
+ * from a previous use of the segment are never replayed. Replay of a
+ * segment stops at the first bad record, which drops records torn by a
+ * power failure. Each write leaves a zeroed record header after the data,
+ * if the log doesn't end with one, writes continue in a new segment rather
+ * than next to the damage. Since records only move forward in sequence
+ * order, a record interrupted while being moved is found in both segments
+ * and the newer copy wins.
+ */
+
+#define KV_SEG_SIZE CONFIG_KV_STORE_SEGMENT_SIZE
+#define KV_SEGS CONFIG_KV_STORE_SEGMENTS
+#define KV_SEG_MAGIC 0x564b5054 /* "TPKV" */
+#define KV_SEG_HDR_SIZE 12
+#define KV_REC_HDR_SIZE 8
+#define KV_TOMBSTONE 0xffff
+#define KV_MAX_KEY_LEN 255
+#define KV_MAX_REC_SIZE (KV_SEG_SIZE - KV_SEG_HDR_SIZE)
+#define KV_INDEX_BUCKETS 32
+/* Records moved per event loop iteration */
+#define KV_COMPACT_BATCH 4
+
+typedef struct kv_entry_t {
+    struct kv_entry_t *next;
+    u32 offset; /* Record offset in the store */
+    u16 value_len;
+    u8 key_len;
+    char key[];
+} kv_entry_t;
+
+typedef struct {
+    event_t e;
+    int id;
+} kv_pump_t;
+
+typedef struct {
+    u16 key_len;
+    u16 value_len;
+    u32 size;
+    char key[KV_MAX_KEY_LEN];
+} kv_rec_t;
+
+static struct {
+    int mounted;
+    kv_entry_t *index[KV_INDEX_BUCKETS];
+    u32 seq[KV_SEGS]; /* 0 for free segments */
+    u32 end[KV_SEGS]; /* Bytes written, including the header */
+    u32 live[KV_SEGS]; /* Bytes of live records */
+    int head;
+    int compact_seg;
+    u32 compact_pos; /* 0 when idle */
+    u32 keys, compactions;
+    kv_pump_t *pump;
+} kv;
+
+#ifdef CONFIG_KV_STORE_BACKEND_BLOCK
+
+static int dev_open(void)
+{
+    return block_init();
+}
+
+/* Reads to rbuf or writes wbuf, partial sectors are read first */
+static int dev_io(u32 offset, u8 *rbuf, const u8 *wbuf, int len)
+{
+    static u8 sector[BLOCK_SECTOR_SIZE];
+
+    while (len)
+    {
+        int sec = CONFIG_KV_STORE_FIRST_SECTOR + offset / BLOCK_SECTOR_SIZE;
+        int off = offset % BLOCK_SECTOR_SIZE, n = BLOCK_SECTOR_SIZE - off;
+
+        if (n > len)
+            n = len;
+
+        if (wbuf && n == BLOCK_SECTOR_SIZE)
+        {
+            if (block_write(wbuf, sec, 1))
+                return -1;
+        }
+        else
+        {
+            if (block_read(sector, sec, 1))
+                return -1;
+
+            if (!wbuf)
+                memcpy(rbuf, sector + off, n);
+            else
+            {
+                memcpy(sector + off, wbuf, n);
+                if (block_write(sector, sec, 1))
+                    return -1;
+            }
+        }
+
+        offset += n;
+        if (wbuf)
+            wbuf += n;
+        else
+            rbuf += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+static int dev_read(u32 offset, void *buf, int len)
+{
+    return dev_io(offset, buf, NULL, len);
+}
+
+static int dev_write(u32 offset, const void *buf, int len)
+{
+    return dev_io(offset, NULL, buf, len);
+}
+
+static void dev_sync(void)
+{
+    block_ioctl(BLOCK_IOCTL_SYNC, NULL);
+}
+
+static void dev_close(void)
+{
+    dev_sync();
+}
+
+#else
+
+static vfs_file_t *dev_file;
+
+static int dev_open(void)
+{
+    static char zeros[64];
+    tstr_t path = S(CONFIG_KV_STORE_FILE_PATH);
+    int size;
+
+    if (!(dev_file = vfs_open(&path, VFS_O_READ | VFS_O_WRITE)) &&
+        !(dev_file = vfs_open(&path, VFS_O_READ | VFS_O_WRITE | VFS_O_CREATE)))
+    {
+        return -1;
+    }
+
+    /* Reads never go past the end of the file */
+    size = vfs_seek(dev_file, 0, VFS_SEEK_END);
+    while (size >= 0 && (u32)size < (u32)KV_SEGS * KV_SEG_SIZE)
+    {
+        if (vfs_write(dev_file, zeros, sizeof(zeros)) != sizeof(zeros))
+            size = -1;
+        else
+            size += sizeof(zeros);
+    }
+
+    if (size < 0)
+    {
+        vfs_close(dev_file);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int dev_read(u32 offset, void *buf, int len)
+{
+    if (vfs_seek(dev_file, offset, VFS_SEEK_SET) < 0)
+        return -1;
+
+    return vfs_read(dev_file, buf, len) == len ? 0 : -1;
+}
+
+static int dev_write(u32 offset, const void *buf, int len)
+{
+    if (vfs_seek(dev_file, offset, VFS_SEEK_SET) < 0)
+        return -1;
+
+    return vfs_write(dev_file, buf, len) == len ? 0 : -1;
+}
+
+static void dev_sync(void)
+{
+}
+
+static void dev_close(void)
+{
+    vfs_close(dev_file);
+    dev_file = NULL;
+}
+
+#endif
+
+static void put_u16(u8 *p, u16 v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_u32(u8 *p, u32 v)
+{
+    put_u16(p, v);
+    put_u16(p + 2, v >> 16);
+}
+
+static u16 get_u16(const u8 *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static u32 get_u32(const u8 *p)
+{
+    return get_u16(p) | (u32)get_u16(p + 2) << 16;
+}
+
+static u32 crc32(u32 crc, const void *buf, int len)
+{
+    const u8 *p = buf;
+    int i;
+
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static inline u32 seg_offset(int seg)
+{
+    return (u32)seg * KV_SEG_SIZE;
+}
+
+static inline u32 rec_size(int key_len, int value_len)
+{
+    return (u32)KV_REC_HDR_SIZE + key_len +
+        (value_len == KV_TOMBSTONE ? 0 : (u16)value_len);
+}
+
+static u32 key_hash(const char *key, int len)
+{
+    u32 h = 2166136261u;
+
+    while (len--)
+        h = (h ^ (u8)*key++) * 16777619;
+    return h;
+}
+
+static kv_entry_t **index_find(const char *key, int len)
+{
+    kv_entry_t **e;
+
+    for (e = &kv.index[key_hash(key, len) % KV_INDEX_BUCKETS]; *e;
+        e = &(*e)->next)
+    {
+        if ((*e)->key_len == len && !memcmp((*e)->key, key, len))
+            break;
+    }
+
+    return e;
+}
+
+static inline void live_update(kv_entry_t *e, int delta)
+{
+    kv.live[e->offset / KV_SEG_SIZE] += delta *
+        rec_size(e->key_len, e->value_len);
+}
+
+static void index_set(const char *key, int len, u32 offset, int value_len)
+{
+    kv_entry_t **pe = index_find(key, len), *e = *pe;
+
+    if (e)
+        live_update(e, -1);
+    else
+    {
+        e = *pe = tmalloc(sizeof(kv_entry_t) + len, "kv_entry_t");
+        e->next = NULL;
+        e->key_len = len;
+        memcpy(e->key, key, len);
+        kv.keys++;
+    }
+
+    e->offset = offset;
+    e->value_len = value_len;
+    live_update(e, 1);
+}
+
+static void index_remove(const char *key, int len)
+{
+    kv_entry_t **pe = index_find(key, len), *e = *pe;
+
+    if (!e)
+        return;
+
+    live_update(e, -1);
+    *pe = e->next;
+    tfree(e);
+    kv.keys--;
+}
+
+static void index_free(void)
+{
+    kv_entry_t *e;
+    int i;
+
+    for (i = 0; i < KV_INDEX_BUCKETS; i++)
+    {
+        while ((e = kv.index[i]))
+        {
+            kv.index[i] = e->next;
+            tfree(e);
+        }
+    }
+    kv.keys = 0;
+}
+
+/* Reads the record header and key at pos of seg, returns -1 at the end of
+ * the segment data.
+ */
+static int rec_read(kv_rec_t *rec, int seg, u32 pos)
+{
+    u8 hdr[KV_REC_HDR_SIZE], buf[32];
+    u32 crc, offset = seg_offset(seg) + pos;
+    int value_len, done, n;
+
+    if (pos + KV_REC_HDR_SIZE > KV_SEG_SIZE ||
+        dev_read(offset, hdr, sizeof(hdr)))
+    {
+        return -1;
+    }
+
+    rec->key_len = get_u16(hdr);
+    rec->value_len = get_u16(hdr + 2);
+    rec->size = rec_size(rec->key_len, rec->value_len);
+    if (!rec->key_len || rec->key_len > KV_MAX_KEY_LEN ||
+        pos + rec->size > KV_SEG_SIZE)
+    {
+        return -1;
+    }
+
+    if (dev_read(offset + KV_REC_HDR_SIZE, rec->key, rec->key_len))
+        return -1;
+
+    crc = crc32(kv.seq[seg], hdr, 4);
+    crc = crc32(crc, rec->key, rec->key_len);
+    value_len = rec->size - KV_REC_HDR_SIZE - rec->key_len;
+    offset += KV_REC_HDR_SIZE + rec->key_len;
+    for (done = 0; done < value_len; done += n)
+    {
+        n = value_len - done > sizeof(buf) ? sizeof(buf) : value_len - done;
+        if (dev_read(offset + done, buf, n))
+            return -1;
+        crc = crc32(crc, buf, n);
+    }
+
+    return crc == get_u32(hdr + 4) ? 0 : -1;
+}
+
+static void seg_replay(int seg)
+{
+    kv_rec_t rec;
+    u32 pos = KV_SEG_HDR_SIZE;
+
+    for (; !rec_read(&rec, seg, pos); pos += rec.size)
+    {
+        if (rec.value_len == KV_TOMBSTONE)
+            index_remove(rec.key, rec.key_len);
+        else
+            index_set(rec.key, rec.key_len, seg_offset(seg) + pos,
+                rec.value_len);
+    }
+
+    kv.end[seg] = pos;
+}
+
+/* Marks the end of the log at pos of seg */
+static int end_mark(int seg, u32 pos)
+{
+    static const u8 zeros[KV_REC_HDR_SIZE];
+
+    if (pos + KV_REC_HDR_SIZE > KV_SEG_SIZE)
+        return 0;
+
+    return dev_write(seg_offset(seg) + pos, zeros, sizeof(zeros));
+}
+
+static int end_is_marked(int seg, u32 pos)
+{
+    u8 hdr[KV_REC_HDR_SIZE];
+    int i;
+
+    if (pos + KV_REC_HDR_SIZE > KV_SEG_SIZE)
+        return 1;
+
+    if (dev_read(seg_offset(seg) + pos, hdr, sizeof(hdr)))
+        return 0;
+
+    for (i = 0; i < sizeof(hdr) && !hdr[i]; i++);
+    return i == sizeof(hdr);
+}
+
+static int seg_start(int seg, u32 seq)
+{
+    u8 hdr[KV_SEG_HDR_SIZE];
+
+    put_u32(hdr, KV_SEG_MAGIC);
+    put_u32(hdr + 4, seq);
+    put_u32(hdr + 8, crc32(0, hdr, 8));
+    if (end_mark(seg, KV_SEG_HDR_SIZE) ||
+        dev_write(seg_offset(seg), hdr, sizeof(hdr)))
+    {
+        return -1;
+    }
+
+    kv.seq[seg] = seq;
+    kv.end[seg] = KV_SEG_HDR_SIZE;
+    kv.live[seg] = 0;
+    kv.head = seg;
+    return 0;
+}
+
+static void seg_free(int seg)
+{
+    u8 hdr[KV_SEG_HDR_SIZE] = {};
+
+    dev_write(seg_offset(seg), hdr, sizeof(hdr));
+    dev_sync();
+    kv.seq[seg] = 0;
+}
+
+/* Segment with the lowest sequence above seg's, or -1 */
+static int seg_next(int seg)
+{
+    int s, next = -1;
+
+    for (s = 0; s < KV_SEGS; s++)
+    {
+        if (kv.seq[s] > kv.seq[seg] && (next < 0 || kv.seq[s] < kv.seq[next]))
+            next = s;
+    }
+    return next;
+}
+
+static int segs_free(void)
+{
+    int seg, n = 0;
+
+    for (seg = 0; seg < KV_SEGS; seg++)
+        n += !kv.seq[seg];
+    return n;
+}
+
+static int seg_oldest(void)
+{
+    int seg, oldest = kv.head;
+
+    for (seg = 0; seg < KV_SEGS; seg++)
+    {
+        if (kv.seq[seg] && kv.seq[seg] < kv.seq[oldest])
+            oldest = seg;
+    }
+    return oldest;
+}
+
+static u32 dead_bytes(void)
+{
+    u32 dead = 0;
+    int seg;
+
+    for (seg = 0; seg < KV_SEGS; seg++)
+    {
+        if (kv.seq[seg])
+            dead += kv.end[seg] - KV_SEG_HDR_SIZE - kv.live[seg];
+    }
+    return dead;
+}
+
+static int compact_step(void);
+
+static void pump_stop(void)
+{
+    if (!kv.pump)
+        return;
+
+    event_timer_del(kv.pump->id);
+    kv.pump = NULL;
+}
+
+static void pump_trigger(event_t *e, u32 resource_id, u64 timestamp)
+{
+    int i, rc = 0;
+
+    for (i = 0; i < KV_COMPACT_BATCH && !rc; i++)
+        rc = compact_step();
+
+    if (rc < 0 || (rc && (segs_free() > 1 || !dead_bytes())))
+        pump_stop();
+}
+
+static void pump_free(event_t *e)
+{
+    kv_pump_t *p = container_of(e, kv_pump_t, e);
+
+    if (p == kv.pump)
+        kv.pump = NULL; /* Event loop shutdown */
+    tfree(p);
+}
+
+/* Compaction runs in the background once a single free segment is left */
+static void compact_schedule(void)
+{
+    if (kv.pump || segs_free() > 1 || !dead_bytes())
+        return;
+
+    kv.pump = tmalloc_type(kv_pump_t);
+    kv.pump->e = (event_t){
+        .trigger = pump_trigger,
+        .free = pump_free,
+    };
+    kv.pump->id = event_timer_set_period(0, &kv.pump->e);
+}
+
+/* Sets the record offset on success. Compaction may use the last free
+ * segment, puts leave it for compaction.
+ */
+static int append(u32 *offset, const char *key, int key_len,
+    const char *value, int value_len, int compacting)
+{
+    u8 hdr[KV_REC_HDR_SIZE];
+    u32 size = rec_size(key_len, value_len), crc;
+    int seg;
+
+    if (kv.end[kv.head] + size > KV_SEG_SIZE)
+    {
+        if (segs_free() < (compacting ? 1 : 2))
+            return -1;
+
+        /* Next free segment in turn */
+        for (seg = (kv.head + 1) % KV_SEGS; kv.seq[seg];
+            seg = (seg + 1) % KV_SEGS);
+
+        if (seg_start(seg, kv.seq[kv.head] + 1))
+            return -1;
+
+        compact_schedule();
+    }
+
+    put_u16(hdr, key_len);
+    put_u16(hdr + 2, value_len);
+    crc = crc32(kv.seq[kv.head], hdr, 4);
+    crc = crc32(crc, key, key_len);
+    if (value_len != KV_TOMBSTONE)
+        crc = crc32(crc, value, value_len);
+    put_u32(hdr + 4, crc);
+
+    *offset = seg_offset(kv.head) + kv.end[kv.head];
+    if (dev_write(*offset, hdr, sizeof(hdr)) ||
+        dev_write(*offset + KV_REC_HDR_SIZE, key, key_len) ||
+        (value_len != KV_TOMBSTONE && dev_write(*offset + KV_REC_HDR_SIZE +
+        key_len, value, value_len)) ||
+        end_mark(kv.head, kv.end[kv.head] + size))
+    {
+        return -1;
+    }
+
+    dev_sync();
+    kv.end[kv.head] += size;
+    return 0;
+}
+
+/* Moves the next live record of the oldest segment to the head. Returns 1
+ * once the segment was reclaimed, -1 if there is nothing to compact.
+ */
+static int compact_step(void)
+{
+    kv_entry_t *e;
+    kv_rec_t rec;
+    char *value;
+    u32 offset;
+
+    if (!kv.compact_pos)
+    {
+        if ((kv.compact_seg = seg_oldest()) == kv.head)
+            return -1;
+
+        kv.compact_pos = KV_SEG_HDR_SIZE;
+    }
+
+    if (kv.compact_pos >= kv.end[kv.compact_seg] ||
+        rec_read(&rec, kv.compact_seg, kv.compact_pos))
+    {
+        seg_free(kv.compact_seg);
+        kv.compact_pos = 0;
+        kv.compactions++;
+        return 1;
+    }
+
+    offset = seg_offset(kv.compact_seg) + kv.compact_pos;
+    e = *index_find(rec.key, rec.key_len);
+    if (e && e->offset == offset)
+    {
+        value = tmalloc(e->value_len + 1, "kv value");
+        if (dev_read(offset + KV_REC_HDR_SIZE + rec.key_len, value,
+            e->value_len) || append(&offset, rec.key, rec.key_len, value,
+            e->value_len, 1))
+        {
+            tfree(value);
+            return -1;
+        }
+
+        tfree(value);
+        index_set(rec.key, rec.key_len, offset, e->value_len);
+    }
+
+    kv.compact_pos += rec.size;
+    return 0;
+}
+
+static int mount(void)
+{
+    u8 hdr[KV_SEG_HDR_SIZE];
+    int seg;
+
+    if (kv.mounted)
+        return 0;
+
+    if (dev_open())
+    {
+        tp_err("KV store: failed to open storage\n");
+        return -1;
+    }
+
+    kv.head = -1;
+    for (seg = 0; seg < KV_SEGS; seg++)
+    {
+        kv.seq[seg] = kv.live[seg] = 0;
+        if (dev_read(seg_offset(seg), hdr, sizeof(hdr)) ||
+            get_u32(hdr) != KV_SEG_MAGIC ||
+            get_u32(hdr + 8) != crc32(0, hdr, 8))
+        {
+            continue;
+        }
+
+        kv.seq[seg] = get_u32(hdr + 4);
+        if (kv.head < 0 || kv.seq[seg] > kv.seq[kv.head])
+            kv.head = seg;
+    }
+
+    if (kv.head < 0 && seg_start(0, 1))
+    {
+        dev_close();
+        return -1;
+    }
+
+    /* Replay in sequence order, so that later records win */
+    for (seg = seg_oldest(); seg >= 0; seg = seg_next(seg))
+        seg_replay(seg);
+
+    /* Don't write next to a torn record */
+    if (!end_is_marked(kv.head, kv.end[kv.head]))
+        kv.end[kv.head] = KV_SEG_SIZE;
+
+    kv.compact_pos = 0;
+    kv.mounted = 1;
+    compact_schedule();
+    return 0;
+}
+
+int kv_store_get(tstr_t *value, tstr_t *key)
+{
+    kv_entry_t *e;
+
+    if (mount() || !(e = *index_find(TPTR(key), key->len)))
+        return -1;
+
+    tstr_init_alloc_data(value, e->value_len);
+    if (dev_read(e->offset + KV_REC_HDR_SIZE + e->key_len, TPTR(value),
+        e->value_len))
+    {
+        tstr_free(value);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Appends a record, reclaiming the oldest segments when the store is out
+ * of free segments.
+ */
+static int append_reclaim(u32 *offset, tstr_t *key, const char *value,
+    int value_len)
+{
+    int tries = 0, rc;
+
+    while (append(offset, TPTR(key), key->len, value, value_len, 0))
+    {
+        if (!dead_bytes() || tries++ == 2 * KV_SEGS)
+        {
+            tp_err("KV store: out of space\n");
+            return -1;
+        }
+
+        while (!(rc = compact_step()));
+        if (rc < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+int kv_store_put(tstr_t *key, tstr_t *value)
+{
+    u32 offset;
+
+    if (!key->len || key->len > KV_MAX_KEY_LEN || value->len >=
+        KV_TOMBSTONE || rec_size(key->len, value->len) > KV_MAX_REC_SIZE)
+    {
+        return -1;
+    }
+
+    if (mount() || append_reclaim(&offset, key, TPTR(value), value->len))
+    {
+        return -1;
+    }
+
+    index_set(TPTR(key), key->len, offset, value->len);
+    return 0;
+}
+
+int kv_store_delete(tstr_t *key)
+{
+    u32 offset;
+
+    if (mount() || !*index_find(TPTR(key), key->len) ||
+        append_reclaim(&offset, key, NULL, KV_TOMBSTONE))
+    {
+        return -1;
+    }
+
+    index_remove(TPTR(key), key->len);
+    return 0;
+}
+
+int kv_store_stats_get(kv_store_stats_t *stats)
+{
+    int seg;
+
+    if (mount())
+        return -1;
+
+    stats->keys = kv.keys;
+    stats->live = 0;
+    for (seg = 0; seg < KV_SEGS; seg++)
+    {
+        if (kv.seq[seg])
+            stats->live += kv.live[seg];
+    }
+    stats->dead = dead_bytes();
+    stats->free = segs_free();
+    stats->compactions = kv.compactions;
+    return 0;
+}
+
+void kv_store_close(void)
+{
+    if (!kv.mounted)
+        return;
+
+    pump_stop();
+    index_free();
+    dev_close();
+    kv.mounted = 0;
+}
@@ -0,0 +1,63 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __KV_STORE_H__
+#define __KV_STORE_H__
+
+#include "util/tstr.h"
+#include "util/tp_types.h"
+
+#ifdef CONFIG_KV_STORE
+
+typedef struct {
+    u32 keys;
+    u32 live; /* Bytes of records holding current values */
+    u32 dead; /* Bytes of overwritten and deleted records */
+    u32 free; /* Free segments */
+    u32 compactions; /* Segments reclaimed */
+} kv_store_stats_t;
+
+/* The store is mounted on first access. Values are returned allocated. */
+int kv_store_get(tstr_t *value, tstr_t *key);
+int kv_store_put(tstr_t *key, tstr_t *value);
+/* Returns -1 if the key does not exist */
+int kv_store_delete(tstr_t *key);
+
+int kv_store_stats_get(kv_store_stats_t *stats);
+
+/* Drops the RAM index, the next access mounts the store again */
+void kv_store_close(void);
+
+static inline void kv_store_uninit(void)
+{
+    kv_store_close();
+}
+
+#else
+
+static inline void kv_store_uninit(void) { }
+
+#endif
+
+#endif
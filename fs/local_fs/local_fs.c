@@ -25,9 +25,12 @@
 #include "util/debug.h"
 #include "platform/platform.h"
 #include "util/tstr.h"
+#include "util/tp_misc.h"
 #include "mem/tmalloc.h"
 #include "fs/vfs.h"
 #include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
 
 static int local_file_read_fill_fn(void *ctx, char *buf, int size)
 {
@@ -47,6 +50,8 @@ static int local_file_read(tstr_t *content, tstr_t *file_name)
     if (!(fp = fopen(file_n, "r")))
     {
         /* Silently fail */
+        if (errno == ENOENT || errno == ENOTDIR)
+            rc = VFS_ERR_NOT_FOUND;
         goto Exit;
     }
 
@@ -115,12 +120,95 @@ Exit:
     return rc;
 }
 
+typedef struct {
+    vfs_file_t file;
+    FILE *fp;
+} local_file_t;
+
+#define to_local_file(f) container_of(f, local_file_t, file)
+
+static vfs_file_t *local_open(tstr_t *file_name, int flags)
+{
+    local_file_t *f;
+    const char *mode;
+    char *file_n;
+    FILE *fp;
+
+    if (flags & VFS_O_APPEND)
+        mode = flags & VFS_O_READ ? "a+" : "a";
+    else if (flags & VFS_O_CREATE)
+        mode = flags & VFS_O_READ ? "w+" : "w";
+    else
+        mode = flags & VFS_O_WRITE ? "r+" : "r";
+
+    file_n = tstr_to_strz(file_name);
+    fp = fopen(file_n, mode);
+    tfree(file_n);
+    if (!fp)
+        return NULL;
+
+    f = tmalloc_type(local_file_t);
+    f->fp = fp;
+    return &f->file;
+}
+
+static int local_read(vfs_file_t *file, char *buf, int len)
+{
+    FILE *fp = to_local_file(file)->fp;
+    size_t nread;
+
+    nread = fread(buf, 1, len, fp);
+    return nread || !ferror(fp) ? nread : -1;
+}
+
+static int local_write(vfs_file_t *file, const char *buf, int len)
+{
+    FILE *fp = to_local_file(file)->fp;
+    size_t nwrote;
+
+    nwrote = fwrite(buf, 1, len, fp);
+    return nwrote || !ferror(fp) ? nwrote : -1;
+}
+
+static int local_seek(vfs_file_t *file, int offset, int whence)
+{
+    static const int whences[] = {
+        [VFS_SEEK_SET] = SEEK_SET,
+        [VFS_SEEK_CUR] = SEEK_CUR,
+        [VFS_SEEK_END] = SEEK_END,
+    };
+    FILE *fp = to_local_file(file)->fp;
+
+    if (fseek(fp, offset, whences[whence]))
+        return -1;
+
+    return ftell(fp);
+}
+
+static void local_close(vfs_file_t *file)
+{
+    local_file_t *f = to_local_file(file);
+
+    fclose(f->fp);
+    tfree(f);
+}
+
 int local_readdir(tstr_t *path, readdir_cb_t cb, void *ctx)
 {
     tp_err("Readdir not implemented yet...\n");
     return -1;
 }
 
+static int local_unlink(tstr_t *file_name)
+{
+    char *file_n = tstr_to_strz(file_name);
+    int rc;
+
+    rc = unlink(file_n);
+    tfree(file_n);
+    return rc ? -1 : 0;
+}
+
 static void local_init(void)
 {
 }
@@ -136,4 +224,12 @@ const fs_t local_fs = {
     .file_read = local_file_read,
     .file_write = local_file_write,
     .readdir = local_readdir,
+    .unlink = local_unlink,
+    .open = local_open,
+    .read = local_read,
+    .write = local_write,
+    .seek = local_seek,
+    .close = local_close,
+    /* Host stdio handles its own locking */
+    .thread_safe = 1,
 };
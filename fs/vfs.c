@@ -24,6 +24,8 @@
  */
 #include "util/debug.h"
 #include "fs/vfs.h"
+#include "fs/vfs_async.h"
+#include "fs/kv_store.h"
 
 #ifdef CONFIG_FAT_FS
 extern const fs_t fat_fs;
@@ -50,6 +52,69 @@ static const fs_t *fs_list[] = {
 
 #define foreach_fs(fs) for (fs = fs_list; *fs; fs++)
 
+static vfs_file_t *open_files;
+
+#ifdef CONFIG_VFS_NEGATIVE_CACHE
+
+/* File names not found by vfs_file_read_anyfs(), per FS. Repeated lookups,
+ * e.g. require() of builtin modules, skip the FSs known not to hold the
+ * file. Writing to an FS through the VFS forgets its misses.
+ */
+typedef struct {
+    tstr_t name;
+    u32 fs_misses; /* Bit per fs_list entry */
+} vfs_neg_entry_t;
+
+static vfs_neg_entry_t neg_cache[CONFIG_VFS_NEGATIVE_CACHE_SIZE];
+static int neg_cache_next;
+
+static vfs_neg_entry_t *neg_cache_get(tstr_t *file_name)
+{
+    vfs_neg_entry_t *e;
+    int i;
+
+    for (i = 0; i < CONFIG_VFS_NEGATIVE_CACHE_SIZE; i++)
+    {
+        e = &neg_cache[i];
+        if (e->name.len && !tstr_cmp(&e->name, file_name))
+            return e;
+    }
+
+    /* Replace the oldest entry */
+    e = &neg_cache[neg_cache_next];
+    neg_cache_next = (neg_cache_next + 1) % CONFIG_VFS_NEGATIVE_CACHE_SIZE;
+    tstr_free(&e->name);
+    tstr_init_alloc_data(&e->name, file_name->len);
+    memcpy(TPTR(&e->name), TPTR(file_name), file_name->len);
+    e->fs_misses = 0;
+    return e;
+}
+
+static void neg_cache_forget(const fs_t *fs)
+{
+    const fs_t **iter;
+    int i;
+
+    for (iter = fs_list; *iter != fs; iter++);
+    for (i = 0; i < CONFIG_VFS_NEGATIVE_CACHE_SIZE; i++)
+        neg_cache[i].fs_misses &= ~(1 << (iter - fs_list));
+}
+
+static void neg_cache_uninit(void)
+{
+    int i;
+
+    for (i = 0; i < CONFIG_VFS_NEGATIVE_CACHE_SIZE; i++)
+        tstr_free(&neg_cache[i].name);
+}
+
+#else
+
+static inline void neg_cache_forget(const fs_t *fs) { }
+static inline void neg_cache_uninit(void) { }
+
+#endif
+
 int vfs_is_root_path(tstr_t *path)
 {
     char c;
@@ -67,11 +132,33 @@ int vfs_is_root_path(tstr_t *path)
 static int vfs_file_read_anyfs(tstr_t *content, tstr_t *file_name)
 {
     const fs_t **fs;
+#ifdef CONFIG_VFS_NEGATIVE_CACHE
+    vfs_neg_entry_t *e = neg_cache_get(file_name);
+    u32 bit;
+
+    foreach_fs(fs)
+    {
+        bit = 1 << (fs - fs_list);
+        if (!(*fs)->file_read || (e->fs_misses & bit))
+            continue;
+
+        switch ((*fs)->file_read(content, file_name))
+        {
+        case 0:
+            return 0;
+        case VFS_ERR_NOT_FOUND:
+            /* Other errors, e.g. an unmounted card, may go away */
+            e->fs_misses |= bit;
+            break;
+        }
+    }
+#else
     foreach_fs(fs)
     {
         if ((*fs)->file_read && !(*fs)->file_read(content, file_name))
             return 0;
     }
+#endif
     return -1;
 }
 
@@ -128,9 +215,80 @@ int vfs_file_write(tstr_t *content, tstr_t *file_name)
     if (!(fs = get_fs(&fs_name)))
         return -1;
 
+    neg_cache_forget(fs);
     return fs->file_write(content, &file_path);
 }
 
+int vfs_unlink(tstr_t *file_name)
+{
+    const fs_t *fs;
+    tstr_t fs_name, file_path;
+
+    path_parse(file_name, &fs_name, &file_path);
+    if (!(fs = get_fs(&fs_name)) || !fs->unlink)
+        return -1;
+
+    return fs->unlink(&file_path);
+}
+
+vfs_file_t *vfs_open(tstr_t *file_name, int flags)
+{
+    const fs_t *fs;
+    tstr_t fs_name, file_path;
+    vfs_file_t *file;
+
+    path_parse(file_name, &fs_name, &file_path);
+    if (!(fs = get_fs(&fs_name)))
+        return NULL;
+
+    if (!fs->open)
+    {
+        tp_err("VFS: %s FS does not support open\n", fs->name);
+        return NULL;
+    }
+
+    if (flags & (VFS_O_WRITE | VFS_O_CREATE | VFS_O_APPEND))
+        neg_cache_forget(fs);
+
+    if (!(file = fs->open(&file_path, flags)))
+        return NULL;
+
+    file->fs = fs;
+    file->next = open_files;
+    open_files = file;
+    return file;
+}
+
+int vfs_read(vfs_file_t *file, char *buf, int len)
+{
+    return file->fs->read(file, buf, len);
+}
+
+int vfs_write(vfs_file_t *file, const char *buf, int len)
+{
+    if (!file->fs->write)
+        return -1; /* Read only FS */
+
+    return file->fs->write(file, buf, len);
+}
+
+int vfs_seek(vfs_file_t *file, int offset, int whence)
+{
+    if (whence < VFS_SEEK_SET || whence > VFS_SEEK_END)
+        return -1;
+
+    return file->fs->seek(file, offset, whence);
+}
+
+void vfs_close(vfs_file_t *file)
+{
+    vfs_file_t **iter;
+
+    for (iter = &open_files; *iter != file; iter = &(*iter)->next);
+    *iter = file->next;
+    file->fs->close(file);
+}
+
 static void readdir_root(readdir_cb_t cb, void *ctx)
 {
     const fs_t **fs;
@@ -179,6 +337,14 @@ void vfs_uninit(void)
 {
     const fs_t **fs;
     tp_out("VFS Uninit\n");
+    vfs_async_uninit();
+    kv_store_uninit();
+    while (open_files)
+    {
+        tp_warn("VFS: closing file left open\n");
+        vfs_close(open_files);
+    }
+    neg_cache_uninit();
     foreach_fs(fs)
     {
         (*fs)->uninit();
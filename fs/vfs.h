@@ -31,14 +31,49 @@
 
 typedef void (*readdir_cb_t)(tstr_t *file_name, void *ctx);
 
-typedef struct {
+typedef struct fs_t fs_t;
+
+/* Open file handle. File systems embed it in their own handle struct */
+typedef struct vfs_file_t {
+    struct vfs_file_t *next;
+    const fs_t *fs;
+} vfs_file_t;
+
+/* vfs_open() flags */
+#define VFS_O_READ 0x1
+#define VFS_O_WRITE 0x2
+#define VFS_O_CREATE 0x4 /* Create or truncate */
+#define VFS_O_APPEND 0x8 /* Writes go to the end of the file */
+
+/* vfs_seek() whence */
+#define VFS_SEEK_SET 0
+#define VFS_SEEK_CUR 1
+#define VFS_SEEK_END 2
+
+/* file_read() error for files that don't exist, as opposed to failing to
+ * read them.
+ */
+#define VFS_ERR_NOT_FOUND -2
+
+struct fs_t {
     const char *name;
     int (*file_read)(tstr_t *content, tstr_t *file_name);
     int (*file_write)(tstr_t *content, tstr_t *file_name);
     int (*readdir)(tstr_t *path, readdir_cb_t cb, void *ctx);
+    int (*unlink)(tstr_t *file_name); /* Optional */
+    /* Handle based access. Optional, read/write return the number of bytes
+     * transferred or -1, seek returns the new position or -1.
+     */
+    vfs_file_t *(*open)(tstr_t *file_name, int flags);
+    int (*read)(vfs_file_t *file, char *buf, int len);
+    int (*write)(vfs_file_t *file, const char *buf, int len);
+    int (*seek)(vfs_file_t *file, int offset, int whence);
+    void (*close)(vfs_file_t *file);
     void (*init)(void);
     void (*uninit)(void);
-} fs_t;
+    /* Handle ops may run on another thread alongside other VFS calls */
+    int thread_safe;
+};
 
 #define VFS_FLAGS_ANY_FS 0x1
 
@@ -46,6 +81,13 @@ int vfs_is_root_path(tstr_t *path);
 int vfs_file_read(tstr_t *content, tstr_t *file_name, int flags);
 int vfs_file_write(tstr_t *content, tstr_t *file_name);
 int vfs_readdir(tstr_t *path, readdir_cb_t cb, void *ctx);
+int vfs_unlink(tstr_t *file_name);
+
+vfs_file_t *vfs_open(tstr_t *file_name, int flags);
+int vfs_read(vfs_file_t *file, char *buf, int len);
+int vfs_write(vfs_file_t *file, const char *buf, int len);
+int vfs_seek(vfs_file_t *file, int offset, int whence);
+void vfs_close(vfs_file_t *file);
 
 void vfs_init(void);
 void vfs_uninit(void);
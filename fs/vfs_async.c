@@ -0,0 +1,429 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/debug.h"
+#include "util/event.h"
+#include "util/tp_misc.h"
+#include "mem/tmalloc.h"
+#include "fs/vfs_async.h"
+
+#ifdef CONFIG_VFS_ASYNC_THREAD
+#include "drivers/resources.h"
+#include "drivers/serial/serial.h"
+#include "platform/unix/sim.h"
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+    vfs_async_req_t *head;
+    vfs_async_req_t *tail;
+} req_queue_t;
+
+typedef struct vfs_async_backend_t vfs_async_backend_t;
+
+/* The pump keeps the event loop alive while a backend has requests in
+ * flight.
+ */
+typedef struct {
+    event_t e;
+    int id;
+    const vfs_async_backend_t *backend;
+} vfs_async_pump_t;
+
+struct vfs_async_backend_t {
+    vfs_async_pump_t **pump;
+    int (*start)(void);
+    void (*add)(vfs_async_req_t *req);
+    void (*trigger)(void);
+    int (*idle)(void);
+    int (*pump_set)(vfs_async_pump_t *p);
+    void (*pump_del)(vfs_async_pump_t *p);
+    void (*drop_all)(void);
+};
+
+static void req_enqueue(req_queue_t *q, vfs_async_req_t *req)
+{
+    req->next = NULL;
+    if (q->tail)
+        q->tail->next = req;
+    else
+        q->head = req;
+    q->tail = req;
+}
+
+static vfs_async_req_t *req_dequeue(req_queue_t *q)
+{
+    vfs_async_req_t *req = q->head;
+
+    if (!req)
+        return NULL;
+
+    if (!(q->head = req->next))
+        q->tail = NULL;
+    return req;
+}
+
+/* Returns 1 once the request is complete */
+static int req_step(vfs_async_req_t *req)
+{
+    int len = req->len - req->done, rc;
+
+    if (len > CONFIG_VFS_ASYNC_CHUNK_SIZE)
+        len = CONFIG_VFS_ASYNC_CHUNK_SIZE;
+
+    if (req->op == VFS_ASYNC_READ)
+        rc = vfs_read(req->file, req->buf + req->done, len);
+    else
+        rc = vfs_write(req->file, req->buf + req->done, len);
+
+    if (rc < 0)
+    {
+        req->done = -1;
+        return 1;
+    }
+
+    req->done += rc;
+    /* Short transfer means end of file */
+    return rc < len || req->done == req->len;
+}
+
+static void req_complete(vfs_async_req_t *req)
+{
+    req->complete(req, req->done);
+}
+
+static void reqs_free(req_queue_t *q)
+{
+    vfs_async_req_t *req;
+
+    while ((req = req_dequeue(q)))
+        req->free(req);
+}
+
+/* Requests are processed a chunk per event loop iteration, so that timers
+ * and interrupt driven events are served in between.
+ */
+static req_queue_t chunk_pending;
+static vfs_async_pump_t *chunk_pump;
+
+static void chunk_add(vfs_async_req_t *req)
+{
+    req_enqueue(&chunk_pending, req);
+}
+
+static void chunk_trigger(void)
+{
+    vfs_async_req_t *req = chunk_pending.head;
+
+    if (!req || !req_step(req))
+        return;
+
+    req_dequeue(&chunk_pending);
+    /* May submit further requests */
+    req_complete(req);
+}
+
+static int chunk_idle(void)
+{
+    return !chunk_pending.head;
+}
+
+static int chunk_pump_set(vfs_async_pump_t *p)
+{
+    return event_timer_set_period(0, &p->e);
+}
+
+static void chunk_pump_del(vfs_async_pump_t *p)
+{
+    event_timer_del(p->id);
+}
+
+static void chunk_drop_all(void)
+{
+    reqs_free(&chunk_pending);
+}
+
+static const vfs_async_backend_t chunk_backend = {
+    .pump = &chunk_pump,
+    .add = chunk_add,
+    .trigger = chunk_trigger,
+    .idle = chunk_idle,
+    .pump_set = chunk_pump_set,
+    .pump_del = chunk_pump_del,
+    .drop_all = chunk_drop_all,
+};
+
+#ifdef CONFIG_VFS_ASYNC_THREAD
+
+/* Requests on thread safe file systems are handed to a worker thread, which
+ * writes a byte to a pipe watched by the event loop for each completed
+ * request.
+ */
+static pthread_t worker;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static req_queue_t worker_pending, completed;
+static vfs_async_req_t *busy;
+static vfs_async_pump_t *worker_pump;
+static int worker_started, worker_stop, pipe_fds[2], pipe_event_id = -1;
+
+static void *worker_thread(void *arg)
+{
+    vfs_async_req_t *req;
+    char c = 0;
+
+    pthread_mutex_lock(&lock);
+    while (!worker_stop)
+    {
+        if (!(req = req_dequeue(&worker_pending)))
+        {
+            pthread_cond_wait(&cond, &lock);
+            continue;
+        }
+
+        busy = req;
+        pthread_mutex_unlock(&lock);
+        while (!req_step(req));
+        pthread_mutex_lock(&lock);
+        busy = NULL;
+        req_enqueue(&completed, req);
+        pthread_cond_broadcast(&cond);
+        if (write(pipe_fds[1], &c, 1) != 1)
+            tp_err("VFS async: failed to signal completion\n");
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+static int worker_start(void)
+{
+    if (worker_started)
+        return 0;
+
+    if (pipe(pipe_fds))
+    {
+        tp_err("VFS async: failed to create pipe\n");
+        return -1;
+    }
+
+    if ((pipe_event_id = unix_sim_event_id_alloc()) < 0)
+        goto Error;
+
+    unix_set_nonblock(pipe_fds[0]);
+    unix_sim_add_fd_event_to_map(pipe_event_id, pipe_fds[0], pipe_fds[1]);
+    worker_stop = 0;
+    if (pthread_create(&worker, NULL, worker_thread, NULL))
+    {
+        unix_sim_remove_fd_event_from_map(pipe_event_id);
+        unix_sim_event_id_free(pipe_event_id);
+        goto Error;
+    }
+
+    worker_started = 1;
+    return 0;
+
+Error:
+    tp_err("VFS async: failed to start worker\n");
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return -1;
+}
+
+static void worker_uninit(void)
+{
+    if (!worker_started)
+        return;
+
+    pthread_mutex_lock(&lock);
+    worker_stop = 1;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&lock);
+    pthread_join(worker, NULL);
+
+    unix_sim_remove_fd_event_from_map(pipe_event_id);
+    unix_sim_event_id_free(pipe_event_id);
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    worker_started = 0;
+}
+
+static void worker_add(vfs_async_req_t *req)
+{
+    pthread_mutex_lock(&lock);
+    req_enqueue(&worker_pending, req);
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+static void worker_trigger(void)
+{
+    vfs_async_req_t *req;
+    char buf[16];
+
+    while (read(pipe_fds[0], buf, sizeof(buf)) > 0);
+
+    for (;;)
+    {
+        pthread_mutex_lock(&lock);
+        req = req_dequeue(&completed);
+        pthread_mutex_unlock(&lock);
+        if (!req)
+            break;
+
+        /* May submit further requests */
+        req_complete(req);
+    }
+}
+
+static int worker_idle(void)
+{
+    int idle;
+
+    pthread_mutex_lock(&lock);
+    idle = !worker_pending.head && !busy && !completed.head;
+    pthread_mutex_unlock(&lock);
+    return idle;
+}
+
+static int worker_pump_set(vfs_async_pump_t *p)
+{
+    return event_watch_set(UART_RES(pipe_event_id), &p->e);
+}
+
+static void worker_pump_del(vfs_async_pump_t *p)
+{
+    event_watch_del(p->id);
+}
+
+static void worker_drop_all(void)
+{
+    req_queue_t q;
+
+    pthread_mutex_lock(&lock);
+    /* The request in progress can't be interrupted, wait for it */
+    while (busy)
+        pthread_cond_wait(&cond, &lock);
+    q = completed;
+    completed = (req_queue_t){};
+    if (worker_pending.head)
+    {
+        if (q.tail)
+            q.tail->next = worker_pending.head;
+        else
+            q.head = worker_pending.head;
+        q.tail = worker_pending.tail;
+        worker_pending = (req_queue_t){};
+    }
+    pthread_mutex_unlock(&lock);
+    reqs_free(&q);
+}
+
+static const vfs_async_backend_t worker_backend = {
+    .pump = &worker_pump,
+    .start = worker_start,
+    .add = worker_add,
+    .trigger = worker_trigger,
+    .idle = worker_idle,
+    .pump_set = worker_pump_set,
+    .pump_del = worker_pump_del,
+    .drop_all = worker_drop_all,
+};
+
+static const vfs_async_backend_t *backend_get(vfs_file_t *file)
+{
+    /* Other file systems share state with the synchronous calls made on
+     * the event loop, e.g. FatFs and the block cache.
+     */
+    return file->fs->thread_safe ? &worker_backend : &chunk_backend;
+}
+
+#else
+
+static inline const vfs_async_backend_t *backend_get(vfs_file_t *file)
+{
+    return &chunk_backend;
+}
+
+static inline void worker_uninit(void) { }
+
+#endif
+
+static void pump_free(event_t *e)
+{
+    vfs_async_pump_t *p = container_of(e, vfs_async_pump_t, e);
+    const vfs_async_backend_t *b = p->backend;
+
+    if (p == *b->pump)
+    {
+        /* Event loop shutdown, requests will never complete */
+        *b->pump = NULL;
+        b->drop_all();
+    }
+    tfree(p);
+}
+
+static void pump_event_trigger(event_t *e, u32 resource_id, u64 timestamp)
+{
+    const vfs_async_backend_t *b = container_of(e, vfs_async_pump_t,
+        e)->backend;
+
+    b->trigger();
+    if (*b->pump && b->idle())
+    {
+        b->pump_del(*b->pump);
+        *b->pump = NULL;
+    }
+}
+
+void vfs_async_submit(vfs_async_req_t *req)
+{
+    const vfs_async_backend_t *b = backend_get(req->file);
+    vfs_async_pump_t *p;
+
+    req->done = 0;
+    if (b->start && b->start())
+    {
+        req->complete(req, -1);
+        return;
+    }
+
+    b->add(req);
+    if (*b->pump)
+        return;
+
+    p = tmalloc_type(vfs_async_pump_t);
+    p->e = (event_t){
+        .trigger = pump_event_trigger,
+        .free = pump_free,
+    };
+    p->backend = b;
+    *b->pump = p;
+    p->id = b->pump_set(p);
+}
+
+void vfs_async_uninit(void)
+{
+    worker_uninit();
+}
@@ -0,0 +1,68 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __VFS_ASYNC_H__
+#define __VFS_ASYNC_H__
+
+#include "fs/vfs.h"
+
+#ifdef CONFIG_VFS_ASYNC
+
+#define VFS_ASYNC_READ 0
+#define VFS_ASYNC_WRITE 1
+
+typedef struct vfs_async_req_t vfs_async_req_t;
+
+/* Requests are embedded by their owners and processed in submission order
+ * per file system, CONFIG_VFS_ASYNC_CHUNK_SIZE bytes at a time.
+ */
+struct vfs_async_req_t {
+    vfs_async_req_t *next;
+    vfs_file_t *file;
+    int op; /* VFS_ASYNC_XXX */
+    char *buf;
+    int len;
+    int done; /* Bytes transferred so far */
+    /* Called from the event loop. rc is the number of bytes transferred,
+     * less than len on end of file, or -1 on error.
+     */
+    void (*complete)(vfs_async_req_t *req, int rc);
+    /* Called instead of complete when the request is dropped on shutdown */
+    void (*free)(vfs_async_req_t *req);
+};
+
+/* Transfer req->len bytes at the current position of req->file. The file
+ * and the buffer must not be used until the request completes.
+ */
+void vfs_async_submit(vfs_async_req_t *req);
+
+void vfs_async_uninit(void);
+
+#else
+
+static inline void vfs_async_uninit(void) { }
+
+#endif
+
+#endif
@@ -23,8 +23,11 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "util/debug.h"
+#include "util/tp_misc.h"
 #include "graphics/canvas.h"
 
+#define SPAN_CHUNK 32
+
 static void swap(u16 *a, u16 *b)
 {
     u16 tmp = *a;
@@ -41,10 +44,162 @@ static void cap(u16 *a, u16 lo, u16 hi)
         *a = hi;
 }
 
+/* Intersect [x0, x1) x [y0, y1) with the canvas */
+static int clip(canvas_t *c, canvas_rect_t *r, int x0, int y0, int x1, int y1)
+{
+    x0 = MAX(x0, 0);
+    y0 = MAX(y0, 0);
+    x1 = MIN(x1, c->width);
+    y1 = MIN(y1, c->height);
+    if (x0 >= x1 || y0 >= y1)
+        return -1;
+
+    *r = (canvas_rect_t){ .x0 = x0, .y0 = y0, .x1 = x1, .y1 = y1 };
+    return 0;
+}
+
+/* Generic fallbacks for drivers lacking the block transfer ops */
+static void ops_fill_rect(canvas_t *c, const canvas_rect_t *r, u16 val)
+{
+    u16 x, y;
+
+    if (c->ops->fill_rect)
+    {
+        c->ops->fill_rect(c, r, val);
+        return;
+    }
+
+    for (y = r->y0; y < r->y1; y++)
+    {
+        if (c->ops->hline)
+        {
+            c->ops->hline(c, r->x0, r->x1, y, val);
+            continue;
+        }
+
+        for (x = r->x0; x < r->x1; x++)
+        {
+            /* Skipping sanity checks */
+            c->ops->pixel_set(c, x, y, val);
+        }
+    }
+}
+
+static void ops_write_span(canvas_t *c, u16 x, u16 y, u16 n,
+    const u16 *pixels)
+{
+    if (c->ops->write_span)
+    {
+        c->ops->write_span(c, x, y, n, pixels);
+        return;
+    }
+
+    while (n--)
+        c->ops->pixel_set(c, x++, y, *pixels++);
+}
+
+static u32 rect_area(const canvas_rect_t *r)
+{
+    return (u32)(r->x1 - r->x0) * (r->y1 - r->y0);
+}
+
+static void rect_union(canvas_rect_t *r, const canvas_rect_t *o)
+{
+    if (o->x0 < r->x0)
+        r->x0 = o->x0;
+    if (o->y0 < r->y0)
+        r->y0 = o->y0;
+    if (o->x1 > r->x1)
+        r->x1 = o->x1;
+    if (o->y1 > r->y1)
+        r->y1 = o->y1;
+}
+
+/* Undamaged area the union of two rectangles would add */
+static u32 merge_cost(const canvas_rect_t *a, const canvas_rect_t *b)
+{
+    canvas_rect_t u = *a;
+    u32 sum = rect_area(a) + rect_area(b), area;
+
+    rect_union(&u, b);
+    area = rect_area(&u);
+    return area > sum ? area - sum : 0;
+}
+
+/* Absorb the rectangles that the grown damage[ri] now touches */
+static void damage_coalesce(canvas_t *c, int ri)
+{
+    int i = 0;
+
+    while (i < c->damage_count)
+    {
+        if (i == ri || merge_cost(&c->damage[ri], &c->damage[i]))
+        {
+            i++;
+            continue;
+        }
+
+        rect_union(&c->damage[ri], &c->damage[i]);
+        c->damage[i] = c->damage[--c->damage_count];
+        if (ri == c->damage_count)
+            ri = i;
+        i = 0;
+    }
+}
+
+void canvas_damage_add(canvas_t *c, u16 x0, u16 y0, u16 x1, u16 y1)
+{
+    canvas_rect_t n = { .x0 = x0, .y0 = y0, .x1 = x1, .y1 = y1 };
+    u32 cost, best_cost = ~0;
+    int i, best = 0;
+
+    if (x0 >= x1 || y0 >= y1)
+        return;
+
+    for (i = 0; i < c->damage_count; i++)
+    {
+        canvas_rect_t *r = &c->damage[i];
+
+        if (r->x0 <= x0 && r->y0 <= y0 && r->x1 >= x1 && r->y1 >= y1)
+            return; /* Already damaged */
+
+        if ((cost = merge_cost(r, &n)) < best_cost)
+        {
+            best_cost = cost;
+            best = i;
+        }
+    }
+
+    /* Keep separate changes apart while there is room */
+    if (best_cost && c->damage_count < CONFIG_GRAPHICS_DAMAGE_RECTS)
+    {
+        c->damage[c->damage_count++] = n;
+        return;
+    }
+
+    rect_union(&c->damage[best], &n);
+    damage_coalesce(c, best);
+}
+
+void canvas_flip(canvas_t *c)
+{
+    int i;
+
+    if (c->ops->flush)
+    {
+        for (i = 0; i < c->damage_count; i++)
+            c->ops->flush(c, &c->damage[i]);
+        c->damage_count = 0;
+    }
+
+    if (c->ops->flip)
+        c->ops->flip(c);
+}
+
 void canvas_hline(canvas_t *c, u16 x0, u16 x1, u16 y, u16 val)
 {
     u16 w = c->width - 1;
-    int i;
+    canvas_rect_t r;
 
     if (y > c->height - 1)
         return;
@@ -55,23 +210,23 @@ void canvas_hline(canvas_t *c, u16 x0, u16 x1, u16 y, u16 val)
     cap(&x0, 0, w - 1);
     cap(&x1, 0, w - 1);
 
+    if (c->ops->flush)
+        canvas_damage_add(c, x0, y, x1, y + 1);
+
     if (c->ops->hline)
     {
         c->ops->hline(c, x0, x1, y, val);
         return;
     }
 
-    for (i = x0; i < x1; i++)
-    {
-        /* Skipping sanity checks */
-        c->ops->pixel_set(c, i, y, val);
-    }
+    r = (canvas_rect_t){ .x0 = x0, .y0 = y, .x1 = x1, .y1 = y + 1 };
+    ops_fill_rect(c, &r, val);
 }
 
 void canvas_vline(canvas_t *c, u16 x, u16 y0, u16 y1, u16 val)
 {
     u16 h = c->height - 1;
-    int j;
+    canvas_rect_t r;
 
     if (x > c->width - 1)
         return;
@@ -82,22 +237,28 @@ void canvas_vline(canvas_t *c, u16 x, u16 y0, u16 y1, u16 val)
     cap(&y0, 0, h - 1);
     cap(&y1, 0, h - 1);
 
+    if (c->ops->flush)
+        canvas_damage_add(c, x, y0, x + 1, y1);
+
     if (c->ops->vline)
     {
         c->ops->vline(c, x, y0, y1, val);
         return;
     }
 
-    for (j = y0; j < y1; j++)
-    {
-        /* Skipping sanity checks */
-        c->ops->pixel_set(c, x, j, val);
-    }
+    r = (canvas_rect_t){ .x0 = x, .y0 = y0, .x1 = x + 1, .y1 = y1 };
+    ops_fill_rect(c, &r, val);
 }
 
 void canvas_fill(canvas_t *c, u16 val)
 {
-    int i, j;
+    canvas_rect_t r = { .x1 = c->width, .y1 = c->height };
+
+    if (c->ops->flush)
+    {
+        c->damage[0] = r;
+        c->damage_count = 1;
+    }
 
     if (c->ops->fill)
     {
@@ -105,12 +266,95 @@ void canvas_fill(canvas_t *c, u16 val)
         return;
     }
 
-    for (i = 0; i < c->width; i++)
+    ops_fill_rect(c, &r, val);
+}
+
+void canvas_fill_rect(canvas_t *c, int x, int y, int w, int h, u16 val)
+{
+    canvas_rect_t r;
+
+    if (clip(c, &r, x, y, x + w, y + h))
+        return;
+
+    if (c->ops->flush)
+        canvas_damage_add(c, r.x0, r.y0, r.x1, r.y1);
+
+    ops_fill_rect(c, &r, val);
+}
+
+void canvas_write_span(canvas_t *c, int x, int y, int n, const u16 *pixels)
+{
+    canvas_rect_t r;
+
+    if (clip(c, &r, x, y, x + n, y + 1))
+        return;
+
+    if (c->ops->flush)
+        canvas_damage_add(c, r.x0, r.y0, r.x1, r.y1);
+
+    ops_write_span(c, r.x0, r.y0, r.x1 - r.x0, pixels + (r.x0 - x));
+}
+
+/* Draw the part of the bitmap at (x, y) that lies in r */
+static void blit_generic(canvas_t *c, int x, int y, const canvas_bitmap_t *b,
+    const canvas_rect_t *r, u16 fg, u16 bg)
+{
+    int transparent = b->flags & CANVAS_BITMAP_TRANSPARENT;
+    u16 span[SPAN_CHUNK];
+    canvas_rect_t run;
+    int i, n, set;
+
+    for (run.y0 = r->y0; run.y0 < r->y1; run.y0++)
     {
-        for (j = 0; j < c->height; j++)
+        run.y1 = run.y0 + 1;
+
+        if (!transparent && c->ops->write_span)
         {
-            /* Skipping sanity checks */
-            c->ops->pixel_set(c, i, j, val);
+            for (run.x0 = r->x0; run.x0 < r->x1; run.x0 += n)
+            {
+                n = MIN(r->x1 - run.x0, SPAN_CHUNK);
+                for (i = 0; i < n; i++)
+                {
+                    span[i] = canvas_bitmap_pixel(b, run.x0 + i - x,
+                        run.y0 - y) ? fg : bg;
+                }
+                c->ops->write_span(c, run.x0, run.y0, n, span);
+            }
+            continue;
         }
+
+        /* Runs of equal pixels */
+        for (run.x0 = r->x0; run.x0 < r->x1; run.x0 = run.x1)
+        {
+            set = !!canvas_bitmap_pixel(b, run.x0 - x, run.y0 - y);
+            for (run.x1 = run.x0 + 1; run.x1 < r->x1 &&
+                !!canvas_bitmap_pixel(b, run.x1 - x, run.y0 - y) == set;
+                run.x1++);
+
+            if (set || !transparent)
+                ops_fill_rect(c, &run, set ? fg : bg);
+        }
+    }
+}
+
+void canvas_blit(canvas_t *c, int x, int y, const canvas_bitmap_t *b, u16 fg,
+    u16 bg)
+{
+    canvas_rect_t r;
+
+    if (clip(c, &r, x, y, x + b->width, y + b->height))
+        return;
+
+    if (c->ops->flush)
+        canvas_damage_add(c, r.x0, r.y0, r.x1, r.y1);
+
+    if (c->ops->blit && !(b->flags & CANVAS_BITMAP_TRANSPARENT) &&
+        r.x0 == x && r.y0 == y && r.x1 - x == b->width &&
+        r.y1 - y == b->height)
+    {
+        c->ops->blit(c, x, y, b, fg, bg);
+        return;
     }
+
+    blit_generic(c, x, y, b, &r, fg, bg);
 }
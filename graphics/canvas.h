@@ -28,12 +28,40 @@
 #include "util/tp_types.h"
 
 typedef struct canvas_t canvas_t;
+
+/* [x0, x1) x [y0, y1) */
+typedef struct {
+    u16 x0, y0, x1, y1;
+} canvas_rect_t;
+
+/* 1 bit per pixel, rows of stride bytes */
+typedef struct {
+    u16 width;
+    u16 height;
+    u16 stride;
+#define CANVAS_BITMAP_LSB_FIRST (1<<0) /* Bit 0 is the leftmost pixel */
+#define CANVAS_BITMAP_TRANSPARENT (1<<1) /* Clear bits are not drawn */
+    u8 flags;
+    const u8 *bits;
+} canvas_bitmap_t;
     
 typedef struct {
     void (*pixel_set)(canvas_t *c, u16 x, u16 y, u16 val);
     void (*hline)(canvas_t *c, u16 x0, u16 x1, u16 y, u16 val);
     void (*vline)(canvas_t *c, u16 x0, u16 y0, u16 y1, u16 val);
     void (*fill)(canvas_t *c, u16 val);
+    /* Block transfers, called with areas inside the canvas. A controller
+     * can draw each as a single window write.
+     */
+    void (*fill_rect)(canvas_t *c, const canvas_rect_t *r, u16 val);
+    void (*write_span)(canvas_t *c, u16 x, u16 y, u16 n, const u16 *pixels);
+    /* Opaque bitmaps only, transparent ones are drawn as fill_rect runs */
+    void (*blit)(canvas_t *c, u16 x, u16 y, const canvas_bitmap_t *b, u16 fg,
+        u16 bg);
+    /* Frame buffered canvases write a buffer rectangle to the display.
+     * Drawing is then tracked and flip flushes only the damaged areas.
+     */
+    void (*flush)(canvas_t *c, const canvas_rect_t *r);
     void (*flip)(canvas_t *c);
     void (*free)(canvas_t *c);
 } canvas_ops_t;
@@ -42,25 +70,41 @@ struct canvas_t {
     const canvas_ops_t *ops;
     u16 width;
     u16 height;
+    /* Areas drawn since the last flip, when ops->flush is set */
+    canvas_rect_t damage[CONFIG_GRAPHICS_DAMAGE_RECTS];
+    u8 damage_count;
 };
 
+void canvas_damage_add(canvas_t *c, u16 x0, u16 y0, u16 x1, u16 y1);
+
 static inline void canvas_pixel_set(canvas_t *c, u16 x, u16 y, u16 val)
 {
     if ((s16)x < 0 || x >= c->width || (s16)y < 0 || y >= c->height)
         return;
 
-    c->ops->pixel_set(c, x, y, val);
-}
+    if (c->ops->flush)
+        canvas_damage_add(c, x, y, x + 1, y + 1);
 
-static inline void canvas_flip(canvas_t *c)
-{
-    if (c->ops->flip)
-        c->ops->flip(c);
+    c->ops->pixel_set(c, x, y, val);
 }
 
+void canvas_flip(canvas_t *c);
 void canvas_hline(canvas_t *c, u16 x0, u16 x1, u16 y, u16 val);
 void canvas_vline(canvas_t *c, u16 x, u16 y0, u16 y1, u16 val);
 void canvas_fill(canvas_t *c, u16 val);
+void canvas_fill_rect(canvas_t *c, int x, int y, int w, int h, u16 val);
+void canvas_write_span(canvas_t *c, int x, int y, int n, const u16 *pixels);
+void canvas_blit(canvas_t *c, int x, int y, const canvas_bitmap_t *b, u16 fg,
+    u16 bg);
+
+static inline int canvas_bitmap_pixel(const canvas_bitmap_t *b, int x, int y)
+{
+    u8 cell = b->bits[y * b->stride + (x >> 3)];
+
+    if (b->flags & CANVAS_BITMAP_LSB_FIRST)
+        return cell & (1 << (x & 0x7));
+    return cell & (0x80 >> (x & 0x7));
+}
 
 static inline void canvas_free(canvas_t *c)
 {
@@ -26,18 +26,12 @@
 
 void bitmap_draw(canvas_t *c, int x, int y, int w, int h, const u8 *image)
 {
-    int i, j, byte_width = (w + 7) / 8;
+    canvas_bitmap_t b = {
+        .width = w,
+        .height = h,
+        .stride = (w + 7) / 8,
+        .bits = image,
+    };
 
-    for (i = 0; i < w; i++)
-    {
-        for (j = 0; j < h; j++)
-        {
-            u16 val;
-            u8 cell;
-
-            cell = *(image + j * byte_width + (i / 8));
-            val = cell & (128 >> (i & 0x7)) ? (u16)-1 : 0;
-            canvas_pixel_set(c, i + x, j + y, val);
-        }
-    }
+    canvas_blit(c, x, y, &b, (u16)-1, 0);
 }
@@ -60,16 +60,11 @@ void round_rect_draw(canvas_t *c, int x, int y, int w, int h, int r, int type,
 
 void rect_fill(canvas_t *c, int x, int y, int w, int h, u16 color)
 {
-    int j;
-
-    for (j = 0; j < h; j++)
-        canvas_hline(c, x, x + w, y + j, color);
+    canvas_fill_rect(c, x, y, w, h, color);
 }
 
 void round_rect_fill(canvas_t *c, int x, int y, int w, int h, int r, u16 color)
 {
-    int j;
-
     /* Corners */
     _circle_fill(c, x + r, y + r, r, CIRC_270_0, color);
     _circle_fill(c, x + w - r, y + r, r, CIRC_0_90, color);
@@ -85,8 +80,7 @@ void round_rect_fill(canvas_t *c, int x, int y, int w, int h, int r, u16 color)
      * \              /
      *  \------------/
      */
-    for (j = r; j <= h - r; j++)
-        canvas_hline(c, x, x + w, y + j, color);
+    canvas_fill_rect(c, x, y + r, w, h - 2 * r + 1, color);
     /*  /------------\
      * / xxxxxxxxxxxx \
      * |              |
@@ -94,9 +88,6 @@ void round_rect_fill(canvas_t *c, int x, int y, int w, int h, int r, u16 color)
      * \ xxxxxxxxxxxx /
      *  \------------/
      */
-    for (j = 0; j < r; j++)
-    {
-        canvas_hline(c, x + r, x + w - r, y + j, color);
-        canvas_hline(c, x + r, x + w - r, y + (h + 1) - r + j, color);
-    }
+    canvas_fill_rect(c, x + r, y, w - 2 * r, r, color);
+    canvas_fill_rect(c, x + r, y + (h + 1) - r, w - 2 * r, r, color);
 }
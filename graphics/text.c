@@ -26,29 +26,22 @@
 #include "graphics/font.h"
 #include "util/debug.h"
 
-static inline int text_point(int x, int y, const tstr_t *str)
-{
-    const unsigned char *c;
-
-    /* Font size 8x7 */
-    c = font[tstr_peek(str, x >> 3) - ' '];
-    return c[y] & (1<<(x & 0x7));
-}
-
 void string_draw(canvas_t *c, int x, int y, tstr_t *str, u16 color)
 {
-    int end = (str->len * 8) - 1, i, j;
+    /* Font size 8x7 */
+    canvas_bitmap_t glyph = {
+        .width = 8,
+        .height = 7,
+        .stride = 1,
+        .flags = CANVAS_BITMAP_LSB_FIRST | CANVAS_BITMAP_TRANSPARENT,
+    };
+    int i;
     
     tp_info("Printing %S at (%d,%d)\n", str, x, y);
 
-    for (i = 0; i < end; i++)
+    for (i = 0; i < str->len; i++)
     {
-        for (j = 0; j < 7; j++)
-        {
-            if (!text_point(i, j, str))
-               continue;
-
-            canvas_pixel_set(c, i + x, j + y, color);
-        }
+        glyph.bits = font[tstr_peek(str, i) - ' '];
+        canvas_blit(c, x + i * 8, y, &glyph, color, 0);
     }
 }
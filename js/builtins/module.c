@@ -43,3 +43,26 @@ int do_require(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
 
     return rc;
 }
+
+int do_compile_module(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    tstr_t src, dst;
+    int rc;
+
+    if (argc != 3)
+        return js_invalid_args(ret);
+
+    src = obj_get_str(argv[1]);
+    dst = obj_get_str(argv[2]);
+    rc = module_compile(&dst, &src);
+    tstr_free(&src);
+    tstr_free(&dst);
+    if (rc)
+    {
+        return throw_exception(ret,
+            &S("Exception: Module compilation failed"));
+    }
+
+    *ret = UNDEF;
+    return 0;
+}
@@ -0,0 +1,73 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "fs/vfs.h"
+#include "js/js_obj.h"
+#include "js/js_utils.h"
+#include "js/js_snapshot.h"
+#include "js/jsapi_decl.h"
+
+int do_snapshot_save(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    tstr_t path, image;
+    int rc = 0;
+
+    if (argc != 2)
+        return js_invalid_args(ret);
+
+    if (js_snapshot_save(&image))
+        return throw_exception(ret, &S("Exception: Snapshot failed"));
+
+    path = obj_get_str(argv[1]);
+    if (vfs_file_write(&image, &path))
+        rc = throw_exception(ret, &S("Exception: Path not found"));
+    else
+        *ret = UNDEF;
+
+    tstr_free(&path);
+    tstr_free(&image);
+    return rc;
+}
+
+int do_snapshot_load(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    tstr_t path, image;
+    int rc;
+
+    if (argc != 2)
+        return js_invalid_args(ret);
+
+    path = obj_get_str(argv[1]);
+    rc = vfs_file_read(&image, &path, 0);
+    tstr_free(&path);
+    if (rc)
+        return throw_exception(ret, &S("Exception: Path not found"));
+
+    /* The image is owned by the snapshot layer from now on */
+    if (js_snapshot_load(&image))
+        return throw_exception(ret, &S("Exception: Invalid snapshot"));
+
+    *ret = UNDEF;
+    return 0;
+}
@@ -31,6 +31,10 @@
 #include "platform/platform.h"
 
 #define Stimer_id S("timer_id")
+#define Sbusy S("busy")
+#define Sidle S("idle")
+#define Siterations S("iterations")
+#define Ssleeps S("sleeps")
 
 static void interval_cb(event_t *e, u32 resource_id, u64 timestamp)
 {
@@ -114,6 +118,36 @@ int do_clear_timeout(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
     return do_clear_timer(ret, this, argc, argv);
 }
 
+int do_set_timer_slack(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    if (argc != 2)
+        return js_invalid_args(ret);
+
+    event_timer_slack_set(NUM_INT(to_num(argv[1])));
+    return 0;
+}
+
+#ifdef CONFIG_EVENT_LOOP_STATS
+int do_get_loop_stats(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    event_loop_stats_t stats;
+
+    if (argc > 2)
+        return js_invalid_args(ret);
+
+    event_loop_stats_get(&stats);
+    if (argc == 2 && obj_true(argv[1]))
+        event_loop_stats_reset();
+
+    *ret = object_new();
+    obj_set_property_fp(*ret, Sbusy, (double)stats.busy_us);
+    obj_set_property_fp(*ret, Sidle, (double)stats.idle_us);
+    obj_set_property_int(*ret, Siterations, stats.iterations);
+    obj_set_property_int(*ret, Ssleeps, stats.sleeps);
+    return 0;
+}
+#endif
+
 int do_get_time(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
 {
     u32 sec, usec;
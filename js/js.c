@@ -34,6 +34,9 @@
 #include "js/js_event.h"
 #include "js/js_builtins.h"
 #include "js/js_compiler.h"
+#ifdef CONFIG_JS_SNAPSHOT
+#include "js/js_snapshot.h"
+#endif
 #ifdef CONFIG_GPIO
 #include "drivers/gpio/gpio.h"
 #endif
@@ -94,6 +97,10 @@ void js_uninit(void)
     js_eval_uninit();
     /* Time to mop */
     __js_gc_run(1);
+#ifdef CONFIG_JS_SNAPSHOT
+    /* Freed objects may have referenced the images */
+    js_snapshot_uninit();
+#endif
     js_obj_uninit();
 }
 
@@ -110,6 +117,9 @@ void js_init(void)
     js_event_init();
     js_builtins_init();
     js_compiler_init();
+#ifdef CONFIG_JS_SNAPSHOT
+    js_snapshot_init();
+#endif
     tp_info("Object sizes:\n");
 #define OSIZE(o) tp_info(#o ": %d\n", sizeof(o))
     OSIZE(obj_t);
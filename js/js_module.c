@@ -28,16 +28,21 @@
 #include "js/js_obj.h"
 #include "js/js_module.h"
 #include "js/js_eval.h"
+#include "js/js_scan.h"
 #include "js/js_types.h"
 #include "js/jsapi_decl.h"
 
 typedef struct js_module_t {
     struct js_module_t *next;
     tstr_t name;
-    tstr_t code;
+    tstr_t code; /* Released once the module is evaluated */
     obj_t *exports;
 } js_module_t;
 
+#define Smodules S("modules")
+
+extern obj_t *meta_env;
+
 static js_module_t *js_modules;
 
 static js_module_t *module_load_vfs(tstr_t *mod_name)
@@ -48,6 +53,21 @@ static js_module_t *module_load_vfs(tstr_t *mod_name)
     if (vfs_file_read(&code, mod_name, VFS_FLAGS_ANY_FS))
         return NULL;
 
+#ifdef CONFIG_JS_MODULE_PRECOMPILE
+    /* Source read into RAM is replaced by its pre-tokenized image, which
+     * is smaller and much faster to evaluate. Source kept as const data
+     * is left where it is.
+     */
+    if (TSTR_IS_ALLOCATED(&code) && !js_scan_is_image(&code))
+    {
+        tstr_t image;
+
+        js_scan_compile(&image, &code);
+        tstr_free(&code);
+        code = image;
+    }
+#endif
+
     mod = tmalloc_type(js_module_t);
     mod->code = code;
     mod->name = tstr_dup(*mod_name);
@@ -72,6 +92,7 @@ int module_require(obj_t **ret, tstr_t *mod_name)
 {
     int rc;
     js_module_t *mod;
+    obj_t *modules;
 
     mod = module_lookup(mod_name);
     if (!mod)
@@ -88,6 +109,33 @@ int module_require(obj_t **ret, tstr_t *mod_name)
         return rc;
 
     mod->exports = obj_get(*ret);
+    /* Keep the exports reachable by the GC */
+    modules = obj_get_property(NULL, meta_env, &Smodules);
+    obj_set_property(modules, mod->name, mod->exports);
+    obj_put(modules);
+    /* Functions hold their own copies of the code they need */
+    tstr_free(&mod->code);
+    tstr_init(&mod->code, NULL, 0, 0);
+    return rc;
+}
+
+int module_compile(tstr_t *dst, tstr_t *src)
+{
+    tstr_t code, image;
+    int rc;
+
+    if (vfs_file_read(&code, src, VFS_FLAGS_ANY_FS))
+        return -1;
+
+    if (!js_scan_is_image(&code))
+    {
+        js_scan_compile(&image, &code);
+        tstr_free(&code);
+        code = image;
+    }
+
+    rc = vfs_file_write(&code, dst);
+    tstr_free(&code);
     return rc;
 }
 
@@ -99,6 +147,7 @@ void modules_uninit(void)
     {
         js_modules = js_modules->next;
         obj_put(mod->exports);
+        tstr_free(&mod->name);
         tstr_free(&mod->code);
         tfree(mod);
     }
@@ -106,4 +155,5 @@ void modules_uninit(void)
 
 void modules_init(void)
 {
+    _obj_set_property(meta_env, Smodules, object_new());
 }
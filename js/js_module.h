@@ -29,5 +29,7 @@
 #include "util/tstr.h"
 
 int module_require(obj_t **ret, tstr_t *mod_name);
+/* Write the pre-tokenized image of module src to dst */
+int module_compile(tstr_t *dst, tstr_t *src);
 
 #endif
@@ -323,6 +323,34 @@ obj_t *obj_get_own_property(obj_t ***lval, obj_t *o, const tstr_t *key)
     return NULL;
 }
 
+int obj_is_templ_function(obj_t *o, const tstr_t *key, obj_t *value)
+{
+    const function_template_t *tmpl;
+
+    if (OBJ_IS_INT_VAL(value) || !is_function(value) || 
+        !(tmpl = templ_find(o, key)))
+    {
+        return 0;
+    }
+
+    return to_function(value)->call == tmpl->call;
+}
+
+void obj_foreach_property(obj_t *o, 
+    void (*cb)(void *ctx, const tstr_t *key, obj_t *value), void *ctx)
+{
+    var_t *iter;
+
+    if (OBJ_IS_INT_VAL(o))
+        return;
+
+    for (iter = o->properties; iter; iter = iter->next)
+    {
+        if (iter->obj)
+            cb(ctx, &iter->key, iter->obj);
+    }
+}
+
 void obj_walk(obj_t *o, int (*cb)(obj_t *o))
 {
     var_t *iter;
@@ -339,6 +367,8 @@ void obj_walk(obj_t *o, int (*cb)(obj_t *o))
         obj_walk(to_function(o)->scope, cb);
     if (is_pointer(o))
         obj_walk(to_pointer(o)->related_obj, cb);
+    if (is_array_buffer_view(o))
+        obj_walk((obj_t *)to_array_buffer_view(o)->array_buffer, cb);
 }
 
 obj_t *obj_cast(obj_t *o, unsigned char class)
@@ -1707,6 +1737,12 @@ static int array_buffer_view_set_own_property(obj_t *o, tstr_t str,
     return array_buffer_view_item_val_set(v, idx, val);
 }
 
+static void array_buffer_view_free_gc(obj_t *o)
+{
+    /* Release the reference without freeing, the buffer is swept on its own */
+    to_array_buffer_view(o)->array_buffer->obj.ref_count--;
+}
+
 static void array_buffer_view_free(obj_t *o)
 {
     array_buffer_view_t *v = to_array_buffer_view(o);
@@ -1982,6 +2018,7 @@ const obj_class_t classes[] = {
         .dump = array_dump,
         .cast = array_buffer_view_cast,
         .free = array_buffer_view_free,
+        .free_gc = array_buffer_view_free_gc,
         .get_own_property = array_buffer_view_get_own_property,
         .set_own_property = array_buffer_view_set_own_property,
         .do_op = object_do_op,
@@ -204,6 +204,11 @@ extern bool_t false_obj;
 /* Generic obj methods */
  /* obj_walk: cb returns true when object had already been walked */
 void obj_walk(obj_t *o, int (*cb)(obj_t *o));
+/* Iterate over all own properties of o, internal ones included */
+void obj_foreach_property(obj_t *o,
+    void (*cb)(void *ctx, const tstr_t *key, obj_t *value), void *ctx);
+/* Is value the function generated from the builtin template of o[key] */
+int obj_is_templ_function(obj_t *o, const tstr_t *key, obj_t *value);
 obj_t *obj_cast(obj_t *o, unsigned char class);
 obj_t **obj_var_create(obj_t *o, const tstr_t *str);
 obj_t *obj_get_own_property(obj_t ***lval, obj_t *o, const tstr_t *str);
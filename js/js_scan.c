@@ -46,6 +46,8 @@ struct scan_t {
     char look;
 #define SCAN_FLAG_EOF 0x0001
 #define SCAN_FLAG_INVALID 0x0002
+#define SCAN_FLAG_IMAGE 0x0004
+#define SCAN_FLAG_NO_CONSTANTS 0x0008
     unsigned short flags;
     scan_value_t value;
 };
@@ -55,6 +57,18 @@ static get_constants_cb_t g_get_constants_cb;
 #define IS_EOF(scan) ((scan)->flags & SCAN_FLAG_EOF)
 #define SET_EOF(scan) ((scan)->flags |= SCAN_FLAG_EOF)
 
+/* Pre-tokenized images start with a header followed by the tokens, with
+ * no whitespace or comments. Tokens below 0x80 are stored as is, operators
+ * carrying flags take two bytes. Identifiers, strings and non integer
+ * numbers are followed by their length and text. No byte of an image is
+ * 0, so images can be kept as C strings.
+ */
+#define IMAGE_MAGIC "\x7fTJS\x01"
+#define IMAGE_MAGIC_LEN 5
+#define IMAGE_TOK_OP 0x80 /* Token flags in the low nibble, char follows */
+#define IMAGE_TOK_INT 0xc0 /* Integer literal, value follows */
+#define IMAGE_TOK_ESCAPED_STRING 0xc1
+
 static inline int is_digit(char c)
 {
     return c >= '0' && c <= '9';
@@ -333,10 +347,104 @@ static inline tnum_t extract_num(scan_t *scan)
     return ret;
 }
 
+static inline unsigned char image_get_byte(scan_t *scan)
+{
+    scan->size--;
+    return tstr_peek(&scan->code, scan->lpc++);
+}
+
+/* Lengths and values are stored as base 127 digits, each offset by 1 so
+ * they are never 0. The high bit marks that more digits follow.
+ */
+static int image_get_varint(scan_t *scan)
+{
+    int v = 0, mul = 1;
+    unsigned char b;
+
+    do
+    {
+        b = image_get_byte(scan);
+        v += ((b & 0x7f) - 1) * mul;
+        mul *= 127;
+    } while (b & 0x80);
+
+    return v;
+}
+
+static tstr_t image_get_piece(scan_t *scan)
+{
+    int len = image_get_varint(scan);
+    tstr_t ret;
+
+    ret = tstr_piece(&scan->code, scan->lpc, len);
+    scan->lpc += len;
+    scan->size -= len;
+    return ret;
+}
+
+static void image_next_token(scan_t *scan)
+{
+    unsigned char b;
+    tstr_t s;
+
+    scan->flags &= ~SCAN_FLAG_INVALID;
+    scan->last_token_start = scan->lpc;
+    if (scan->size <= 0)
+    {
+        scan->tok = TOK_EOF;
+        return;
+    }
+
+    switch ((b = image_get_byte(scan)))
+    {
+    case TOK_ID:
+        s = image_get_piece(scan);
+        if (g_get_constants_cb && !g_get_constants_cb(&scan->value.constant,
+            &s))
+        {
+            scan->tok = TOK_CONSTANT;
+            break;
+        }
+        scan->tok = TOK_ID;
+        scan->value.identifier = s;
+        break;
+    case TOK_NUM:
+        s = image_get_piece(scan);
+        scan->tok = TOK_NUM;
+        if (tstr_to_tnum(&scan->value.num, &s))
+            scan->flags |= SCAN_FLAG_INVALID;
+        break;
+    case IMAGE_TOK_INT:
+        scan->tok = TOK_NUM;
+        scan->value.num.flags = 0;
+        NUMERIC_INT(scan->value.num) = image_get_varint(scan);
+        break;
+    case TOK_STRING:
+    case IMAGE_TOK_ESCAPED_STRING:
+        scan->tok = TOK_STRING;
+        scan->value.string = image_get_piece(scan);
+        if (b == IMAGE_TOK_ESCAPED_STRING)
+            scan->value.string.flags |= TSTR_FLAG_ESCAPED;
+        break;
+    default:
+        if (b & IMAGE_TOK_OP)
+            scan->tok = (b & 0xf) << 8 | image_get_byte(scan);
+        else
+            scan->tok = b;
+        break;
+    }
+}
+
 void js_scan_next_token(scan_t *scan)
 {
     char next = 0, next2 = 0, next3 = 0;
 
+    if (scan->flags & SCAN_FLAG_IMAGE)
+    {
+        image_next_token(scan);
+        return;
+    }
+
     scan->tok = 0;
     scan->flags &= ~SCAN_FLAG_INVALID;
     scan->last_token_start = scan->lpc;
@@ -422,7 +530,8 @@ void js_scan_next_token(scan_t *scan)
         int constant;
         tstr_t id = extract_identifier(scan);
 
-        if (g_get_constants_cb && !g_get_constants_cb(&constant, &id))
+        if (g_get_constants_cb && !(scan->flags & SCAN_FLAG_NO_CONSTANTS) &&
+            !g_get_constants_cb(&constant, &id))
         {
             scan->tok = TOK_CONSTANT;
             scan->value.constant = constant;
@@ -446,7 +555,7 @@ void js_scan_next_token(scan_t *scan)
 
 static char *tok_to_str(token_type_t tok)
 {
-    static char s[3] = { '\'', '\0', '\'' };
+    static char s[4] = { '\'', '\0', '\'', '\0' };
 
     switch (tok)
     {
@@ -465,6 +574,12 @@ void js_scan_trace(scan_t *scan)
 {
     int p;
 
+    if (scan->flags & SCAN_FLAG_IMAGE)
+    {
+        tp_out("<pre-tokenized code>\n");
+        return;
+    }
+
     for (p = scan->trace_point; p - scan->lpc < scan->size; p++)
     {
         char c = tstr_peek(&scan->code, p);
@@ -620,18 +735,31 @@ void js_scan_restore(scan_t *dst, scan_t *src)
 scan_t *js_scan_slice(scan_t *start, scan_t *end)
 {
     scan_t *ret = js_scan_save(start);
+    int base = start->last_token_start;
 
     ret->size = end->lpc - start->lpc;
     if (TSTR_IS_ALLOCATED(&start->code))
     {
-        ret->code = tstr_slice(&start->code, start->lpc, ret->size);
+        /* Keep the current token so the slice can be exported */
+        ret->code = tstr_slice(&start->code, base, end->lpc - base);
         ret->internal_buf = &ret->code;
-        ret->lpc = ret->pc = ret->last_token_start = ret->trace_point = 0;
-        ret->pc += start->pc - start->lpc;
+        ret->lpc -= base;
+        ret->pc -= base;
+        ret->last_token_start = ret->trace_point = 0;
     }
     return ret;
 }
 
+void js_scan_export(tstr_t *code, scan_t *scan)
+{
+    int start = scan->last_token_start, len = scan->lpc + scan->size - start;
+    int hdr_len = scan->flags & SCAN_FLAG_IMAGE ? IMAGE_MAGIC_LEN : 0;
+
+    tstr_init_alloc_data(code, hdr_len + len);
+    memcpy(TPTR(code), IMAGE_MAGIC, hdr_len);
+    memcpy(TPTR(code) + hdr_len, TPTR(&scan->code) + start, len);
+}
+
 void js_scan_free(scan_t *scan)
 {
     if (!scan)
@@ -652,7 +780,7 @@ void js_scan_uninit(scan_t *scan)
     js_scan_free(scan);
 }
 
-scan_t *_js_scan_init(tstr_t *data, int own_data)
+static scan_t *scan_init(tstr_t *data, int own_data, unsigned short flags)
 {
     scan_t *scan = tmalloc_type(scan_t);
 
@@ -660,14 +788,138 @@ scan_t *_js_scan_init(tstr_t *data, int own_data)
     scan->last_token_start = scan->trace_point = scan->pc = 0;
     scan->size = data->len + 1;
     scan->look = 255;
-    scan->flags = 0;
+    scan->flags = flags;
     scan->internal_buf = own_data ? &scan->code : 0;
-    _get_char(scan);
-    skip_white(scan);
+    if (js_scan_is_image(data))
+    {
+        scan->flags |= SCAN_FLAG_IMAGE;
+        scan->lpc = IMAGE_MAGIC_LEN;
+        scan->size = data->len - IMAGE_MAGIC_LEN;
+    }
+    else
+    {
+        _get_char(scan);
+        skip_white(scan);
+    }
     js_scan_next_token(scan);
     return scan;
 }
 
+scan_t *_js_scan_init(tstr_t *data, int own_data)
+{
+    return scan_init(data, own_data, 0);
+}
+
+int js_scan_is_image(const tstr_t *code)
+{
+    return code->len >= IMAGE_MAGIC_LEN &&
+        !memcmp(TPTR(code), IMAGE_MAGIC, IMAGE_MAGIC_LEN);
+}
+
+typedef struct {
+    char *buf; /* NULL when sizing the image */
+    int len;
+} image_writer_t;
+
+static void image_put_byte(image_writer_t *image, unsigned char b)
+{
+    if (image->buf)
+        image->buf[image->len] = b;
+    image->len++;
+}
+
+static void image_put_varint(image_writer_t *image, unsigned int v)
+{
+    unsigned char b;
+
+    do
+    {
+        b = v % 127 + 1;
+        v /= 127;
+        image_put_byte(image, v ? b | 0x80 : b);
+    } while (v);
+}
+
+static void image_put_piece(image_writer_t *image, const tstr_t *s)
+{
+    int i;
+
+    image_put_varint(image, s->len);
+    for (i = 0; i < s->len; i++)
+        image_put_byte(image, tstr_peek(s, i));
+}
+
+static void image_put_tokens(image_writer_t *image, tstr_t *code)
+{
+    scan_t *scan;
+    tstr_t s;
+    int i;
+
+    for (i = 0; i < IMAGE_MAGIC_LEN; i++)
+        image_put_byte(image, IMAGE_MAGIC[i]);
+
+    /* Constants are platform specific, keep them as identifiers */
+    scan = scan_init(code, 0, SCAN_FLAG_NO_CONSTANTS);
+    for (; scan->tok != TOK_EOF; js_scan_next_token(scan))
+    {
+        switch (scan->tok)
+        {
+        case TOK_NONE:
+            /* Skipped character */
+            break;
+        case TOK_ID:
+            image_put_byte(image, TOK_ID);
+            image_put_piece(image, &scan->value.identifier);
+            break;
+        case TOK_NUM:
+            if (!(scan->flags & SCAN_FLAG_INVALID) &&
+                !NUMERIC_IS_FP(scan->value.num) &&
+                NUMERIC_INT(scan->value.num) >= 0)
+            {
+                image_put_byte(image, IMAGE_TOK_INT);
+                image_put_varint(image, NUMERIC_INT(scan->value.num));
+                break;
+            }
+
+            /* Keep the text, it is parsed again when loaded */
+            for (i = scan->last_token_start; i < code->len &&
+                is_number_letter(tstr_peek(code, i)); i++);
+            s = tstr_piece(code, scan->last_token_start,
+                i - scan->last_token_start);
+            image_put_byte(image, TOK_NUM);
+            image_put_piece(image, &s);
+            break;
+        case TOK_STRING:
+            image_put_byte(image, TSTR_IS_ESCAPED(&scan->value.string) ?
+                IMAGE_TOK_ESCAPED_STRING : TOK_STRING);
+            image_put_piece(image, &scan->value.string);
+            break;
+        default:
+            if (scan->tok & ~0x7f)
+            {
+                image_put_byte(image, IMAGE_TOK_OP | scan->tok >> 8);
+                image_put_byte(image, scan->tok & 0xff);
+            }
+            else
+                image_put_byte(image, scan->tok);
+            break;
+        }
+    }
+    js_scan_uninit(scan);
+}
+
+void js_scan_compile(tstr_t *image, tstr_t *code)
+{
+    image_writer_t w = {};
+
+    /* Size the image first so that no more than needed is allocated */
+    image_put_tokens(&w, code);
+    tstr_init_alloc_data(image, w.len);
+    w.buf = TPTR(image);
+    w.len = 0;
+    image_put_tokens(&w, code);
+}
+
 void js_scan_set_constants_cb(get_constants_cb_t cb)
 {
     g_get_constants_cb = cb;
@@ -164,6 +164,10 @@ scan_t *js_scan_save(scan_t *scan);
 void js_scan_restore(scan_t *dst, scan_t *src);
 scan_t *js_scan_slice(scan_t *start, scan_t *end);
 void js_scan_free(scan_t *scan);
+/* Allocate a standalone copy of the code left in scan, starting at the
+ * current token, which can be passed to js_scan_init()
+ */
+void js_scan_export(tstr_t *code, scan_t *scan);
 
 void js_scan_uninit(scan_t *scan);
 scan_t *_js_scan_init(tstr_t *data, int own_data);
@@ -172,6 +176,12 @@ static inline scan_t *js_scan_init(tstr_t *data)
     return _js_scan_init(data, 0);
 }
 
+/* Pre-tokenized code images can be passed to js_scan_init() instead of
+ * source code. js_scan_compile() allocates the image of code.
+ */
+int js_scan_is_image(const tstr_t *code);
+void js_scan_compile(tstr_t *image, tstr_t *code);
+
 /* Global initialization function, not tied to a scan_t instance.
  * cb returns 0 if s matches a known constant, the constant's value
  * is returned in *constant
@@ -0,0 +1,811 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/debug.h"
+#include "mem/tmalloc.h"
+#include "js/js_obj.h"
+#include "js/js_eval.h"
+#include "js/js_snapshot.h"
+#ifdef CONFIG_JS_SNAPSHOT_BOOT
+#include "fs/vfs.h"
+#endif
+
+extern obj_t *global_env;
+
+/* Image layout:
+ * - magic
+ * - number of objects, followed by the class and contents of each object
+ * - scope (functions only) and properties of each object
+ * - number of patched builtin objects, followed by the path of each one and
+ *   the properties added to it by the user
+ * Images do not contain zero bytes so they can be stored in the builtin FS.
+ */
+#define SNAPSHOT_MAGIC "\x7fTPS\x01"
+#define SNAPSHOT_MAGIC_LEN 5
+
+#define VAL_UNDEF 1
+#define VAL_NULL 2
+#define VAL_TRUE 3
+#define VAL_FALSE 4
+#define VAL_NAN 5
+#define VAL_INT 6
+#define VAL_FP 7
+#define VAL_OBJ 8
+#define VAL_BUILTIN 9
+
+/* Blobs are preceded by their length and flags */
+#define BLOB_INTERNAL 0x01
+#define BLOB_ESCAPED 0x02
+#define BLOB_ENCODED 0x04 /* Zero bytes are encoded, blob is not in place */
+#define BLOB_FLAGS_SHIFT 3
+#define BLOB_ESC 0xff
+
+typedef struct snapshot_node_t {
+    struct snapshot_node_t *next;
+    obj_t *obj;
+    /* Builtin objects are saved as the path leading to them */
+    struct snapshot_node_t *parent;
+    const tstr_t *key;
+    int id;
+} snapshot_node_t;
+
+typedef struct {
+    snapshot_node_t *builtins, **builtins_tail;
+    snapshot_node_t *objs, **objs_tail;
+    snapshot_node_t *cur;
+    int cur_is_builtin;
+    int count;
+    int props;
+    int error;
+    char *buf; /* NULL when sizing the image */
+    int len;
+} snapshot_writer_t;
+
+typedef struct {
+    tstr_t *image;
+    int pos;
+    int error;
+    obj_t **objs;
+    int count;
+} snapshot_reader_t;
+
+static tstr_list_t *images;
+
+static inline int is_value(obj_t *o)
+{
+    return is_num(o) || o == UNDEF || o == NULL_OBJ || o == TRUE || 
+        o == FALSE;
+}
+
+static inline u32 zigzag(int v)
+{
+    return ((u32)v << 1) ^ (u32)(v >> 31);
+}
+
+static inline int unzigzag(u32 v)
+{
+    return (int)(v >> 1) ^ -(int)(v & 1);
+}
+
+/*** Writer ***/
+
+static snapshot_node_t *node_find(snapshot_node_t *list, obj_t *obj)
+{
+    for (; list && list->obj != obj; list = list->next);
+    return list;
+}
+
+static snapshot_node_t *node_add(snapshot_node_t ***tail, obj_t *obj,
+    snapshot_node_t *parent, const tstr_t *key)
+{
+    snapshot_node_t *n = tmalloc_type(snapshot_node_t);
+
+    n->next = NULL;
+    n->obj = obj;
+    n->parent = parent;
+    n->key = key;
+    n->id = 0;
+    **tail = n;
+    *tail = &n->next;
+    return n;
+}
+
+static void nodes_free(snapshot_node_t *list)
+{
+    snapshot_node_t *tmp;
+
+    while ((tmp = list))
+    {
+        list = list->next;
+        tfree(tmp);
+    }
+}
+
+static void builtin_discover_cb(void *ctx, const tstr_t *key, obj_t *value)
+{
+    snapshot_writer_t *w = ctx;
+
+    if (is_value(value) || node_find(w->builtins, value))
+        return;
+
+    if (!(value->flags & OBJ_STATIC) && 
+        !obj_is_templ_function(w->cur->obj, key, value))
+    {
+        return;
+    }
+
+    node_add(&w->builtins_tail, value, w->cur, key);
+}
+
+/* Properties set by the builtins initialization are not saved */
+static int is_builtin_property(snapshot_writer_t *w, obj_t *o, 
+    const tstr_t *key, obj_t *value)
+{
+    snapshot_node_t *n;
+
+    if (obj_is_templ_function(o, key, value))
+        return 1;
+
+    if (OBJ_IS_INT_VAL(value) || !(value->flags & OBJ_STATIC))
+        return 0;
+
+    if (o->flags & OBJ_STATIC)
+        return 1;
+
+    /* Builtins are reachable from global_env through their own names */
+    n = node_find(w->builtins, value);
+    return n && n->parent && n->parent->obj == o && !tstr_cmp(n->key, key);
+}
+
+static void obj_ref_add(snapshot_writer_t *w, obj_t *o)
+{
+    if (!o || is_value(o) || node_find(w->builtins, o) || 
+        node_find(w->objs, o))
+    {
+        return;
+    }
+
+    if (o->flags & OBJ_STATIC)
+    {
+        tp_err("Snapshot: builtin object is not reachable from global_env\n");
+        w->error = 1;
+        return;
+    }
+
+    switch (OBJ_CLASS(o))
+    {
+    case OBJECT_CLASS:
+    case ARRAY_CLASS:
+    case ENV_CLASS:
+    case STRING_CLASS:
+    case ARRAY_BUFFER_CLASS:
+        break;
+    case ARRAY_BUFFER_VIEW_CLASS:
+        /* Buffers are restored before their views */
+        obj_ref_add(w, &to_array_buffer_view(o)->array_buffer->obj);
+        break;
+    case FUNCTION_CLASS:
+        if (to_function(o)->call == call_evaluated_function &&
+            to_function(o)->code)
+        {
+            break;
+        }
+        tp_err("Snapshot: native functions can not be saved\n");
+        w->error = 1;
+        return;
+    default:
+        tp_err("Snapshot: objects of class %d can not be saved\n",
+            OBJ_CLASS(o));
+        w->error = 1;
+        return;
+    }
+
+    node_add(&w->objs_tail, o, NULL, NULL)->id = w->count++;
+}
+
+static void obj_refs_add_cb(void *ctx, const tstr_t *key, obj_t *value)
+{
+    obj_ref_add(ctx, value);
+}
+
+static void patch_refs_add_cb(void *ctx, const tstr_t *key, obj_t *value)
+{
+    snapshot_writer_t *w = ctx;
+
+    if (!is_builtin_property(w, w->cur->obj, key, value))
+        obj_ref_add(w, value);
+}
+
+static void put_byte(snapshot_writer_t *w, unsigned char b)
+{
+    if (w->buf)
+        w->buf[w->len] = b;
+    w->len++;
+}
+
+static void put_varint(snapshot_writer_t *w, u64 v)
+{
+    unsigned char b;
+
+    do
+    {
+        b = v % 127 + 1;
+        v /= 127;
+        put_byte(w, v ? b | 0x80 : b);
+    } while (v);
+}
+
+static void put_blob(snapshot_writer_t *w, const tstr_t *s)
+{
+    int i, len = s->len, flags = 0;
+    unsigned char c;
+
+    if (TSTR_IS_INTERNAL(s))
+        flags |= BLOB_INTERNAL;
+    if (TSTR_IS_ESCAPED(s))
+        flags |= BLOB_ESCAPED;
+    for (i = 0; i < s->len; i++)
+    {
+        c = tstr_peek(s, i);
+        if (c == 0)
+            flags |= BLOB_ENCODED;
+        if (c == 0 || c == BLOB_ESC)
+            len++;
+    }
+    if (!(flags & BLOB_ENCODED))
+        len = s->len;
+
+    put_varint(w, ((u64)len << BLOB_FLAGS_SHIFT) | flags);
+    for (i = 0; i < s->len; i++)
+    {
+        c = tstr_peek(s, i);
+        if ((flags & BLOB_ENCODED) && (c == 0 || c == BLOB_ESC))
+        {
+            put_byte(w, BLOB_ESC);
+            c = c ? 2 : 1;
+        }
+        put_byte(w, c);
+    }
+}
+
+static void put_path_keys(snapshot_writer_t *w, snapshot_node_t *n)
+{
+    if (!n->parent)
+        return;
+
+    put_path_keys(w, n->parent);
+    put_blob(w, n->key);
+}
+
+static void put_path(snapshot_writer_t *w, snapshot_node_t *n)
+{
+    snapshot_node_t *p;
+    int depth = 0;
+
+    for (p = n; p->parent; p = p->parent)
+        depth++;
+    put_varint(w, depth);
+    put_path_keys(w, n);
+}
+
+static void put_value(snapshot_writer_t *w, obj_t *v)
+{
+    snapshot_node_t *n;
+
+    if (!v || v == UNDEF)
+        put_byte(w, VAL_UNDEF);
+    else if (v == NULL_OBJ)
+        put_byte(w, VAL_NULL);
+    else if (v == TRUE)
+        put_byte(w, VAL_TRUE);
+    else if (v == FALSE)
+        put_byte(w, VAL_FALSE);
+    else if (v == NAN_OBJ)
+        put_byte(w, VAL_NAN);
+    else if (is_num(v) && NUM_IS_FP(to_num(v)))
+    {
+        double fp = NUM_FP(to_num(v));
+        u64 bits;
+
+        memcpy(&bits, &fp, sizeof(bits));
+        put_byte(w, VAL_FP);
+        put_varint(w, bits);
+    }
+    else if (is_num(v))
+    {
+        put_byte(w, VAL_INT);
+        put_varint(w, zigzag(NUM_INT(to_num(v))));
+    }
+    else if ((n = node_find(w->builtins, v)))
+    {
+        put_byte(w, VAL_BUILTIN);
+        put_path(w, n);
+    }
+    else
+    {
+        put_byte(w, VAL_OBJ);
+        put_varint(w, node_find(w->objs, v)->id);
+    }
+}
+
+static void props_count_cb(void *ctx, const tstr_t *key, obj_t *value)
+{
+    snapshot_writer_t *w = ctx;
+
+    if (!w->cur_is_builtin || 
+        !is_builtin_property(w, w->cur->obj, key, value))
+    {
+        w->props++;
+    }
+}
+
+static void props_put_cb(void *ctx, const tstr_t *key, obj_t *value)
+{
+    snapshot_writer_t *w = ctx;
+
+    if (w->cur_is_builtin && is_builtin_property(w, w->cur->obj, key, value))
+    {
+        return;
+    }
+
+    put_blob(w, key);
+    put_value(w, value);
+}
+
+static int props_count(snapshot_writer_t *w, snapshot_node_t *n, 
+    int is_builtin)
+{
+    w->cur = n;
+    w->cur_is_builtin = is_builtin;
+    w->props = 0;
+    obj_foreach_property(n->obj, props_count_cb, w);
+    return w->props;
+}
+
+static void props_put(snapshot_writer_t *w, snapshot_node_t *n,
+    int is_builtin)
+{
+    put_varint(w, props_count(w, n, is_builtin));
+    obj_foreach_property(n->obj, props_put_cb, w);
+}
+
+static void obj_put_contents(snapshot_writer_t *w, obj_t *o)
+{
+    put_varint(w, OBJ_CLASS(o));
+    switch (OBJ_CLASS(o))
+    {
+    case STRING_CLASS:
+        put_blob(w, &to_string(o)->value);
+        break;
+    case ARRAY_BUFFER_CLASS:
+        put_blob(w, &to_array_buffer(o)->value);
+        break;
+    case ARRAY_BUFFER_VIEW_CLASS:
+        {
+            array_buffer_view_t *v = to_array_buffer_view(o);
+
+            put_varint(w, node_find(w->objs, &v->array_buffer->obj)->id);
+            put_varint(w, v->flags);
+            put_varint(w, v->offset);
+            put_varint(w, v->length);
+        }
+        break;
+    case FUNCTION_CLASS:
+        {
+            function_t *f = to_function(o);
+            tstr_list_t *p;
+            tstr_t code;
+            int count = 0;
+
+            js_scan_export(&code, f->code);
+            put_blob(w, &code);
+            tstr_free(&code);
+            for (p = f->formal_params; p; p = p->next)
+                count++;
+            put_varint(w, count);
+            for (p = f->formal_params; p; p = p->next)
+                put_blob(w, &p->str);
+        }
+        break;
+    }
+}
+
+static void snapshot_write(snapshot_writer_t *w)
+{
+    snapshot_node_t *n;
+    int i, patched = 0;
+
+    for (i = 0; i < SNAPSHOT_MAGIC_LEN; i++)
+        put_byte(w, SNAPSHOT_MAGIC[i]);
+
+    put_varint(w, w->count);
+    for (n = w->objs; n; n = n->next)
+        obj_put_contents(w, n->obj);
+    for (n = w->objs; n; n = n->next)
+    {
+        if (is_function(n->obj))
+            put_value(w, to_function(n->obj)->scope);
+        props_put(w, n, 0);
+    }
+
+    for (n = w->builtins; n; n = n->next)
+    {
+        if (props_count(w, n, 1))
+            patched++;
+    }
+    put_varint(w, patched);
+    for (n = w->builtins; n; n = n->next)
+    {
+        if (!props_count(w, n, 1))
+            continue;
+
+        put_path(w, n);
+        props_put(w, n, 1);
+    }
+}
+
+int js_snapshot_save(tstr_t *image)
+{
+    snapshot_writer_t w = {};
+    snapshot_node_t *n;
+
+    w.builtins_tail = &w.builtins;
+    w.objs_tail = &w.objs;
+
+    /* Breadth first, so builtins get their shortest path */
+    node_add(&w.builtins_tail, global_env, NULL, NULL);
+    for (n = w.builtins; n; n = n->next)
+    {
+        w.cur = n;
+        obj_foreach_property(n->obj, builtin_discover_cb, &w);
+    }
+
+    for (n = w.builtins; n; n = n->next)
+    {
+        w.cur = n;
+        obj_foreach_property(n->obj, patch_refs_add_cb, &w);
+    }
+    for (n = w.objs; n; n = n->next)
+    {
+        obj_foreach_property(n->obj, obj_refs_add_cb, &w);
+        if (is_function(n->obj))
+            obj_ref_add(&w, to_function(n->obj)->scope);
+    }
+
+    if (!w.error)
+    {
+        snapshot_write(&w);
+        tstr_init_alloc_data(image, w.len);
+        w.buf = TPTR(image);
+        w.len = 0;
+        snapshot_write(&w);
+    }
+
+    nodes_free(w.builtins);
+    nodes_free(w.objs);
+    return w.error ? -1 : 0;
+}
+
+/*** Reader ***/
+
+static unsigned char get_byte(snapshot_reader_t *r)
+{
+    if (r->pos >= r->image->len)
+    {
+        r->error = 1;
+        return 1; /* Terminates varints */
+    }
+
+    return TPTR(r->image)[r->pos++];
+}
+
+static u64 get_varint(snapshot_reader_t *r)
+{
+    u64 v = 0, mul = 1;
+    unsigned char b;
+
+    do
+    {
+        b = get_byte(r);
+        v += ((b & 0x7f) - 1) * mul;
+        mul *= 127;
+    } while (b & 0x80);
+
+    return v;
+}
+
+static void get_blob(snapshot_reader_t *r, tstr_t *s)
+{
+    u64 hdr = get_varint(r);
+    int i, len = hdr >> BLOB_FLAGS_SHIFT, dlen = 0;
+    unsigned short flags = 0;
+    char *p;
+
+    if (hdr & BLOB_INTERNAL)
+        flags |= TSTR_FLAG_INTERNAL;
+    if (hdr & BLOB_ESCAPED)
+        flags |= TSTR_FLAG_ESCAPED;
+
+    if (len < 0 || len > r->image->len - r->pos)
+    {
+        r->error = 1;
+        len = 0;
+    }
+
+    p = TPTR(r->image) + r->pos;
+    r->pos += len;
+    if (!(hdr & BLOB_ENCODED))
+    {
+        /* Referenced in place */
+        tstr_init(s, p, len, flags);
+        return;
+    }
+
+    for (i = 0; i < len; i++)
+    {
+        if ((unsigned char)p[i] == BLOB_ESC)
+            i++;
+        dlen++;
+    }
+
+    tstr_init_alloc_data(s, dlen);
+    s->flags |= flags;
+    for (i = 0, dlen = 0; i < len; i++)
+    {
+        if ((unsigned char)p[i] == BLOB_ESC && i + 1 < len)
+            TPTR(s)[dlen++] = p[++i] == 1 ? 0 : BLOB_ESC;
+        else
+            TPTR(s)[dlen++] = p[i];
+    }
+}
+
+static obj_t *get_path(snapshot_reader_t *r)
+{
+    obj_t *o = obj_get(global_env), *next;
+    int depth = get_varint(r);
+    tstr_t key;
+
+    while (depth-- && !r->error)
+    {
+        get_blob(r, &key);
+        next = obj_get_own_property(NULL, o, &key);
+        tstr_free(&key);
+        obj_put(o);
+        if (!(o = next))
+        {
+            tp_err("Snapshot: builtin object not found\n");
+            r->error = 1;
+            return UNDEF;
+        }
+    }
+
+    return o;
+}
+
+/* Returns a new reference */
+static obj_t *get_value(snapshot_reader_t *r)
+{
+    u64 v;
+
+    switch (get_byte(r))
+    {
+    case VAL_UNDEF:
+        return UNDEF;
+    case VAL_NULL:
+        return NULL_OBJ;
+    case VAL_TRUE:
+        return TRUE;
+    case VAL_FALSE:
+        return FALSE;
+    case VAL_NAN:
+        return NAN_OBJ;
+    case VAL_INT:
+        return num_new_int(unzigzag(get_varint(r)));
+    case VAL_FP:
+        {
+            double fp;
+
+            v = get_varint(r);
+            memcpy(&fp, &v, sizeof(fp));
+            return num_new_fp(fp);
+        }
+    case VAL_OBJ:
+        v = get_varint(r);
+        if (v < r->count && r->objs[v])
+            return obj_get(r->objs[v]);
+        break;
+    case VAL_BUILTIN:
+        return get_path(r);
+    }
+
+    r->error = 1;
+    return UNDEF;
+}
+
+static obj_t *function_get(snapshot_reader_t *r)
+{
+    tstr_list_t *params = NULL;
+    tstr_t code, param;
+    int count;
+
+    get_blob(r, &code);
+    count = get_varint(r);
+    while (count-- && !r->error)
+    {
+        get_blob(r, &param);
+        tstr_list_add(&params, &param);
+    }
+
+    return function_new(params, _js_scan_init(&code, 
+        TSTR_IS_ALLOCATED(&code)), evaluated_function_code_free, NULL,
+        call_evaluated_function);
+}
+
+static obj_t *obj_get_contents(snapshot_reader_t *r)
+{
+    obj_t *o = NULL;
+    tstr_t s;
+    u64 id;
+
+    switch (get_varint(r))
+    {
+    case OBJECT_CLASS:
+        return object_new();
+    case ARRAY_CLASS:
+        return array_new();
+    case ENV_CLASS:
+        return env_new(NULL);
+    case STRING_CLASS:
+        get_blob(r, &s);
+        return string_new(s);
+    case ARRAY_BUFFER_CLASS:
+        /* Buffers are writable and are always copied to RAM */
+        get_blob(r, &s);
+        o = array_buffer_new(s.len);
+        memcpy(TPTR(&to_array_buffer(o)->value), TPTR(&s), s.len);
+        tstr_free(&s);
+        return o;
+    case ARRAY_BUFFER_VIEW_CLASS:
+        {
+            u32 flags, offset, length;
+
+            id = get_varint(r);
+            flags = get_varint(r);
+            offset = get_varint(r);
+            length = get_varint(r);
+            if (id >= r->count || !r->objs[id] || 
+                !is_array_buffer(r->objs[id]))
+            {
+                break;
+            }
+            /* Element accesses aren't bounds checked against the buffer */
+            if ((flags & ~(ABV_SHIFT_MASK | ABV_FLAG_UNSIGNED)) ||
+                (flags & ABV_SHIFT_MASK) > ABV_SHIFT_32_BIT ||
+                ((u64)offset + length) << (flags & ABV_SHIFT_MASK) >
+                to_array_buffer(r->objs[id])->value.len)
+            {
+                break;
+            }
+            return array_buffer_view_new(r->objs[id], flags, offset, length);
+        }
+    case FUNCTION_CLASS:
+        return function_get(r);
+    }
+
+    r->error = 1;
+    return NULL;
+}
+
+static void props_get(snapshot_reader_t *r, obj_t *o)
+{
+    int count = get_varint(r);
+    tstr_t key;
+
+    while (count-- && !r->error)
+    {
+        get_blob(r, &key);
+        _obj_set_property(o, key, get_value(r));
+        tstr_free(&key);
+    }
+}
+
+int js_snapshot_load(tstr_t *image)
+{
+    snapshot_reader_t r = { .image = image };
+    obj_t *o;
+    int i, count;
+
+    /* Objects may reference the image data */
+    if (TSTR_IS_ALLOCATED(image))
+        tstr_list_add(&images, image);
+
+    if (image->len < SNAPSHOT_MAGIC_LEN || 
+        memcmp(TPTR(image), SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_LEN))
+    {
+        tp_err("Snapshot: invalid image\n");
+        return -1;
+    }
+    r.pos = SNAPSHOT_MAGIC_LEN;
+
+    r.count = get_varint(&r);
+    if (r.count > image->len)
+    {
+        tp_err("Snapshot: invalid image\n");
+        return -1;
+    }
+
+    r.objs = tmalloc(r.count * sizeof(obj_t *), "Snapshot objects");
+    for (i = 0; i < r.count; i++)
+        r.objs[i] = NULL;
+
+    for (i = 0; i < r.count && !r.error; i++)
+        r.objs[i] = obj_get_contents(&r);
+
+    for (i = 0; i < r.count && !r.error; i++)
+    {
+        if (is_function(r.objs[i]))
+            to_function(r.objs[i])->scope = get_value(&r);
+        props_get(&r, r.objs[i]);
+    }
+
+    count = r.error ? 0 : get_varint(&r);
+    while (count-- && !r.error)
+    {
+        o = get_path(&r);
+        props_get(&r, o);
+        obj_put(o);
+    }
+
+    for (i = 0; i < r.count; i++)
+        obj_put(r.objs[i]);
+    tfree(r.objs);
+
+    if (r.error)
+    {
+        tp_err("Snapshot: invalid image\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+void js_snapshot_uninit(void)
+{
+    tstr_list_free(&images);
+}
+
+void js_snapshot_init(void)
+{
+#ifdef CONFIG_JS_SNAPSHOT_BOOT
+    tstr_t image, path = S(CONFIG_JS_SNAPSHOT_BOOT_PATH);
+
+    if (vfs_file_read(&image, &path, 0))
+    {
+        tp_err("Snapshot: failed to read %S\n", &path);
+        return;
+    }
+
+    js_snapshot_load(&image);
+#endif
+}
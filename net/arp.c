@@ -23,10 +23,14 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include "util/debug.h"
+#include "util/tp_misc.h"
+#include "util/event.h"
+#include "platform/platform.h"
 #include "net/arp.h"
 #include "net/ipv4.h"
 #include "net/ether.h"
 #include "net/packet.h"
+#include "net/net_utils.h"
 #include "net/net_debug.h"
 
 #define ARP_HTYPE_ETHERNET 0x1
@@ -35,28 +39,55 @@
 
 #define ARP_TIMEOUT (2 * 1000)
 #define ARP_RETRIES 4
+/* Entries older than this are refreshed, while still being used */
+#define ARP_ENTRY_TIMEOUT (5 * 60 * 1000)
+/* Packets held per entry while resolving, older ones are dropped */
+#define ARP_QUEUE_LEN 2
 
-static arp_resolve_t *pending_resolve;
-static int arp_timeout_event_id;
-static int arp_retries;
+typedef enum {
+    ARP_FREE = 0,
+    ARP_INCOMPLETE = 1,
+    ARP_REACHABLE = 2,
+    ARP_PROBE = 3, /* Reachable, being refreshed */
+} arp_state_t;
+
+typedef struct {
+    etherif_t *ethif;
+    u32 ip; /* Host order */
+    eth_mac_t mac;
+    arp_state_t state;
+    u32 updated; /* Last confirmation timestamp */
+    u32 used; /* Last lookup timestamp, for LRU eviction */
+    int retries;
+    int timer_id;
+    event_t timer;
+    arp_resolve_t *waiters;
+    packet_queue_t queue;
+} arp_entry_t;
+
+static arp_entry_t arp_table[CONFIG_ARP_TABLE_SIZE];
 
 static void arp_timeout(event_t *e, u32 resource_id, u64 timestamp);
 
-static event_t arp_timeout_event = {
-    .trigger = arp_timeout
-};
+static u32 arp_now(void)
+{
+    return (u32)platform_get_ticks_from_boot();
+}
 
 static void arp_pkt_xmit(etherif_t *ethif, u16 oper, const eth_mac_t *tha,
     u32 spa, u32 tpa)
 {
+    packet_t *pkt;
     arp_packet_t *arp;
     eth_mac_t sha;
 
+    if (!(pkt = packet_alloc()))
+        return;
+
     etherif_mac_addr_get(ethif, &sha);
 
     /* Prepare ARP header */
-    packet_reset(&g_packet, PACKET_RESET_TAIL);
-    arp = packet_push(&g_packet, sizeof(arp_packet_t));
+    arp = packet_push(pkt, sizeof(arp_packet_t));
     arp->htype = htons(ARP_HTYPE_ETHERNET);
     arp->ptype = htons(ETHER_PROTOCOL_IP);
     arp->hlen = 6;
@@ -67,70 +98,204 @@ static void arp_pkt_xmit(etherif_t *ethif, u16 oper, const eth_mac_t *tha,
     arp->tha = *tha;
     arp->tpa = tpa;
 
-    arp_timeout_event_id = event_timer_set(ARP_TIMEOUT, &arp_timeout_event);
+    ethernet_xmit(ethif, pkt, &bcast_mac, htons(ETHER_PROTOCOL_ARP));
+    packet_put(pkt);
+}
+
+static arp_entry_t *arp_entry_find(etherif_t *ethif, u32 ip)
+{
+    arp_entry_t *entry;
 
-    ethernet_xmit(ethif, &bcast_mac, htons(ETHER_PROTOCOL_ARP));
+    for (entry = arp_table; entry < arp_table + CONFIG_ARP_TABLE_SIZE; entry++)
+    {
+        if (entry->state != ARP_FREE && entry->ethif == ethif &&
+            entry->ip == ip)
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
 }
 
-static void arp_resolve_complete(int status, eth_mac_t mac)
+static void arp_entry_timer_stop(arp_entry_t *entry)
 {
-    pending_resolve->resolved(pending_resolve, status, mac);
-    pending_resolve = NULL;
-    event_timer_del(arp_timeout_event_id);
-    arp_timeout_event_id = -1;
+    if (entry->timer_id < 0)
+        return;
+
+    event_timer_del(entry->timer_id);
+    entry->timer_id = -1;
 }
 
-static void arp_resolve_pending(void)
+static void arp_entry_free(arp_entry_t *entry)
 {
-    etherif_t *ethif = pending_resolve->ethif;
+    arp_entry_timer_stop(entry);
+    packet_queue_purge(&entry->queue);
+    entry->state = ARP_FREE;
+    entry->ethif = NULL;
+    entry->waiters = NULL;
+}
+
+/* Reuses the least recently used resolved entry if the table is full.
+ * Entries being resolved are never evicted.
+ */
+static arp_entry_t *arp_entry_alloc(etherif_t *ethif, u32 ip)
+{
+    arp_entry_t *entry, *lru = NULL;
+
+    for (entry = arp_table; entry < arp_table + CONFIG_ARP_TABLE_SIZE; entry++)
+    {
+        if (entry->state == ARP_FREE)
+            break;
+
+        if (entry->state != ARP_INCOMPLETE &&
+            (!lru || (s32)(entry->used - lru->used) < 0))
+        {
+            lru = entry;
+        }
+    }
+
+    if (entry == arp_table + CONFIG_ARP_TABLE_SIZE)
+    {
+        if (!lru)
+        {
+            tp_err("ARP table is full\n");
+            return NULL;
+        }
+
+        tp_debug("ARP: evicting %s\n", ip_addr_serialize(lru->ip));
+        arp_entry_free(lru);
+        entry = lru;
+    }
+
+    entry->ethif = ethif;
+    entry->ip = ip;
+    entry->state = ARP_INCOMPLETE;
+    entry->updated = entry->used = arp_now();
+    entry->timer_id = -1;
+    entry->timer = (event_t){ .trigger = arp_timeout };
+    entry->waiters = NULL;
+    packet_queue_init(&entry->queue);
+    return entry;
+}
+
+static void arp_request_xmit(arp_entry_t *entry)
+{
+    etherif_t *ethif = entry->ethif;
 
     arp_pkt_xmit(ethif, htons(ARP_OPER_REQUEST), &zero_mac,
-        htonl(ipv4_addr(ethif)), htonl(pending_resolve->ip));
+        htonl(ipv4_addr(ethif)), htonl(entry->ip));
+    entry->timer_id = event_timer_set(ARP_TIMEOUT, &entry->timer);
+}
+
+static void arp_entry_resolve(arp_entry_t *entry, arp_state_t state)
+{
+    entry->state = state;
+    entry->retries = ARP_RETRIES;
+    arp_request_xmit(entry);
+}
+
+/* Flush the packets queued on the entry and notify its waiters */
+static void arp_entry_complete(arp_entry_t *entry, int status)
+{
+    arp_resolve_t *waiters = entry->waiters, *ar;
+    eth_mac_t mac = bcast_mac;
+    packet_t *pkt;
+
+    entry->waiters = NULL;
+    if (status)
+        arp_entry_free(entry);
+    else
+    {
+        mac = entry->mac;
+        arp_entry_timer_stop(entry);
+        entry->state = ARP_REACHABLE;
+        entry->updated = arp_now();
+        while ((pkt = packet_dequeue(&entry->queue)))
+        {
+            ethernet_xmit(entry->ethif, pkt, &mac, htons(ETHER_PROTOCOL_IP));
+            packet_put(pkt);
+        }
+    }
+
+    while ((ar = waiters))
+    {
+        waiters = ar->next;
+        ar->next = NULL;
+        ar->resolved(ar, status, mac);
+    }
 }
 
 static void arp_timeout(event_t *e, u32 resource_id, u64 timestamp)
 {
-    if (!pending_resolve)
-        return;
+    arp_entry_t *entry = container_of(e, arp_entry_t, timer);
 
-    if (arp_retries)
+    entry->timer_id = -1;
+    if (entry->retries)
     {
-        arp_retries--;
-        arp_timeout_event_id = event_timer_set(ARP_TIMEOUT, &arp_timeout_event);
-        arp_resolve_pending();
+        entry->retries--;
+        arp_request_xmit(entry);
         return;
     }
 
-    tp_err("ARP request timed out\n");
-    arp_resolve_complete(-1, bcast_mac);
+    tp_err("ARP request for %s timed out\n", ip_addr_serialize(entry->ip));
+    arp_entry_complete(entry, -1);
 }
 
-static void arp_reply_recv(etherif_t *ethif, arp_packet_t *arp)
+/* Returns the entry of 'ip', refreshing it in the background if it has
+ * aged.
+ */
+static arp_entry_t *arp_entry_lookup(etherif_t *ethif, u32 ip)
 {
-    if (!pending_resolve || pending_resolve->ethif != ethif)
-        return;
+    arp_entry_t *entry;
+    u32 now = arp_now();
 
-    if (arp->spa != htonl(pending_resolve->ip))
-        return;
+    if (!(entry = arp_entry_find(ethif, ip)))
+        return NULL;
+
+    entry->used = now;
+    if (entry->state == ARP_REACHABLE &&
+        now - entry->updated > ARP_ENTRY_TIMEOUT)
+    {
+        arp_entry_resolve(entry, ARP_PROBE);
+    }
 
-    arp_resolve_complete(0, arp->sha);
+    return entry;
 }
 
-static void arp_request_recv(etherif_t *ethif, arp_packet_t *arp)
+/* RFC 826 merge: update the sender's entry from any ARP packet, and create
+ * it if the packet is directed to us. Gratuitous ARPs thus refresh the
+ * entries we know of.
+ */
+static void arp_learn(etherif_t *ethif, arp_packet_t *arp)
 {
-    if (ipv4_addr(ethif) != ntohl(arp->tpa))
+    u32 ip = ntohl(arp->spa), our_ip = ipv4_addr(ethif);
+    arp_entry_t *entry;
+
+    if (!ip || ip == our_ip)
         return;
 
-    arp_pkt_xmit(ethif, htons(ARP_OPER_REPLY), &arp->sha, arp->tpa, arp->spa);
+    if (!(entry = arp_entry_find(ethif, ip)))
+    {
+        if (!our_ip || ntohl(arp->tpa) != our_ip)
+            return;
+
+        if (!(entry = arp_entry_alloc(ethif, ip)))
+            return;
+    }
+
+    entry->mac = arp->sha;
+    arp_entry_complete(entry, 0);
 }
 
-static void arp_recv(etherif_t *ethif)
+static void arp_recv(etherif_t *ethif, packet_t *pkt)
 {
-    arp_packet_t *arp = (arp_packet_t *)g_packet.ptr;
+    arp_packet_t *arp = (arp_packet_t *)pkt->ptr;
 
     tp_debug("ARP packet received\n");
 
-    if (arp->htype != htons(ARP_HTYPE_ETHERNET) ||
+    if (pkt->length < sizeof(arp_packet_t) ||
+        arp->htype != htons(ARP_HTYPE_ETHERNET) ||
         arp->ptype != htons(ETHER_PROTOCOL_IP) ||
         arp->hlen != 6 || arp->plen != 4)
     {
@@ -138,25 +303,96 @@ static void arp_recv(etherif_t *ethif)
         return;
     }
 
-    if (arp->oper == htons(ARP_OPER_REPLY))
-        arp_reply_recv(ethif, arp);
-    else if (arp->oper == htons(ARP_OPER_REQUEST))
-        arp_request_recv(ethif, arp);
-    else
+    if (arp->oper != htons(ARP_OPER_REPLY) &&
+        arp->oper != htons(ARP_OPER_REQUEST))
+    {
         tp_info("Unsupported ARP oper %d\n", ntohs(arp->oper));
+        return;
+    }
+
+    arp_learn(ethif, arp);
+
+    if (arp->oper == htons(ARP_OPER_REQUEST) && ipv4_addr(ethif) &&
+        ipv4_addr(ethif) == ntohl(arp->tpa))
+    {
+        arp_pkt_xmit(ethif, htons(ARP_OPER_REPLY), &arp->sha, arp->tpa,
+            arp->spa);
+    }
+}
+
+int arp_lookup(etherif_t *ethif, u32 ip, eth_mac_t *mac)
+{
+    arp_entry_t *entry = arp_entry_lookup(ethif, ip);
+
+    if (!entry || entry->state == ARP_INCOMPLETE)
+        return -1;
+
+    *mac = entry->mac;
+    return 0;
 }
 
 int arp_resolve(arp_resolve_t *resolve)
 {
-    if (pending_resolve)
+    arp_entry_t *entry;
+    arp_resolve_t **iter;
+
+    if ((entry = arp_entry_lookup(resolve->ethif, resolve->ip)) &&
+        entry->state != ARP_INCOMPLETE)
     {
-        tp_err("An ARP resolve request is already pending\n");
-        return -1;
+        resolve->resolved(resolve, 0, entry->mac);
+        return 0;
     }
 
-    pending_resolve = resolve;
-    arp_retries = ARP_RETRIES;
-    arp_resolve_pending();
+    if (!entry)
+    {
+        if (!(entry = arp_entry_alloc(resolve->ethif, resolve->ip)))
+            return -1;
+
+        arp_entry_resolve(entry, ARP_INCOMPLETE);
+    }
+
+    for (iter = &entry->waiters; *iter; iter = &(*iter)->next);
+    resolve->next = NULL;
+    *iter = resolve;
+    return 0;
+}
+
+void arp_resolve_cancel(arp_resolve_t *resolve)
+{
+    arp_entry_t *entry;
+    arp_resolve_t **iter;
+
+    if (!(entry = arp_entry_find(resolve->ethif, resolve->ip)))
+        return;
+
+    for (iter = &entry->waiters; *iter && *iter != resolve;
+        iter = &(*iter)->next);
+    if (*iter)
+        *iter = resolve->next;
+}
+
+int arp_resolve_xmit(etherif_t *ethif, packet_t *pkt, u32 ip)
+{
+    arp_entry_t *entry;
+
+    if ((entry = arp_entry_lookup(ethif, ip)) &&
+        entry->state != ARP_INCOMPLETE)
+    {
+        return ethernet_xmit(ethif, pkt, &entry->mac,
+            htons(ETHER_PROTOCOL_IP));
+    }
+
+    if (!entry)
+    {
+        if (!(entry = arp_entry_alloc(ethif, ip)))
+            return -1;
+
+        arp_entry_resolve(entry, ARP_INCOMPLETE);
+    }
+
+    if (entry->queue.count == ARP_QUEUE_LEN)
+        packet_put(packet_dequeue(&entry->queue));
+    packet_enqueue(&entry->queue, packet_get(pkt));
     return 0;
 }
 
@@ -165,9 +401,27 @@ static ether_proto_t arp_proto = {
     .recv = arp_recv,
 };
 
+void arp_etherif_uninit(etherif_t *ethif)
+{
+    arp_entry_t *entry;
+
+    for (entry = arp_table; entry < arp_table + CONFIG_ARP_TABLE_SIZE; entry++)
+    {
+        if (entry->state != ARP_FREE && entry->ethif == ethif)
+            arp_entry_complete(entry, -1);
+    }
+}
+
 void arp_uninit(void)
 {
-    event_timer_del(arp_timeout_event_id);
+    arp_entry_t *entry;
+
+    for (entry = arp_table; entry < arp_table + CONFIG_ARP_TABLE_SIZE; entry++)
+    {
+        if (entry->state != ARP_FREE)
+            arp_entry_free(entry);
+    }
+
     ethernet_unregister_proto(&arp_proto);
 }
 
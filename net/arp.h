@@ -27,17 +27,33 @@
 
 #include "net/net_types.h"
 #include "net/etherif.h"
+#include "net/packet.h"
 
 typedef struct arp_resolve_t arp_resolve_t;
 
 struct arp_resolve_t {
+    arp_resolve_t *next;
     etherif_t *ethif;
     u32 ip; /* Host order */
     void (*resolved)(arp_resolve_t *ar, int status, eth_mac_t mac);
 };
 
+/* 'resolved' is called once the address is known or resolution failed.
+ * Addresses found in the neighbor cache are reported before returning.
+ */
 int arp_resolve(arp_resolve_t *resolve);
+void arp_resolve_cancel(arp_resolve_t *resolve);
+
+/* Returns 0 and fills 'mac' if 'ip' (host order) is in the neighbor cache */
+int arp_lookup(etherif_t *ethif, u32 ip, eth_mac_t *mac);
+
+/* Transmit an IPv4 packet to the neighbor 'ip' (host order). While the
+ * address is being resolved the packet is queued on the neighbor entry,
+ * holding its own reference.
+ */
+int arp_resolve_xmit(etherif_t *ethif, packet_t *pkt, u32 ip);
 
+void arp_etherif_uninit(etherif_t *ethif);
 void arp_uninit(void);
 void arp_init(void);
 
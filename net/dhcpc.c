@@ -25,6 +25,9 @@
 #include <string.h> /* memcpy, memset */
 #include "mem/tmalloc.h"
 #include "util/tp_misc.h"
+#include "util/event.h"
+#include "platform/platform.h"
+#include "fs/vfs.h"
 #include "net/dhcpc.h"
 #include "net/packet.h"
 #include "net/ether.h"
@@ -45,23 +48,73 @@
 #define DHCP_MSG_OFFER 2
 #define DHCP_MSG_REQUEST 3
 #define DHCP_MSG_ACK 5
+#define DHCP_MSG_NAK 6
+
+#define DHCP_LEASE_INFINITE 0xffffffff
+
+/* Retransmissions back off from 4 to 64 seconds, RFC 2131 section 4.1 */
+#define DHCPC_RETRANSMIT_MS 4000
+#define DHCPC_RETRANSMIT_MAX_MS 64000
+/* REQUESTs sent before falling back to DISCOVER */
+#define DHCPC_REQUEST_RETRIES 3
+/* A stored lease is given up quickly, servers may silently ignore it */
+#define DHCPC_REBOOT_MS 2000
+#define DHCPC_REBOOT_RETRIES 2
+/* Minimal wait between RENEWING and REBINDING retransmissions */
+#define DHCPC_RENEW_RETRY_MS 60000
+/* Longer waits are split, timers are int milliseconds */
+#define DHCPC_MAX_TIMER_MS (24 * 60 * 60 * 1000)
+
+typedef enum {
+    DHCPC_SELECTING = 0,
+    DHCPC_REQUESTING = 1,
+    DHCPC_REBOOTING = 2,
+    DHCPC_BOUND = 3,
+    DHCPC_RENEWING = 4,
+    DHCPC_REBINDING = 5,
+} dhcpc_state_t;
+
+typedef struct {
+    u8 msg_type;
+    /* All in HOST order, times in seconds */
+    u32 ip;
+    u32 netmask;
+    u32 router;
+    u32 server;
+    u32 lease_time;
+    u32 t1;
+    u32 t2;
+} dhcpc_reply_t;
 
 typedef struct {
     udp_socket_t udp_sock;
     etherif_t *ethif;
     ipv4_info_t ip_info;
+    dhcpc_state_t state;
     u32 xid;
-    u8 waited_message;
+    u32 requested_ip; /* Offered or stored address, host order */
+    u32 server; /* Host order */
+    u32 lease_time, t1, t2; /* Seconds */
+    u64 bound_at; /* Ticks of the last ACK */
+    int retries;
+    int timer_id;
 } dhcpc_t;
 
+typedef struct {
+    event_t e;
+    dhcpc_t *dhcpc;
+} dhcpc_timer_t;
+
 static u32 xid_seed = 0x453a939a;
-static const u8 requested_options[] = { 0x1, 0x3 };
+static const u8 requested_options[] = { 1, 3, 51, 58, 59 };
+
+static void dhcpc_timeout(dhcpc_t *dhcpc);
 
-static int __opt_put(u8 opt_num, const u8 opt[], u8 opt_len)
+static int __opt_put(packet_t *pkt, u8 opt_num, const u8 opt[], u8 opt_len)
 {
     u8 *p;
 
-    if (!(p = packet_push(&g_packet, 2 + opt_len)))
+    if (!(p = packet_push(pkt, 2 + opt_len)))
         return -1;
 
     *p++ = opt_num;
@@ -70,162 +123,328 @@ static int __opt_put(u8 opt_num, const u8 opt[], u8 opt_len)
     return 0;
 }
 
-#define opt_put(opt_num, val) __opt_put(opt_num, val, sizeof(val))
+#define opt_put(pkt, opt_num, val) __opt_put(pkt, opt_num, val, sizeof(val))
 
 #define DECL_PUT_OPT(type) \
-static int opt_put_##type(u8 opt_num, type val) \
+static int opt_put_##type(packet_t *pkt, u8 opt_num, type val) \
 { \
-    return opt_put(opt_num, (u8 *)&(val)); \
+    return __opt_put(pkt, opt_num, (u8 *)&(val), sizeof(val)); \
 }
 
 DECL_PUT_OPT(u8)
 DECL_PUT_OPT(u16)
 DECL_PUT_OPT(u32)
 
-static int dhcpc_msg_xmit(dhcpc_t *dhcpc)
+static void dhcpc_timer_free(event_t *e)
+{
+    tfree(container_of(e, dhcpc_timer_t, e));
+}
+
+static void dhcpc_timer_trigger(event_t *e, u32 resource_id, u64 timestamp)
+{
+    dhcpc_t *dhcpc = container_of(e, dhcpc_timer_t, e)->dhcpc;
+
+    dhcpc->timer_id = -1;
+    dhcpc_timeout(dhcpc);
+}
+
+static void dhcpc_timer_stop(dhcpc_t *dhcpc)
+{
+    if (dhcpc->timer_id < 0)
+        return;
+
+    event_timer_del(dhcpc->timer_id);
+    dhcpc->timer_id = -1;
+}
+
+/* The timer is allocated separately, as deleted timers are freed after the
+ * dhcpc itself may be gone.
+ */
+static void dhcpc_timer_start(dhcpc_t *dhcpc, u64 ms)
+{
+    dhcpc_timer_t *t = tmalloc_type(dhcpc_timer_t);
+
+    dhcpc_timer_stop(dhcpc);
+    t->e = (event_t){ .trigger = dhcpc_timer_trigger,
+        .free = dhcpc_timer_free };
+    t->dhcpc = dhcpc;
+    dhcpc->timer_id = event_timer_set(MIN(ms, DHCPC_MAX_TIMER_MS), &t->e);
+}
+
+static int dhcpc_msg_xmit(dhcpc_t *dhcpc, packet_t *pkt)
 {
     dhcp_msg_t *msg;
     eth_mac_t mac;
+    u32 ciaddr = 0;
 
-    if (!(msg = packet_push(&g_packet, sizeof(dhcp_msg_t))))
+    if (!(msg = packet_push(pkt, sizeof(dhcp_msg_t))))
         return -1;
 
     etherif_mac_addr_get(dhcpc->ethif, &mac);
 
+    /* A bound client owns its address and is answered by unicast */
+    if (dhcpc->state == DHCPC_RENEWING || dhcpc->state == DHCPC_REBINDING)
+        ciaddr = dhcpc->ip_info.ip;
+
     msg->op = DHCP_OP_REQUEST;
     msg->htype = DHCP_HW_TYPE_ETH;
     msg->hlen = 6;
     msg->hops = 0;
     msg->xid = dhcpc->xid;
     msg->secs = 0;
-    msg->flags = htons(BROADCAST_FLAG);
-    msg->ciaddr = 0;
+    msg->flags = ciaddr ? 0 : htons(BROADCAST_FLAG);
+    msg->ciaddr = htonl(ciaddr);
     msg->yiaddr = 0;
     msg->siaddr = 0;
     msg->giaddr = 0;
     memcpy(msg->chaddr, mac.mac, 6);
     memset(msg->chaddr + 6, 0, 192 + 10);
     msg->magic_cookie = htonl(DHCP_MAGIC_COOKIE);
-    return udp_sock_xmit(dhcpc->ethif, &dhcpc->udp_sock, &bcast_mac,
-        IP_ADDR_ANY, IP_ADDR_BCAST, g_packet.length);
+
+    /* Renewals go to the leasing server, the next hop is resolved by ARP */
+    if (dhcpc->state == DHCPC_RENEWING && dhcpc->server)
+    {
+        return udp_sock_xmit(dhcpc->ethif, &dhcpc->udp_sock, pkt, NULL,
+            ciaddr, dhcpc->server, pkt->length);
+    }
+
+    return udp_sock_xmit(dhcpc->ethif, &dhcpc->udp_sock, pkt, &bcast_mac,
+        ciaddr, IP_ADDR_BCAST, pkt->length);
 }
 
-static int dhcpc_pad(void)
+static int dhcpc_pad(packet_t *pkt)
 {
     u16 pad_len;
 
-    pad_len = DHCP_MIN_PACKET_LEN - (g_packet.length + sizeof(dhcp_msg_t));
+    pad_len = DHCP_MIN_PACKET_LEN - (pkt->length + sizeof(dhcp_msg_t));
 
-    if (!packet_push(&g_packet, pad_len))
+    if (!packet_push(pkt, pad_len))
         return -1;
 
-    memset(g_packet.ptr, 0, pad_len);
+    memset(pkt->ptr, 0, pad_len);
     return 0;
 }
 
+/* Max DHCP message size we accept, i.e. our frame buffer sans Ethernet */
+#define DHCP_MAX_MSG_SIZE (NET_PACKET_SIZE - sizeof(eth_hdr_t))
+
 static int dhcp_discover(dhcpc_t *dhcpc)
 {
-    packet_reset(&g_packet, PACKET_RESET_TAIL);
+    packet_t *pkt;
+    int ret = -1;
+
+    if (!(pkt = packet_alloc()))
+        return -1;
 
     /* Add options in reverse */
-    if (opt_put_u8(0xff, 0) ||
-        opt_put(55, requested_options) ||
-        opt_put_u16(57, htons(NET_PACKET_SIZE)) ||
-        opt_put_u8(53, DHCP_MSG_DISCOVER))
+    if (opt_put_u8(pkt, 0xff, 0) ||
+        opt_put(pkt, 55, requested_options) ||
+        opt_put_u16(pkt, 57, htons(DHCP_MAX_MSG_SIZE)) ||
+        opt_put_u8(pkt, 53, DHCP_MSG_DISCOVER))
     {
-        return -1;
+        goto Exit;
     }
 
-    if (dhcpc_pad())
-        return -1;
+    if (dhcpc_pad(pkt))
+        goto Exit;
 
-    dhcpc->xid = xid_seed++;
-    return dhcpc_msg_xmit(dhcpc);
+    ret = dhcpc_msg_xmit(dhcpc, pkt);
+
+Exit:
+    packet_put(pkt);
+    return ret;
 }
 
 static int dhcp_request(dhcpc_t *dhcpc)
 {
-    packet_reset(&g_packet, PACKET_RESET_TAIL);
+    packet_t *pkt;
+    int ret = -1;
+
+    if (!(pkt = packet_alloc()))
+        return -1;
 
     /* Add options in reverse */
-    if (opt_put_u8(0xff, 0) ||
-        opt_put(55, requested_options) ||
-        opt_put_u16(57, htons(NET_PACKET_SIZE)) ||
-        opt_put_u32(50, htonl(dhcpc->ip_info.ip)) ||
-        opt_put_u8(53, DHCP_MSG_REQUEST))
+    if (opt_put_u8(pkt, 0xff, 0) ||
+        opt_put(pkt, 55, requested_options) ||
+        opt_put_u16(pkt, 57, htons(DHCP_MAX_MSG_SIZE)))
+    {
+        goto Exit;
+    }
+
+    /* RFC 2131 table 5: only a REQUEST answering an OFFER names the server,
+     * and bound clients identify their address using ciaddr instead.
+     */
+    if (dhcpc->state == DHCPC_REQUESTING &&
+        opt_put_u32(pkt, 54, htonl(dhcpc->server)))
+    {
+        goto Exit;
+    }
+
+    if ((dhcpc->state == DHCPC_REQUESTING ||
+        dhcpc->state == DHCPC_REBOOTING) &&
+        opt_put_u32(pkt, 50, htonl(dhcpc->requested_ip)))
+    {
+        goto Exit;
+    }
+
+    if (opt_put_u8(pkt, 53, DHCP_MSG_REQUEST) || dhcpc_pad(pkt))
+        goto Exit;
+
+    ret = dhcpc_msg_xmit(dhcpc, pkt);
+
+Exit:
+    packet_put(pkt);
+    return ret;
+}
+
+#ifdef CONFIG_DHCP_CLIENT_LEASE_STORE
+
+#define DHCPC_LEASE_MAGIC 0x44484331 /* DHC1 */
+
+/* Boards may have no wall clock to tell whether a stored lease expired.
+ * INIT-REBOOT has the server confirm it instead.
+ */
+typedef struct {
+    u32 magic;
+    u8 mac[6];
+    u32 ip;
+    u32 server;
+} dhcpc_lease_t;
+
+static int dhcpc_lease_load(dhcpc_t *dhcpc)
+{
+    tstr_t content, path = S(CONFIG_DHCP_CLIENT_LEASE_PATH);
+    dhcpc_lease_t lease;
+    eth_mac_t mac;
+
+    if (vfs_file_read(&content, &path, 0))
+        return -1;
+
+    if (content.len != sizeof(lease))
     {
+        tstr_free(&content);
         return -1;
     }
 
-    if (dhcpc_pad())
+    tstr_serialize((char *)&lease, &content, 0, sizeof(lease));
+    tstr_free(&content);
+
+    etherif_mac_addr_get(dhcpc->ethif, &mac);
+    if (lease.magic != DHCPC_LEASE_MAGIC || memcmp(lease.mac, mac.mac, 6) ||
+        !lease.ip)
+    {
         return -1;
+    }
+
+    dhcpc->requested_ip = lease.ip;
+    dhcpc->server = lease.server;
+    return 0;
+}
 
-    return dhcpc_msg_xmit(dhcpc);
+static void dhcpc_lease_save(dhcpc_t *dhcpc)
+{
+    tstr_t content, path = S(CONFIG_DHCP_CLIENT_LEASE_PATH);
+    dhcpc_lease_t lease;
+    eth_mac_t mac;
+
+    memset(&lease, 0, sizeof(lease));
+    etherif_mac_addr_get(dhcpc->ethif, &mac);
+    lease.magic = DHCPC_LEASE_MAGIC;
+    memcpy(lease.mac, mac.mac, 6);
+    lease.ip = dhcpc->ip_info.ip;
+    lease.server = dhcpc->server;
+
+    tstr_init(&content, (char *)&lease, sizeof(lease), 0);
+    if (vfs_file_write(&content, &path))
+        tp_warn("DHCP: failed to store lease\n");
 }
 
-static int dhcpc_options_iter(int (*cb)(dhcpc_t *dhcpc, u8 opt, u8 len),
-    dhcpc_t *dhcpc)
+#else
+
+static inline int dhcpc_lease_load(dhcpc_t *dhcpc) { return -1; }
+static inline void dhcpc_lease_save(dhcpc_t *dhcpc) { }
+
+#endif
+
+static int dhcpc_options_iter(int (*cb)(dhcpc_reply_t *reply, packet_t *pkt,
+    u8 opt, u8 len), dhcpc_reply_t *reply, packet_t *pkt)
 {
-    while (g_packet.length >= 2)
+    while (pkt->length >= 2)
     {
         u8 opt, len;
 
-        opt = *g_packet.ptr;
-        packet_pull(&g_packet, 1);
-        len = *g_packet.ptr;
-        packet_pull(&g_packet, 1);
+        opt = *pkt->ptr;
+        packet_pull(pkt, 1);
+        if (!opt) /* Pad */
+            continue;
 
         if  (opt == 0xFF)
             break;
 
-        if (cb(dhcpc, opt, len))
-            return -1;
+        len = *pkt->ptr;
+        packet_pull(pkt, 1);
 
-        if (!packet_pull(&g_packet, len))
+        if (len > pkt->length)
         {
             tp_err("Invalid DHCP option %d\n", opt);
             return -1;
         }
+
+        if (cb(reply, pkt, opt, len))
+            return -1;
+
+        packet_pull(pkt, len);
     }
 
     return 0;
 }
 
-static int dhcpc_options_cb(dhcpc_t *dhcpc, u8 opt, u8 len)
+static int dhcpc_options_cb(dhcpc_reply_t *reply, packet_t *pkt, u8 opt,
+    u8 len)
 {
 #define VAL_U8(p) (*(u8 *)(p))
 #define VAL_U32(p) (((u32)VAL_U8(p)) | ((u32)VAL_U8(p + 1) << 8) | \
     ((u32)VAL_U8(p + 2) << 16) | ((u32)VAL_U8(p + 3) << 24))
 
+    if (len < (opt == 53 ? 1 : 4))
+        return 0;
+
     switch (opt)
     {
     case 53:
-        if (VAL_U8(g_packet.ptr) != dhcpc->waited_message)
-        {
-            tp_err("Expected %d, got %d\n",dhcpc->waited_message,
-                VAL_U8(g_packet.ptr));
-            return -1;
-        }
+        reply->msg_type = VAL_U8(pkt->ptr);
         break;
     case 1:
-        dhcpc->ip_info.netmask = ntohl(VAL_U32(g_packet.ptr));
+        reply->netmask = ntohl(VAL_U32(pkt->ptr));
         break;
     case 3:
-        dhcpc->ip_info.router = ntohl(VAL_U32(g_packet.ptr));
+        reply->router = ntohl(VAL_U32(pkt->ptr));
+        break;
+    case 51:
+        reply->lease_time = ntohl(VAL_U32(pkt->ptr));
+        break;
+    case 54:
+        reply->server = ntohl(VAL_U32(pkt->ptr));
+        break;
+    case 58:
+        reply->t1 = ntohl(VAL_U32(pkt->ptr));
+        break;
+    case 59:
+        reply->t2 = ntohl(VAL_U32(pkt->ptr));
         break;
     }
     return 0;
 }
 
-static int dhcpc_options_process(dhcpc_t *dhcpc)
+static int dhcpc_options_process(dhcpc_reply_t *reply, packet_t *pkt)
 {
-    if (!packet_pull(&g_packet, sizeof(dhcp_msg_t)))
+    if (!packet_pull(pkt, sizeof(dhcp_msg_t)))
     {
         tp_err("Not enough packet room for DHCP options");
         return -1;
     }
 
-    if (dhcpc_options_iter(dhcpc_options_cb, dhcpc))
+    if (dhcpc_options_iter(dhcpc_options_cb, reply, pkt))
     {
         tp_err("DHCP options processing failed\n");
         return -1;
@@ -234,16 +453,164 @@ static int dhcpc_options_process(dhcpc_t *dhcpc)
     return 0;
 }
 
-static void dhcpc_recv(udp_socket_t *sock)
+static u64 dhcpc_retransmit_ms(dhcpc_t *dhcpc)
+{
+    return MIN((u64)DHCPC_RETRANSMIT_MS << dhcpc->retries,
+        DHCPC_RETRANSMIT_MAX_MS);
+}
+
+static void dhcpc_init_state(dhcpc_t *dhcpc)
+{
+    dhcpc->state = DHCPC_SELECTING;
+    dhcpc->xid = xid_seed++;
+    dhcpc->retries = 0;
+    dhcp_discover(dhcpc);
+    dhcpc_timer_start(dhcpc, dhcpc_retransmit_ms(dhcpc));
+}
+
+static void dhcpc_reboot_state(dhcpc_t *dhcpc)
+{
+    tp_debug("DHCP INIT-REBOOT %s\n", ip_addr_serialize(dhcpc->requested_ip));
+    dhcpc->state = DHCPC_REBOOTING;
+    dhcpc->xid = xid_seed++;
+    dhcpc->retries = 0;
+    dhcp_request(dhcpc);
+    dhcpc_timer_start(dhcpc, DHCPC_REBOOT_MS);
+}
+
+/* The address can no longer be used, start over */
+static void dhcpc_lease_drop(dhcpc_t *dhcpc)
+{
+    if (dhcpc->ethif->ipv4_info == &dhcpc->ip_info)
+        dhcpc->ethif->ipv4_info = NULL;
+
+    dhcpc_init_state(dhcpc);
+}
+
+/* Half the time left before the deadline, RFC 2131 section 4.4.5 */
+static u64 dhcpc_renew_retry_ms(u64 left)
+{
+    return MAX(left / 2, MIN(left, DHCPC_RENEW_RETRY_MS));
+}
+
+static void dhcpc_lease_timeout(dhcpc_t *dhcpc)
+{
+    u64 elapsed = platform_get_ticks_from_boot() - dhcpc->bound_at;
+    u64 lease_ms = (u64)dhcpc->lease_time * 1000;
+    u64 t1_ms = (u64)dhcpc->t1 * 1000, t2_ms = (u64)dhcpc->t2 * 1000;
+
+    if (elapsed >= lease_ms)
+    {
+        tp_warn("DHCP lease expired\n");
+        dhcpc_lease_drop(dhcpc);
+        return;
+    }
+
+    if (elapsed >= t2_ms)
+    {
+        if (dhcpc->state != DHCPC_REBINDING)
+        {
+            dhcpc->state = DHCPC_REBINDING;
+            dhcpc->xid = xid_seed++;
+        }
+        dhcp_request(dhcpc);
+        dhcpc_timer_start(dhcpc, dhcpc_renew_retry_ms(lease_ms - elapsed));
+    }
+    else if (elapsed >= t1_ms)
+    {
+        if (dhcpc->state != DHCPC_RENEWING)
+        {
+            dhcpc->state = DHCPC_RENEWING;
+            dhcpc->xid = xid_seed++;
+        }
+        dhcp_request(dhcpc);
+        dhcpc_timer_start(dhcpc, dhcpc_renew_retry_ms(t2_ms - elapsed));
+    }
+    else
+        dhcpc_timer_start(dhcpc, t1_ms - elapsed);
+}
+
+static void dhcpc_timeout(dhcpc_t *dhcpc)
+{
+    switch (dhcpc->state)
+    {
+    case DHCPC_SELECTING:
+        if (dhcpc_retransmit_ms(dhcpc) < DHCPC_RETRANSMIT_MAX_MS)
+            dhcpc->retries++;
+        dhcp_discover(dhcpc);
+        dhcpc_timer_start(dhcpc, dhcpc_retransmit_ms(dhcpc));
+        break;
+    case DHCPC_REQUESTING:
+        if (++dhcpc->retries == DHCPC_REQUEST_RETRIES)
+        {
+            dhcpc_init_state(dhcpc);
+            break;
+        }
+        dhcp_request(dhcpc);
+        dhcpc_timer_start(dhcpc, dhcpc_retransmit_ms(dhcpc));
+        break;
+    case DHCPC_REBOOTING:
+        if (++dhcpc->retries == DHCPC_REBOOT_RETRIES)
+        {
+            dhcpc_init_state(dhcpc);
+            break;
+        }
+        dhcp_request(dhcpc);
+        dhcpc_timer_start(dhcpc, DHCPC_REBOOT_MS);
+        break;
+    default:
+        dhcpc_lease_timeout(dhcpc);
+        break;
+    }
+}
+
+static void dhcpc_bind(dhcpc_t *dhcpc, dhcpc_reply_t *reply)
+{
+    ipv4_info_t *ip_info = &dhcpc->ip_info;
+    int changed;
+
+    changed = dhcpc->ethif->ipv4_info != ip_info || ip_info->ip != reply->ip ||
+        ip_info->netmask != reply->netmask ||
+        ip_info->router != reply->router || dhcpc->server != reply->server;
+
+    ip_info->ip = reply->ip;
+    ip_info->netmask = reply->netmask;
+    ip_info->router = reply->router;
+    dhcpc->server = reply->server;
+    dhcpc->lease_time = reply->lease_time;
+    dhcpc->t1 = reply->t1 ? : reply->lease_time / 2;
+    dhcpc->t2 = reply->t2 ? : reply->lease_time / 8 * 7;
+    dhcpc->bound_at = platform_get_ticks_from_boot();
+    dhcpc->state = DHCPC_BOUND;
+
+    dhcpc_timer_stop(dhcpc);
+    if (dhcpc->lease_time != DHCP_LEASE_INFINITE)
+        dhcpc_timer_start(dhcpc, (u64)dhcpc->t1 * 1000);
+
+    /* Renewals of an unchanged lease don't rewrite the stored copy */
+    if (!changed)
+        return;
+
+    tp_out("Address: %s\n", ip_addr_serialize(ip_info->ip));
+    tp_out("Netmask: %s\n", ip_addr_serialize(ip_info->netmask));
+    tp_out("Router: %s\n", ip_addr_serialize(ip_info->router));
+
+    dhcpc_lease_save(dhcpc);
+    etherif_ipv4_info_set(dhcpc->ethif, ip_info);
+}
+
+static void dhcpc_recv(udp_socket_t *sock, packet_t *pkt)
 {
     dhcpc_t *dhcpc = container_of(sock, dhcpc_t, udp_sock);
-    dhcp_msg_t *msg = (dhcp_msg_t *)g_packet.ptr;
+    dhcp_msg_t *msg = (dhcp_msg_t *)pkt->ptr;
+    dhcpc_reply_t reply = {};
     eth_mac_t mac;
 
     tp_debug("DHCP Received\n");
 
-    if (msg->op != DHCP_OP_REPLY || msg->htype != DHCP_HW_TYPE_ETH ||
-        msg->hlen != 6 || msg->hops || msg->xid != dhcpc->xid)
+    if (pkt->length < sizeof(dhcp_msg_t) || msg->op != DHCP_OP_REPLY || msg->htype != DHCP_HW_TYPE_ETH ||
+        msg->hlen != 6 || msg->hops || msg->xid != dhcpc->xid ||
+        dhcpc->state == DHCPC_BOUND)
     {
         return;
     }
@@ -252,25 +619,42 @@ static void dhcpc_recv(udp_socket_t *sock)
     if (memcmp(msg->chaddr, mac.mac, 6))
         return;
 
-    dhcpc->ip_info.ip = ntohl(msg->yiaddr);
-    
-    if (dhcpc_options_process(dhcpc))
-        return;
+    reply.ip = ntohl(msg->yiaddr);
+    reply.lease_time = DHCP_LEASE_INFINITE;
 
-    tp_out("Address: %s\n", ip_addr_serialize(dhcpc->ip_info.ip));
-    tp_out("Netmask: %s\n", ip_addr_serialize(dhcpc->ip_info.netmask));
-    tp_out("Router: %s\n", ip_addr_serialize(dhcpc->ip_info.router));
+    if (dhcpc_options_process(&reply, pkt))
+        return;
 
-    switch (dhcpc->waited_message)
+    switch (reply.msg_type)
     {
     case DHCP_MSG_OFFER:
+        if (dhcpc->state != DHCPC_SELECTING)
+            break;
+
         tp_debug("DHCP OFFER\n");
-        dhcpc->waited_message = DHCP_MSG_ACK;
+        dhcpc->requested_ip = reply.ip;
+        dhcpc->server = reply.server;
+        dhcpc->state = DHCPC_REQUESTING;
+        dhcpc->retries = 0;
         dhcp_request(dhcpc);
+        dhcpc_timer_start(dhcpc, dhcpc_retransmit_ms(dhcpc));
         break;
     case DHCP_MSG_ACK:
+        if (dhcpc->state == DHCPC_SELECTING || !reply.ip)
+            break;
+
         tp_debug("DHCP ACK\n");
-        etherif_ipv4_info_set(dhcpc->ethif, &dhcpc->ip_info); 
+        dhcpc_bind(dhcpc, &reply);
+        break;
+    case DHCP_MSG_NAK:
+        if (dhcpc->state == DHCPC_SELECTING)
+            break;
+
+        tp_warn("DHCP NAK, restarting\n");
+        dhcpc_lease_drop(dhcpc);
+        break;
+    default:
+        tp_err("Unexpected DHCP message %d\n", reply.msg_type);
         break;
     }
 }
@@ -282,30 +666,39 @@ void dhcpc_stop(etherif_t *ethif)
     if (!dhcpc)
         return;
 
+    dhcpc_timer_stop(dhcpc);
     udp_unregister_socket(ethif, &dhcpc->udp_sock);
+    /* The lease is no longer valid */
+    if (ethif->ipv4_info == &dhcpc->ip_info)
+        ethif->ipv4_info = NULL;
+    ethif->dhcpc = NULL;
     tfree(dhcpc);
 }
 
 int dhcpc_start(etherif_t *ethif)
 {
-    dhcpc_t *dhcpc = tmalloc_type(dhcpc_t);
+    dhcpc_t *dhcpc;
 
+    dhcpc_stop(ethif);
+
+    dhcpc = tmalloc_type(dhcpc_t);
+    memset(dhcpc, 0, sizeof(*dhcpc));
     dhcpc->udp_sock.recv = dhcpc_recv;
     dhcpc->udp_sock.local_port = 68;
     dhcpc->udp_sock.remote_port = 67;
     dhcpc->udp_sock.next = NULL;
-    dhcpc->waited_message = DHCP_MSG_OFFER;
+    dhcpc->timer_id = -1;
 
     udp_register_socket(ethif, &dhcpc->udp_sock);
 
     dhcpc->ethif = ethif;
     ethif->dhcpc = dhcpc;
 
-    if (dhcp_discover(dhcpc))
-    {
-        dhcpc_stop(ethif);
-        return -1;
-    }
+    /* A stored lease is requested right away, skipping DISCOVER/OFFER */
+    if (!dhcpc_lease_load(dhcpc))
+        dhcpc_reboot_state(dhcpc);
+    else
+        dhcpc_init_state(dhcpc);
 
     return 0;
 }
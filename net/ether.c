@@ -33,8 +33,10 @@ const eth_mac_t bcast_mac = { .mac = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff } };
 const eth_mac_t zero_mac;
 
 static ether_proto_t *protocols;
+static packet_queue_t rx_queue;
 
-int ethernet_xmit(etherif_t *ethif, const eth_mac_t *dst_mac, u16 eth_type)
+int ethernet_xmit(etherif_t *ethif, packet_t *pkt, const eth_mac_t *dst_mac,
+    u16 eth_type)
 {
     eth_hdr_t *hdr;
     eth_mac_t src_mac;
@@ -42,39 +44,32 @@ int ethernet_xmit(etherif_t *ethif, const eth_mac_t *dst_mac, u16 eth_type)
     etherif_mac_addr_get(ethif, &src_mac);
 
     /* Prepare Ethernet Header */
-    if (!(hdr = packet_push(&g_packet, sizeof(eth_hdr_t))))
+    if (!(hdr = packet_push(pkt, sizeof(eth_hdr_t))))
         return -1;
 
     hdr->eth_type = eth_type;
     hdr->dst = *dst_mac;
     hdr->src = src_mac;
 
-    etherif_packet_xmit(ethif, g_packet.ptr, g_packet.length);
+    etherif_packet_xmit(ethif, pkt->ptr, pkt->length);
     return 0;
 }
 
-static void ethernet_packet_received(event_t *e, u32 resource_id, u64 timestamp)
+static void ethernet_packet_process(packet_t *pkt)
 {
     etherif_t *ethif;
     eth_hdr_t *eth_hdr;
     ether_proto_t *proto;
     u16 eth_type;
-    int len;
 
-    ethif = etherif_get_by_id(RES_MAJ(resource_id));
-
-    tp_debug("Packet received\n");
+    /* The interface may have been removed while the packet was queued */
+    if (!(ethif = etherif_get_by_id(pkt->netif_id)))
+        return;
 
-    packet_reset(&g_packet, PACKET_RESET_HEAD);
-    len = etherif_packet_recv(ethif, g_packet.ptr, g_packet.length);
-    if (len < 0)
-    {
-        tp_err("Error receiving packet %d\n", len);
+    if (pkt->length < sizeof(eth_hdr_t))
         return;
-    }
 
-    g_packet.length = len;
-    eth_hdr = (eth_hdr_t *)g_packet.ptr;
+    eth_hdr = (eth_hdr_t *)pkt->ptr;
     eth_type = eth_hdr->eth_type;
     for (proto = protocols; proto && proto->eth_type != eth_type;
         proto = proto->next);
@@ -84,8 +79,62 @@ static void ethernet_packet_received(event_t *e, u32 resource_id, u64 timestamp)
         return;
     }
 
-    packet_pull(&g_packet, sizeof(eth_hdr_t));
-    proto->recv(ethif);
+    packet_pull(pkt, sizeof(eth_hdr_t));
+    proto->recv(ethif, pkt);
+}
+
+/* Returns 0 if a frame was queued */
+static int ethernet_packet_fetch(etherif_t *ethif)
+{
+    packet_t *pkt;
+    u8 drop;
+    int len;
+
+    if (!(pkt = packet_alloc()))
+    {
+        /* Consume the frame anyway so the interface is not stalled */
+        tp_info("No packet buffer, dropping frame\n");
+        etherif_packet_recv(ethif, &drop, sizeof(drop));
+        return -1;
+    }
+
+    packet_reset(pkt, PACKET_RESET_HEAD);
+    len = etherif_packet_recv(ethif, pkt->ptr, pkt->length);
+    if (len < 0)
+    {
+        tp_err("Error receiving packet %d\n", len);
+        packet_put(pkt);
+        return -1;
+    }
+
+    pkt->length = len;
+    pkt->netif_id = ethif->netif.id;
+    packet_enqueue(&rx_queue, pkt);
+    return 0;
+}
+
+static void ethernet_packet_received(event_t *e, u32 resource_id, u64 timestamp)
+{
+    etherif_t *ethif;
+    packet_t *pkt;
+    int batch = 0;
+
+    ethif = etherif_get_by_id(RES_MAJ(resource_id));
+
+    tp_debug("Packet received\n");
+
+    /* Fetch the frames waiting on the interface before processing them, so
+     * that a burst is taken off the device while replies are generated.
+     * Keep a buffer free for the replies.
+     */
+    while (!ethernet_packet_fetch(ethif) && ++batch < CONFIG_NET_RX_BATCH &&
+        packet_pool_free_count() > 1 && etherif_packet_pending(ethif));
+
+    while ((pkt = packet_dequeue(&rx_queue)))
+    {
+        ethernet_packet_process(pkt);
+        packet_put(pkt);
+    }
 }
 
 static event_t ethernet_packet_received_event = {
@@ -27,22 +27,28 @@
 
 #include "net/net_types.h"
 #include "net/etherif.h"
+#include "net/packet.h"
 
 typedef struct ether_proto_t ether_proto_t;
 
 struct ether_proto_t {
     ether_proto_t *next;
     u16 eth_type; /* EtherType in network order */
-    void (*recv)(etherif_t *ethif);
+    /* pkt ptr points to the Ethernet payload. The packet is released on
+     * return, take a reference to hold it.
+     */
+    void (*recv)(etherif_t *ethif, packet_t *pkt);
 };
 
 extern const eth_mac_t bcast_mac;
 extern const eth_mac_t zero_mac;
 
-/* - packet ptr is expected to point to the IPv4 payload
+/* - packet ptr is expected to point to the Ethernet payload
  * - eth_type is in network order
+ * - the caller keeps its reference to the packet
  */
-int ethernet_xmit(etherif_t *ethif, const eth_mac_t *dst_mac, u16 eth_type);
+int ethernet_xmit(etherif_t *ethif, packet_t *pkt, const eth_mac_t *dst_mac,
+    u16 eth_type);
 
 /* protocols are assumed to be statically allocated */
 void ethernet_unregister_proto(ether_proto_t *proto);
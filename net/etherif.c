@@ -64,6 +64,81 @@ static u32 etherif_netif_ip_addr_get(netif_t *netif)
     return ipv4_addr(netif_to_etherif(netif));
 }
 
+#ifdef CONFIG_TCP
+static int etherif_netif_proto_connect(netif_t *netif, u8 proto, void *params)
+{
+    tcp_udp_connect_params_t *conn = params;
+
+    if (proto != IP_PROTOCOL_TCP)
+    {
+        tp_err("Protocol %d not supported\n", proto);
+        return -1;
+    }
+
+    return tcp_connect(netif_to_etherif(netif), conn->ip, conn->port);
+}
+
+static int etherif_netif_tcp_read(netif_t *netif, int sock, char *buf,
+    int size)
+{
+    return tcp_read(netif_to_etherif(netif), sock, buf, size);
+}
+
+static int etherif_netif_tcp_write(netif_t *netif, int sock, char *buf,
+    int size)
+{
+    return tcp_write(netif_to_etherif(netif), sock, buf, size);
+}
+
+static int etherif_netif_tcp_listen(netif_t *netif, u16 port)
+{
+    return tcp_listen(netif_to_etherif(netif), port);
+}
+
+static int etherif_netif_tcp_accept(netif_t *netif, int sock)
+{
+    return tcp_accept(netif_to_etherif(netif), sock);
+}
+#endif
+
+#ifdef CONFIG_UDP
+static int etherif_netif_udp_bind(netif_t *netif, u16 port)
+{
+    return udp_netif_bind(netif_to_etherif(netif), port);
+}
+
+static int etherif_netif_udp_sendto(netif_t *netif, int sock, u32 ip, u16 port,
+    char *buf, int size)
+{
+    return udp_netif_sendto(netif_to_etherif(netif), sock, ip, port, buf,
+        size);
+}
+
+static int etherif_netif_udp_recvfrom(netif_t *netif, int sock, char *buf,
+    int size, u32 *ip, u16 *port)
+{
+    return udp_netif_recvfrom(netif_to_etherif(netif), sock, buf, size, ip,
+        port);
+}
+#endif
+
+#if defined(CONFIG_TCP) || defined(CONFIG_UDP)
+static int etherif_netif_disconnect(netif_t *netif, int sock)
+{
+    etherif_t *ethif = netif_to_etherif(netif);
+
+#ifdef CONFIG_UDP
+    if (!udp_netif_close(ethif, sock))
+        return 0;
+#endif
+#ifdef CONFIG_TCP
+    return tcp_close(ethif, sock);
+#else
+    return -1;
+#endif
+}
+#endif
+
 static void etherif_netif_free(netif_t *netif)
 {
     etherif_free(netif_to_etherif(netif));
@@ -75,6 +150,21 @@ static const netif_ops_t etherif_netif_ops = {
     .ip_connect = etherif_netif_ip_connect,
     .ip_disconnect = etherif_netif_ip_disconnect,
     .ip_addr_get = etherif_netif_ip_addr_get,
+#ifdef CONFIG_TCP
+    .proto_connect = etherif_netif_proto_connect,
+    .tcp_read = etherif_netif_tcp_read,
+    .tcp_write = etherif_netif_tcp_write,
+    .tcp_listen = etherif_netif_tcp_listen,
+    .tcp_accept = etherif_netif_tcp_accept,
+#endif
+#ifdef CONFIG_UDP
+    .udp_bind = etherif_netif_udp_bind,
+    .udp_sendto = etherif_netif_udp_sendto,
+    .udp_recvfrom = etherif_netif_udp_recvfrom,
+#endif
+#if defined(CONFIG_TCP) || defined(CONFIG_UDP)
+    .disconnect = etherif_netif_disconnect,
+#endif
     .free = etherif_netif_free,
 };
 
@@ -84,8 +174,39 @@ etherif_t *netif_to_etherif(netif_t *netif)
     return (etherif_t *)netif;
 }
 
+int etherif_sock_alloc(etherif_t *ethif)
+{
+    int idx;
+
+    for (idx = 0; idx < NETIF_MAX_SOCKETS && (ethif->socks & (1 << idx));
+        idx++);
+    if (idx == NETIF_MAX_SOCKETS)
+        return -1;
+
+    ethif->socks |= 1 << idx;
+    return idx;
+}
+
+void etherif_sock_free(etherif_t *ethif, int idx)
+{
+    ethif->socks &= ~(1 << idx);
+}
+
 void etherif_destruct(etherif_t *ethif)
 {
+#ifdef CONFIG_TCP
+    tcp_etherif_uninit(ethif);
+#endif
+#ifdef CONFIG_UDP
+    udp_etherif_uninit(ethif);
+#endif
+#ifdef CONFIG_ARP
+    arp_etherif_uninit(ethif);
+#endif
+#ifdef CONFIG_DHCP_CLIENT
+    dhcpc_stop(ethif);
+#endif
+    ethernet_detach_etherif(ethif);
     netif_unregister(&ethif->netif);
 }
 
@@ -96,7 +217,10 @@ void etherif_construct(etherif_t *ethif, const char *name,
     ethif->ipv4_info = NULL;
     ethif->dhcpc = NULL;
     ethif->udp = NULL;
+    ethif->tcp = NULL;
+    ethif->socks = 0;
 
-    ethernet_attach_etherif(ethif);
+    /* The netif ID is needed for the packet received event */
     netif_register(&ethif->netif, name, &etherif_netif_ops);
+    ethernet_attach_etherif(ethif);
 }
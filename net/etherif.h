@@ -34,6 +34,8 @@ typedef struct {
     int (*link_status)(etherif_t *ethif);
     void (*mac_addr_get)(etherif_t *ethif, eth_mac_t *mac);
     int (*packet_recv)(etherif_t *ethif, u8 *buf, int size);
+    /* Optional. Non zero if another frame can be received right away */
+    int (*packet_pending)(etherif_t *ethif);
     void (*packet_xmit)(etherif_t *ethif, u8 *buf, int size);
     void (*free)(etherif_t *ethif);
 } etherif_ops_t;
@@ -43,7 +45,9 @@ struct etherif_t {
     const etherif_ops_t *ops;
     void *ipv4_info;
     void *udp;
+    void *tcp;
     void *dhcpc;
+    u32 socks; /* Netif socket indices in use by TCP and UDP */
 };
 
 void etherif_destruct(etherif_t *ethif);
@@ -53,6 +57,10 @@ void etherif_construct(etherif_t *ethif, const char *name,
 etherif_t *etherif_get_by_id(int id);
 etherif_t *netif_to_etherif(netif_t *netif);
 
+/* Returns a free netif socket index or -1 */
+int etherif_sock_alloc(etherif_t *ethif);
+void etherif_sock_free(etherif_t *ethif, int idx);
+
 static inline int etherif_link_status(etherif_t *ethif)
 {
     return ethif->ops->link_status(ethif);
@@ -68,6 +76,11 @@ static inline int etherif_packet_recv(etherif_t *ethif, u8 *buf, int size)
     return ethif->ops->packet_recv(ethif, buf, size);
 }
 
+static inline int etherif_packet_pending(etherif_t *ethif)
+{
+    return ethif->ops->packet_pending ? ethif->ops->packet_pending(ethif) : 0;
+}
+
 static inline void etherif_packet_xmit(etherif_t *ethif, u8 *buf, int size)
 {
     ethif->ops->packet_xmit(ethif, buf, size);
@@ -32,47 +32,104 @@
 #define ICMP_ECHO_REPLY 0
 #define ICMP_ECHO_REQUEST 8
 
-static void icmp_echo_req_recv(etherif_t *ethif)
+static icmp_echo_reply_handler_t echo_reply_handler;
+
+static void icmp_echo_req_recv(etherif_t *ethif, packet_t *pkt)
 {
-    icmp_hdr_t *icmph = (icmp_hdr_t *)g_packet.ptr;
+    icmp_hdr_t *icmph = (icmp_hdr_t *)pkt->ptr;
     ip_hdr_t *iph;
     eth_hdr_t *eth_hdr;
-    eth_mac_t *dst_mac;
+    eth_mac_t dst_mac;
     u32 src_addr, dst_addr;
 
     if (!ipv4_addr(ethif))
         return;
 
     /* Trick - fetch IP & Ethernet addresses from the packet */
-    iph = packet_push(&g_packet, sizeof(ip_hdr_t));
+    iph = packet_push(pkt, sizeof(ip_hdr_t));
     src_addr = ntohl(iph->dst_addr);
     dst_addr = ntohl(iph->src_addr);
 
-    eth_hdr = packet_push(&g_packet, sizeof(eth_hdr_t));
-    dst_mac = &eth_hdr->src;
+    eth_hdr = packet_push(pkt, sizeof(eth_hdr_t));
+    dst_mac = eth_hdr->src;
     
-    packet_pull(&g_packet, sizeof(eth_hdr_t));
-    packet_pull(&g_packet, sizeof(ip_hdr_t));
+    packet_pull(pkt, sizeof(eth_hdr_t));
+    packet_pull(pkt, sizeof(ip_hdr_t));
    
-    /* Construct ICMP reply */ 
+    /* Construct ICMP reply in place, only the type/code word changes */ 
+    icmph->checksum = net_csum_update16(icmph->checksum,
+        htons(icmph->type << 8 | icmph->code), htons(ICMP_ECHO_REPLY << 8));
     icmph->type = ICMP_ECHO_REPLY;
     icmph->code = 0;
-    icmph->checksum = net_csum((u16 *)icmph, g_packet.length);
 
-    ipv4_xmit(ethif, dst_mac, IP_PROTOCOL_ICMP, src_addr, dst_addr,
-        g_packet.length);
+    ipv4_xmit(ethif, pkt, &dst_mac, IP_PROTOCOL_ICMP, src_addr, dst_addr,
+        pkt->length);
+}
+
+static void icmp_echo_reply_recv(etherif_t *ethif, packet_t *pkt)
+{
+    icmp_hdr_t *icmph = (icmp_hdr_t *)pkt->ptr;
+    ip_hdr_t *iph = (ip_hdr_t *)(pkt->ptr - sizeof(ip_hdr_t));
+    u32 hdr_data = ntohl(icmph->hdr_data);
+
+    if (!echo_reply_handler)
+        return;
+
+    echo_reply_handler(ethif, ntohl(iph->src_addr), hdr_data >> 16,
+        hdr_data & 0xffff);
+}
+
+int icmp_echo_xmit(etherif_t *ethif, u32 dst_addr, u16 id, u16 seq,
+    int payload_len)
+{
+    icmp_hdr_t *icmph;
+    packet_t *pkt;
+    u8 *data;
+    int i, len = sizeof(icmp_hdr_t) + payload_len, rc = -1;
+
+    if (!ipv4_addr(ethif) || !(pkt = packet_alloc()))
+        return -1;
+
+    if (!(icmph = packet_push(pkt, len)))
+        goto Exit;
+
+    icmph->type = ICMP_ECHO_REQUEST;
+    icmph->code = 0;
+    icmph->checksum = 0;
+    icmph->hdr_data = htonl((u32)id << 16 | seq);
+    for (data = (u8 *)(icmph + 1), i = 0; i < payload_len; i++)
+        data[i] = (u8)i;
+    icmph->checksum = net_csum((u16 *)icmph, len);
+
+    rc = ipv4_xmit(ethif, pkt, NULL, IP_PROTOCOL_ICMP, ipv4_addr(ethif),
+        dst_addr, len);
+
+Exit:
+    packet_put(pkt);
+    return rc;
 }
 
-static void icmp_recv(etherif_t *ethif)
+void icmp_echo_reply_handler_set(icmp_echo_reply_handler_t handler)
 {
-    icmp_hdr_t *icmph = (icmp_hdr_t *)g_packet.ptr;
+    echo_reply_handler = handler;
+}
+
+static void icmp_recv(etherif_t *ethif, packet_t *pkt)
+{
+    icmp_hdr_t *icmph = (icmp_hdr_t *)pkt->ptr;
 
     tp_debug("ICMP packet received\n");
 
+    if (pkt->length < sizeof(icmp_hdr_t))
+        return;
+
     switch (icmph->type)
     {
     case ICMP_ECHO_REQUEST:
-        icmp_echo_req_recv(ethif);
+        icmp_echo_req_recv(ethif, pkt);
+        break;
+    case ICMP_ECHO_REPLY:
+        icmp_echo_reply_recv(ethif, pkt);
         break;
     default:
         tp_warn("unsupported ICMP message type %d\n", icmph->type);
@@ -87,6 +144,7 @@ static ipv4_proto_t icmp_proto = {
 
 void icmp_uninit(void)
 {
+    echo_reply_handler = NULL;
     ipv4_unregister_proto(&icmp_proto);
 }
 
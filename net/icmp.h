@@ -27,6 +27,18 @@
 
 #include "net/etherif.h"
 
+/* Called for echo replies, addresses are in host order */
+typedef void (*icmp_echo_reply_handler_t)(etherif_t *ethif, u32 src_addr,
+    u16 id, u16 seq);
+
+/* Sends an echo request with payload_len bytes of data, the destination is
+ * resolved using ARP. Returns 0 on success.
+ */
+int icmp_echo_xmit(etherif_t *ethif, u32 dst_addr, u16 id, u16 seq,
+    int payload_len);
+/* A single handler is supported, NULL removes it */
+void icmp_echo_reply_handler_set(icmp_echo_reply_handler_t handler);
+
 void icmp_uninit(void);
 void icmp_init(void);
 
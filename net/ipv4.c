@@ -24,6 +24,7 @@
  */
 #include "net/ipv4.h"
 #include "net/ether.h"
+#include "net/arp.h"
 #include "net/net.h"
 #include "net/packet.h"
 #include "net/net_debug.h"
@@ -32,16 +33,17 @@
 static ether_proto_t ipv4_proto;
 static ipv4_proto_t *ipv4_protocols;
 
-int ipv4_xmit(etherif_t *ethif, const eth_mac_t *dst_mac, u8 protocol,
-    u32 src_addr, u32 dst_addr, u16 payload_len)
+int ipv4_xmit(etherif_t *ethif, packet_t *pkt, const eth_mac_t *dst_mac,
+    u8 protocol, u32 src_addr, u32 dst_addr, u16 payload_len)
 {
+    ipv4_info_t *ip_info = ethif->ipv4_info;
     ip_hdr_t *iph;
     u16 tot_len;
 
     tot_len = sizeof(ip_hdr_t) + payload_len;
 
     /* IPv4 Header */
-    if (!(iph = packet_push(&g_packet, sizeof(ip_hdr_t))))
+    if (!(iph = packet_push(pkt, sizeof(ip_hdr_t))))
         return -1;
 
     iph->ver = 4;
@@ -57,7 +59,21 @@ int ipv4_xmit(etherif_t *ethif, const eth_mac_t *dst_mac, u8 protocol,
     iph->dst_addr = htonl(dst_addr);
     iph->checksum = net_csum((u16 *)iph, sizeof(ip_hdr_t));
 
-    return ethernet_xmit(ethif, dst_mac, htons(ETHER_PROTOCOL_IP));
+    if (dst_mac)
+        return ethernet_xmit(ethif, pkt, dst_mac, htons(ETHER_PROTOCOL_IP));
+
+    if (dst_addr == IP_ADDR_BCAST || (ip_info &&
+        dst_addr == (ip_info->ip | ~ip_info->netmask)))
+    {
+        return ethernet_xmit(ethif, pkt, &bcast_mac, htons(ETHER_PROTOCOL_IP));
+    }
+
+#ifdef CONFIG_ARP
+    return arp_resolve_xmit(ethif, pkt, ipv4_next_hop(ethif, dst_addr));
+#else
+    tp_err("IPv4: no way to resolve %s\n", ip_addr_serialize(dst_addr));
+    return -1;
+#endif
 }
 
 static int ipv4_filter(etherif_t *ethif, ip_hdr_t *iph)
@@ -87,16 +103,24 @@ static int ipv4_filter(etherif_t *ethif, ip_hdr_t *iph)
     return 1;
 }
 
-static void ipv4_recv(etherif_t *ethif)
+static void ipv4_recv(etherif_t *ethif, packet_t *pkt)
 {
-    ip_hdr_t *iph = (ip_hdr_t *)g_packet.ptr;
+    ip_hdr_t *iph = (ip_hdr_t *)pkt->ptr;
     ipv4_proto_t *proto;
+    u16 tot_len;
 
     tp_debug("IPv4 packet received\n");
 
-    if (!ipv4_filter(ethif, iph))
+    if (pkt->length < sizeof(ip_hdr_t) || !ipv4_filter(ethif, iph))
+        return;
+
+    tot_len = ntohs(iph->tot_len);
+    if (tot_len < sizeof(ip_hdr_t) || tot_len > pkt->length)
         return;
 
+    /* Drop Ethernet padding */
+    pkt->length = tot_len;
+
     for (proto = ipv4_protocols; proto && proto->protocol != iph->protocol;
         proto = proto->next);
     if (!proto)
@@ -105,8 +129,8 @@ static void ipv4_recv(etherif_t *ethif)
         return;
     }
 
-    packet_pull(&g_packet, sizeof(ip_hdr_t));
-    proto->recv(ethif);
+    packet_pull(pkt, sizeof(ip_hdr_t));
+    proto->recv(ethif, pkt);
 }
 
 void ipv4_unregister_proto(ipv4_proto_t *proto)
@@ -27,6 +27,7 @@
 
 #include "net/net_types.h"
 #include "net/etherif.h"
+#include "net/packet.h"
 
 #define IP_ADDR_ANY 0x00000000
 #define IP_ADDR_BCAST 0xffffffff
@@ -43,14 +44,17 @@ typedef struct ipv4_proto_t ipv4_proto_t;
 struct ipv4_proto_t {
     ipv4_proto_t *next;
     u16 protocol;
-    void (*recv)(etherif_t *ethif);
+    /* pkt ptr points to the IPv4 payload, the IPv4 header precedes it */
+    void (*recv)(etherif_t *ethif, packet_t *pkt);
 };
 
 /* - packet ptr is expected to point to the IPv4 payload
  * - addresses are in host order
+ * - the caller keeps its reference to the packet
+ * - if dst_mac is NULL, the next hop is resolved using ARP
  */
-int ipv4_xmit(etherif_t *ethif, const eth_mac_t *dst_mac, u8 protocol,
-    u32 src_addr, u32 dst_addr, u16 payload_len);
+int ipv4_xmit(etherif_t *ethif, packet_t *pkt, const eth_mac_t *dst_mac,
+    u8 protocol, u32 src_addr, u32 dst_addr, u16 payload_len);
 
 static inline u32 ipv4_addr(etherif_t *ethif)
 {
@@ -58,6 +62,17 @@ static inline u32 ipv4_addr(etherif_t *ethif)
     return ip_info ? ip_info->ip : 0;
 }
 
+/* Host order. Off subnet destinations are reached through the router */
+static inline u32 ipv4_next_hop(etherif_t *ethif, u32 dst_addr)
+{
+    ipv4_info_t *ip_info = ethif->ipv4_info;
+
+    if (!ip_info || !((dst_addr ^ ip_info->ip) & ip_info->netmask))
+        return dst_addr;
+
+    return ip_info->router;
+}
+
 /* protocols are assumed to be statically allocated */
 void ipv4_unregister_proto(ipv4_proto_t *proto);
 void ipv4_register_proto(ipv4_proto_t *proto);
@@ -24,6 +24,7 @@
  */
 #include "net/js_netif.h"
 #include "net/net_utils.h"
+#include "mem/tmalloc.h"
 #include "js/js_utils.h"
 #include "js/js_event.h"
 #include "js/jsapi_decl.h"
@@ -157,19 +158,41 @@ int do_netif_link_status(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
     return 0;
 }
 
+/* Socket index is an optional argument, defaulting to the first socket */
+static int netif_obj_get_sock(obj_t **ret, int argc, obj_t *argv[], int idx,
+    int *sock)
+{
+    *sock = 0;
+    if (argc <= idx || argv[idx] == UNDEF)
+        return 0;
+
+    if (!is_num(argv[idx]))
+        return js_invalid_args(ret);
+
+    *sock = obj_get_int(argv[idx]);
+    if (*sock < 0 || *sock >= NETIF_MAX_SOCKETS)
+        return throw_exception(ret, &S("Invalid socket"));
+
+    return 0;
+}
+
 int do_netif_tcp_connect(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
 {
     netif_t *netif;
     event_t *e;
     u32 ip;
     u16 port;
+    int sock;
     tstr_t ip_str;
+    char *ip_strz;
 
     if (argc != 4)
         return js_invalid_args(ret);
 
     ip_str = obj_get_str(argv[1]);
-    ip = ip_addr_parse(tstr_to_strz(&ip_str), ip_str.len);
+    ip_strz = tstr_to_strz(&ip_str);
+    ip = ip_addr_parse(ip_strz, ip_str.len);
+    tfree(ip_strz);
     tstr_free(&ip_str);
     if (!ip)
         return js_invalid_args(ret);
@@ -183,154 +206,471 @@ int do_netif_tcp_connect(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
     if (!(netif = netif_obj_get_netif(this)))
         return throw_exception(ret, &Sinvalid_netif);
 
+    if ((sock = netif_tcp_connect(netif, ip, port)) < 0)
+        return throw_exception(ret, &S("Failed to connect"));
+
+    /* Listeners of a previous user of this socket are stale */
+    netif_sock_events_clear(netif, sock);
+
     e = js_event_new(argv[3], this, js_event_gen_trigger);
 
-    _event_watch_set(NETIF_RES(netif, NETIF_EVENT_L4_CONNECTED), e, 0, 1);
+    event_watch_set_once(NETIF_SOCK_RES(netif, sock,
+        NETIF_SOCK_EVENT_CONNECTED), e);
 
-    if (netif_tcp_connect(netif, ip, port))
-        return throw_exception(ret, &S("Failed to connect"));
+    *ret = num_new_int(sock);
+    return 0;
+}
 
-    *ret = UNDEF;
+int do_netif_tcp_listen(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    netif_t *netif;
+    event_t *e;
+    u16 port;
+    int sock;
+
+    if (argc != 3)
+        return js_invalid_args(ret);
+
+    if (!(port = (u16)obj_get_int(argv[1])))
+        return js_invalid_args(ret);
+
+    if (!is_function(argv[2]))
+        return throw_exception(ret, &S("Invalid callback"));
+
+    if (!(netif = netif_obj_get_netif(this)))
+        return throw_exception(ret, &Sinvalid_netif);
+
+    if ((sock = netif_tcp_listen(netif, port)) < 0)
+        return throw_exception(ret, &S("Failed to listen"));
+
+    netif_sock_events_clear(netif, sock);
+
+    e = js_event_new(argv[2], this, js_event_gen_trigger);
+
+    event_watch_set(NETIF_SOCK_RES(netif, sock, NETIF_SOCK_EVENT_ACCEPT), e);
+
+    *ret = num_new_int(sock);
     return 0;
 }
 
-int do_netif_tcp_disconnect(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+int do_netif_tcp_accept(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
 {
     netif_t *netif = netif_obj_get_netif(this);
+    int sock, new_sock, rc;
+
+    if (argc != 2)
+        return js_invalid_args(ret);
 
     if (!netif)
         return throw_exception(ret, &Sinvalid_netif);
 
-    netif_tcp_disconnect(netif);
+    if ((rc = netif_obj_get_sock(ret, argc, argv, 1, &sock)))
+        return rc;
 
     *ret = UNDEF;
+    if ((new_sock = netif_tcp_accept(netif, sock)) < 0)
+        return 0;
+
+    netif_sock_events_clear(netif, new_sock);
+    *ret = num_new_int(new_sock);
     return 0;
 }
 
-int do_netif_on_tcp_data(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+int do_netif_tcp_disconnect(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
 {
     netif_t *netif = netif_obj_get_netif(this);
-    event_t *e;
+    int sock, rc;
 
     if (!netif)
         return throw_exception(ret, &Sinvalid_netif);
 
-    *ret = UNDEF;
-    if (argc == 1 || (argc == 2 && argv[1] == UNDEF))
-    {
-        netif_on_event_clear(netif, NETIF_EVENT_TCP_DATA_AVAIL);
-        return 0;
-    }
+    if ((rc = netif_obj_get_sock(ret, argc, argv, 1, &sock)))
+        return rc;
 
-    e = js_event_new(argv[1], this, js_event_gen_trigger);
+    netif_tcp_disconnect(netif, sock);
+    netif_sock_events_clear(netif, sock);
 
-    netif_on_event_set(netif, NETIF_EVENT_TCP_DATA_AVAIL, e);
+    *ret = UNDEF;
     return 0;
 }
 
-int do_netif_on_tcp_disconnect(obj_t **ret, obj_t *this, int argc,
-    obj_t *argv[])
+static int netif_on_sock_event(obj_t **ret, obj_t *this, int argc,
+    obj_t *argv[], netif_sock_event_t event, int once)
 {
     netif_t *netif = netif_obj_get_netif(this);
     event_t *e;
+    int sock, rc;
 
     if (!netif)
         return throw_exception(ret, &Sinvalid_netif);
 
+    if ((rc = netif_obj_get_sock(ret, argc, argv, 2, &sock)))
+        return rc;
+
     *ret = UNDEF;
-    if (argc == 1 || (argc == 2 && argv[1] == UNDEF))
+    if (argc == 1 || argv[1] == UNDEF)
     {
-        netif_on_event_clear(netif, NETIF_EVENT_TCP_DISCONNECTED);
+        netif_sock_on_event_clear(netif, sock, event);
         return 0;
     }
 
+    if (!is_function(argv[1]))
+        return throw_exception(ret, &S("Invalid callback"));
+
     e = js_event_new(argv[1], this, js_event_gen_trigger);
 
-    _event_watch_set(NETIF_RES(netif, NETIF_EVENT_TCP_DISCONNECTED), e, 0, 1);
+    _event_watch_set(NETIF_SOCK_RES(netif, sock, event), e, 0, once);
     return 0;
 }
 
-static int netif_tcp_write_dump(void *ctx, char *buf, int len)
+int do_netif_on_tcp_data(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
 {
-    return netif_tcp_write(ctx, buf, len);
+    return netif_on_sock_event(ret, this, argc, argv,
+        NETIF_SOCK_EVENT_DATA_AVAIL, 0);
 }
 
-int do_netif_tcp_write(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+int do_netif_on_tcp_writable(obj_t **ret, obj_t *this, int argc,
+    obj_t *argv[])
 {
-    netif_t *netif = netif_obj_get_netif(this);
+    return netif_on_sock_event(ret, this, argc, argv,
+        NETIF_SOCK_EVENT_WRITABLE, 0);
+}
 
-    if (argc != 2)
-        return js_invalid_args(ret);
+int do_netif_on_tcp_disconnect(obj_t **ret, obj_t *this, int argc,
+    obj_t *argv[])
+{
+    return netif_on_sock_event(ret, this, argc, argv,
+        NETIF_SOCK_EVENT_DISCONNECTED, 1);
+}
 
-    if (!netif)
-        return throw_exception(ret, &Sinvalid_netif);
+typedef struct {
+    netif_t *netif;
+    int sock;
+} netif_sock_ctx_t;
 
-    *ret = UNDEF;
+typedef int (*netif_write_fn_t)(void *ctx, char *buf, int len);
+
+static int netif_tcp_write_dump(void *ctx, char *buf, int len)
+{
+    netif_sock_ctx_t *c = ctx;
 
-    if (is_string(argv[1]))
+    return netif_tcp_write(c->netif, c->sock, buf, len);
+}
+
+/* Returns the number of bytes accepted, or -1 on error */
+static int netif_write_obj(obj_t **ret, netif_write_fn_t write_fn, void *ctx,
+    obj_t *o)
+{
+    if (is_string(o))
     {
-        string_t *s = to_string(argv[1]);
+        string_t *s = to_string(o);
 
-        __tstr_dump(&s->value, 0, s->value.len, netif_tcp_write_dump, netif);
-        return 0;
+        return __tstr_dump(&s->value, 0, s->value.len, write_fn, ctx);
     }
     
-    if (is_num(argv[1]))
+    if (is_num(o))
     {
-	int n = obj_get_int(argv[1]);
+	int n = obj_get_int(o);
 	char b;
 
 	if (n < 0 || n > 255)
-	    return throw_exception(ret, &S("Value must be in [0-255] range"));
+	{
+	    throw_exception(ret, &S("Value must be in [0-255] range"));
+	    return -1;
+	}
 
 	b = (char)n;
-	netif_tcp_write(netif, &b, 1);
-	return 0;
+	return write_fn(ctx, &b, 1);
     }
     
-    if (is_array(argv[1]) || is_array_buffer_view(argv[1]))
+    if (is_array(o) || is_array_buffer_view(o))
     {
 	array_iter_t iter;
-	int rc = 0;
+	int len, total = 0;
 
-	array_iter_init(&iter, argv[1], 0);
+	array_iter_init(&iter, o, 0);
 	while (array_iter_next(&iter))
 	{
-	    obj_t *new_argv[2];
-
-	    new_argv[0] = argv[0];
-	    new_argv[1] = iter.obj;
-
-	    if ((rc = do_netif_tcp_write(ret, this, 2, new_argv)))
+	    if ((len = netif_write_obj(ret, write_fn, ctx, iter.obj)) < 0)
+	    {
+	        total = -1;
 		break;
+	    }
+
+	    total += len;
+	    /* Backpressure, the rest has to wait for onTCPWritable */
+	    if (!len)
+	        break;
 	}
 	array_iter_uninit(&iter);
-	return rc;
+	return total;
     }
 
     /* Unknown parameter type */
-    return js_invalid_args(ret);
+    js_invalid_args(ret);
+    return -1;
+}
+
+int do_netif_tcp_write(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    netif_sock_ctx_t c = { .netif = netif_obj_get_netif(this) };
+    int len, rc;
+
+    if (argc != 2 && argc != 3)
+        return js_invalid_args(ret);
+
+    if (!c.netif)
+        return throw_exception(ret, &Sinvalid_netif);
+
+    if ((rc = netif_obj_get_sock(ret, argc, argv, 2, &c.sock)))
+        return rc;
+
+    *ret = UNDEF;
+    if ((len = netif_write_obj(ret, netif_tcp_write_dump, &c, argv[1])) < 0)
+    {
+        if (*ret == UNDEF)
+            return throw_exception(ret, &S("Failed to write"));
+        return COMPLETION_THROW;
+    }
+
+    *ret = num_new_int(len);
+    return 0;
 }
 
 static int netif_tcp_read_fill_fn(void *ctx, char *buf, int size)
 {
-    return netif_tcp_read(ctx, buf, size);
+    netif_sock_ctx_t *c = ctx;
+
+    return netif_tcp_read(c->netif, c->sock, buf, size);
 }
 
+#define NETIF_TCP_READ_SIZE 256
+
 int do_netif_tcp_read(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
 {
-    netif_t *netif = netif_obj_get_netif(this);
+    netif_sock_ctx_t c = { .netif = netif_obj_get_netif(this) };
     tstr_t data;
+    int len, rc;
 
-    if (argc != 1)
+    if (argc > 2)
         return js_invalid_args(ret);
 
-    if (!netif)
+    if (!c.netif)
         return throw_exception(ret, &Sinvalid_netif);
 
-    /* XXX: read as much as possible */
-    tstr_init_alloc_data(&data, 64);
-    data.len = tstr_fill(&data, 64, netif_tcp_read_fill_fn, netif);
+    if ((rc = netif_obj_get_sock(ret, argc, argv, 1, &c.sock)))
+        return rc;
+
+    tstr_init_alloc_data(&data, NETIF_TCP_READ_SIZE);
+    len = tstr_fill(&data, NETIF_TCP_READ_SIZE, netif_tcp_read_fill_fn, &c);
+    data.len = len < 0 ? 0 : len;
     *ret = string_new(data);
     return 0;
 }
+
+int do_netif_udp_bind(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    netif_t *netif = netif_obj_get_netif(this);
+    int port = 0, sock;
+
+    if (argc > 2)
+        return js_invalid_args(ret);
+
+    if (!netif)
+        return throw_exception(ret, &Sinvalid_netif);
+
+    if (argc == 2 && argv[1] != UNDEF)
+    {
+        if (!is_num(argv[1]))
+            return js_invalid_args(ret);
+
+        port = obj_get_int(argv[1]);
+        if (port < 0 || port > 65535)
+            return js_invalid_args(ret);
+    }
+
+    if ((sock = netif_udp_bind(netif, (u16)port)) < 0)
+        return throw_exception(ret, &S("Failed to bind"));
+
+    netif_sock_events_clear(netif, sock);
+    *ret = num_new_int(sock);
+    return 0;
+}
+
+/* Largest payload of a datagram fitting an Ethernet frame */
+#define NETIF_UDP_MAX_SIZE 1472
+
+typedef struct {
+    char *buf;
+    int len;
+} netif_udp_buf_t;
+
+static int netif_udp_buf_dump(void *ctx, char *buf, int len)
+{
+    netif_udp_buf_t *b = ctx;
+
+    if (b->len + len > NETIF_UDP_MAX_SIZE)
+        return -1;
+
+    memcpy(b->buf + b->len, buf, len);
+    b->len += len;
+    return len;
+}
+
+int do_netif_udp_send(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    netif_t *netif = netif_obj_get_netif(this);
+    netif_udp_buf_t b = {};
+    tstr_t ip_str;
+    char *ip_strz;
+    u32 ip;
+    int port, sock, rc;
+
+    if (argc != 4 && argc != 5)
+        return js_invalid_args(ret);
+
+    if (!netif)
+        return throw_exception(ret, &Sinvalid_netif);
+
+    ip_str = obj_get_str(argv[2]);
+    ip_strz = tstr_to_strz(&ip_str);
+    ip = ip_addr_parse(ip_strz, ip_str.len);
+    tfree(ip_strz);
+    tstr_free(&ip_str);
+    if (!ip)
+        return js_invalid_args(ret);
+
+    port = obj_get_int(argv[3]);
+    if (port <= 0 || port > 65535)
+        return js_invalid_args(ret);
+
+    if ((rc = netif_obj_get_sock(ret, argc, argv, 4, &sock)))
+        return rc;
+
+    /* The datagram is sent in one piece, so the data is flattened first */
+    b.buf = tmalloc(NETIF_UDP_MAX_SIZE, "UDP datagram");
+    *ret = UNDEF;
+    if (netif_write_obj(ret, netif_udp_buf_dump, &b, argv[1]) < 0)
+    {
+        tfree(b.buf);
+        if (*ret == UNDEF)
+            return throw_exception(ret, &S("Datagram too large"));
+        return COMPLETION_THROW;
+    }
+
+    rc = netif_udp_sendto(netif, sock, ip, (u16)port, b.buf, b.len);
+    tfree(b.buf);
+    if (rc < 0)
+        return throw_exception(ret, &S("Failed to send"));
+
+    *ret = num_new_int(rc);
+    return 0;
+}
+
+/* Datagrams delivered per event, the rest wait for the next one */
+#define NETIF_UDP_BATCH 16
+
+static void netif_on_udp_message_cb(event_t *e, u32 resource_id,
+    u64 timestamp)
+{
+    obj_t *o, *argv[4], *this, *func, *ip_obj = NULL;
+    netif_t *netif;
+    int sock = RES_MAJ(resource_id) & (NETIF_MAX_SOCKETS - 1), len, n;
+    u32 ip, last_ip = 0;
+    u16 port;
+    tstr_t data;
+
+    this = js_event_get_this(e);
+    if (!(netif = netif_obj_get_netif(this)))
+    {
+        obj_put(this);
+        return;
+    }
+
+    argv[0] = func = js_event_get_func(e);
+    for (n = 0; n < NETIF_UDP_BATCH; n++)
+    {
+        if ((len = netif_udp_recvfrom(netif, sock, NULL, 0, &ip, &port)) < 0)
+            break;
+
+        /* Allocated to the exact size and handed over to the string */
+        tstr_init_alloc_data(&data, len);
+        if ((len = netif_udp_recvfrom(netif, sock, TPTR(&data), len, &ip,
+            &port)) < 0)
+        {
+            tstr_free(&data);
+            break;
+        }
+
+        data.len = len;
+        /* Bursts usually come from a single peer */
+        if (!ip_obj || ip != last_ip)
+        {
+            tstr_t s;
+
+            obj_put(ip_obj);
+            tstr_init_copy_string(&s, ip_addr_serialize(ip));
+            ip_obj = string_new(s);
+            last_ip = ip;
+        }
+
+        argv[1] = string_new(data);
+        argv[2] = ip_obj;
+        argv[3] = num_new_int(port);
+
+        function_call(&o, this, 4, argv);
+
+        obj_put(argv[1]);
+        obj_put(argv[3]);
+        obj_put(o);
+    }
+
+    obj_put(ip_obj);
+    obj_put(func);
+    obj_put(this);
+}
+
+int do_netif_on_udp_message(obj_t **ret, obj_t *this, int argc,
+    obj_t *argv[])
+{
+    netif_t *netif = netif_obj_get_netif(this);
+    event_t *e;
+    int sock, rc;
+
+    if (!netif)
+        return throw_exception(ret, &Sinvalid_netif);
+
+    if ((rc = netif_obj_get_sock(ret, argc, argv, 2, &sock)))
+        return rc;
+
+    *ret = UNDEF;
+    netif_sock_on_event_clear(netif, sock, NETIF_SOCK_EVENT_DATA_AVAIL);
+    if (argc == 1 || argv[1] == UNDEF)
+        return 0;
+
+    if (!is_function(argv[1]))
+        return throw_exception(ret, &S("Invalid callback"));
+
+    e = js_event_new(argv[1], this, netif_on_udp_message_cb);
+
+    netif_sock_on_event_set(netif, sock, NETIF_SOCK_EVENT_DATA_AVAIL, e);
+    return 0;
+}
+
+int do_netif_udp_close(obj_t **ret, obj_t *this, int argc, obj_t *argv[])
+{
+    netif_t *netif = netif_obj_get_netif(this);
+    int sock, rc;
+
+    if (!netif)
+        return throw_exception(ret, &Sinvalid_netif);
+
+    if ((rc = netif_obj_get_sock(ret, argc, argv, 1, &sock)))
+        return rc;
+
+    netif_tcp_disconnect(netif, sock);
+    netif_sock_events_clear(netif, sock);
+
+    *ret = UNDEF;
+    return 0;
+}
@@ -27,10 +27,14 @@
 #include "net/arp.h"
 #include "net/ipv4.h"
 #include "net/udp.h"
+#include "net/tcp.h"
 
 void net_uninit(void)
 {
     tp_out("NET Uninit\n");
+#ifdef CONFIG_TCP
+    tcp_uninit();
+#endif
 #ifdef CONFIG_UDP
     udp_uninit();
 #endif
@@ -43,11 +47,17 @@ void net_uninit(void)
 #ifdef CONFIG_ARP
     arp_uninit();
 #endif
+#ifdef CONFIG_PACKET
+    packet_uninit();
+#endif
 }
 
 void net_init(void)
 {
     tp_out("NET Init\n");
+#ifdef CONFIG_PACKET
+    packet_init();
+#endif
 #ifdef CONFIG_ARP
     arp_init();
 #endif
@@ -60,4 +70,7 @@ void net_init(void)
 #ifdef CONFIG_UDP
     udp_init();
 #endif
+#ifdef CONFIG_TCP
+    tcp_init();
+#endif
 }
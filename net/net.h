@@ -51,6 +51,9 @@
 #ifdef CONFIG_UDP
 #include "net/udp.h"
 #endif
+#ifdef CONFIG_TCP
+#include "net/tcp.h"
+#endif
 #ifdef CONFIG_DHCP_CLIENT
 #include "net/dhcpc.h"
 #endif
@@ -118,6 +118,24 @@ typedef struct __attribute__((packed)) {
     u16 checksum;
 } udp_hdr_t;
 
+typedef struct __attribute__((packed)) {
+    u16 src_port;
+    u16 dst_port;
+    u32 seq;
+    u32 ack;
+#ifdef CONFIG_BIG_ENDIAN_BITFIELD
+    u8 data_off : 4;
+    u8 reserved : 4;
+#else
+    u8 reserved : 4;
+    u8 data_off : 4;
+#endif
+    u8 flags;
+    u16 window;
+    u16 checksum;
+    u16 urg_ptr;
+} tcp_hdr_t;
+
 typedef struct __attribute__((packed)) {
     u8 type;
     u8 code;
@@ -22,22 +22,136 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include <string.h> /* memcpy */
 #include "net/net_utils.h"
 #include "util/tprintf.h"
 
-u16 net_csum(u16 *addr, u16 byte_len)
+/* Words are summed in memory order, values of a lone byte at an even or odd
+ * offset of a 16 bit word.
+ */
+#ifdef CONFIG_BIG_ENDIAN
+#define CSUM_EVEN_BYTE(b) ((u32)(b) << 8)
+#define CSUM_ODD_BYTE(b) ((u32)(b))
+#else
+#define CSUM_EVEN_BYTE(b) ((u32)(b))
+#define CSUM_ODD_BYTE(b) ((u32)(b) << 8)
+#endif
+
+typedef u16 __attribute__((__may_alias__)) csum_u16_t;
+typedef u32 __attribute__((__may_alias__)) csum_u32_t;
+
+static u32 csum_fold64(u64 acc)
 {
-    u32 sum = 0;
+    acc = (acc & 0xffffffff) + (acc >> 32);
+    acc = (acc & 0xffffffff) + (acc >> 32);
+    acc = (acc & 0xffff) + (acc >> 16);
+    acc = (acc & 0xffff) + (acc >> 16);
+    return (u32)acc;
+}
+
+/* 32 bit words are accumulated in 64 bits, so carries are only folded once
+ * at the end.
+ */
+u32 net_csum_partial(const void *buf, int len, u32 sum)
+{
+    const u8 *p = buf;
+    u64 acc = sum;
+    u32 res;
+    int odd;
 
-    for (; byte_len > 1; byte_len -= 2)
-        sum += *addr++;
+    if (len <= 0)
+        return sum;
 
-    if (byte_len)
-        sum += *(u8 *)addr;
-    while (sum >> 16)
-        sum = (sum & 0xffff) + (sum >> 16);
+    /* Sum an odd address as if it was preceded by a zero byte, and swap
+     * the result back.
+     */
+    if ((odd = (uint_ptr_t)p & 1))
+    {
+        acc = CSUM_ODD_BYTE(*p++);
+        len--;
+    }
+
+    if (len >= 2 && ((uint_ptr_t)p & 2))
+    {
+        acc += *(const csum_u16_t *)p;
+        p += 2;
+        len -= 2;
+    }
+
+    for (; len >= 16; len -= 16, p += 16)
+    {
+        const csum_u32_t *w = (const csum_u32_t *)p;
+
+        acc += (u64)w[0] + w[1] + w[2] + w[3];
+    }
+
+    for (; len >= 4; len -= 4, p += 4)
+        acc += *(const csum_u32_t *)p;
+
+    if (len >= 2)
+    {
+        acc += *(const csum_u16_t *)p;
+        p += 2;
+        len -= 2;
+    }
 
-    return (u16)~sum;
+    if (len)
+        acc += CSUM_EVEN_BYTE(*p);
+
+    res = csum_fold64(acc);
+    if (odd)
+    {
+        res = ((res & 0xff) << 8) | (res >> 8);
+        res = csum_fold64((u64)res + sum);
+    }
+
+    return res;
+}
+
+u32 net_csum_copy(void *dst, const void *src, int len, u32 sum)
+{
+    u8 *d = dst;
+    const u8 *s = src;
+    u64 acc = sum;
+    u32 w[4];
+    u16 h;
+
+    for (; len >= 16; len -= 16, s += 16, d += 16)
+    {
+        memcpy(w, s, 16);
+        memcpy(d, w, 16);
+        acc += (u64)w[0] + w[1] + w[2] + w[3];
+    }
+
+    for (; len >= 4; len -= 4, s += 4, d += 4)
+    {
+        memcpy(w, s, 4);
+        memcpy(d, w, 4);
+        acc += w[0];
+    }
+
+    if (len >= 2)
+    {
+        memcpy(&h, s, 2);
+        memcpy(d, &h, 2);
+        acc += h;
+        s += 2;
+        d += 2;
+        len -= 2;
+    }
+
+    if (len)
+    {
+        *d = *s;
+        acc += CSUM_EVEN_BYTE(*s);
+    }
+
+    return csum_fold64(acc);
+}
+
+u16 net_csum(u16 *addr, u16 byte_len)
+{
+    return net_csum_fold(net_csum_partial(addr, byte_len, 0));
 }
 
 u32 ip_addr_parse(char *buf, int len)
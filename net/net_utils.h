@@ -27,7 +27,39 @@
 
 #include "net/net_types.h"
 
+/* Internet checksum (RFC 1071) helpers. Partial sums are 16 bit ones'
+ * complement sums in host byte order, all but the last buffer summed into
+ * a partial sum must have an even length.
+ */
+u32 net_csum_partial(const void *buf, int len, u32 sum);
+/* Sum 'len' bytes while copying them from 'src' to 'dst' */
+u32 net_csum_copy(void *dst, const void *src, int len, u32 sum);
+
+static inline u16 net_csum_fold(u32 sum)
+{
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return (u16)~sum;
+}
+
 u16 net_csum(u16 *addr, u16 byte_len);
+
+/* RFC 1624 incremental update of checksum 'csum' when a 16 bit field
+ * covered by it changes from 'old' to 'new'. Values are as found in the
+ * packet, e.g. a TTL/protocol pair or half an IPv4 address.
+ */
+static inline u16 net_csum_update16(u16 csum, u16 old, u16 new)
+{
+    return net_csum_fold((u16)~csum + (u16)~old + new);
+}
+
+static inline u16 net_csum_update32(u16 csum, u32 old, u32 new)
+{
+    return net_csum_fold((u16)~csum + (u16)~old + (u16)~(old >> 16) +
+        (new & 0xffff) + (new >> 16));
+}
+
 /* IPs are in host order */
 u32 ip_addr_parse(char *buf, int len);
 char *ip_addr_serialize(u32 ip);
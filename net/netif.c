@@ -26,7 +26,6 @@
 #include "util/debug.h"
 
 static netif_t *netifs;
-static int netifs_last_id;
 
 netif_t *netif_get_by_id(int id)
 {
@@ -37,10 +36,30 @@ netif_t *netif_get_by_id(int id)
     return ret;
 }
 
+void netif_sock_events_clear(netif_t *netif, int sock)
+{
+    netif_sock_event_t event;
+
+    for (event = NETIF_SOCK_EVENT_FIRST; event < NETIF_SOCK_EVENT_COUNT;
+        event++)
+    {
+        netif_sock_on_event_clear(netif, sock, event);
+    }
+}
+
+void netif_sock_disconnected(netif_t *netif, int sock)
+{
+    netif_sock_on_event_clear(netif, sock, NETIF_SOCK_EVENT_CONNECTED);
+    netif_sock_on_event_clear(netif, sock, NETIF_SOCK_EVENT_DATA_AVAIL);
+    netif_sock_on_event_clear(netif, sock, NETIF_SOCK_EVENT_WRITABLE);
+    netif_sock_event_trigger(netif, sock, NETIF_SOCK_EVENT_DISCONNECTED);
+}
+
 void netif_unregister(netif_t *netif)
 {
     netif_event_t event;
     netif_t **iter;
+    int sock;
 
     for (iter = &netifs; *iter && *iter != netif; iter = &(*iter)->next);
     tp_assert(*iter);
@@ -49,13 +68,29 @@ void netif_unregister(netif_t *netif)
     /* Remove events */
     for (event = NETIF_EVENT_FIRST; event < NETIF_EVENT_COUNT; event++)
         event_watch_del_by_resource(NETIF_RES(netif, event));
+    for (sock = 0; sock < NETIF_MAX_SOCKETS; sock++)
+        netif_sock_events_clear(netif, sock);
 }
 
 void netif_register(netif_t *netif, const char *name, const netif_ops_t *ops)
 {
+    netif_t *iter;
+    int id;
+
+    /* Take the lowest free id, so ids keep fitting socket resources however
+     * many netifs come and go.
+     */
+    for (id = 0; ; id++)
+    {
+        for (iter = netifs; iter && iter->id != id; iter = iter->next);
+        if (!iter)
+            break;
+    }
+    tp_assert(id < NETIF_MAX_NETIFS);
+
     netif->name = name;
     netif->ops = ops;
-    netif->id = netifs_last_id++;
+    netif->id = id;
     netif->next = netifs;
     netifs = netif;
 }
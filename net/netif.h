@@ -36,15 +36,37 @@ typedef enum {
     NETIF_EVENT_PACKET_RECEIVED = 2,
     NETIF_EVENT_PACKET_XMITTED = 3,
     NETIF_EVENT_IPV4_CONNECTED = 4,
-    NETIF_EVENT_L4_CONNECTED = 5,
-    NETIF_EVENT_TCP_DATA_AVAIL = 6,
-    NETIF_EVENT_TCP_DISCONNECTED = 7,
     NETIF_EVENT_COUNT
 } netif_event_t;
 
 #define NETIF_RES(netif, event) \
     RES(NETIF_RESOURCE_ID_BASE, (netif)->id, event)
 
+/* Per socket events */
+typedef enum {
+    NETIF_SOCK_EVENT_FIRST = 0,
+    NETIF_SOCK_EVENT_CONNECTED = 0,
+    NETIF_SOCK_EVENT_DATA_AVAIL = 1,
+    NETIF_SOCK_EVENT_WRITABLE = 2,
+    NETIF_SOCK_EVENT_DISCONNECTED = 3,
+    NETIF_SOCK_EVENT_ACCEPT = 4, /* Listening socket has a new connection */
+    NETIF_SOCK_EVENT_COUNT
+} netif_sock_event_t;
+
+/* Sockets are identified by a per netif index. The index is encoded
+ * together with the netif id in the resource major.
+ */
+#define NETIF_SOCK_BITS 4
+#define NETIF_MAX_SOCKETS (1 << NETIF_SOCK_BITS)
+/* Netif ids that fit in the resource major above the socket index. Only 8
+ * on 16 bit targets.
+ */
+#define NETIF_MAX_NETIFS ((RES_MAJ_MASK + 1) >> NETIF_SOCK_BITS)
+
+#define NETIF_SOCK_RES(netif, sock, event) \
+    RES(NETIF_SOCK_RESOURCE_ID_BASE, \
+        ((netif)->id << NETIF_SOCK_BITS) | (sock), event)
+
 typedef struct {
     u32 ip;
     u16 port;
@@ -57,11 +79,36 @@ typedef struct {
     int (*link_status)(netif_t *netif);
     int (*ip_connect)(netif_t *netif);
     void (*ip_disconnect)(netif_t *netif);
-    /* Addresses in host order */
+    /* Addresses in host order.
+     * Returns the socket index or -1 on error. Completion is signaled
+     * using NETIF_SOCK_EVENT_CONNECTED/DISCONNECTED.
+     */
     int (*proto_connect)(netif_t *netif, u8 proto, void *params);
-    int (*tcp_read)(netif_t *netif, char *buf, int size);
-    int (*tcp_write)(netif_t *netif, char *buf, int size);
-    int (*disconnect)(netif_t *netif);
+    int (*tcp_read)(netif_t *netif, int sock, char *buf, int size);
+    /* Returns the number of bytes accepted. If less than size, wait for
+     * NETIF_SOCK_EVENT_WRITABLE before writing more.
+     */
+    int (*tcp_write)(netif_t *netif, int sock, char *buf, int size);
+    int (*disconnect)(netif_t *netif, int sock);
+    /* Optional. Returns the listening socket index or -1 on error */
+    int (*tcp_listen)(netif_t *netif, u16 port);
+    /* Returns the index of an established connection or -1 if none */
+    int (*tcp_accept)(netif_t *netif, int sock);
+    /* Optional. UDP sockets share the index space of TCP sockets and are
+     * closed using disconnect. Port 0 selects a free port.
+     * Returns the socket index or -1 on error. NETIF_SOCK_EVENT_DATA_AVAIL
+     * is triggered when datagrams are queued.
+     */
+    int (*udp_bind)(netif_t *netif, u16 port);
+    /* Returns size or -1 on error */
+    int (*udp_sendto)(netif_t *netif, int sock, u32 ip, u16 port, char *buf,
+        int size);
+    /* Dequeues a single datagram, truncated to size. Returns its length or
+     * -1 if none is queued. If buf is NULL, the length of the next datagram
+     * is returned without dequeuing it.
+     */
+    int (*udp_recvfrom)(netif_t *netif, int sock, char *buf, int size,
+        u32 *ip, u16 *port);
     u32 (*ip_addr_get)(netif_t *netif);
     void (*free)(netif_t *netif);
 } netif_ops_t;
@@ -102,19 +149,63 @@ static inline int netif_tcp_connect(netif_t *netif, u32 ip, u16 port)
     return netif->ops->proto_connect(netif, IP_PROTOCOL_TCP, &conn);
 }
 
-static inline int netif_tcp_read(netif_t *netif, char *buf, int size)
+static inline int netif_tcp_read(netif_t *netif, int sock, char *buf,
+    int size)
 {
-    return netif->ops->tcp_read(netif, buf, size);
+    return netif->ops->tcp_read(netif, sock, buf, size);
 }
 
-static inline int netif_tcp_write(netif_t *netif, char *buf, int size)
+static inline int netif_tcp_write(netif_t *netif, int sock, char *buf,
+    int size)
 {
-    return netif->ops->tcp_write(netif, buf, size);
+    return netif->ops->tcp_write(netif, sock, buf, size);
 }
 
-static inline int netif_tcp_disconnect(netif_t *netif)
+static inline int netif_tcp_disconnect(netif_t *netif, int sock)
 {
-    return netif->ops->disconnect(netif);
+    return netif->ops->disconnect(netif, sock);
+}
+
+static inline int netif_tcp_listen(netif_t *netif, u16 port)
+{
+    if (!netif->ops->tcp_listen)
+        return -1;
+
+    return netif->ops->tcp_listen(netif, port);
+}
+
+static inline int netif_tcp_accept(netif_t *netif, int sock)
+{
+    if (!netif->ops->tcp_accept)
+        return -1;
+
+    return netif->ops->tcp_accept(netif, sock);
+}
+
+static inline int netif_udp_bind(netif_t *netif, u16 port)
+{
+    if (!netif->ops->udp_bind)
+        return -1;
+
+    return netif->ops->udp_bind(netif, port);
+}
+
+static inline int netif_udp_sendto(netif_t *netif, int sock, u32 ip, u16 port,
+    char *buf, int size)
+{
+    if (!netif->ops->udp_sendto)
+        return -1;
+
+    return netif->ops->udp_sendto(netif, sock, ip, port, buf, size);
+}
+
+static inline int netif_udp_recvfrom(netif_t *netif, int sock, char *buf,
+    int size, u32 *ip, u16 *port)
+{
+    if (!netif->ops->udp_recvfrom)
+        return -1;
+
+    return netif->ops->udp_recvfrom(netif, sock, buf, size, ip, port);
 }
 
 static inline u32 netif_ip_addr_get(netif_t *netif)
@@ -143,6 +234,31 @@ static inline void netif_event_trigger(netif_t *netif, netif_event_t event)
     event_watch_trigger(NETIF_RES(netif, event));
 }
 
+static inline void netif_sock_on_event_set(netif_t *netif, int sock,
+    netif_sock_event_t event, event_t *ev)
+{
+    event_watch_set(NETIF_SOCK_RES(netif, sock, event), ev);
+}
+
+static inline void netif_sock_on_event_clear(netif_t *netif, int sock,
+    netif_sock_event_t event)
+{
+    event_watch_del_by_resource(NETIF_SOCK_RES(netif, sock, event));
+}
+
+static inline void netif_sock_event_trigger(netif_t *netif, int sock,
+    netif_sock_event_t event)
+{
+    event_watch_trigger(NETIF_SOCK_RES(netif, sock, event));
+}
+
+/* Remove all event listeners of a closed socket */
+void netif_sock_events_clear(netif_t *netif, int sock);
+/* Called by drivers when the peer closed the connection or it failed.
+ * Only the disconnect listeners remain.
+ */
+void netif_sock_disconnected(netif_t *netif, int sock);
+
 netif_t *netif_get_by_id(int id);
 void netif_register(netif_t *netif, const char *name, const netif_ops_t *ops);
 void netif_unregister(netif_t *netif);
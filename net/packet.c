@@ -24,11 +24,82 @@
  */
 #include "net/packet.h"
 
-static u8 packet_buf[NET_PACKET_SIZE];
-
-packet_t g_packet = {
-    .head = packet_buf,
-    .ptr = packet_buf,
-    .tail = packet_buf + sizeof(packet_buf),
-    .length = sizeof(packet_buf),
-};
+typedef struct {
+    packet_t pkt;
+    u8 buf[NET_PACKET_SIZE];
+} packet_buf_t;
+
+static packet_buf_t packet_pool[CONFIG_NET_PACKET_POOL_SIZE];
+static packet_t *free_packets;
+static int free_count;
+
+packet_t *packet_alloc(void)
+{
+    packet_t *pkt;
+
+    if (!(pkt = free_packets))
+    {
+        tp_debug("Packet pool exhausted\n");
+        return NULL;
+    }
+
+    free_packets = pkt->next;
+    free_count--;
+
+    pkt->next = NULL;
+    pkt->refcnt = 1;
+    pkt->netif_id = -1;
+    packet_reset(pkt, PACKET_RESET_TAIL);
+    return pkt;
+}
+
+void packet_put(packet_t *pkt)
+{
+    tp_assert(pkt->refcnt > 0);
+
+    if (--pkt->refcnt)
+        return;
+
+    pkt->next = free_packets;
+    free_packets = pkt;
+    free_count++;
+}
+
+int packet_pool_free_count(void)
+{
+    return free_count;
+}
+
+void packet_queue_purge(packet_queue_t *q)
+{
+    packet_t *pkt;
+
+    while ((pkt = packet_dequeue(q)))
+        packet_put(pkt);
+}
+
+void packet_uninit(void)
+{
+    if (free_count != CONFIG_NET_PACKET_POOL_SIZE)
+    {
+        tp_warn("%d packets were not released\n",
+            CONFIG_NET_PACKET_POOL_SIZE - free_count);
+    }
+}
+
+void packet_init(void)
+{
+    int i;
+
+    free_packets = NULL;
+    for (i = 0; i < CONFIG_NET_PACKET_POOL_SIZE; i++)
+    {
+        packet_t *pkt = &packet_pool[i].pkt;
+
+        pkt->head = packet_pool[i].buf;
+        pkt->tail = pkt->head + NET_PACKET_SIZE;
+        pkt->next = free_packets;
+        free_packets = pkt;
+    }
+    free_count = CONFIG_NET_PACKET_POOL_SIZE;
+}
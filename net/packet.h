@@ -29,18 +29,83 @@
 #include "util/tp_types.h"
 #include "util/debug.h"
 
-typedef struct {
+typedef struct packet_t packet_t;
+
+struct packet_t {
+    packet_t *next; /* Free list / queue link */
     u8 *head;
     u8 *tail;
     u8 *ptr;
     int length;
-} packet_t;
+    int refcnt;
+    int netif_id; /* Receiving interface */
+};
+
+typedef struct {
+    packet_t *head;
+    packet_t *tail;
+    int count;
+} packet_queue_t;
+
+/* Sized for a full Ethernet frame */
+#define NET_PACKET_SIZE CONFIG_NET_PACKET_SIZE
+
+/* Packets come from a fixed pool. Returns NULL if the pool is exhausted,
+ * otherwise a packet with one reference, empty and reset to its tail
+ * so that headers may be pushed.
+ */
+packet_t *packet_alloc(void);
+/* Release a reference, the packet returns to the pool on the last one */
+void packet_put(packet_t *pkt);
 
-/* All network transactions are synchronous. So we only need one packet
- * at a time.
+/* Take a reference in order to hold the packet beyond the current call,
+ * e.g. while waiting for address resolution.
  */
-#define NET_PACKET_SIZE 400
-extern packet_t g_packet;
+static inline packet_t *packet_get(packet_t *pkt)
+{
+    pkt->refcnt++;
+    return pkt;
+}
+
+int packet_pool_free_count(void);
+
+static inline void packet_queue_init(packet_queue_t *q)
+{
+    q->head = q->tail = NULL;
+    q->count = 0;
+}
+
+/* The queue takes over the caller's reference */
+static inline void packet_enqueue(packet_queue_t *q, packet_t *pkt)
+{
+    pkt->next = NULL;
+    if (q->tail)
+        q->tail->next = pkt;
+    else
+        q->head = pkt;
+    q->tail = pkt;
+    q->count++;
+}
+
+static inline packet_t *packet_dequeue(packet_queue_t *q)
+{
+    packet_t *pkt;
+
+    if (!(pkt = q->head))
+        return NULL;
+
+    if (!(q->head = pkt->next))
+        q->tail = NULL;
+    pkt->next = NULL;
+    q->count--;
+    return pkt;
+}
+
+/* Release all packets in the queue */
+void packet_queue_purge(packet_queue_t *q);
+
+void packet_uninit(void);
+void packet_init(void);
 
 static inline void *packet_push(packet_t *pkt, int len)
 {
@@ -0,0 +1,1242 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <string.h> /* memcpy, memset */
+#include "mem/tmalloc.h"
+#include "util/tp_misc.h"
+#include "util/event.h"
+#include "platform/platform.h"
+#include "net/tcp.h"
+#include "net/arp.h"
+#include "net/ipv4.h"
+#include "net/packet.h"
+#include "net/net_utils.h"
+#include "net/net_debug.h"
+
+#define TCP_FLAG_FIN 0x01
+#define TCP_FLAG_SYN 0x02
+#define TCP_FLAG_RST 0x04
+#define TCP_FLAG_PSH 0x08
+#define TCP_FLAG_ACK 0x10
+
+#define TCP_OPT_END 0
+#define TCP_OPT_NOP 1
+#define TCP_OPT_MSS 2
+
+/* Largest segment fitting both our packet buffer and an Ethernet MTU,
+ * advertised on SYN
+ */
+#define TCP_MTU MIN(NET_PACKET_SIZE - sizeof(eth_hdr_t), 1500)
+#define TCP_MSS (TCP_MTU - sizeof(ip_hdr_t) - sizeof(tcp_hdr_t))
+/* RFC 1122: MSS assumed when the peer does not send the option */
+#define TCP_DEFAULT_MSS 536
+
+/* Timers, in ms */
+#define TCP_RTO_INIT 1000
+#define TCP_RTO_MIN 200
+#define TCP_RTO_MAX 16000
+#define TCP_TIME_WAIT 2000
+#define TCP_FIN_WAIT_2_TIMEOUT 10000
+#define TCP_MAX_RETRIES 6
+
+#define TCP_EPHEMERAL_PORT_START 49152
+
+#define SEQ_LT(a, b) ((s32)((a) - (b)) < 0)
+
+typedef enum {
+    TCP_CLOSED = 0,
+    TCP_LISTEN = 1,
+    TCP_SYN_SENT = 2,
+    TCP_SYN_RCVD = 3,
+    TCP_ESTABLISHED = 4,
+    TCP_CLOSE_WAIT = 5,
+    TCP_FIN_WAIT_1 = 6,
+    TCP_FIN_WAIT_2 = 7,
+    TCP_CLOSING = 8,
+    TCP_LAST_ACK = 9,
+    TCP_TIME_WAIT_STATE = 10,
+} tcp_state_t;
+
+typedef struct {
+    u8 *buf;
+    u16 size;
+    u16 head;
+    u16 len;
+} tcp_ring_t;
+
+typedef struct tcp_sock_t tcp_sock_t;
+
+struct tcp_sock_t {
+    tcp_sock_t *next;
+    etherif_t *ethif;
+    tcp_state_t state;
+    int idx; /* netif socket index, -1 once released by the user */
+    int parent; /* Listening socket index until accepted, -1 otherwise */
+    u32 remote_ip;
+    u16 local_port;
+    u16 remote_port;
+    eth_mac_t remote_mac;
+    arp_resolve_t arp;
+    /* Send sequence space. snd_una is the sequence of tx.buf[tx.head] */
+    u32 iss;
+    u32 snd_una;
+    u32 snd_nxt;
+    u32 snd_max;
+    u16 snd_wnd;
+    u16 mss;
+    u32 rcv_nxt;
+    tcp_ring_t tx;
+    tcp_ring_t rx;
+    /* Retransmission */
+    int timer_id;
+    u16 rto;
+    u8 retries;
+    s32 srtt; /* -1 until the first sample */
+    s32 rttvar;
+    u32 rtt_seq;
+    u32 rtt_start;
+    /* Deferred notifications of an accepted socket */
+    int notify_id;
+    u8 arp_pending : 1;
+    u8 fin_pending : 1; /* Send FIN once the tx buffer is drained */
+    u8 fin_sent : 1;
+    u8 rx_fin : 1;
+    u8 tx_blocked : 1;
+    u8 rtt_active : 1;
+    u8 closed_notified : 1;
+};
+
+/* Timer events are referenced by the event loop after they are deleted, so
+ * they are allocated apart from the socket and freed by the loop.
+ */
+typedef struct {
+    event_t e;
+    tcp_sock_t *sock;
+} tcp_timer_t;
+
+typedef struct {
+    tcp_sock_t *socks[NETIF_MAX_SOCKETS];
+    u16 next_port;
+} tcp_etherif_t;
+
+typedef struct {
+    eth_mac_t src_mac;
+    u32 src_addr;
+    u16 src_port;
+    u16 dst_port;
+    u32 seq;
+    u32 ack;
+    u8 flags;
+    u16 window;
+    u16 mss;
+    u8 *data;
+    u16 len;
+} tcp_seg_t;
+
+typedef struct __attribute__((packed)) {
+    u32 src_addr;
+    u32 dst_addr;
+    u8 zero;
+    u8 protocol;
+    u16 length;
+} tcp_pseudo_hdr_t;
+
+static tcp_sock_t *tcp_socks;
+static u32 iss_seed;
+
+static void tcp_output(tcp_sock_t *sock, int force_ack);
+static void tcp_timeout(event_t *e, u32 resource_id, u64 timestamp);
+
+static void ring_init(tcp_ring_t *r, u16 size)
+{
+    r->buf = tmalloc(size, "TCP buffer");
+    r->size = size;
+    r->head = r->len = 0;
+}
+
+static inline u16 ring_room(tcp_ring_t *r)
+{
+    return r->size - r->len;
+}
+
+static void ring_copy_out(tcp_ring_t *r, u16 offset, u8 *dst, u16 len)
+{
+    u16 start = (r->head + offset) % r->size;
+    u16 first = MIN(len, r->size - start);
+
+    memcpy(dst, r->buf + start, first);
+    memcpy(dst + first, r->buf, len - first);
+}
+
+static u16 ring_put(tcp_ring_t *r, const u8 *src, u16 len)
+{
+    u16 tail = (r->head + r->len) % r->size, first;
+
+    len = MIN(len, ring_room(r));
+    first = MIN(len, r->size - tail);
+    memcpy(r->buf + tail, src, first);
+    memcpy(r->buf, src + first, len - first);
+    r->len += len;
+    return len;
+}
+
+static void ring_consume(tcp_ring_t *r, u16 len)
+{
+    r->head = (r->head + len) % r->size;
+    r->len -= len;
+}
+
+static u32 tcp_now(void)
+{
+    return (u32)platform_get_ticks_from_boot();
+}
+
+static tcp_sock_t *tcp_sock_get(etherif_t *ethif, int idx)
+{
+    tcp_etherif_t *t = ethif->tcp;
+
+    if (!t || idx < 0 || idx >= NETIF_MAX_SOCKETS)
+        return NULL;
+
+    return t->socks[idx];
+}
+
+static netif_t *tcp_sock_netif(tcp_sock_t *sock)
+{
+    return &sock->ethif->netif;
+}
+
+/* Connections pending accept and released sockets have no listeners */
+static int tcp_sock_is_user(tcp_sock_t *sock)
+{
+    return sock->idx >= 0 && sock->parent < 0;
+}
+
+static void tcp_sock_trigger(tcp_sock_t *sock, netif_sock_event_t event)
+{
+    if (!tcp_sock_is_user(sock))
+        return;
+
+    netif_sock_event_trigger(tcp_sock_netif(sock), sock->idx, event);
+}
+
+/* Packet ptr is expected to point to the TCP header. The pseudo header is
+ * built in the headroom, where the IPv4 header is placed later on.
+ * Addresses are in network order.
+ */
+static u16 tcp_csum(packet_t *pkt, u32 src_addr, u32 dst_addr, u16 len)
+{
+    tcp_pseudo_hdr_t *ph;
+    u16 csum;
+
+    ph = packet_push(pkt, sizeof(tcp_pseudo_hdr_t));
+    ph->src_addr = src_addr;
+    ph->dst_addr = dst_addr;
+    ph->zero = 0;
+    ph->protocol = IP_PROTOCOL_TCP;
+    ph->length = htons(len);
+    csum = net_csum((u16 *)ph, sizeof(tcp_pseudo_hdr_t) + len);
+    packet_pull(pkt, sizeof(tcp_pseudo_hdr_t));
+    return csum;
+}
+
+/* - packet ptr is expected to point to the TCP payload
+ * - ports and addresses are in host order
+ */
+static int tcp_segment_xmit(etherif_t *ethif, packet_t *pkt,
+    const eth_mac_t *dst_mac, u32 dst_addr, u16 src_port, u16 dst_port, u32 seq, u32 ack, u8 flags,
+    u16 window)
+{
+    u32 src_addr = ipv4_addr(ethif);
+    u16 hdr_len = sizeof(tcp_hdr_t);
+    tcp_hdr_t *tcph;
+    u8 *opt;
+
+    if (flags & TCP_FLAG_SYN)
+    {
+        if (!(opt = packet_push(pkt, 4)))
+            return -1;
+
+        opt[0] = TCP_OPT_MSS;
+        opt[1] = 4;
+        opt[2] = TCP_MSS >> 8;
+        opt[3] = TCP_MSS & 0xff;
+        hdr_len += 4;
+    }
+
+    if (!(tcph = packet_push(pkt, sizeof(tcp_hdr_t))))
+        return -1;
+
+    tcph->src_port = htons(src_port);
+    tcph->dst_port = htons(dst_port);
+    tcph->seq = htonl(seq);
+    tcph->ack = flags & TCP_FLAG_ACK ? htonl(ack) : 0;
+    tcph->reserved = 0;
+    tcph->data_off = hdr_len / 4;
+    tcph->flags = flags;
+    tcph->window = htons(window);
+    tcph->checksum = 0;
+    tcph->urg_ptr = 0;
+    tcph->checksum = tcp_csum(pkt, htonl(src_addr), htonl(dst_addr),
+        pkt->length);
+
+    return ipv4_xmit(ethif, pkt, dst_mac, IP_PROTOCOL_TCP, src_addr, dst_addr,
+        pkt->length);
+}
+
+/* Send a segment carrying 'len' bytes from 'offset' in the tx buffer */
+static void tcp_sock_xmit(tcp_sock_t *sock, u8 flags, u32 seq, u16 offset,
+    u16 len)
+{
+    packet_t *pkt;
+    u8 *data;
+
+    /* Pool exhausted: the segment is recovered by retransmission */
+    if (!(pkt = packet_alloc()))
+        return;
+
+    if (len)
+    {
+        data = packet_push(pkt, len);
+        ring_copy_out(&sock->tx, offset, data, len);
+    }
+
+    tcp_segment_xmit(sock->ethif, pkt, &sock->remote_mac, sock->remote_ip,
+        sock->local_port, sock->remote_port, seq, sock->rcv_nxt, flags,
+        ring_room(&sock->rx));
+    packet_put(pkt);
+}
+
+/* Reply with a reset to an unexpected segment */
+static void tcp_rst_xmit(etherif_t *ethif, tcp_seg_t *seg)
+{
+    packet_t *pkt;
+    u32 seq = 0, ack = 0;
+    u8 flags = TCP_FLAG_RST;
+
+    if (seg->flags & TCP_FLAG_RST || !(pkt = packet_alloc()))
+        return;
+
+    if (seg->flags & TCP_FLAG_ACK)
+        seq = seg->ack;
+    else
+    {
+        ack = seg->seq + seg->len + !!(seg->flags & TCP_FLAG_SYN) +
+            !!(seg->flags & TCP_FLAG_FIN);
+        flags |= TCP_FLAG_ACK;
+    }
+
+    tcp_segment_xmit(ethif, pkt, &seg->src_mac, seg->src_addr, seg->dst_port,
+        seg->src_port, seq, ack, flags, 0);
+    packet_put(pkt);
+}
+
+static void tcp_timer_free(event_t *e)
+{
+    tfree(container_of(e, tcp_timer_t, e));
+}
+
+static int tcp_timer_new(tcp_sock_t *sock, int ms,
+    void (*trigger)(event_t *e, u32 resource_id, u64 timestamp))
+{
+    tcp_timer_t *t = tmalloc_type(tcp_timer_t);
+
+    t->e = (event_t){ .trigger = trigger, .free = tcp_timer_free };
+    t->sock = sock;
+    return event_timer_set(ms, &t->e);
+}
+
+static inline tcp_sock_t *tcp_timer_sock(event_t *e)
+{
+    return container_of(e, tcp_timer_t, e)->sock;
+}
+
+static void tcp_timer_stop(tcp_sock_t *sock)
+{
+    if (sock->timer_id < 0)
+        return;
+
+    event_timer_del(sock->timer_id);
+    sock->timer_id = -1;
+}
+
+static void tcp_timer_start(tcp_sock_t *sock, int ms)
+{
+    tcp_timer_stop(sock);
+    sock->timer_id = tcp_timer_new(sock, ms, tcp_timeout);
+}
+
+/* Run the retransmission timer while data is in flight, or while data is
+ * held back by a zero window.
+ */
+static void tcp_timer_update(tcp_sock_t *sock)
+{
+    int needed;
+
+    if (sock->state == TCP_TIME_WAIT_STATE || sock->state == TCP_FIN_WAIT_2)
+        return;
+
+    needed = sock->snd_nxt != sock->snd_una ||
+        (sock->tx.len && !sock->snd_wnd);
+    if (!needed)
+        tcp_timer_stop(sock);
+    else if (sock->timer_id < 0)
+        tcp_timer_start(sock, sock->rto);
+}
+
+static void tcp_sock_free(tcp_sock_t *sock)
+{
+    tcp_sock_t **iter;
+
+    if (sock->arp_pending)
+        arp_resolve_cancel(&sock->arp);
+
+    for (iter = &tcp_socks; *iter && *iter != sock; iter = &(*iter)->next);
+    tp_assert(*iter);
+    *iter = sock->next;
+
+    if (sock->idx >= 0)
+    {
+        ((tcp_etherif_t *)sock->ethif->tcp)->socks[sock->idx] = NULL;
+        etherif_sock_free(sock->ethif, sock->idx);
+    }
+
+    tcp_timer_stop(sock);
+    if (sock->notify_id >= 0)
+        event_timer_del(sock->notify_id);
+    tfree(sock->tx.buf);
+    tfree(sock->rx.buf);
+    tfree(sock);
+}
+
+/* The user no longer references the socket, it lingers until closed */
+static void tcp_sock_detach(tcp_sock_t *sock)
+{
+    ((tcp_etherif_t *)sock->ethif->tcp)->socks[sock->idx] = NULL;
+    etherif_sock_free(sock->ethif, sock->idx);
+    sock->idx = -1;
+}
+
+static void tcp_peer_closed(tcp_sock_t *sock)
+{
+    if (!tcp_sock_is_user(sock) || sock->closed_notified)
+        return;
+
+    sock->closed_notified = 1;
+    netif_sock_disconnected(tcp_sock_netif(sock), sock->idx);
+}
+
+/* Connection reset or timed out */
+static void tcp_sock_abort(tcp_sock_t *sock)
+{
+    tcp_timer_stop(sock);
+    sock->state = TCP_CLOSED;
+    if (!tcp_sock_is_user(sock))
+    {
+        tcp_sock_free(sock);
+        return;
+    }
+
+    tcp_peer_closed(sock);
+}
+
+static void tcp_time_wait(tcp_sock_t *sock)
+{
+    sock->state = TCP_TIME_WAIT_STATE;
+    tcp_timer_start(sock, TCP_TIME_WAIT);
+}
+
+static void tcp_syn_xmit(tcp_sock_t *sock)
+{
+    u8 flags = TCP_FLAG_SYN;
+
+    if (sock->state == TCP_SYN_RCVD)
+        flags |= TCP_FLAG_ACK;
+
+    sock->snd_nxt = sock->snd_max = sock->iss + 1;
+    tcp_sock_xmit(sock, flags, sock->iss, 0, 0);
+}
+
+static void tcp_timeout(event_t *e, u32 resource_id, u64 timestamp)
+{
+    tcp_sock_t *sock = tcp_timer_sock(e);
+
+    sock->timer_id = -1;
+    if (sock->state == TCP_TIME_WAIT_STATE || sock->state == TCP_FIN_WAIT_2)
+    {
+        tcp_sock_free(sock);
+        return;
+    }
+
+    if (++sock->retries > TCP_MAX_RETRIES)
+    {
+        tp_info("TCP: connection timed out\n");
+        tcp_sock_abort(sock);
+        return;
+    }
+
+    sock->rto = MIN(sock->rto * 2, TCP_RTO_MAX);
+    /* Karn's algorithm: no RTT samples from retransmitted segments */
+    sock->rtt_active = 0;
+
+    if (sock->state == TCP_SYN_SENT || sock->state == TCP_SYN_RCVD)
+    {
+        tcp_syn_xmit(sock);
+        tcp_timer_start(sock, sock->rto);
+        return;
+    }
+
+    /* Go back to the first unacknowledged byte. When the window is
+     * closed, this sends a single byte window probe.
+     */
+    sock->snd_nxt = sock->snd_una;
+    sock->fin_sent = 0;
+    tcp_output(sock, 0);
+}
+
+static void tcp_notify(event_t *e, u32 resource_id, u64 timestamp)
+{
+    tcp_sock_t *sock = tcp_timer_sock(e);
+
+    sock->notify_id = -1;
+    if (sock->rx.len)
+        tcp_sock_trigger(sock, NETIF_SOCK_EVENT_DATA_AVAIL);
+    else if (sock->rx_fin || sock->state == TCP_CLOSED)
+        tcp_peer_closed(sock);
+}
+
+static int tcp_is_synchronized(tcp_sock_t *sock)
+{
+    return sock->state >= TCP_ESTABLISHED &&
+        sock->state != TCP_TIME_WAIT_STATE;
+}
+
+static void tcp_output(tcp_sock_t *sock, int force_ack)
+{
+    u16 sent, len, wnd;
+
+    while (tcp_is_synchronized(sock) && !sock->fin_sent)
+    {
+        sent = sock->snd_nxt - sock->snd_una;
+        len = sock->tx.len - sent;
+        wnd = sock->snd_wnd > sent ? sock->snd_wnd - sent : 0;
+        if (!wnd && !sent && len && sock->timer_id < 0 && sock->retries)
+            wnd = 1; /* Window probe */
+
+        len = MIN(len, MIN(wnd, sock->mss));
+        /* Nagle: hold back small segments while data is in flight */
+        if (!len || (len < sock->mss && sent && sent + len == sock->tx.len))
+            break;
+
+        tcp_sock_xmit(sock, TCP_FLAG_ACK |
+            (sent + len == sock->tx.len ? TCP_FLAG_PSH : 0), sock->snd_nxt,
+            sent, len);
+        if (!sock->rtt_active)
+        {
+            sock->rtt_active = 1;
+            sock->rtt_seq = sock->snd_nxt + len;
+            sock->rtt_start = tcp_now();
+        }
+        sock->snd_nxt += len;
+        force_ack = 0;
+    }
+
+    if (tcp_is_synchronized(sock) && sock->fin_pending && !sock->fin_sent &&
+        (u16)(sock->snd_nxt - sock->snd_una) == sock->tx.len)
+    {
+        tcp_sock_xmit(sock, TCP_FLAG_FIN | TCP_FLAG_ACK, sock->snd_nxt, 0, 0);
+        sock->snd_nxt++;
+        sock->fin_sent = 1;
+        force_ack = 0;
+        if (sock->state == TCP_ESTABLISHED)
+            sock->state = TCP_FIN_WAIT_1;
+        else if (sock->state == TCP_CLOSE_WAIT)
+            sock->state = TCP_LAST_ACK;
+    }
+
+    if (force_ack)
+        tcp_sock_xmit(sock, TCP_FLAG_ACK, sock->snd_nxt, 0, 0);
+
+    if (SEQ_LT(sock->snd_max, sock->snd_nxt))
+        sock->snd_max = sock->snd_nxt;
+    tcp_timer_update(sock);
+}
+
+static void tcp_rtt_update(tcp_sock_t *sock, u32 ack)
+{
+    s32 rtt, delta;
+
+    if (!sock->rtt_active || SEQ_LT(ack, sock->rtt_seq))
+        return;
+
+    sock->rtt_active = 0;
+    rtt = tcp_now() - sock->rtt_start;
+    if (sock->srtt < 0)
+    {
+        sock->srtt = rtt;
+        sock->rttvar = rtt / 2;
+    }
+    else
+    {
+        delta = rtt - sock->srtt;
+        sock->srtt += delta / 8;
+        sock->rttvar += ((delta < 0 ? -delta : delta) - sock->rttvar) / 4;
+    }
+
+    rtt = sock->srtt + 4 * sock->rttvar;
+    sock->rto = MAX(TCP_RTO_MIN, MIN(TCP_RTO_MAX, rtt));
+}
+
+/* Returns non zero if processing of the segment should stop */
+static int tcp_ack_recv(tcp_sock_t *sock, tcp_seg_t *seg)
+{
+    u32 acked;
+    int fin_acked;
+
+    if (SEQ_LT(sock->snd_max, seg->ack))
+    {
+        /* Acknowledges something not yet sent */
+        tcp_output(sock, 1);
+        return 1;
+    }
+
+    if (SEQ_LT(seg->ack, sock->snd_una))
+        return 0; /* Duplicate */
+
+    sock->snd_wnd = seg->window;
+    if (seg->ack == sock->snd_una)
+    {
+        /* A peer answering window probes is alive, probing goes on for as
+         * long as it does (RFC 1122 4.2.2.17).
+         */
+        if (!seg->window && sock->tx.len)
+            sock->retries = 0;
+        return 0;
+    }
+
+    acked = seg->ack - sock->snd_una;
+    fin_acked = sock->fin_pending && acked > sock->tx.len;
+    ring_consume(&sock->tx, fin_acked ? acked - 1 : acked);
+    tcp_rtt_update(sock, seg->ack);
+    sock->snd_una = seg->ack;
+    if (SEQ_LT(sock->snd_nxt, sock->snd_una))
+        sock->snd_nxt = sock->snd_una;
+    sock->retries = 0;
+    tcp_timer_stop(sock);
+
+    if (sock->tx_blocked)
+    {
+        sock->tx_blocked = 0;
+        tcp_sock_trigger(sock, NETIF_SOCK_EVENT_WRITABLE);
+    }
+
+    if (!fin_acked)
+        return 0;
+
+    sock->fin_sent = 1;
+    switch (sock->state)
+    {
+    case TCP_FIN_WAIT_1:
+        sock->state = TCP_FIN_WAIT_2;
+        tcp_timer_start(sock, TCP_FIN_WAIT_2_TIMEOUT);
+        break;
+    case TCP_CLOSING:
+        tcp_time_wait(sock);
+        break;
+    case TCP_LAST_ACK:
+        tcp_sock_free(sock);
+        return 1;
+    default:
+        break;
+    }
+    return 0;
+}
+
+static void tcp_syn_sent_recv(tcp_sock_t *sock, tcp_seg_t *seg)
+{
+    if ((seg->flags & TCP_FLAG_ACK) && seg->ack != sock->snd_nxt)
+    {
+        tcp_rst_xmit(sock->ethif, seg);
+        return;
+    }
+
+    if (seg->flags & TCP_FLAG_RST)
+    {
+        if (seg->flags & TCP_FLAG_ACK)
+            tcp_sock_abort(sock); /* Connection refused */
+        return;
+    }
+
+    /* Simultaneous open is not supported */
+    if ((seg->flags & (TCP_FLAG_SYN | TCP_FLAG_ACK)) !=
+        (TCP_FLAG_SYN | TCP_FLAG_ACK))
+    {
+        return;
+    }
+
+    sock->rcv_nxt = seg->seq + 1;
+    sock->snd_una = seg->ack;
+    sock->snd_wnd = seg->window;
+    sock->mss = MIN(seg->mss, TCP_MSS);
+    sock->state = TCP_ESTABLISHED;
+    sock->retries = 0;
+    tcp_timer_stop(sock);
+    tcp_sock_trigger(sock, NETIF_SOCK_EVENT_CONNECTED);
+    /* ACK the SYN along with any data written while connecting */
+    tcp_output(sock, 1);
+}
+
+static void tcp_sock_recv(tcp_sock_t *sock, tcp_seg_t *seg)
+{
+    int need_ack = 0;
+    u16 len = 0;
+
+    if (sock->state == TCP_SYN_SENT)
+    {
+        tcp_syn_sent_recv(sock, seg);
+        return;
+    }
+
+    /* The peer retransmits its SYN when our SYN-ACK was lost */
+    if (sock->state == TCP_SYN_RCVD && (seg->flags & TCP_FLAG_SYN) &&
+        seg->seq == sock->rcv_nxt - 1)
+    {
+        tcp_syn_xmit(sock);
+        return;
+    }
+
+    /* Only in order segments are accepted. Anything else is answered with
+     * an ACK of what we expect, and has to be retransmitted.
+     */
+    if (seg->seq != sock->rcv_nxt)
+    {
+        if (!(seg->flags & TCP_FLAG_RST))
+            tcp_output(sock, 1);
+        return;
+    }
+
+    if (seg->flags & TCP_FLAG_RST)
+    {
+        tcp_sock_abort(sock);
+        return;
+    }
+
+    if (seg->flags & TCP_FLAG_SYN)
+    {
+        tcp_rst_xmit(sock->ethif, seg);
+        tcp_sock_abort(sock);
+        return;
+    }
+
+    if (!(seg->flags & TCP_FLAG_ACK))
+        return;
+
+    if (sock->state == TCP_SYN_RCVD)
+    {
+        if (seg->ack != sock->snd_nxt)
+        {
+            tcp_rst_xmit(sock->ethif, seg);
+            return;
+        }
+
+        sock->snd_una = seg->ack;
+        sock->snd_wnd = seg->window;
+        sock->state = TCP_ESTABLISHED;
+        sock->retries = 0;
+        tcp_timer_stop(sock);
+        if (sock->parent >= 0)
+        {
+            netif_sock_event_trigger(tcp_sock_netif(sock), sock->parent,
+                NETIF_SOCK_EVENT_ACCEPT);
+        }
+    }
+    else if (tcp_ack_recv(sock, seg))
+        return;
+
+    if (seg->len && (sock->state == TCP_ESTABLISHED ||
+        sock->state == TCP_FIN_WAIT_1 || sock->state == TCP_FIN_WAIT_2))
+    {
+        /* Whatever doesn't fit the window is dropped */
+        len = ring_put(&sock->rx, seg->data, seg->len);
+        sock->rcv_nxt += len;
+        need_ack = 1;
+        if (len)
+            tcp_sock_trigger(sock, NETIF_SOCK_EVENT_DATA_AVAIL);
+    }
+
+    if ((seg->flags & TCP_FLAG_FIN) && len == seg->len &&
+        sock->state != TCP_CLOSE_WAIT && sock->state != TCP_CLOSING &&
+        sock->state != TCP_LAST_ACK && sock->state != TCP_TIME_WAIT_STATE)
+    {
+        sock->rcv_nxt++;
+        sock->rx_fin = 1;
+        need_ack = 1;
+        if (sock->state == TCP_ESTABLISHED)
+            sock->state = TCP_CLOSE_WAIT;
+        else if (sock->state == TCP_FIN_WAIT_1)
+            sock->state = TCP_CLOSING;
+        else if (sock->state == TCP_FIN_WAIT_2)
+            tcp_time_wait(sock);
+
+        if (!sock->rx.len)
+            tcp_peer_closed(sock);
+    }
+
+    tcp_output(sock, need_ack);
+}
+
+static tcp_sock_t *tcp_sock_new(etherif_t *ethif, tcp_state_t state)
+{
+    tcp_etherif_t *t = ethif->tcp;
+    tcp_sock_t *sock;
+    int idx;
+
+    if (!t)
+    {
+        t = ethif->tcp = tmalloc_type(tcp_etherif_t);
+        memset(t, 0, sizeof(*t));
+        t->next_port = TCP_EPHEMERAL_PORT_START;
+    }
+
+    if ((idx = etherif_sock_alloc(ethif)) < 0)
+    {
+        tp_err("TCP: out of sockets\n");
+        return NULL;
+    }
+
+    sock = tmalloc_type(tcp_sock_t);
+    memset(sock, 0, sizeof(*sock));
+    sock->ethif = ethif;
+    sock->state = state;
+    sock->idx = idx;
+    sock->parent = -1;
+    sock->timer_id = sock->notify_id = -1;
+    sock->rto = TCP_RTO_INIT;
+    sock->srtt = -1;
+    sock->mss = TCP_DEFAULT_MSS;
+    /* RFC 793 suggests a 4us clock */
+    sock->iss = tcp_now() * 250 + (iss_seed++ << 16);
+    sock->snd_una = sock->snd_nxt = sock->snd_max = sock->iss;
+    if (state != TCP_LISTEN)
+    {
+        ring_init(&sock->tx, CONFIG_TCP_TX_BUFFER_SIZE);
+        ring_init(&sock->rx, CONFIG_TCP_RX_BUFFER_SIZE);
+    }
+
+    t->socks[idx] = sock;
+    sock->next = tcp_socks;
+    tcp_socks = sock;
+    return sock;
+}
+
+static int tcp_port_taken(etherif_t *ethif, u16 port)
+{
+    tcp_sock_t *sock;
+
+    for (sock = tcp_socks; sock; sock = sock->next)
+    {
+        if (sock->ethif == ethif && sock->local_port == port)
+            return 1;
+    }
+    return 0;
+}
+
+static u16 tcp_port_alloc(etherif_t *ethif)
+{
+    tcp_etherif_t *t = ethif->tcp;
+
+    do
+    {
+        if (++t->next_port < TCP_EPHEMERAL_PORT_START)
+            t->next_port = TCP_EPHEMERAL_PORT_START;
+    } while (tcp_port_taken(ethif, t->next_port));
+
+    return t->next_port;
+}
+
+static void tcp_listen_recv(tcp_sock_t *listener, tcp_seg_t *seg)
+{
+    tcp_sock_t *sock;
+
+    if (seg->flags & TCP_FLAG_RST)
+        return;
+
+    if (seg->flags & TCP_FLAG_ACK)
+    {
+        tcp_rst_xmit(listener->ethif, seg);
+        return;
+    }
+
+    if (!(seg->flags & TCP_FLAG_SYN))
+        return;
+
+    if (!(sock = tcp_sock_new(listener->ethif, TCP_SYN_RCVD)))
+        return; /* Backlog is full, the peer will retry */
+
+    sock->parent = listener->idx;
+    sock->local_port = listener->local_port;
+    sock->remote_port = seg->src_port;
+    sock->remote_ip = seg->src_addr;
+    sock->remote_mac = seg->src_mac;
+    sock->rcv_nxt = seg->seq + 1;
+    sock->snd_wnd = seg->window;
+    sock->mss = MIN(seg->mss, TCP_MSS);
+    tcp_syn_xmit(sock);
+    tcp_timer_update(sock);
+}
+
+static tcp_sock_t *tcp_sock_lookup(etherif_t *ethif, tcp_seg_t *seg)
+{
+    tcp_sock_t *sock, *listener = NULL;
+
+    for (sock = tcp_socks; sock; sock = sock->next)
+    {
+        if (sock->ethif != ethif || sock->local_port != seg->dst_port)
+            continue;
+
+        if (sock->state == TCP_LISTEN)
+            listener = sock;
+        else if (sock->remote_port == seg->src_port &&
+            sock->remote_ip == seg->src_addr)
+        {
+            return sock;
+        }
+    }
+
+    return listener;
+}
+
+static void tcp_options_parse(tcp_seg_t *seg, u8 *opt, int len)
+{
+    while (len > 0 && *opt != TCP_OPT_END)
+    {
+        if (*opt == TCP_OPT_NOP)
+        {
+            opt++;
+            len--;
+            continue;
+        }
+
+        if (len < 2 || opt[1] < 2 || opt[1] > len)
+            return;
+
+        /* An MSS of 0 would never let us send */
+        if (*opt == TCP_OPT_MSS && opt[1] == 4 && (opt[2] || opt[3]))
+            seg->mss = (opt[2] << 8) | opt[3];
+
+        len -= opt[1];
+        opt += opt[1];
+    }
+}
+
+static void tcp_recv(etherif_t *ethif, packet_t *pkt)
+{
+    tcp_hdr_t *tcph = (tcp_hdr_t *)pkt->ptr;
+    ip_hdr_t *iph = (ip_hdr_t *)(pkt->ptr - sizeof(ip_hdr_t));
+    eth_hdr_t *eth_hdr = (eth_hdr_t *)((u8 *)iph - sizeof(eth_hdr_t));
+    tcp_sock_t *sock;
+    tcp_seg_t seg;
+    u16 tcp_len, hdr_len;
+    u32 dst_addr;
+
+    tp_debug("TCP packet received\n");
+
+    tcp_len = ntohs(iph->tot_len) - sizeof(ip_hdr_t);
+    hdr_len = tcph->data_off * 4;
+    if (tcp_len > pkt->length || hdr_len < sizeof(tcp_hdr_t) ||
+        hdr_len > tcp_len)
+    {
+        return; /* Malformed or truncated */
+    }
+
+    seg.src_mac = eth_hdr->src;
+    seg.src_addr = ntohl(iph->src_addr);
+    dst_addr = iph->dst_addr;
+    if (tcp_csum(pkt, iph->src_addr, dst_addr, tcp_len))
+    {
+        tp_info("TCP: bad checksum\n");
+        return;
+    }
+
+    seg.src_port = ntohs(tcph->src_port);
+    seg.dst_port = ntohs(tcph->dst_port);
+    seg.seq = ntohl(tcph->seq);
+    seg.ack = ntohl(tcph->ack);
+    seg.flags = tcph->flags;
+    seg.window = ntohs(tcph->window);
+    seg.mss = TCP_DEFAULT_MSS;
+    seg.data = pkt->ptr + hdr_len;
+    seg.len = tcp_len - hdr_len;
+    if (seg.flags & TCP_FLAG_SYN)
+    {
+        tcp_options_parse(&seg, pkt->ptr + sizeof(tcp_hdr_t),
+            hdr_len - sizeof(tcp_hdr_t));
+    }
+
+    if (dst_addr != htonl(ipv4_addr(ethif)))
+        return; /* No connections on broadcast addresses */
+
+    sock = tcp_sock_lookup(ethif, &seg);
+    if (!sock || sock->state == TCP_CLOSED)
+    {
+        tcp_rst_xmit(ethif, &seg);
+        return;
+    }
+
+    if (sock->state == TCP_LISTEN)
+        tcp_listen_recv(sock, &seg);
+    else
+        tcp_sock_recv(sock, &seg);
+}
+
+static void tcp_arp_resolved(arp_resolve_t *ar, int status, eth_mac_t mac)
+{
+    tcp_sock_t *sock = container_of(ar, tcp_sock_t, arp);
+
+    sock->arp_pending = 0;
+    if (status)
+    {
+        tcp_sock_abort(sock);
+        return;
+    }
+
+    sock->remote_mac = mac;
+    tcp_syn_xmit(sock);
+    tcp_timer_update(sock);
+}
+
+int tcp_connect(etherif_t *ethif, u32 ip, u16 port)
+{
+    tcp_sock_t *sock;
+
+    if (!ethif->ipv4_info)
+    {
+        tp_err("TCP: no IP address\n");
+        return -1;
+    }
+
+    if (!(sock = tcp_sock_new(ethif, TCP_SYN_SENT)))
+        return -1;
+
+    sock->remote_ip = ip;
+    sock->remote_port = port;
+    sock->local_port = tcp_port_alloc(ethif);
+
+    /* Completes right away if the next hop is in the neighbor cache */
+    sock->arp.ethif = ethif;
+    sock->arp.ip = ipv4_next_hop(ethif, ip);
+    sock->arp.resolved = tcp_arp_resolved;
+    sock->arp_pending = 1;
+    if (arp_resolve(&sock->arp))
+    {
+        sock->arp_pending = 0;
+        tcp_sock_free(sock);
+        return -1;
+    }
+
+    return sock->idx;
+}
+
+int tcp_listen(etherif_t *ethif, u16 port)
+{
+    tcp_sock_t *sock;
+
+    if (!port || tcp_port_taken(ethif, port))
+    {
+        tp_err("TCP: port %d is not available\n", port);
+        return -1;
+    }
+
+    if (!(sock = tcp_sock_new(ethif, TCP_LISTEN)))
+        return -1;
+
+    sock->local_port = port;
+    return sock->idx;
+}
+
+int tcp_accept(etherif_t *ethif, int idx)
+{
+    tcp_sock_t *sock = tcp_sock_get(ethif, idx);
+
+    if (!sock || sock->state != TCP_LISTEN)
+        return -1;
+
+    for (sock = tcp_socks; sock; sock = sock->next)
+    {
+        if (sock->ethif != ethif || sock->parent != idx ||
+            sock->state == TCP_SYN_RCVD)
+        {
+            continue;
+        }
+
+        sock->parent = -1;
+        /* Events of the new socket can only be listened to once we return */
+        if (sock->rx.len || sock->rx_fin || sock->state == TCP_CLOSED)
+            sock->notify_id = tcp_timer_new(sock, 0, tcp_notify);
+        return sock->idx;
+    }
+
+    return -1;
+}
+
+int tcp_read(etherif_t *ethif, int idx, char *buf, int size)
+{
+    tcp_sock_t *sock = tcp_sock_get(ethif, idx);
+    u16 room, len;
+
+    if (!sock || sock->state == TCP_LISTEN)
+        return -1;
+
+    room = ring_room(&sock->rx);
+    len = MIN(size, sock->rx.len);
+    ring_copy_out(&sock->rx, 0, (u8 *)buf, len);
+    ring_consume(&sock->rx, len);
+
+    /* Window update once a full segment fits again */
+    if (room < sock->mss && ring_room(&sock->rx) >= sock->mss &&
+        tcp_is_synchronized(sock) && !sock->rx_fin)
+    {
+        tcp_output(sock, 1);
+    }
+
+    if (sock->rx.len) /* More data waiting */
+        tcp_sock_trigger(sock, NETIF_SOCK_EVENT_DATA_AVAIL);
+    else if (sock->rx_fin)
+        tcp_peer_closed(sock);
+    return len;
+}
+
+int tcp_write(etherif_t *ethif, int idx, char *buf, int size)
+{
+    tcp_sock_t *sock = tcp_sock_get(ethif, idx);
+    u16 len;
+
+    if (!sock || (sock->state != TCP_SYN_SENT &&
+        sock->state != TCP_SYN_RCVD && sock->state != TCP_ESTABLISHED &&
+        sock->state != TCP_CLOSE_WAIT))
+    {
+        return -1;
+    }
+
+    len = ring_put(&sock->tx, (u8 *)buf, MIN(size, 0xffff));
+    if (len < size)
+        sock->tx_blocked = 1;
+
+    tcp_output(sock, 0);
+    return len;
+}
+
+static void tcp_listen_close(etherif_t *ethif, int idx)
+{
+    tcp_sock_t *sock, *next;
+
+    for (sock = tcp_socks; sock; sock = next)
+    {
+        next = sock->next;
+        if (sock->ethif != ethif || sock->parent != idx)
+            continue;
+
+        if (sock->state != TCP_CLOSED)
+            tcp_sock_xmit(sock, TCP_FLAG_RST | TCP_FLAG_ACK, sock->snd_nxt, 0, 0);
+        tcp_sock_free(sock);
+    }
+}
+
+int tcp_close(etherif_t *ethif, int idx)
+{
+    tcp_sock_t *sock = tcp_sock_get(ethif, idx);
+
+    if (!sock)
+        return 0;
+
+    tcp_sock_detach(sock);
+    switch (sock->state)
+    {
+    case TCP_LISTEN:
+        tcp_listen_close(ethif, idx);
+        tcp_sock_free(sock);
+        break;
+    case TCP_ESTABLISHED:
+    case TCP_CLOSE_WAIT:
+        sock->fin_pending = 1;
+        tcp_output(sock, 0);
+        break;
+    case TCP_SYN_SENT:
+    case TCP_SYN_RCVD:
+        /* Don't leave the peer half open. Our SYN went out unless ARP is
+         * still pending, and the peer's sequence is only known once we
+         * received its SYN.
+         */
+        if (!sock->arp_pending)
+        {
+            tcp_sock_xmit(sock, sock->state == TCP_SYN_RCVD ?
+                TCP_FLAG_RST | TCP_FLAG_ACK : TCP_FLAG_RST, sock->snd_nxt, 0,
+                0);
+        }
+        tcp_sock_free(sock);
+        break;
+    default:
+        /* Not synchronized, or already reset */
+        tcp_sock_free(sock);
+        break;
+    }
+    return 0;
+}
+
+void tcp_etherif_uninit(etherif_t *ethif)
+{
+    tcp_sock_t *sock, *next;
+
+    if (!ethif->tcp)
+        return;
+
+    for (sock = tcp_socks; sock; sock = next)
+    {
+        next = sock->next;
+        if (sock->ethif != ethif)
+            continue;
+
+        if (sock->idx >= 0)
+            tcp_sock_detach(sock);
+        tcp_sock_free(sock);
+    }
+
+    tfree(ethif->tcp);
+    ethif->tcp = NULL;
+}
+
+static ipv4_proto_t tcp_proto = {
+    .protocol = IP_PROTOCOL_TCP,
+    .recv = tcp_recv,
+};
+
+void tcp_uninit(void)
+{
+    ipv4_unregister_proto(&tcp_proto);
+}
+
+void tcp_init(void)
+{
+    ipv4_register_proto(&tcp_proto);
+}
@@ -0,0 +1,48 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __TCP_H__
+#define __TCP_H__
+
+#include "net/etherif.h"
+
+/* Sockets are identified by their netif socket index and report their
+ * state using the netif socket events, see NETIF_SOCK_RES().
+ * Addresses and ports are in host order.
+ */
+int tcp_connect(etherif_t *ethif, u32 ip, u16 port);
+int tcp_listen(etherif_t *ethif, u16 port);
+int tcp_accept(etherif_t *ethif, int sock);
+int tcp_read(etherif_t *ethif, int sock, char *buf, int size);
+/* Returns the number of bytes queued for transmission */
+int tcp_write(etherif_t *ethif, int sock, char *buf, int size);
+int tcp_close(etherif_t *ethif, int sock);
+
+/* Drop all connections of an interface being removed */
+void tcp_etherif_uninit(etherif_t *ethif);
+
+void tcp_uninit(void);
+void tcp_init(void);
+
+#endif
@@ -22,15 +22,41 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
+#include <string.h> /* memcpy */
+#include "mem/tmalloc.h"
+#include "util/tp_misc.h"
 #include "net/net_types.h"
 #include "net/net_debug.h"
 #include "net/udp.h"
 #include "net/ipv4.h"
+#include "net/ether.h"
 #include "net/packet.h"
 
 #define UDP_FREE_PORT_START 1024
 #define UDP_FREE_PORT_END 65535
 
+/* Largest payload fitting both our packet buffer and an Ethernet MTU */
+#define UDP_MAX_PAYLOAD (MIN(NET_PACKET_SIZE - sizeof(eth_hdr_t), 1500) - \
+    sizeof(ip_hdr_t) - sizeof(udp_hdr_t))
+
+/* Sockets bound through the netif API, identified by their netif index.
+ * Received datagrams are held in their packets until read.
+ */
+typedef struct udp_netif_sock_t udp_netif_sock_t;
+
+struct udp_netif_sock_t {
+    udp_netif_sock_t *next;
+    udp_socket_t sock;
+    etherif_t *ethif;
+    int idx;
+    packet_queue_t rx;
+};
+
+static udp_netif_sock_t *udp_netif_socks;
+
+/* Queued datagrams must not starve the rest of the stack of packets */
+#define UDP_POOL_RESERVE 2
+
 static int udp_is_port_taken(etherif_t *ethif, u16 port)
 {
     udp_socket_t *sock;
@@ -53,8 +79,8 @@ static int udp_get_free_port(u16 *port, etherif_t *ethif)
     return -1;
 }
 
-int udp_xmit(etherif_t *ethif, const eth_mac_t *dst_mac, u32 src_addr,
-    u32 dst_addr, u16 src_port, u16 dst_port, u16 payload_len)
+int udp_xmit(etherif_t *ethif, packet_t *pkt, const eth_mac_t *dst_mac,
+    u32 src_addr, u32 dst_addr, u16 src_port, u16 dst_port, u16 payload_len)
 {
     udp_hdr_t *udph;
     u16 len;
@@ -68,7 +94,7 @@ int udp_xmit(etherif_t *ethif, const eth_mac_t *dst_mac, u32 src_addr,
     len = sizeof(udp_hdr_t) + payload_len;
 
     /* UDP Header */
-    if (!(udph = packet_push(&g_packet, sizeof(udp_hdr_t))))
+    if (!(udph = packet_push(pkt, sizeof(udp_hdr_t))))
         return -1;
 
     udph->src_port = htons(src_port);
@@ -76,10 +102,11 @@ int udp_xmit(etherif_t *ethif, const eth_mac_t *dst_mac, u32 src_addr,
     udph->length = htons(len);
     udph->checksum = 0;
 
-    return ipv4_xmit(ethif, dst_mac, IP_PROTOCOL_UDP, src_addr, dst_addr, len);
+    return ipv4_xmit(ethif, pkt, dst_mac, IP_PROTOCOL_UDP, src_addr, dst_addr,
+        len);
 }
 
-int udp_sock_xmit(etherif_t *ethif, udp_socket_t *sock,
+int udp_sock_xmit(etherif_t *ethif, udp_socket_t *sock, packet_t *pkt,
     const eth_mac_t *dst_mac, u32 src_addr, u32 dst_addr, u16 payload_len)
 {
     if (sock->remote_port == UDP_PORT_ANY)
@@ -95,18 +122,27 @@ int udp_sock_xmit(etherif_t *ethif, udp_socket_t *sock,
         sock->local_port = local_port;
     }
 
-    return udp_xmit(ethif, dst_mac, src_addr, dst_addr, sock->local_port,
+    return udp_xmit(ethif, pkt, dst_mac, src_addr, dst_addr, sock->local_port,
         sock->remote_port, payload_len);
 }
 
-static void udp_recv(etherif_t *ethif)
+static void udp_recv(etherif_t *ethif, packet_t *pkt)
 {
-    udp_hdr_t *udph = (udp_hdr_t *)g_packet.ptr;
+    udp_hdr_t *udph = (udp_hdr_t *)pkt->ptr;
     udp_socket_t *sock;
-    u16 dst_port, src_port;
+    u16 dst_port, src_port, len;
 
     tp_debug("UDP packet received\n");
 
+    if (pkt->length < sizeof(udp_hdr_t))
+        return;
+
+    len = ntohs(udph->length);
+    if (len < sizeof(udp_hdr_t) || len > pkt->length)
+        return; /* Truncated */
+
+    pkt->length = len;
+
     src_port = ntohs(udph->src_port);
     dst_port = ntohs(udph->dst_port);
     if (!src_port || !dst_port)
@@ -130,8 +166,150 @@ static void udp_recv(etherif_t *ethif)
         return;
     }
 
-    packet_pull(&g_packet, sizeof(udp_hdr_t));
-    sock->recv(sock);
+    packet_pull(pkt, sizeof(udp_hdr_t));
+    sock->recv(sock, pkt);
+}
+
+static udp_netif_sock_t *udp_netif_sock_get(etherif_t *ethif, int idx)
+{
+    udp_netif_sock_t *s;
+
+    for (s = udp_netif_socks; s && (s->ethif != ethif || s->idx != idx);
+        s = s->next);
+    return s;
+}
+
+static void udp_netif_recv(udp_socket_t *sock, packet_t *pkt)
+{
+    udp_netif_sock_t *s = container_of(sock, udp_netif_sock_t, sock);
+
+    if (s->rx.count == CONFIG_UDP_RX_QUEUE_LEN ||
+        packet_pool_free_count() < UDP_POOL_RESERVE)
+    {
+        tp_info("UDP: socket %d queue is full, dropping\n", s->idx);
+        return;
+    }
+
+    packet_enqueue(&s->rx, packet_get(pkt));
+    netif_sock_event_trigger(&s->ethif->netif, s->idx,
+        NETIF_SOCK_EVENT_DATA_AVAIL);
+}
+
+int udp_netif_bind(etherif_t *ethif, u16 port)
+{
+    udp_netif_sock_t *s;
+    int idx;
+
+    if (port == UDP_PORT_ANY && udp_get_free_port(&port, ethif))
+        return -1;
+
+    if (udp_is_port_taken(ethif, port))
+    {
+        tp_err("UDP: port %d is not available\n", port);
+        return -1;
+    }
+
+    if ((idx = etherif_sock_alloc(ethif)) < 0)
+    {
+        tp_err("UDP: out of sockets\n");
+        return -1;
+    }
+
+    s = tmalloc_type(udp_netif_sock_t);
+    s->ethif = ethif;
+    s->idx = idx;
+    s->sock.local_port = port;
+    s->sock.remote_port = UDP_PORT_ANY;
+    s->sock.recv = udp_netif_recv;
+    packet_queue_init(&s->rx);
+    udp_register_socket(ethif, &s->sock);
+
+    s->next = udp_netif_socks;
+    udp_netif_socks = s;
+    return idx;
+}
+
+int udp_netif_sendto(etherif_t *ethif, int idx, u32 ip, u16 port, char *buf,
+    int size)
+{
+    udp_netif_sock_t *s = udp_netif_sock_get(ethif, idx);
+    packet_t *pkt;
+    int rc;
+
+    if (!s || !port || size < 0 || size > UDP_MAX_PAYLOAD)
+        return -1;
+
+    if (!ipv4_addr(ethif) || !(pkt = packet_alloc()))
+        return -1;
+
+    /* Payload is placed at the tail, headers are pushed into the headroom */
+    memcpy(packet_push(pkt, size), buf, size);
+    rc = udp_xmit(ethif, pkt, NULL, ipv4_addr(ethif), ip, s->sock.local_port,
+        port, size);
+    packet_put(pkt);
+    return rc ? -1 : size;
+}
+
+int udp_netif_recvfrom(etherif_t *ethif, int idx, char *buf, int size,
+    u32 *ip, u16 *port)
+{
+    udp_netif_sock_t *s = udp_netif_sock_get(ethif, idx);
+    packet_t *pkt;
+    udp_hdr_t *udph;
+    ip_hdr_t *iph;
+
+    if (!s || !(pkt = s->rx.head))
+        return -1;
+
+    if (!buf)
+        return pkt->length;
+
+    udph = (udp_hdr_t *)(pkt->ptr - sizeof(udp_hdr_t));
+    iph = (ip_hdr_t *)((u8 *)udph - sizeof(ip_hdr_t));
+    *ip = ntohl(iph->src_addr);
+    *port = ntohs(udph->src_port);
+    if (size > pkt->length)
+        size = pkt->length;
+    memcpy(buf, pkt->ptr, size);
+
+    packet_put(packet_dequeue(&s->rx));
+    return size;
+}
+
+static void udp_netif_sock_free(udp_netif_sock_t *s)
+{
+    udp_netif_sock_t **iter;
+
+    for (iter = &udp_netif_socks; *iter != s; iter = &(*iter)->next);
+    *iter = s->next;
+
+    udp_unregister_socket(s->ethif, &s->sock);
+    packet_queue_purge(&s->rx);
+    etherif_sock_free(s->ethif, s->idx);
+    tfree(s);
+}
+
+int udp_netif_close(etherif_t *ethif, int idx)
+{
+    udp_netif_sock_t *s = udp_netif_sock_get(ethif, idx);
+
+    if (!s)
+        return -1;
+
+    udp_netif_sock_free(s);
+    return 0;
+}
+
+void udp_etherif_uninit(etherif_t *ethif)
+{
+    udp_netif_sock_t *s, *next;
+
+    for (s = udp_netif_socks; s; s = next)
+    {
+        next = s->next;
+        if (s->ethif == ethif)
+            udp_netif_sock_free(s);
+    }
 }
 
 void udp_unregister_socket(etherif_t *ethif, udp_socket_t *sock)
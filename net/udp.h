@@ -26,6 +26,7 @@
 #define __UDP_H__
 
 #include "net/etherif.h"
+#include "net/packet.h"
 
 typedef struct udp_socket_t udp_socket_t;
 
@@ -35,23 +36,34 @@ struct udp_socket_t {
     udp_socket_t *next;
     u16 local_port; /* host order */
     u16 remote_port; /* host order */
-    void (*recv)(udp_socket_t *sock);
+    /* pkt ptr points to the UDP payload */
+    void (*recv)(udp_socket_t *sock, packet_t *pkt);
 };
 
 /* - packet ptr is expected to point to the UDP payload
  * - ports and addresses are in host order
  */
-int udp_xmit(etherif_t *ethif, const eth_mac_t *dst_mac, u32 src_addr,
-    u32 dst_addr, u16 src_port, u16 dst_port, u16 payload_len);
+int udp_xmit(etherif_t *ethif, packet_t *pkt, const eth_mac_t *dst_mac,
+    u32 src_addr, u32 dst_addr, u16 src_port, u16 dst_port, u16 payload_len);
 
 /* If the socket's local port is not provided, it is selected and set on xmit */
-int udp_sock_xmit(etherif_t *ethif, udp_socket_t *sock,
+int udp_sock_xmit(etherif_t *ethif, udp_socket_t *sock, packet_t *pkt,
     const eth_mac_t *dst_mac, u32 src_addr, u32 dst_addr, u16 payload_len);
 
 /* Sockets are assumed to be statically allocated */
 void udp_unregister_socket(etherif_t *ethif, udp_socket_t *sock);
 void udp_register_socket(etherif_t *ethif, udp_socket_t *sock);
 
+/* Sockets of the netif API, see netif_ops_t. Addresses are in host order */
+int udp_netif_bind(etherif_t *ethif, u16 port);
+int udp_netif_sendto(etherif_t *ethif, int idx, u32 ip, u16 port, char *buf,
+    int size);
+int udp_netif_recvfrom(etherif_t *ethif, int idx, char *buf, int size,
+    u32 *ip, u16 *port);
+/* Returns -1 if idx is not a UDP socket */
+int udp_netif_close(etherif_t *ethif, int idx);
+void udp_etherif_uninit(etherif_t *ethif);
+
 void udp_uninit(void);
 void udp_init(void);
 
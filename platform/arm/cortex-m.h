@@ -35,4 +35,12 @@ void cortex_m_meminfo(void);
 void cortex_m_reset_isr(void);
 void cortex_m_panic(void);
 
+/* Sleep until the next interrupt (SysTick included) */
+static inline void cortex_m_idle(void)
+{
+#ifdef CONFIG_PLAT_IDLE_SLEEP
+    __asm__ volatile ("wfi");
+#endif
+}
+
 #endif
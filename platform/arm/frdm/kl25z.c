@@ -109,7 +109,8 @@ static int kl25z_select(int ms)
     {
         event |= buffered_serial_events_process();
 
-        /* XXX: Sleep */
+        if (!event)
+            cortex_m_idle();
     }
 
     return event;
@@ -42,7 +42,8 @@ int stm32_select(int ms)
 #ifdef CONFIG_USB_DEVICE
         event |= stm32_usb_event_process();
 #endif
-        /* XXX: Sleep */
+        if (!event)
+            cortex_m_idle();
     }
 
     return event;
@@ -235,7 +235,8 @@ int ti_arm_mcu_select(int ms)
 #endif
         event |= buffered_serial_events_process();
 
-        ti_arm_mcu_sleep();
+        if (!event)
+            ti_arm_mcu_sleep();
     }
 
     return event;
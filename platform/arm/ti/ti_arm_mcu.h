@@ -138,7 +138,9 @@ static inline void ti_arm_mcu_periph_disable(unsigned long periph)
 
 static inline void ti_arm_mcu_sleep(void)
 {
-#if defined(CONFIG_STELLARIS) || defined(CONFIG_TIVA_C)
+#ifndef CONFIG_PLAT_IDLE_SLEEP
+    /* Busy poll */
+#elif defined(CONFIG_STELLARIS) || defined(CONFIG_TIVA_C)
     MAP_SysCtlSleep();
 #elif defined(CONFIG_CC3200)
     /* Not implemented yet */
@@ -64,6 +64,10 @@ ISR (TIMER0_COMPA_vect)
 static void avr8_init(void)
 {
     clock_init();
+#ifdef CONFIG_PLAT_IDLE_SLEEP
+    /* Timer0 keeps running in idle mode and wakes us every tick */
+    set_sleep_mode(SLEEP_MODE_IDLE);
+#endif
 }
 
 static int avr8_select(int ms)
@@ -75,6 +79,20 @@ static int avr8_select(int ms)
     {
         cli();
         event |= buffered_serial_events_process();
+#ifdef CONFIG_PLAT_IDLE_SLEEP
+        if (!event)
+        {
+            /* The instruction following sei() is guaranteed to execute
+             * before any pending interrupt, so we can't miss a wakeup
+             * between the check above and going to sleep.
+             */
+            sleep_enable();
+            sei();
+            sleep_cpu();
+            sleep_disable();
+            continue;
+        }
+#endif
         sei();
     }
     return event;
@@ -83,7 +83,7 @@ static void data_received(void *arg, char *pdata, unsigned short len)
 
     memcpy(rx_tail, pdata, len);
     rx_tail += len;
-    netif_event_trigger(&netif, NETIF_EVENT_TCP_DATA_AVAIL);
+    netif_sock_event_trigger(&netif, 0, NETIF_SOCK_EVENT_DATA_AVAIL);
     espconn_recv_hold(conn);
 }
 
@@ -93,12 +93,18 @@ static void tcp_connected(void *arg)
 
     rx_head = rx_tail = rx_buf;
     espconn_regist_recvcb(conn, data_received);
-    netif_event_trigger(&netif, NETIF_EVENT_L4_CONNECTED);
+    espconn_regist_sentcb(conn, data_sent);
+    netif_sock_event_trigger(&netif, 0, NETIF_SOCK_EVENT_CONNECTED);
+}
+
+static void data_sent(void *arg)
+{
+    netif_sock_event_trigger(&netif, 0, NETIF_SOCK_EVENT_WRITABLE);
 }
 
 static void tcp_disconnected(void *arg)
 {
-    netif_event_trigger(&netif, NETIF_EVENT_TCP_DISCONNECTED);
+    netif_sock_disconnected(&netif, 0);
 }
 
 static void esp8266_wifi_mac_addr_get(netif_t *netif, eth_mac_t *mac)
@@ -132,7 +138,7 @@ static void esp8266_wifi_ip_disconnect(netif_t *netif)
     wifi_station_disconnect();
 }
 
-static int esp8266_wifi_disconnect(netif_t *netif)
+static int esp8266_wifi_disconnect(netif_t *netif, int sock)
 {
     static struct espconn *conn = &connection;
 
@@ -174,6 +180,7 @@ static int esp8266_wifi_proto_connect(netif_t *netif, u8 proto, void *params)
     espconn_regist_disconcb(conn, tcp_disconnected);
     connection_on = 1;
     espconn_connect(conn);
+    /* Single connection, socket 0 */
     return 0;
 }
 
@@ -185,7 +192,8 @@ static u32 esp8266_wifi_ip_addr_get(netif_t *netif)
     return ntohl(info.ip.addr);
 }
 
-static int esp8266_wifi_tcp_read(netif_t *netif, char *buf, int size)
+static int esp8266_wifi_tcp_read(netif_t *netif, int sock, char *buf,
+    int size)
 {
     static struct espconn *conn = &connection;
 
@@ -198,7 +206,7 @@ static int esp8266_wifi_tcp_read(netif_t *netif, char *buf, int size)
     memcpy(buf, rx_head, size);
     rx_head += size;
     if (rx_tail - rx_head) /* More data waiting */
-        netif_event_trigger(netif, NETIF_EVENT_TCP_DATA_AVAIL);
+        netif_sock_event_trigger(netif, 0, NETIF_SOCK_EVENT_DATA_AVAIL);
     else
         espconn_recv_unhold(conn);
 
@@ -206,7 +214,8 @@ static int esp8266_wifi_tcp_read(netif_t *netif, char *buf, int size)
     return size;
 }
 
-static int esp8266_wifi_tcp_write(netif_t *netif, char *buf, int size)
+static int esp8266_wifi_tcp_write(netif_t *netif, int sock, char *buf,
+    int size)
 {
     struct espconn *conn = &connection;
 
@@ -179,9 +179,10 @@ void msp430f5529_serial_irq_enable(int u, int enabled)
 
 int msp430f5529_select(int ms)
 {
+    uint64_t expire = platform_get_ticks_from_boot() + ms;
     int event = 0;
 
-    while (!event)
+    while ((!ms || platform_get_ticks_from_boot() < expire) && !event)
     {
         event |= buffered_serial_events_process();
 #ifdef CONFIG_GPIO
@@ -37,7 +37,10 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
-#include <netpacket/packet.h>
+#ifdef CONFIG_LINUX_ETH_MMAP
+#include <sys/mman.h>
+#endif
+#include <linux/if_packet.h>
 #include <net/ethernet.h>
 #include <net/if.h>
 #include <net/if_arp.h>
@@ -47,26 +50,39 @@ typedef struct {
     event_t packet_event;
     char dev_name[IFNAMSIZ];
     eth_mac_t mac_addr;
+    int event_id; /* unix sim fd event ID */
     int packet_event_id;
     int packet_socket;
-    u8 last_packet[1518];
-    int last_packet_length;
+#ifdef CONFIG_LINUX_ETH_MMAP
+    u8 *ring;
+    int block; /* Block being consumed */
+    int frames_left; /* Frames not yet consumed in the current block */
+    struct tpacket3_hdr *frame; /* Next frame in the current block */
+#endif
 } linux_eth_t;
 
-/* Singleton for now */
-static linux_eth_t g_eth = { .packet_socket = -1 };
-
 #define ETHIF_TO_PACKET_ETH(x) container_of(x, linux_eth_t, ethif)
-#define NET_RES UART_RES(NET_ID)
 
-static void cur_packet_dump(linux_eth_t *eth) __attribute__((unused));
-static void cur_packet_dump(linux_eth_t *eth)
+#ifdef CONFIG_LINUX_ETH_MMAP
+#define LINUX_ETH_BLOCK_SIZE (1 << 15)
+#define LINUX_ETH_FRAME_SIZE (1 << 11)
+/* Partially filled blocks are handed over after this timeout */
+#define LINUX_ETH_BLOCK_TIMEOUT_MS 1
+#define LINUX_ETH_RING_SIZE \
+    (CONFIG_LINUX_ETH_RING_BLOCKS * LINUX_ETH_BLOCK_SIZE)
+#endif
+
+/* Each instance is a separate station on the wire */
+static u8 linux_eth_instances;
+
+static void packet_dump(u8 *buf, int len) __attribute__((unused));
+static void packet_dump(u8 *buf, int len)
 {
     int i;
 
     printf("\n-------------------------------------\n");
-    for (i = 0; i < eth->last_packet_length; i++)
-        printf("%02x%s", eth->last_packet[i], (i + 1) % 16 ? " " : "\n");
+    for (i = 0; i < len; i++)
+        printf("%02x%s", buf[i], (i + 1) % 16 ? " " : "\n");
     printf("-------------------------------------\n");
 }
 
@@ -87,35 +103,156 @@ static int linux_eth_link_status(etherif_t *ethif)
 
 static void linux_eth_mac_addr_get(etherif_t *ethif, eth_mac_t *mac)
 {
-    static u8 test_mac[] = { 0, 1, 2, 3, 4, 5 };
+    *mac = ETHIF_TO_PACKET_ETH(ethif)->mac_addr;
+}
+
+#ifdef CONFIG_LINUX_ETH_MMAP
+static struct tpacket_block_desc *linux_eth_block(linux_eth_t *eth)
+{
+    return (struct tpacket_block_desc *)(eth->ring +
+        eth->block * LINUX_ETH_BLOCK_SIZE);
+}
 
-    memcpy(mac->mac, test_mac, 6);
+static void linux_eth_block_release(linux_eth_t *eth)
+{
+    /* Frame reads must complete before the kernel reuses the block */
+    __sync_synchronize();
+    linux_eth_block(eth)->hdr.bh1.block_status = TP_STATUS_KERNEL;
+    eth->block = (eth->block + 1) % CONFIG_LINUX_ETH_RING_BLOCKS;
+}
+
+/* Returns the next frame in the ring or NULL if none. Blocks are handed to
+ * the kernel in order once all of their frames are consumed.
+ */
+static struct tpacket3_hdr *linux_eth_ring_frame(linux_eth_t *eth)
+{
+    struct tpacket_block_desc *bd;
+
+    while (!eth->frames_left)
+    {
+        bd = linux_eth_block(eth);
+        if (!(bd->hdr.bh1.block_status & TP_STATUS_USER))
+            return NULL;
+
+        __sync_synchronize();
+        eth->frames_left = bd->hdr.bh1.num_pkts;
+        eth->frame = (struct tpacket3_hdr *)((u8 *)bd +
+            bd->hdr.bh1.offset_to_first_pkt);
+        if (!eth->frames_left)
+            linux_eth_block_release(eth);
+    }
+
+    return eth->frame;
+}
+
+static void linux_eth_ring_frame_consume(linux_eth_t *eth)
+{
+    if (--eth->frames_left)
+    {
+        eth->frame = (struct tpacket3_hdr *)((u8 *)eth->frame +
+            eth->frame->tp_next_offset);
+        return;
+    }
+
+    linux_eth_block_release(eth);
 }
 
 static int linux_eth_packet_recv(etherif_t *ethif, u8 *buf, int size)
 {
     linux_eth_t *eth = ETHIF_TO_PACKET_ETH(ethif);
+    struct tpacket3_hdr *frame;
+
+    /* Nothing ready, an empty frame is dropped by the ethernet layer */
+    if (!(frame = linux_eth_ring_frame(eth)))
+        return 0;
+
+    if (size > frame->tp_snaplen)
+        size = frame->tp_snaplen;
+
+    memcpy(buf, (u8 *)frame + frame->tp_mac, size);
+    linux_eth_ring_frame_consume(eth);
+    return size;
+}
+
+static int linux_eth_packet_pending(etherif_t *ethif)
+{
+    return linux_eth_ring_frame(ETHIF_TO_PACKET_ETH(ethif)) != NULL;
+}
 
-    eth->last_packet_length = serial_read(NET_RES, (char *)eth->last_packet,
-        sizeof(eth->last_packet));
-    if (eth->last_packet_length <= 0)
+static int linux_eth_ring_init(linux_eth_t *eth)
+{
+    struct tpacket_req3 req;
+    int version = TPACKET_V3;
+
+    if (setsockopt(eth->packet_socket, SOL_PACKET, PACKET_VERSION, &version,
+        sizeof(version)) < 0)
+    {
+        perror("PACKET_VERSION");
+        return -1;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = LINUX_ETH_BLOCK_SIZE;
+    req.tp_block_nr = CONFIG_LINUX_ETH_RING_BLOCKS;
+    req.tp_frame_size = LINUX_ETH_FRAME_SIZE;
+    req.tp_frame_nr = LINUX_ETH_RING_SIZE / LINUX_ETH_FRAME_SIZE;
+    req.tp_retire_blk_tov = LINUX_ETH_BLOCK_TIMEOUT_MS;
+    if (setsockopt(eth->packet_socket, SOL_PACKET, PACKET_RX_RING, &req,
+        sizeof(req)) < 0)
+    {
+        perror("PACKET_RX_RING");
+        return -1;
+    }
+
+    eth->ring = mmap(NULL, LINUX_ETH_RING_SIZE, PROT_READ | PROT_WRITE,
+        MAP_SHARED, eth->packet_socket, 0);
+    if (eth->ring == MAP_FAILED)
+    {
+        perror("mmap");
+        return -1;
+    }
+
+    eth->block = 0;
+    eth->frames_left = 0;
+    return 0;
+}
+#else
+static int linux_eth_packet_recv(etherif_t *ethif, u8 *buf, int size)
+{
+    linux_eth_t *eth = ETHIF_TO_PACKET_ETH(ethif);
+    int len;
+
+    /* Frames are read straight into the packet. Packet sockets discard the
+     * part of a frame that does not fit.
+     */
+    if ((len = read(eth->packet_socket, buf, size)) <= 0)
     {
         perror("read");
         return -1;
     }
 
-    if (size > eth->last_packet_length)
-        size = eth->last_packet_length;
+    return len;
+}
 
-    memcpy(buf, eth->last_packet, size);
-    return size;
+static int linux_eth_packet_pending(etherif_t *ethif)
+{
+    linux_eth_t *eth = ETHIF_TO_PACKET_ETH(ethif);
+    int len = 0;
+
+    /* Length of the next queued frame */
+    if (ioctl(eth->packet_socket, FIONREAD, &len) < 0)
+        return 0;
+
+    return len > 0;
 }
+#endif
 
 static void linux_eth_packet_xmit(etherif_t *ethif, u8 *buf, int size)
 {
     linux_eth_t *eth = ETHIF_TO_PACKET_ETH(ethif);
 
-    serial_write(NET_RES, (char *)buf, size);
+    if (write(eth->packet_socket, buf, size) < 0)
+        perror("write");
     etherif_packet_xmitted(&eth->ethif);
 }
 
@@ -128,21 +265,33 @@ static void linux_eth_packet_event(event_t *ev, u32 resource_id, u64 timestamp)
     etherif_packet_received(&eth->ethif);
 }
 
+/* Deleted watches are purged by the event loop later on, so the instance
+ * is released together with its packet event.
+ */
+static void linux_eth_packet_event_free(event_t *ev)
+{
+    tfree(container_of(ev, linux_eth_t, packet_event));
+}
+
 static void linux_eth_free(etherif_t *ethif)
 {
     linux_eth_t *eth = ETHIF_TO_PACKET_ETH(ethif);
 
     event_watch_del(eth->packet_event_id);
-    unix_sim_remove_fd_event_from_map(NET_ID);
+    unix_sim_remove_fd_event_from_map(eth->event_id);
+    unix_sim_event_id_free(eth->event_id);
     etherif_destruct(ethif);
+#ifdef CONFIG_LINUX_ETH_MMAP
+    munmap(eth->ring, LINUX_ETH_RING_SIZE);
+#endif
     close(eth->packet_socket);
-    eth->packet_socket = -1;
 }
 
 static const etherif_ops_t linux_eth_ops = {
     .link_status = linux_eth_link_status,
     .mac_addr_get = linux_eth_mac_addr_get,
     .packet_recv = linux_eth_packet_recv,
+    .packet_pending = linux_eth_packet_pending,
     .packet_xmit = linux_eth_packet_xmit,
     .free = linux_eth_free,
 };
@@ -172,6 +321,16 @@ static int linux_eth_sock_init(linux_eth_t *eth)
 
     ifr = linux_eth_ioctl(eth, SIOCGIFINDEX);
 
+#ifdef CONFIG_LINUX_ETH_MMAP
+    /* Before binding, so that no frame is queued outside of the ring */
+    if (linux_eth_ring_init(eth))
+    {
+        close(eth->packet_socket);
+        eth->packet_socket = -1;
+        return -1;
+    }
+#endif
+
     memset(&sll, 0, sizeof(sll));
     sll.sll_family = AF_PACKET;
     sll.sll_protocol = htons(ETH_P_ALL);
@@ -188,26 +347,45 @@ static int linux_eth_sock_init(linux_eth_t *eth)
 
 netif_t *linux_eth_new(char *dev_name)
 {
-    linux_eth_t *eth = &g_eth;
+    static const eth_mac_t base_mac = { .mac = { 0, 1, 2, 3, 4, 5 } };
+    linux_eth_t *eth;
 
-    if (eth->packet_socket != -1)
+    if (strlen(dev_name) >= IFNAMSIZ)
     {
-        tp_warn("Only one device at a time. Removing old one\n");
-        etherif_free(&eth->ethif);
+        tp_err("Invalid device name %s\n", dev_name);
+        return NULL;
     }
 
+    eth = tmalloc_type(linux_eth_t);
     strcpy(eth->dev_name, dev_name);
+    eth->mac_addr = base_mac;
+    eth->mac_addr.mac[5] += linux_eth_instances;
 
     if (linux_eth_sock_init(eth))
-        return NULL;
+        goto Error;
 
-    eth->packet_event.trigger = linux_eth_packet_event;
+    if ((eth->event_id = unix_sim_event_id_alloc()) < 0)
+    {
+        close(eth->packet_socket);
+        goto Error;
+    }
+
+    linux_eth_instances++;
+    eth->packet_event = (event_t){
+        .trigger = linux_eth_packet_event,
+        .free = linux_eth_packet_event_free,
+    };
     etherif_construct(&eth->ethif, "Packet", &linux_eth_ops);
-    unix_sim_add_fd_event_to_map(NET_ID, eth->packet_socket,
+    unix_sim_add_fd_event_to_map(eth->event_id, eth->packet_socket,
         eth->packet_socket);
-    eth->packet_event_id = event_watch_set(NET_RES, &eth->packet_event);
+    eth->packet_event_id = event_watch_set(UART_RES(eth->event_id),
+        &eth->packet_event);
 
     printf("Created Linux Packet Ethernet Interface. fd %d\n",
         eth->packet_socket);
     return &eth->ethif.netif;
+
+Error:
+    tfree(eth);
+    return NULL;
 }
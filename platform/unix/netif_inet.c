@@ -43,14 +43,29 @@
 #include <ifaddrs.h>
 #include <linux/in.h> /* XXX: should use netinet/in.h */
 
+#define NETIF_INET_WBUF_SIZE 4096
+
+typedef struct netif_inet_t netif_inet_t;
+
 typedef struct {
+    netif_inet_t *inet;
+    int fd;
+    int event_id; /* unix sim fd event ID */
+    int connecting;
+    int listening;
+    int udp;
+    int hung_up; /* Closed by the peer, kept until the user disconnects */
+    char *wbuf; /* Pending output, allocated on first short write */
+    int wbuf_len;
+    event_t in_event;
+    event_t out_event;
+} netif_inet_sock_t;
+
+struct netif_inet_t {
     netif_t netif;
     char dev_name[IFNAMSIZ];
-    int socket;
-    event_t inet_event;
-} netif_inet_t;
-
-#define NET_RES UART_RES(NET_ID)
+    netif_inet_sock_t socks[NETIF_MAX_SOCKETS];
+};
 
 static netif_inet_t *netif_to_inet(netif_t *netif);
 
@@ -80,11 +95,113 @@ static u32 dev_ip_addr_get(const char *dev_name)
     return ret;
 }
 
-static void netif_inet_event(event_t *evt, u32 resource_id, u64 timestamp)
+static int sock_idx(netif_inet_sock_t *sock)
+{
+    return sock - sock->inet->socks;
+}
+
+static netif_inet_sock_t *sock_get(netif_t *netif, int idx)
+{
+    netif_inet_t *inet = netif_to_inet(netif);
+
+    if (idx < 0 || idx >= NETIF_MAX_SOCKETS || inet->socks[idx].fd < 0)
+        return NULL;
+
+    return &inet->socks[idx];
+}
+
+static void sock_close(netif_inet_sock_t *sock)
 {
-    netif_inet_t *inet = container_of(evt, netif_inet_t, inet_event);
+    if (sock->fd < 0)
+        return;
+
+    event_watch_del_by_resource(UART_RES(sock->event_id));
+    event_watch_del_by_resource(UART_TX_RES(sock->event_id));
+    unix_sim_remove_fd_event_from_map(sock->event_id);
+    unix_sim_event_id_free(sock->event_id);
+    close(sock->fd);
+    tfree(sock->wbuf);
+    sock->wbuf = NULL;
+    sock->wbuf_len = 0;
+    sock->connecting = 0;
+    sock->listening = 0;
+    sock->udp = 0;
+    sock->fd = -1;
+}
 
-    netif_event_trigger(&inet->netif, NETIF_EVENT_TCP_DATA_AVAIL);
+/* Connection lost: notify listeners. The slot stays taken until they call
+ * disconnect so its index can't be handed to another connection meanwhile.
+ */
+static void sock_hangup(netif_inet_sock_t *sock)
+{
+    netif_t *netif = &sock->inet->netif;
+    int idx = sock_idx(sock);
+
+    sock_close(sock);
+    sock->hung_up = 1;
+    netif_sock_disconnected(netif, idx);
+}
+
+static int sock_flush(netif_inet_sock_t *sock)
+{
+    int len;
+
+    if (!sock->wbuf_len)
+        return 0;
+
+    len = write(sock->fd, sock->wbuf, sock->wbuf_len);
+    if (len < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+
+    sock->wbuf_len -= len;
+    memmove(sock->wbuf, sock->wbuf + len, sock->wbuf_len);
+    return 0;
+}
+
+static void netif_inet_in_event(event_t *evt, u32 resource_id, u64 timestamp)
+{
+    netif_inet_sock_t *sock = container_of(evt, netif_inet_sock_t, in_event);
+
+    if (sock->connecting)
+        return;
+
+    netif_sock_event_trigger(&sock->inet->netif, sock_idx(sock),
+        sock->listening ? NETIF_SOCK_EVENT_ACCEPT :
+        NETIF_SOCK_EVENT_DATA_AVAIL);
+}
+
+static void netif_inet_out_event(event_t *evt, u32 resource_id, u64 timestamp)
+{
+    netif_inet_sock_t *sock = container_of(evt, netif_inet_sock_t, out_event);
+    netif_t *netif = &sock->inet->netif;
+    int idx = sock_idx(sock), err = 0;
+    socklen_t err_len = sizeof(err);
+
+    if (sock->connecting)
+    {
+        if (getsockopt(sock->fd, SOL_SOCKET, SO_ERROR, &err, &err_len) || err)
+        {
+            tp_err("netif_inet: connect failed: %s\n", strerror(err));
+            sock_hangup(sock);
+            return;
+        }
+
+        sock->connecting = 0;
+        netif_sock_event_trigger(netif, idx, NETIF_SOCK_EVENT_CONNECTED);
+    }
+
+    if (sock_flush(sock))
+    {
+        perror("netif_inet: write");
+        sock_hangup(sock);
+        return;
+    }
+
+    if (sock->wbuf_len)
+        return;
+
+    unix_sim_fd_event_write_watch(sock->event_id, 0);
+    netif_sock_event_trigger(netif, idx, NETIF_SOCK_EVENT_WRITABLE);
 }
 
 static void netif_inet_mac_addr_get(netif_t *netif, eth_mac_t *mac)
@@ -108,17 +225,15 @@ static void netif_inet_ip_disconnect(netif_t *netif)
     /* Nothing to do */
 }
 
-static int netif_inet_disconnect(netif_t *netif)
+static int netif_inet_disconnect(netif_t *netif, int idx)
 {
     netif_inet_t *inet = netif_to_inet(netif);
 
-    if (inet->socket < 0)
+    if (idx < 0 || idx >= NETIF_MAX_SOCKETS)
         return 0;
 
-    event_watch_del_by_resource(NET_RES);
-    unix_sim_remove_fd_event_from_map(NET_ID);
-    close(inet->socket);
-    inet->socket = -1;
+    sock_close(&inet->socks[idx]);
+    inet->socks[idx].hung_up = 0;
     return 0;
 }
 
@@ -127,112 +242,299 @@ static u32 netif_inet_ip_addr_get(netif_t *netif)
     return ntohl(dev_ip_addr_get(netif_to_inet(netif)->dev_name));
 }
 
-static int netif_inet_proto_connect(netif_t *netif, u8 proto, void *params)
+static netif_inet_sock_t *sock_alloc(netif_inet_t *inet)
 {
-    netif_inet_t *inet = netif_to_inet(netif);
-    struct sockaddr_in addr;
-    tcp_udp_connect_params_t *conn = params;
-    long on = 1;
-    int rc;
+    int i;
 
-    if (proto != IP_PROTOCOL_TCP)
+    for (i = 0; i < NETIF_MAX_SOCKETS &&
+        (inet->socks[i].fd >= 0 || inet->socks[i].hung_up); i++);
+    if (i == NETIF_MAX_SOCKETS)
     {
-        tp_err("Protocol %d not supported\n", proto);
-        return -1;
+        tp_err("netif_inet: out of sockets\n");
+        return NULL;
     }
 
-    if (inet->socket > 0)
-    {
-        tp_err("netif_inet: only one socket at a time for now\n");
-        return -1;
-    }
+    return &inet->socks[i];
+}
+
+/* Takes ownership of 'fd' */
+static netif_inet_sock_t *sock_open(netif_inet_t *inet, int fd)
+{
+    netif_inet_sock_t *sock;
+
+    if (!(sock = sock_alloc(inet)))
+        goto Error;
 
-    inet->socket = socket(AF_INET, SOCK_STREAM, 0);
-    if (inet->socket < 0)
+    if ((sock->event_id = unix_sim_event_id_alloc()) < 0)
+        goto Error;
+
+    sock->fd = fd;
+    unix_sim_add_fd_event_to_map(sock->event_id, fd, fd);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    sock->in_event = (event_t){ .trigger = netif_inet_in_event };
+    event_watch_set(UART_RES(sock->event_id), &sock->in_event);
+    sock->out_event = (event_t){ .trigger = netif_inet_out_event };
+    event_watch_set(UART_TX_RES(sock->event_id), &sock->out_event);
+    return sock;
+
+Error:
+    close(fd);
+    return NULL;
+}
+
+static int sock_create(netif_inet_t *inet, int type, u16 port)
+{
+    struct sockaddr_in addr;
+    long on = 1;
+    int fd;
+
+    fd = socket(AF_INET, type, 0);
+    if (fd < 0)
     {
         perror("netif_inet: socket");
         return -1;
     }
 
-    unix_sim_add_fd_event_to_map(NET_ID, inet->socket, inet->socket);
-
-    if (setsockopt(inet->socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)))
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)))
     {
         perror("netif_inet: setsockopt");
         goto Error;
     }
 
-    if (*inet->dev_name)
+    if (*inet->dev_name || port)
     {
         memset(&addr, 0, sizeof(addr));
         addr.sin_family = AF_INET;
-        addr.sin_addr.s_addr = dev_ip_addr_get(inet->dev_name);
-        addr.sin_port = 0;
+        addr.sin_addr.s_addr = *inet->dev_name ?
+            dev_ip_addr_get(inet->dev_name) : INADDR_ANY;
+        addr.sin_port = htons(port);
 
-        if (bind(inet->socket, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
         {
             perror("netif_inet: bind");
             goto Error;
         }
     }
 
-#if 0
-    /* XXX: problem - we only listen on in_fds in unix_select() */
-    /* Set the socket to non-blocking */
-    flags = fcntl(inet->socket, F_GETFL, 0);
-    fcntl(inet->socket, F_SETFL, flags | O_NONBLOCK);
-#endif
+    return fd;
+
+Error:
+    close(fd);
+    return -1;
+}
 
-    inet->inet_event = (event_t){ .trigger = netif_inet_event };
-    event_watch_set(NET_RES, &inet->inet_event);
+static int netif_inet_proto_connect(netif_t *netif, u8 proto, void *params)
+{
+    netif_inet_t *inet = netif_to_inet(netif);
+    netif_inet_sock_t *sock;
+    struct sockaddr_in addr;
+    tcp_udp_connect_params_t *conn = params;
+    int fd, rc;
+
+    if (proto != IP_PROTOCOL_TCP)
+    {
+        tp_err("Protocol %d not supported\n", proto);
+        return -1;
+    }
+
+    if ((fd = sock_create(inet, SOCK_STREAM, 0)) < 0 ||
+        !(sock = sock_open(inet, fd)))
+    {
+        return -1;
+    }
 
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
     addr.sin_port = htons(conn->port);
     addr.sin_addr.s_addr = htonl(conn->ip);
-    rc = connect(inet->socket, (struct sockaddr *)&addr, sizeof(addr));
+    rc = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
     if (rc < 0 && errno != EINPROGRESS)
     {
         perror("netif_inet: connect");
-        goto Error;
+        sock_close(sock);
+        return -1;
     }
 
-    netif_event_trigger(netif, NETIF_EVENT_L4_CONNECTED);
-    return 0;
-
-Error:
-    netif_inet_disconnect(netif);
-    return -1;
+    /* Connection completion is reported once the socket becomes writable */
+    sock->connecting = 1;
+    unix_sim_fd_event_write_watch(sock->event_id, 1);
+    return sock_idx(sock);
 }
 
-static int netif_inet_tcp_read(netif_t *netif, char *buf, int size)
+static int netif_inet_tcp_listen(netif_t *netif, u16 port)
 {
     netif_inet_t *inet = netif_to_inet(netif);
+    netif_inet_sock_t *sock;
+    int fd;
+
+    if ((fd = sock_create(inet, SOCK_STREAM, port)) < 0 ||
+        !(sock = sock_open(inet, fd)))
+    {
+        return -1;
+    }
+
+    if (listen(fd, NETIF_MAX_SOCKETS) < 0)
+    {
+        perror("netif_inet: listen");
+        sock_close(sock);
+        return -1;
+    }
+
+    sock->listening = 1;
+    return sock_idx(sock);
+}
+
+static int netif_inet_tcp_accept(netif_t *netif, int idx)
+{
+    netif_inet_sock_t *sock = sock_get(netif, idx);
+    int fd;
+
+    if (!sock || !sock->listening)
+        return -1;
+
+    if ((fd = accept(sock->fd, NULL, NULL)) < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            perror("netif_inet: accept");
+        return -1;
+    }
+
+    if (!(sock = sock_open(sock->inet, fd)))
+        return -1;
+
+    return sock_idx(sock);
+}
+
+static int netif_inet_tcp_read(netif_t *netif, int idx, char *buf, int size)
+{
+    netif_inet_sock_t *sock = sock_get(netif, idx);
     int len;
 
-    if (inet->socket < 0)
+    if (!sock || sock->connecting || sock->listening || sock->udp)
         return -1;
 
-    len = read(inet->socket, buf, size);
-    if (!len)
-        netif_event_trigger(netif, NETIF_EVENT_TCP_DISCONNECTED);
+    len = read(sock->fd, buf, size);
+    if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return 0;
+
+    if (len <= 0)
+        sock_hangup(sock);
     return len;
 }
 
-static int netif_inet_tcp_write(netif_t *netif, char *buf, int size)
+static int netif_inet_tcp_write(netif_t *netif, int idx, char *buf, int size)
+{
+    netif_inet_sock_t *sock = sock_get(netif, idx);
+    int len = 0, room;
+
+    if (!sock || sock->listening || sock->udp)
+        return -1;
+
+    /* Preserve ordering: only write directly if nothing is pending */
+    if (!sock->connecting && !sock->wbuf_len)
+    {
+        len = write(sock->fd, buf, size);
+        if (len < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                perror("netif_inet: write");
+                return -1;
+            }
+            len = 0;
+        }
+        if (len == size)
+            return len;
+    }
+
+    if (!sock->wbuf)
+        sock->wbuf = tmalloc(NETIF_INET_WBUF_SIZE, "netif_inet wbuf");
+
+    room = NETIF_INET_WBUF_SIZE - sock->wbuf_len;
+    if (room > size - len)
+        room = size - len;
+
+    memcpy(sock->wbuf + sock->wbuf_len, buf + len, room);
+    sock->wbuf_len += room;
+    unix_sim_fd_event_write_watch(sock->event_id, 1);
+    return len + room;
+}
+
+static int netif_inet_udp_bind(netif_t *netif, u16 port)
 {
     netif_inet_t *inet = netif_to_inet(netif);
+    netif_inet_sock_t *sock;
+    int fd;
+
+    if ((fd = sock_create(inet, SOCK_DGRAM, port)) < 0 ||
+        !(sock = sock_open(inet, fd)))
+    {
+        return -1;
+    }
+
+    sock->udp = 1;
+    return sock_idx(sock);
+}
+
+static int netif_inet_udp_sendto(netif_t *netif, int idx, u32 ip, u16 port,
+    char *buf, int size)
+{
+    netif_inet_sock_t *sock = sock_get(netif, idx);
+    struct sockaddr_in addr;
 
-    if (inet->socket < 0)
+    if (!sock || !sock->udp)
         return -1;
 
-    return write(inet->socket, buf, size);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(ip);
+    if (sendto(sock->fd, buf, size, 0, (struct sockaddr *)&addr,
+        sizeof(addr)) < 0)
+    {
+        perror("netif_inet: sendto");
+        return -1;
+    }
+
+    return size;
+}
+
+static int netif_inet_udp_recvfrom(netif_t *netif, int idx, char *buf,
+    int size, u32 *ip, u16 *port)
+{
+    netif_inet_sock_t *sock = sock_get(netif, idx);
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int len;
+
+    if (!sock || !sock->udp)
+        return -1;
+
+    if (!buf)
+        return recv(sock->fd, NULL, 0, MSG_PEEK | MSG_TRUNC);
+
+    len = recvfrom(sock->fd, buf, size, 0, (struct sockaddr *)&addr,
+        &addr_len);
+    if (len < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            perror("netif_inet: recvfrom");
+        return -1;
+    }
+
+    *ip = ntohl(addr.sin_addr.s_addr);
+    *port = ntohs(addr.sin_port);
+    return len;
 }
 
 static void netif_inet_free(netif_t *netif)
 {
     netif_inet_t *inet = netif_to_inet(netif);
+    int i;
 
+    for (i = 0; i < NETIF_MAX_SOCKETS; i++)
+        sock_close(&inet->socks[i]);
     netif_unregister(netif);
     tfree(inet);
 }
@@ -245,6 +547,11 @@ static const netif_ops_t netif_inet_ops = {
     .proto_connect = netif_inet_proto_connect,
     .tcp_read = netif_inet_tcp_read ,
     .tcp_write = netif_inet_tcp_write,
+    .tcp_listen = netif_inet_tcp_listen,
+    .tcp_accept = netif_inet_tcp_accept,
+    .udp_bind = netif_inet_udp_bind,
+    .udp_sendto = netif_inet_udp_sendto,
+    .udp_recvfrom = netif_inet_udp_recvfrom,
     .disconnect = netif_inet_disconnect,
     .ip_addr_get = netif_inet_ip_addr_get,
     .free = netif_inet_free,
@@ -259,6 +566,7 @@ netif_inet_t *netif_to_inet(netif_t *netif)
 netif_t *netif_inet_new(char *dev_name)
 {
     netif_inet_t *inet;
+    int i;
 
     if (dev_name && strlen(dev_name) >= IFNAMSIZ)
     {
@@ -271,7 +579,8 @@ netif_t *netif_inet_new(char *dev_name)
         strcpy(inet->dev_name, dev_name);
     else
         inet->dev_name[0] = '\0';
-    inet->socket = -1;
+    for (i = 0; i < NETIF_MAX_SOCKETS; i++)
+        inet->socks[i] = (netif_inet_sock_t){ .inet = inet, .fd = -1 };
 
     netif_register(&inet->netif, "INET", &netif_inet_ops);
     printf("Created INET Interface\n");
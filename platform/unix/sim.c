@@ -41,10 +41,9 @@
 static int pty_fd = -1;
 static int ext_tty_fd = -1;
 
-static int unix_sim_event_fd_count;
-static unix_fd_event_map_t unix_sim_event_fd_map[NUM_IDS + 1] = { 
-    [0 ... NUM_IDS] = { .event = -1 }
-};
+static unix_fd_event_map_t unix_sim_event_fd_map;
+/* Dynamically allocated event IDs, see unix_sim_event_id_alloc() */
+static unsigned char unix_sim_event_id_used[UNIX_MAX_FD_EVENTS];
 
 #define STDIN_FD 0
 #define STDOUT_FD 1
@@ -55,22 +54,40 @@ FILE *block_disk;
 void unix_sim_add_fd_event_to_map(int event, int in_fd,
     int out_fd)
 {
-    unix_sim_event_fd_map[unix_sim_event_fd_count].event = event;
-    unix_sim_event_fd_map[unix_sim_event_fd_count].in_fd = in_fd;
-    unix_sim_event_fd_map[unix_sim_event_fd_count].out_fd = out_fd;
-    unix_sim_event_fd_count++;
+    if (unix_fd_event_add(&unix_sim_event_fd_map, event, in_fd, out_fd))
+        tp_crit("Failed adding fd event %d\n", event);
 }
 
 void unix_sim_remove_fd_event_from_map(int event)
 {
-    unix_fd_event_map_t *from, *to;
-
-    for (to = unix_sim_event_fd_map; to->event != event; to++);
-    tp_assert(to->event != -1);
-    from = to;
-    while (to->event != -1)
-        *to++ = *++from;
-    unix_sim_event_fd_count--;
+    unix_fd_event_remove(&unix_sim_event_fd_map, event);
+}
+
+int unix_sim_fd_event_write_watch(int event, int enable)
+{
+    return unix_fd_event_write_watch(&unix_sim_event_fd_map, event, enable);
+}
+
+int unix_sim_event_id_alloc(void)
+{
+    int id;
+
+    for (id = NUM_IDS; id < UNIX_MAX_FD_EVENTS && unix_sim_event_id_used[id];
+        id++);
+    if (id == UNIX_MAX_FD_EVENTS)
+    {
+        tp_err("Out of event IDs\n");
+        return -1;
+    }
+
+    unix_sim_event_id_used[id] = 1;
+    return id;
+}
+
+void unix_sim_event_id_free(int id)
+{
+    tp_assert(id >= NUM_IDS && id < UNIX_MAX_FD_EVENTS);
+    unix_sim_event_id_used[id] = 0;
 }
 
 #ifdef CONFIG_PLATFORM_EMULATION_PTY_TERM
@@ -126,17 +143,17 @@ static int ext_tty_open(void)
 
 static int sim_unix_select(int ms)
 {
-    return unix_select(ms, unix_sim_event_fd_map);
+    return unix_select(ms, &unix_sim_event_fd_map);
 }
 
 static int sim_unix_serial_read(int id, char *buf, int size)
 {
-    return unix_read(id, buf, size, unix_sim_event_fd_map);
+    return unix_read(id, buf, size, &unix_sim_event_fd_map);
 }
 
 static int sim_unix_serial_write(int id, char *buf, int size)
 {
-    return unix_write(id, buf, size, unix_sim_event_fd_map);
+    return unix_write(id, buf, size, &unix_sim_event_fd_map);
 }
 
 static int sim_unix_serial_enable(int id, int enabled)
@@ -163,10 +180,20 @@ static int sim_unix_serial_enable(int id, int enabled)
         break;
 #endif
     default:
+        /* Dynamic IDs are mapped by whoever allocated them */
+        if (id >= NUM_IDS)
+            return 0;
+
         tp_err("Unsupported Serial ID %d\n", id);
         return -1;
     }
 
+    if (in_fd < 0)
+    {
+        tp_err("Failed opening Serial ID %d\n", id);
+        return -1;
+    }
+
     unix_set_nonblock(in_fd);
     unix_set_term_raw(in_fd, 1);
     unix_sim_add_fd_event_to_map(id, in_fd, out_fd);
@@ -221,7 +248,7 @@ int sim_unix_block_disk_read(unsigned char *buf, int sector, int count)
         return -1;
     }
 
-    n = fread(buf, count, SEC_SIZE, block_disk);
+    n = fread(buf, SEC_SIZE, count, block_disk) * SEC_SIZE;
     if (n != count * SEC_SIZE)
     {
         tp_err("read %d/%d bytes\n", n, count * SEC_SIZE);
@@ -241,7 +268,7 @@ int sim_unix_block_disk_write(const unsigned char *buf, int sector, int count)
         return -1;
     }
 
-    n = fwrite(buf, count, SEC_SIZE, block_disk);
+    n = fwrite(buf, SEC_SIZE, count, block_disk) * SEC_SIZE;
     if (n != count * SEC_SIZE)
     {
         tp_err("wrote %d/%d bytes\n", n, count * SEC_SIZE);
@@ -284,6 +311,7 @@ static void sim_unix_uninit(void)
         fclose(block_disk);
     set_sigint_handler(SIG_DFL);
     unix_set_term_raw(STDIN_FD, 0);
+    unix_fd_event_map_uninit(&unix_sim_event_fd_map);
     unix_uninit();
 }
 
@@ -292,6 +320,7 @@ static void sim_unix_init(void)
     printf("Unix Platform Simulator Init\n");
 
     unix_init();
+    unix_fd_event_map_init(&unix_sim_event_fd_map);
 
     set_sigint_handler(sigint_handler);
 
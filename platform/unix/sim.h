@@ -31,9 +31,14 @@
 #define PTY_ID 1
 #define NET_ID 2
 #define EXT_TTY_ID 3
-#define NUM_IDS 4
+#define NUM_IDS 4 /* Static IDs, dynamic IDs are allocated above these */
 
 void unix_sim_add_fd_event_to_map(int event, int in_fd, int out_fd);
 void unix_sim_remove_fd_event_from_map(int event);
+/* Write readiness triggers UART_TX_RES(event) */
+int unix_sim_fd_event_write_watch(int event, int enable);
+
+int unix_sim_event_id_alloc(void);
+void unix_sim_event_id_free(int id);
 
 #endif
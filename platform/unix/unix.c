@@ -42,57 +42,312 @@
 #include <sys/select.h>
 #include "platform/unix/unix.h"
 #include "drivers/serial/serial_platform.h"
+#include "util/tp_misc.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#define UNIX_EPOLL
+#endif
+
+#define UNIX_FD_EVENT_OUT_FD_FLAG 0x10000
 
 static struct timeval boot;
 
+static unix_fd_event_t *fd_event_get(unix_fd_event_map_t *map, int event)
+{
+    if (event < 0 || event >= UNIX_MAX_FD_EVENTS || !map->fds[event].watched)
+    {
+        printf("invalid event id %d\n", event);
+        exit(1);
+    }
+
+    return &map->fds[event];
+}
+
+static void fd_event_ready(int event, int out)
+{
+    if (out)
+        serial_tx_event_trigger(event);
+    else
+        serial_event_trigger(event);
+}
+
+#ifdef UNIX_EPOLL
+
+#define UNIX_EPOLL_MAX_EVENTS 64
+
+static void fd_events_always_ready(unix_fd_event_map_t *map)
+{
+    int event;
+
+    for (event = 0; event < UNIX_MAX_FD_EVENTS; event++)
+    {
+        unix_fd_event_t *fde = &map->fds[event];
+
+        if (!fde->always_ready)
+            continue;
+
+        fd_event_ready(event, 0);
+        if (fde->watched & UNIX_FD_EVENT_OUT)
+            fd_event_ready(event, 1);
+    }
+}
+
+static int fd_event_poll_set(unix_fd_event_map_t *map, int op, int fd,
+    uint32_t events, uint32_t data)
+{
+    struct epoll_event ev = { .events = events, .data.u32 = data };
+
+    return epoll_ctl(map->poll_fd, op, fd, &ev);
+}
+
+static int fd_event_poll_register(unix_fd_event_map_t *map, int event,
+    unix_fd_event_t *fde)
+{
+    if (!fd_event_poll_set(map, EPOLL_CTL_ADD, fde->in_fd, EPOLLIN, event))
+        return 0;
+
+    if (errno != EPERM)
+    {
+        perror("epoll_ctl");
+        return -1;
+    }
+
+    /* Regular files can't be polled, but are always readable */
+    fde->always_ready = 1;
+    map->always_ready_count++;
+    return 0;
+}
+
+static void fd_event_poll_unregister(unix_fd_event_map_t *map,
+    unix_fd_event_t *fde)
+{
+    if (fde->always_ready)
+        return;
+
+    fd_event_poll_set(map, EPOLL_CTL_DEL, fde->in_fd, 0, 0);
+    if ((fde->watched & UNIX_FD_EVENT_OUT) && fde->out_fd != fde->in_fd)
+        fd_event_poll_set(map, EPOLL_CTL_DEL, fde->out_fd, 0, 0);
+}
+
+static int fd_event_poll_write_watch(unix_fd_event_map_t *map, int event,
+    unix_fd_event_t *fde, int enable)
+{
+    if (fde->always_ready)
+        return 0;
+
+    if (fde->out_fd == fde->in_fd)
+    {
+        return fd_event_poll_set(map, EPOLL_CTL_MOD, fde->in_fd,
+            EPOLLIN | (enable ? EPOLLOUT : 0), event);
+    }
+
+    return fd_event_poll_set(map, enable ? EPOLL_CTL_ADD : EPOLL_CTL_DEL,
+        fde->out_fd, EPOLLOUT, event | UNIX_FD_EVENT_OUT_FD_FLAG);
+}
+
 int unix_select(int ms, unix_fd_event_map_t *map)
 {
-    fd_set rfds;
+    struct epoll_event events[UNIX_EPOLL_MAX_EVENTS];
+    int rc, i, timeout;
+
+    /* ms == 0 means wait forever. Don't block if some fds are always ready */
+    timeout = map->always_ready_count ? 0 : ms ? ms : -1;
+
+    rc = epoll_wait(map->poll_fd, events, UNIX_EPOLL_MAX_EVENTS, timeout);
+    if (rc == -1 && errno != EINTR)
+        perror("epoll_wait");
+
+    for (i = 0; i < rc; i++)
+    {
+        uint32_t data = events[i].data.u32;
+        int event = data & ~UNIX_FD_EVENT_OUT_FD_FLAG;
+
+        if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+            !(data & UNIX_FD_EVENT_OUT_FD_FLAG))
+        {
+            fd_event_ready(event, 0);
+        }
+        if ((events[i].events & (EPOLLOUT | EPOLLERR)) &&
+            (map->fds[event].watched & UNIX_FD_EVENT_OUT))
+        {
+            fd_event_ready(event, 1);
+        }
+    }
+
+    if (map->always_ready_count)
+    {
+        fd_events_always_ready(map);
+        rc = (rc < 0 ? 0 : rc) + map->always_ready_count;
+    }
+    return rc;
+}
+
+#else
+
+static int fd_event_poll_register(unix_fd_event_map_t *map, int event,
+    unix_fd_event_t *fde)
+{
+    return 0;
+}
+
+static void fd_event_poll_unregister(unix_fd_event_map_t *map,
+    unix_fd_event_t *fde)
+{
+}
+
+static int fd_event_poll_write_watch(unix_fd_event_map_t *map, int event,
+    unix_fd_event_t *fde, int enable)
+{
+    return 0;
+}
+
+int unix_select(int ms, unix_fd_event_map_t *map)
+{
+    fd_set rfds, wfds;
     struct timeval tv;
-    int rc, sec, max_fd = 0;
-    unix_fd_event_map_t *iter;
+    int rc, sec, max_fd = 0, event;
 
     FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
 
-    for (iter = map; iter->event != -1; iter++)
+    for (event = 0; event < UNIX_MAX_FD_EVENTS; event++)
     {
-        FD_SET(iter->in_fd, &rfds);
-        if (iter->in_fd > max_fd - 1)
-            max_fd = iter->in_fd + 1;
+        unix_fd_event_t *fde = &map->fds[event];
+
+        if (!fde->watched)
+            continue;
+
+        FD_SET(fde->in_fd, &rfds);
+        if (fde->in_fd > max_fd - 1)
+            max_fd = fde->in_fd + 1;
+
+        if (!(fde->watched & UNIX_FD_EVENT_OUT))
+            continue;
+
+        FD_SET(fde->out_fd, &wfds);
+        if (fde->out_fd > max_fd - 1)
+            max_fd = fde->out_fd + 1;
     }
 
     sec = ms / 1000;
     tv.tv_sec = sec;
     tv.tv_usec = (ms - sec * 1000) * 1000;
 
-    rc = select(max_fd, &rfds, NULL, NULL, ms ? &tv : NULL);
+    rc = select(max_fd, &rfds, &wfds, NULL, ms ? &tv : NULL);
     if (rc == -1 && errno != EINTR)
         perror("select");
     if (rc > 0)
     {
-        for (iter = map; iter->event != -1; iter++)
+        for (event = 0; event < UNIX_MAX_FD_EVENTS; event++)
         {
-            if (!FD_ISSET(iter->in_fd, &rfds))
+            unix_fd_event_t *fde = &map->fds[event];
+
+            if (!fde->watched)
                 continue;
-                
-            serial_event_trigger(iter->event);
+
+            if (FD_ISSET(fde->in_fd, &rfds))
+                fd_event_ready(event, 0);
+            if ((fde->watched & UNIX_FD_EVENT_OUT) &&
+                FD_ISSET(fde->out_fd, &wfds))
+            {
+                fd_event_ready(event, 1);
+            }
         }
     }
     return rc;
 }
 
-static int get_event_fd(int event, unix_fd_event_map_t *map, int in)
+#endif
+
+int unix_fd_event_map_init(unix_fd_event_map_t *map)
 {
-    unix_fd_event_map_t *iter;
+    memset(map, 0, sizeof(*map));
+#ifdef UNIX_EPOLL
+    if ((map->poll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+    {
+        perror("epoll_create1");
+        return -1;
+    }
+#else
+    map->poll_fd = -1;
+#endif
+    return 0;
+}
 
-    for (iter = map; iter->event != -1 && iter->event != event; iter++);
-    if (iter->event == -1)
+void unix_fd_event_map_uninit(unix_fd_event_map_t *map)
+{
+    if (map->poll_fd >= 0)
+        close(map->poll_fd);
+    map->poll_fd = -1;
+}
+
+int unix_fd_event_add(unix_fd_event_map_t *map, int event, int in_fd,
+    int out_fd)
+{
+    unix_fd_event_t *fde;
+
+    if (event < 0 || event >= UNIX_MAX_FD_EVENTS)
     {
         printf("invalid event id %d\n", event);
-        exit(1);
+        return -1;
+    }
+
+    fde = &map->fds[event];
+    if (fde->watched)
+    {
+        /* Re-enabling the same device */
+        if (fde->in_fd == in_fd && fde->out_fd == out_fd)
+            return 0;
+
+        unix_fd_event_remove(map, event);
+    }
+
+    fde->in_fd = in_fd;
+    fde->out_fd = out_fd;
+    fde->always_ready = 0;
+    if (fd_event_poll_register(map, event, fde))
+        return -1;
+
+    fde->watched = UNIX_FD_EVENT_IN;
+    map->count++;
+    return 0;
+}
+
+void unix_fd_event_remove(unix_fd_event_map_t *map, int event)
+{
+    unix_fd_event_t *fde = fd_event_get(map, event);
+
+    fd_event_poll_unregister(map, fde);
+    if (fde->always_ready)
+        map->always_ready_count--;
+    memset(fde, 0, sizeof(*fde));
+    map->count--;
+}
+
+int unix_fd_event_write_watch(unix_fd_event_map_t *map, int event,
+    int enable)
+{
+    unix_fd_event_t *fde = fd_event_get(map, event);
+
+    if (!enable == !(fde->watched & UNIX_FD_EVENT_OUT))
+        return 0;
+
+    if (fd_event_poll_write_watch(map, event, fde, enable))
+    {
+        perror("write watch");
+        return -1;
     }
 
-    return in ? iter->in_fd : iter->out_fd;
+    bit_set(fde->watched, UNIX_FD_EVENT_OUT, enable);
+    return 0;
+}
+
+static int get_event_fd(int event, unix_fd_event_map_t *map, int in)
+{
+    unix_fd_event_t *fde = fd_event_get(map, event);
+
+    return in ? fde->in_fd : fde->out_fd;
 }
 
 int unix_read(int event, char *buf, int size, unix_fd_event_map_t *map)
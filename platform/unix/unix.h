@@ -27,12 +27,39 @@
 
 #include "platform/platform.h"
 
+/* Event IDs are used as serial resource minors, see UART_RES() */
+#define UNIX_MAX_FD_EVENTS 256
+
+#define UNIX_FD_EVENT_IN 0x1
+#define UNIX_FD_EVENT_OUT 0x2
+
 typedef struct {
-    int event;
     int in_fd;
     int out_fd;
+    int watched; /* UNIX_FD_EVENT_XXX */
+    int always_ready; /* fd can't be polled (e.g. regular file) */
+} unix_fd_event_t;
+
+/* Maps event IDs to the file descriptors backing them.
+ * On Linux, fds are registered once with epoll, otherwise the select()
+ * fd sets are built from the map on each call.
+ */
+typedef struct {
+    int poll_fd;
+    int count;
+    int always_ready_count;
+    unix_fd_event_t fds[UNIX_MAX_FD_EVENTS];
 } unix_fd_event_map_t;
 
+int unix_fd_event_map_init(unix_fd_event_map_t *map);
+void unix_fd_event_map_uninit(unix_fd_event_map_t *map);
+int unix_fd_event_add(unix_fd_event_map_t *map, int event, int in_fd,
+    int out_fd);
+void unix_fd_event_remove(unix_fd_event_map_t *map, int event);
+/* Enable/disable write readiness notifications on event's out_fd */
+int unix_fd_event_write_watch(unix_fd_event_map_t *map, int event,
+    int enable);
+
 void unix_set_term_raw(int fd, int raw);
 void unix_set_nonblock(int fd);
 
@@ -0,0 +1,123 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/* Host tool compressing stdin to stdout in the format decoded by
+ * util/lzss.c
+ *
+ * Usage: lzss_compress <window size>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "util/lzss.h"
+
+static unsigned char *read_all(FILE *f, int *size)
+{
+    unsigned char *buf = NULL;
+    int n, alloc = 0;
+
+    *size = 0;
+    do {
+        if (*size == alloc)
+        {
+            alloc = alloc ? alloc * 2 : 4096;
+            if (!(buf = realloc(buf, alloc)))
+                exit(1);
+        }
+        n = fread(buf + *size, 1, alloc - *size, f);
+        *size += n;
+    } while (n > 0);
+
+    return buf;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned char *in, group[1 + 8 * 2];
+    int size, window, pos = 0, items = 0, group_len = 1;
+
+    if (argc != 2 || (window = atoi(argv[1])) < LZSS_MAX_MATCH ||
+        window > LZSS_MAX_WINDOW)
+    {
+        fprintf(stderr, "Usage: %s <window size (%d-%d)>\n", argv[0],
+            LZSS_MAX_MATCH, LZSS_MAX_WINDOW);
+        return 1;
+    }
+
+    in = read_all(stdin, &size);
+    putchar(size & 0xff);
+    putchar((size >> 8) & 0xff);
+    putchar((size >> 16) & 0xff);
+    putchar((size >> 24) & 0xff);
+
+    group[0] = 0;
+    while (pos < size)
+    {
+        int off, best_len = 0, best_off = 0;
+
+        /* Greedy longest match, nearest first */
+        for (off = 1; off <= window && off <= pos; off++)
+        {
+            int len = 0;
+
+            while (len < LZSS_MAX_MATCH && pos + len < size &&
+                in[pos + len] == in[pos + len - off])
+            {
+                len++;
+            }
+
+            if (len > best_len)
+            {
+                best_len = len;
+                best_off = off;
+            }
+        }
+
+        if (best_len >= LZSS_MIN_MATCH)
+        {
+            group[group_len++] = (best_off - 1) & 0xff;
+            group[group_len++] = ((best_off - 1) >> 8) << 4 |
+                (best_len - LZSS_MIN_MATCH);
+            pos += best_len;
+        }
+        else
+        {
+            group[0] |= 1 << items;
+            group[group_len++] = in[pos++];
+        }
+
+        if (++items == 8)
+        {
+            fwrite(group, 1, group_len, stdout);
+            group[0] = 0;
+            group_len = 1;
+            items = 0;
+        }
+    }
+
+    if (items)
+        fwrite(group, 1, group_len, stdout);
+
+    free(in);
+    return 0;
+}
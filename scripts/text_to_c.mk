@@ -20,3 +20,55 @@ $1:: $2 scripts/text_to_c_str.sed
 	$$(Q)echo ";" >> $1
 
 endef
+
+# bin_to_c - same as text_to_c, but the file content is kept as is. The file
+# must not contain 0 bytes.
+#
+# Usage $(eval $(call bin_to_c,$1,$2,$3))
+
+define bin_to_c
+
+AUTO_GEN_FILES+=$1
+MK_OBJS+=$(notdir $(1:%.c=%.o))
+
+$1:: $2
+	@echo GEN $$@
+	$$(Q)echo "#include \"util/tstr.h\"" > $1
+	$$(Q)echo -n "char *$3 = " >> $1
+	$$(Q)od -An -v -tx1 $2 | sed 's/ \([0-9a-f][0-9a-f]\)/\\x\1/g;s/^/"/;s/$$$$/"/' >> $1
+	$$(Q)echo ";" >> $1
+
+endef
+
+# lz_to_c - same as bin_to_c, but the file content is compressed by
+# scripts/lzss_compress.c, so it may hold any byte. Text files are
+# preprocessed as text_to_c does.
+#
+# Usage $(eval $(call lz_to_c,$1,$2,$3,$4))
+#
+# $4 - "text" for text files
+
+LZSS_COMPRESS:=$(BUILD)/scripts/lzss_compress
+HOSTCC?=cc
+AUTO_GEN_FILES+=$(LZSS_COMPRESS)
+
+$(LZSS_COMPRESS): scripts/lzss_compress.c util/lzss.h util/tp_types.h
+	@echo HOSTCC $@
+	$(Q)mkdir -p $(dir $@)
+	$(Q)$(HOSTCC) -O2 -I. -o $@ $<
+
+define lz_to_c
+
+AUTO_GEN_FILES+=$1
+MK_OBJS+=$(notdir $(1:%.c=%.o))
+
+$1:: $2 $(LZSS_COMPRESS)
+	@echo GEN $$@
+	$$(Q)echo "#include \"util/tstr.h\"" > $1
+	$$(Q)echo -n "char *$3 = " >> $1
+	$$(Q)$(if $4,cpp -P $2 | tr -d '\t',cat $2) | \
+	  $(LZSS_COMPRESS) $(CONFIG_BUILTIN_FS_COMPRESS_WINDOW) | od -An -v -tx1 | \
+	  sed 's/ \([0-9a-f][0-9a-f]\)/\\x\1/g;s/^/"/;s/$$$$/"/' >> $1
+	$$(Q)echo ";" >> $1
+
+endef
@@ -0,0 +1,64 @@
+var ticks = 0, done = 0;
+var t = setInterval(function() { ticks++; }, 1);
+var big = '';
+for (var i = 0; i < 200; i++)
+    big += '0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef';
+
+fs.writeFile('Local/async_test.txt', big, function(err) {
+    debug.assert(err, undefined);
+    fs.readFile('Local/async_test.txt', function(err, data) {
+        debug.assert(err, undefined);
+        debug.assert(data.length, big.length);
+        debug.assert(data, big);
+        done++;
+        builtinTest();
+    });
+});
+
+/* File systems that aren't thread safe are served in event loop chunks */
+function builtinTest()
+{
+    fs.readFile('Builtin/assert.js', function(err, data) {
+        debug.assert(err, undefined);
+        debug.assert(data, fs.readFileSync('Builtin/assert.js'));
+        done++;
+        streamTest();
+    });
+}
+
+function streamTest()
+{
+    var fd = fs.openSync('Local/async_test.txt', 'w'), written = 0;
+    var b = new Uint8Array(4);
+
+    b[0] = 65; b[1] = 66; b[2] = 67; b[3] = 10;
+    /* Writes queue up in order */
+    fs.write(fd, 'line 1\n', function(err, n) { written += n; });
+    fs.write(fd, b, function(err, n) { written += n; });
+    debug.assert_exception(function() { fs.closeSync(fd); });
+    fs.write(fd, 'line 2\n', function(err, n) {
+        written += n;
+        debug.assert(written, 18);
+        fs.closeSync(fd);
+        fd = fs.openSync('Local/async_test.txt');
+        var r = new Uint8Array(64);
+        fs.read(fd, r, function(err, n) {
+            debug.assert(err, undefined);
+            debug.assert(n, 18);
+            debug.assert(r[7], 65);
+            debug.assert(r[10], 10);
+            fs.closeSync(fd);
+            done++;
+            clearInterval(t);
+            debug.assert(done, 3);
+            /* The event loop kept running during the transfers */
+            debug.assert(ticks > 0, true);
+            fs.unlinkSync('Local/async_test.txt');
+            console.log('async test done');
+        });
+    });
+}
+
+debug.assert_exception(function() { fs.readFile('Local/no_such_dir/file', function() {}); });
+debug.assert_exception(function() { fs.readFile('Local/async_test.txt'); });
+debug.assert_exception(function() { fs.write(7, 'x', function() {}); });
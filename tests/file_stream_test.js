@@ -0,0 +1,74 @@
+var fd = fs.openSync('Local/stream_test.txt', 'w');
+debug.assert(fs.writeSync(fd, 'hello '), 6);
+debug.assert(fs.writeSync(fd, 'world'), 5);
+fs.closeSync(fd);
+
+/* Append */
+fd = fs.openSync('Local/stream_test.txt', 'a');
+var b = new Uint8Array(3);
+b[0] = 33; b[1] = 33; b[2] = 10;
+debug.assert(fs.writeSync(fd, b), 3);
+fs.closeSync(fd);
+debug.assert(fs.readFileSync('Local/stream_test.txt'), 'hello world!!\n');
+
+/* Read in chunks */
+fd = fs.openSync('Local/stream_test.txt');
+var chunk = new Uint8Array(4), expected = 'hello world!!\n', total = 0, n, i;
+while ((n = fs.readSync(fd, chunk)) > 0)
+{
+    for (i = 0; i < n; i++)
+        debug.assert(chunk[i], expected.charCodeAt(total + i));
+    total += n;
+}
+debug.assert(total, expected.length);
+
+/* Seek */
+debug.assert(fs.seekSync(fd, 0, 2), 14);
+debug.assert(fs.seekSync(fd, 6), 6);
+debug.assert(fs.readSync(fd, chunk, 2), 2);
+debug.assert(chunk[0], 'w'.charCodeAt(0));
+debug.assert(chunk[1], 'o'.charCodeAt(0));
+debug.assert(fs.seekSync(fd, -3, 1), 5);
+fs.closeSync(fd);
+
+/* Builtin FS files can be streamed, but not written */
+fd = fs.openSync('Builtin/assert');
+debug.assert(fs.readSync(fd, chunk) > 0, true);
+debug.assert_exception(function() { fs.writeSync(fd, 'x'); });
+fs.closeSync(fd);
+debug.assert_exception(function() { fs.openSync('Builtin/assert', 'w'); });
+
+/* Streamed builtin files match whole file reads, also across seeks */
+var whole = fs.readFileSync('Builtin/assert'), big = new Uint8Array(7);
+fd = fs.openSync('Builtin/assert');
+debug.assert(fs.seekSync(fd, 0, 2), whole.length);
+debug.assert(fs.seekSync(fd, 0), 0);
+total = 0;
+while ((n = fs.readSync(fd, big)) > 0)
+{
+    for (i = 0; i < n; i++)
+        debug.assert(big[i], whole.charCodeAt(total + i));
+    total += n;
+}
+debug.assert(total, whole.length);
+debug.assert(fs.seekSync(fd, 5), 5);
+debug.assert(fs.readSync(fd, chunk), 4);
+debug.assert(chunk[0], whole.charCodeAt(5));
+debug.assert(fs.seekSync(fd, whole.length - 1), whole.length - 1);
+debug.assert(fs.readSync(fd, chunk), 1);
+debug.assert(chunk[0], whole.charCodeAt(whole.length - 1));
+fs.closeSync(fd);
+
+/* Test stream exceptions */
+debug.assert_exception(function() { fs.openSync('Local/no_such_dir/file'); });
+debug.assert_exception(function() { fs.openSync('Local/stream_test.txt', 'x'); });
+debug.assert_exception(function() { fs.openSync('no_such_fs/file'); });
+debug.assert_exception(function() { fs.readSync(fd, chunk); });
+debug.assert_exception(function() { fs.closeSync(fd); });
+debug.assert_exception(function() { fs.readSync(100, chunk); });
+fd = fs.openSync('Local/stream_test.txt');
+debug.assert_exception(function() { fs.readSync(fd, 'not a buffer'); });
+debug.assert_exception(function() { fs.seekSync(fd, -1); });
+/* Left open on purpose, closed by the VFS on exit */
+fs.unlinkSync('Local/stream_test.txt');
+console.log('stream test done');
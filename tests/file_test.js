@@ -3,6 +3,15 @@ console.log('Test String : ' + s);
 fs.writeFileSync('Local/test.txt', s);
 var s2 = fs.readFileSync('Local/test.txt');
 debug.assert(s, s2);
+
+/* Test file deletion */
+fs.unlinkSync('Local/test.txt');
+debug.assert_exception(function() { fs.readFileSync('Local/test.txt'); });
+debug.assert_exception(function() { fs.unlinkSync('Local/test.txt'); });
+debug.assert_exception(function() { fs.unlinkSync('Builtin/assert.js'); });
+debug.assert_exception(function() { fs.unlinkSync('no_such_fs/test.txt'); });
+debug.assert_exception(function() { fs.unlinkSync('Local/test.txt', 'invalid arg'); });
+
 fs.writeFileSync('FAT/test.txt', s);
 var s2 = fs.readFileSync('FAT/test.txt');
 
@@ -17,7 +26,13 @@ var dirs = fs.readdirSync('/');
 debug.assert(dirs[0], 'FAT');
 
 var builtin_files = fs.readdirSync('Builtin');
-debug.assert(builtin_files[0], 'assert');
+debug.assert(builtin_files[0], 'assert.js');
+/* Builtin files are found with or without their extension */
+debug.assert(fs.readFileSync('Builtin/assert'),
+    fs.readFileSync('Builtin/assert.js'));
+debug.assert_exception(function() { fs.readFileSync('Builtin/assert.j'); });
+debug.assert_exception(function() { fs.readFileSync('Builtin/asser'); });
+debug.assert_exception(function() { fs.readFileSync('Builtin/zzz'); });
 
 /* Builtin fs doesn't allow subfolders */
 debug.assert_exception(function() { console.log(fs.readdirSync('Builtin/kuku/ku')); });
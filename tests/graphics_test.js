@@ -30,6 +30,52 @@ console.log("draws " + num_draws);
 g.lineDraw(0, 0, 0, 0, 1);
 console.log("draws " + num_draws);
 
+/* Block transfers drawn through the generic fallbacks */
+var pixels = {}, num_pixels = 0;
+var p = {
+    pixelDraw: function(x, y, c) {
+        debug.assert(x >= 0 && x < this.width && y >= 0 && y < this.height,
+            true);
+        if (pixels[x + ',' + y] === undefined)
+            num_pixels++;
+        pixels[x + ',' + y] = c;
+    },
+    flip: function() { pixels = {}; num_pixels = 0; },
+    height: 40,
+    width: 60
+};
+var pg = new Graphics(p);
+
+pg.rectFill(2, 3, 5, 4, 7);
+debug.assert(num_pixels, 20);
+debug.assert(pixels['2,3'], 7);
+debug.assert(pixels['6,6'], 7);
+debug.assert(pixels['7,6'], undefined);
+p.flip();
+pg.rectFill(-2, -3, 4, 5, 1);
+debug.assert(num_pixels, 4);
+pg.rectFill(58, 38, 10, 10, 1);
+debug.assert(num_pixels, 8);
+p.flip();
+
+/* Text is the same wherever it is drawn, and clipped at the edges */
+pg.stringDraw(0, 0, "Hi!", 3);
+var text = pixels, text_pixels = num_pixels;
+p.flip();
+pg.stringDraw(10, 20, "Hi!", 3);
+debug.assert(num_pixels, text_pixels);
+var k, clipped = 0;
+for (k in text)
+{
+    var xy = k.split(',');
+    debug.assert(pixels[(+xy[0] + 10) + ',' + (+xy[1] + 20)], 3);
+    if (+xy[0] >= 4 && +xy[1] >= 2)
+        clipped++;
+}
+p.flip();
+pg.stringDraw(-4, -2, "Hi!", 3);
+debug.assert(num_pixels, clipped);
+
 debug.assert_exception(function() { var g = new Graphics()});
 debug.assert_exception(function() { var g = new Graphics({})});
 /* Test invalid params */
@@ -56,6 +102,18 @@ d.flip();
 d.fill(1);
 d.pixelDraw(1, 1, 1);
 var dummy_g = new Graphics(d);
+/* Only the areas drawn since the last flip are flushed */
+d.flip();
+d.pixelDraw(1, 1, 1);
+d.pixelDraw(2, 1, 1);
+d.pixelDraw(100, 50, 1);
+dummy_g.rectFill(10, 20, 4, 3, 1);
+d.flip();
+/* Drawn as one block */
+dummy_g.rectFill(120, 60, 20, 20, 1);
+dummy_g.stringDraw(0, 10, "a", 1);
+d.flip();
+d.flip();
 debug.assert_exception(function() { d.fill(); } );
 debug.assert_exception(function() { var s = d.fill; s(1); } );
 debug.assert_exception(function() { d.pixelDraw(); } );
@@ -0,0 +1,56 @@
+/* Start from a known state, the store outlives test runs */
+var i, s, keys = ['a', 'b', 'counter', 'big', 'k0', 'k1', 'k2', 'k3'];
+for (i = 0; i < keys.length; i++)
+    kv.delete(keys[i]);
+
+debug.assert(kv.get('a'), undefined);
+kv.put('a', 'hello');
+kv.put('b', 12);
+debug.assert(kv.get('a'), 'hello');
+debug.assert(kv.get('b'), '12');
+debug.assert(kv.delete('a'), true);
+debug.assert(kv.delete('a'), false);
+debug.assert(kv.get('a'), undefined);
+
+/* Overwrites fill the log until old segments are reclaimed */
+s = kv.getStats();
+var compactions = s.compactions;
+for (i = 0; i < 200; i++)
+{
+    kv.put('counter', 'value number ' + i + ' padded to take some space');
+    kv.put('k' + (i % 4), i);
+}
+debug.assert(kv.get('counter'), 'value number 199 padded to take some space');
+debug.assert(kv.get('k3'), '199');
+s = kv.getStats();
+debug.assert(s.compactions > compactions, true);
+debug.assert(s.free >= 1, true);
+
+/* Values are read back from the storage */
+kv.close();
+debug.assert(kv.get('counter'), 'value number 199 padded to take some space');
+debug.assert(kv.get('b'), '12');
+debug.assert(kv.get('a'), undefined);
+for (i = 0; i < 4; i++)
+    debug.assert(kv.get('k' + i), '' + (196 + i));
+
+/* Records larger than a segment are refused */
+s = 'x';
+for (i = 0; i < 12; i++)
+    s += s;
+debug.assert_exception(function() { kv.put('big', s); });
+debug.assert_exception(function() { kv.put('', 'x'); });
+debug.assert(kv.get('big'), undefined);
+
+/* Background compaction catches up on its own */
+setTimeout(function() {
+    var st = kv.getStats();
+
+    debug.assert(st.free >= 1, true);
+    debug.assert(st.keys >= 6, true);
+
+    /* Don't leave the store behind */
+    kv.close();
+    fs.unlinkSync('Local/tp_kv_store.bin');
+    console.log('kv test done');
+}, 10);
@@ -0,0 +1,78 @@
+/* Test pre-tokenized module images */
+var src = "/* Exercise the tokens an image has to keep */\n" +
+    "var exports = module.exports;\n" +
+    "var hex = 0x1f, fp = 2.5, big = 1e3, s = 'it\\'s', t = \"tab\\tx\";\n" +
+    "// Single line comment\n" +
+    "function Counter(start) { this.n = start; }\n" +
+    "Counter.prototype.inc = function() { return ++this.n; };\n" +
+    "exports.ops = function(a) {\n" +
+    "    var r = a;\n" +
+    "    r <<= 2; r >>= 1; r >>>= 0; r |= 1; r &= 0xff; r ^= 2;\n" +
+    "    return [r, a === 3, a !== 3, a == '3', a != 4, a >>> 1, -a >> 1,\n" +
+    "        a <= 3 && a >= 3, !a || ~a, a % 2, a * fp, hex, big];\n" +
+    "};\n" +
+    "exports.strings = function() { return s + t + 'x'.length; };\n" +
+    "exports.sum = function(n) {\n" +
+    "    var i, t = 0;\n" +
+    "    for (i = 0; i < n; i++) { if (i == 2) continue; t += i; }\n" +
+    "    do { t--; } while (false);\n" +
+    "    return t;\n" +
+    "};\n" +
+    "exports.misc = function(x) {\n" +
+    "    var c = new Counter(x), o = { a: 1, 'b': 2 }, k, keys = '';\n" +
+    "    for (k in o) keys += k;\n" +
+    "    switch (x) { case 1: keys += 'one'; break; default: keys += 'd'; }\n" +
+    "    try { throw 5; } catch (e) { keys += e; }\n" +
+    "    return keys + c.inc() + (x ? 'y' : null);\n" +
+    "};\n";
+
+fs.writeFileSync('Local/module_image_src.js', src);
+compileModule('module_image_src.js', 'Local/module_image.jsc');
+
+var image = fs.readFileSync('Local/module_image.jsc');
+debug.assert(image.charCodeAt(0), 127);
+debug.assert(image.length < src.length, true);
+
+function check(m) {
+    var ops = m.ops(3);
+    debug.assert(ops.length, 13);
+    debug.assert(ops[0], 5);
+    debug.assert(ops[1], true);
+    debug.assert(ops[2], false);
+    debug.assert(ops[3], true);
+    debug.assert(ops[4], true);
+    debug.assert(ops[5], 1);
+    debug.assert(ops[6], -2);
+    debug.assert(ops[7], true);
+    debug.assert(ops[8], true);
+    debug.assert(ops[9], 1);
+    debug.assert(ops[10], 7.5);
+    debug.assert(ops[11], 31);
+    debug.assert(ops[12], 1000);
+    debug.assert(m.strings(), "it's" + "tab\tx" + 1);
+    debug.assert(m.sum(5), 7);
+    debug.assert(m.misc(1), "abone52y");
+}
+
+/* Source read into RAM is converted when required */
+check(require('module_image_src.js'));
+/* Images are loaded as is */
+check(require('module_image.jsc'));
+
+/* Images of builtin modules */
+compileModule('assert', 'Local/assert.jsc');
+var as = require('assert.jsc');
+as.equal(1, 1);
+debug.assert_exception(function() { as.equal(1, 2); });
+
+/* Compiling an image keeps it intact */
+compileModule('module_image.jsc', 'Local/module_image2.jsc');
+debug.assert(fs.readFileSync('Local/module_image2.jsc'), image);
+
+debug.assert_exception(function() { compileModule('no_such_module.js',
+    'Local/x.jsc'); });
+
+fs.unlinkSync('Local/module_image_src.js');
+fs.unlinkSync('Local/module_image.jsc');
+fs.unlinkSync('Local/module_image2.jsc');
+fs.unlinkSync('Local/assert.jsc');
@@ -5,5 +5,14 @@ debug.assert(as, as);
 
 
 debug.assert_exception(function() { doesnt_exist = require('assert2'); });
+require('assert.js').equal(1, 1);
+
+/* Files written after a failed lookup are found */
+try { fs.unlinkSync('Local/module_test_late.js'); } catch (e) { }
+debug.assert_exception(function() { require('module_test_late.js'); });
+fs.writeFileSync('Local/module_test_late.js', 'module.exports.v = 5;');
+debug.assert(require('module_test_late.js').v, 5);
+fs.unlinkSync('Local/module_test_late.js');
+debug.assert_exception(function() { fs.unlinkSync('Local/module_test_late.js'); });
 
 debug.assert_exception(function() { invalid_args = require('assert', "invalid_arg"); });
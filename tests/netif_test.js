@@ -9,9 +9,16 @@ debug.assert_exception(function() { n.IPDisconnect.call(1); });
 debug.assert_exception(function() { n.TCPDisconnect.call(1); });
 debug.assert_exception(function() { n.onTCPData.call(1); });
 debug.assert_exception(function() { n.onTCPDisconnect.call(1); });
+debug.assert_exception(function() { n.onTCPWritable.call(1); });
 debug.assert_exception(function() { n.TCPWrite.call(1, "kku"); });
 debug.assert_exception(function() { n.TCPRead.call(1, "kku"); });
 debug.assert_exception(function() { n.TCPRead.call(1); });
+debug.assert_exception(function() { n.TCPListen.call(1, 8080, function() { }); });
+debug.assert_exception(function() { n.TCPAccept.call(1, 0); });
+debug.assert_exception(function() { n.UDPBind.call(1); });
+debug.assert_exception(function() { n.UDPSend.call(1, "kku", '127.0.0.1', 80); });
+debug.assert_exception(function() { n.onUDPMessage.call(1, function() { }); });
+debug.assert_exception(function() { n.UDPClose.call(1); });
 
 /* Test invalid IP */
 good = 0;
@@ -19,33 +26,144 @@ debug.assert_exception(function() { n.TCPConnect('188.226.224148', 80, function(
 /* Test invalid IP */
 debug.assert_exception(function() { n.TCPConnect('1a88.226.224.148', 80, function() { }); });
 
+/* Test invalid sockets */
+debug.assert_exception(function() { n.TCPRead(-1); });
+debug.assert_exception(function() { n.TCPRead(1000); });
+debug.assert_exception(function() { n.TCPWrite("kku", 1000); });
+debug.assert_exception(function() { n.onTCPData(function() { }, -1); });
+debug.assert_exception(function() { n.TCPListen(0, function() { }); });
+debug.assert_exception(function() { n.TCPAccept(1000); });
+
 debug.assert(n.linkStatus(), true);
 debug.assert((n.MACAddrGet())[0], 0);
 debug.assert((n.MACAddrGet())[0], 0);
 
+/* Test accepting a loopback connection */
+var listener = n.TCPListen(18321, function() {
+    var server = n.TCPAccept(listener);
+
+    debug.assert(server != listener, true);
+    /* Nothing else is pending */
+    debug.assert(n.TCPAccept(listener), undefined);
+    n.onTCPData(function() {
+        var s = n.TCPRead(server);
+
+        if (s == "")
+            return;
+        debug.assert(s, "ping");
+        n.TCPWrite("pong", server);
+    }, server);
+    n.onTCPDisconnect(function() {
+        n.TCPDisconnect(server);
+        n.TCPDisconnect(listener);
+        do_refused();
+    }, server);
+});
+debug.assert(n.TCPRead(listener), "");
+debug.assert_exception(function() { n.TCPWrite("kku", listener); });
+
+var client = n.TCPConnect('127.0.0.1', 18321, function() {
+    n.TCPWrite("ping", client);
+});
+n.onTCPData(function() {
+    var s = n.TCPRead(client);
+
+    if (s == "")
+        return;
+    debug.assert(s, "pong");
+    n.TCPDisconnect(client);
+}, client);
+
+/* Test concurrent non blocking connections failing through the event loop */
+function do_refused() {
+    var refused = 0;
+    var socks = [];
+
+    for (var i = 0; i < 3; i++) {
+        var sock = n.TCPConnect('127.0.0.1', 1, function() {
+            debug.assert(0, 1);
+        });
+        for (var j = 0; j < socks.length; j++)
+            debug.assert(socks[j] != sock, true);
+        socks.push(sock);
+        n.onTCPDisconnect(function() {
+            if (++refused < socks.length)
+                return;
+
+            /* Refused sockets are kept until disconnected */
+            var other = n.UDPBind();
+            for (var j = 0; j < socks.length; j++) {
+                debug.assert(socks[j] != other, true);
+                n.TCPDisconnect(socks[j]);
+            }
+            n.UDPClose(other);
+            do_udp();
+        }, sock);
+    }
+    debug.assert(socks.length, 3);
+}
+
+/* Test a loopback UDP exchange, datagrams are echoed back to their source */
+function do_udp() {
+    var server = n.UDPBind(18322);
+    var client = n.UDPBind();
+    var sent = ["a", "bb", [99, 99, 99]], received = 0;
+
+    debug.assert(server != client, true);
+    debug.assert_exception(function() { n.UDPBind(70000); });
+    debug.assert_exception(function() { n.UDPSend("x", '127.0.0.1', 0, client); });
+    debug.assert_exception(function() { n.UDPSend("x", '127.0.01', 80, client); });
+    /* UDP sockets are not streams */
+    debug.assert(n.TCPRead(server), "");
+    debug.assert_exception(function() { n.TCPWrite("kku", server); });
+
+    n.onUDPMessage(function(data, ip, port) {
+        debug.assert(ip, '127.0.0.1');
+        debug.assert(port != 18322, true);
+        n.UDPSend(data, ip, port, server);
+    }, server);
+    n.onUDPMessage(function(data, ip, port) {
+        debug.assert(ip, '127.0.0.1');
+        debug.assert(port, 18322);
+        debug.assert(data, ["a", "bb", "ccc"][received]);
+        if (++received < sent.length)
+            return;
+
+        n.UDPClose(server);
+        n.UDPClose(client);
+        start_ip();
+    }, client);
+
+    for (var i = 0; i < sent.length; i++)
+        debug.assert(n.UDPSend(sent[i], '127.0.0.1', 18322, client), i + 1);
+}
+
 function do_weather() {
     var full = "";
+    var sock;
+    sock = n.TCPConnect('77.154.221.186', 80, function() {
+        console.log("TCP Connected");
+        n.TCPWrite('GET / HTTP/1.0\r\n' +
+            '\r\n\r\n', sock);
+    });
     n.onTCPDisconnect(function() {
-        n.TCPDisconnect();
+        n.TCPDisconnect(sock);
         n.IPDisconnect();
-        n.onTCPData();
+        n.onTCPData(undefined, sock);
         console.log(full);
-    });
+    }, sock);
     n.onTCPData(function() {
-        var s = n.TCPRead();
+        var s = n.TCPRead(sock);
         if (s == "") {
             return;
         }
         full += s;
-    });
-    n.TCPConnect('77.154.221.186', 80, function() {
-        console.log("TCP Connected");
-        n.TCPWrite('GET / HTTP/1.0\r\n' +
-            '\r\n\r\n');
-    });
+    }, sock);
 }
 
-n.IPConnect(function() {
-    console.log("IP Connected: " + n.IPAddrGet());
-    do_weather();
-});
+function start_ip() {
+    n.IPConnect(function() {
+        console.log("IP Connected: " + n.IPAddrGet());
+        do_weather();
+    });
+}
@@ -0,0 +1,79 @@
+/* Test heap snapshots */
+var i = 5, neg = -70000, fp = 2.5, big = 1e10, s = "it's\ttabbed", n = null;
+var u = undefined, t = true, f = false, nan = NaN;
+var arr = [1, 'two', [3], { four: 4 }];
+var o = { a: 1, nested: { b: 'b' } };
+o.self = o;
+o.arr = arr;
+
+function Counter(start) { this.n = start; }
+Counter.prototype.inc = function() { return ++this.n; };
+var c = new Counter(10);
+
+function make_closure() {
+    var count = 0;
+    return [function() { return ++count; }, function() { return count; }];
+}
+var closures = make_closure();
+closures[0]();
+
+var bytes = new Uint8Array(4);
+bytes[0] = 0;
+bytes[1] = 255;
+bytes[2] = 7;
+
+var floor = Math.floor, M = Math;
+Math.twice = function(x) { return 2 * x; };
+
+function check() {
+    debug.assert(i, 5);
+    debug.assert(neg, -70000);
+    debug.assert(fp, 2.5);
+    debug.assert(big, 1e10);
+    debug.assert(s, "it's\ttabbed");
+    debug.assert(n, null);
+    debug.assert(u, undefined);
+    debug.assert(t, true);
+    debug.assert(f, false);
+    debug.assert(isNaN(nan), true);
+    debug.assert(arr.length, 4);
+    debug.assert(arr[1], 'two');
+    debug.assert(arr[2][0], 3);
+    debug.assert(arr[3].four, 4);
+    debug.assert(o.nested.b, 'b');
+    debug.assert(o.self === o, true);
+    debug.assert(o.arr === arr, true);
+    debug.assert(c.n, 10);
+    debug.assert(c.inc(), 11);
+    debug.assert(closures[0](), 2);
+    debug.assert(closures[1](), 2);
+    debug.assert(bytes.length, 4);
+    debug.assert(bytes[0], 0);
+    debug.assert(bytes[1], 255);
+    debug.assert(bytes[2], 7);
+    debug.assert(floor(2.5), 2);
+    debug.assert(M === Math, true);
+    debug.assert(Math.twice(4), 8);
+}
+
+snapshotSave('Local/snapshot_test.snap');
+
+/* Images can be embedded in the builtin FS */
+var image = fs.readFileSync('Local/snapshot_test.snap'), k;
+debug.assert(image.charCodeAt(0), 127);
+for (k = 0; k < image.length; k++)
+    debug.assert(image.charCodeAt(k) != 0, true);
+
+check();
+
+/* Trash the state, then restore it */
+i = neg = fp = big = s = n = u = t = f = nan = arr = o = c = 0;
+closures = bytes = floor = M = 0;
+Math.twice = 0;
+snapshotLoad('Local/snapshot_test.snap');
+check();
+
+debug.assert_exception(function() { snapshotLoad('Local/snapshot_test.js'); });
+debug.assert_exception(function() { snapshotLoad('Local/no_such.snap'); });
+
+fs.unlinkSync('Local/snapshot_test.snap');
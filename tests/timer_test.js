@@ -14,3 +14,37 @@ setTimeout(function() {clearTimeout(); }, 1500);
 debug.assert_exception(function() { setTimeout(); });
 debug.assert_exception(function() { setInterval(function() {}, 5000, 1); });
 debug.assert_exception(function() { clearInterval(1, 2); });
+
+/* Timers sharing a deadline fire together, in any order */
+var batch = 0;
+for (var i = 0; i < 5; i++)
+    setTimeout(function() { batch++; }, 400);
+setTimeout(function() { debug.assert(batch, 5); }, 450);
+
+/* Many intervals, cleared out of insertion order */
+var ticks = 0, tids = [];
+for (var i = 0; i < 20; i++)
+    tids[i] = setInterval(function() { ticks++; }, 100 + i * 10);
+for (var i = 0; i < 20; i += 2)
+    clearInterval(tids[i]);
+setTimeout(function() {
+    for (var i = 1; i < 20; i += 2)
+        clearInterval(tids[i]);
+    var t = ticks;
+    setTimeout(function() { debug.assert(ticks, t); }, 400);
+}, 700);
+
+/* Timer slack still fires timers, only later */
+var slacked = 0;
+setTimerSlack(50);
+setTimeout(function() { slacked = 1; setTimerSlack(0); }, 1700);
+setTimeout(function() { debug.assert(slacked, 1); }, 1800);
+
+/* Loop statistics */
+getLoopStats(true);
+setTimeout(function() {
+    var s = getLoopStats();
+    debug.assert(s.idle > 0, true);
+    debug.assert(s.busy >= 0, true);
+    debug.assert(s.sleeps > 0, true);
+}, 1900);
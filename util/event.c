@@ -23,6 +23,7 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <stdio.h> /* NULL */
+#include <string.h> /* memcpy */
 #include "util/event.h"
 #include "util/debug.h"
 #include "util/tp_misc.h"
@@ -44,6 +45,11 @@ typedef struct event_internal_t {
     int event_id;
     int period;
     u64 expire;
+    /* Timers only: position in the timers heap (-1 if not queued), and
+     * chaining in the timers index.
+     */
+    int heap_idx;
+    struct event_internal_t *index_next;
     u32 flags; /* Doubles as a counters for timestamps */
     u64 timestamps[0];
 } event_internal_t;
@@ -67,25 +73,157 @@ typedef struct event_internal_t {
 #define EVENT_SET_TS_SIZE(e, n) EVENT_FLAGS_U8_SET(e, n, EVENT_TS_SIZE_SHIFT)
 #define EVENT_SET_TS_COUNT(e, n) EVENT_FLAGS_U8_SET(e, n, EVENT_TS_COUNT_SHIFT)
 #define EVENT_SET_TS_START(e, n) EVENT_FLAGS_U8_SET(e, n, EVENT_TS_START_SHIFT)
- 
-static event_internal_t *watches, *timers;
+
+/* Timers are kept in a binary min-heap ordered by expiration time, and
+ * indexed by event id in a small hash so that deletion does not require a
+ * scan.
+ */
+#define TIMERS_HEAP_INIT_SIZE 8
+#define TIMERS_INDEX_SIZE 32 /* Must be a power of 2 */
+#define TIMERS_INDEX_HASH(id) ((u32)(id) & (TIMERS_INDEX_SIZE - 1))
+
+/* Wrap-around safe comparison of tick values */
+#define TIME_BEFORE(a, b) ((s64)((a) - (b)) < 0)
+
+static event_internal_t *watches;
+static event_internal_t **timers_heap, *timers_index[TIMERS_INDEX_SIZE];
+/* timers_deleted - pending free, timers_expired - batch currently firing */
+static event_internal_t *timers_deleted, *timers_expired;
+static int timers_heap_count, timers_heap_size;
+static int timers_slack = CONFIG_EVENT_TIMER_SLACK_MS;
 static int g_event_id = 0;
+#ifdef CONFIG_EVENT_LOOP_STATS
+static event_loop_stats_t loop_stats;
+#endif
 
 #define watches_foreach(e) for (e = watches; e; e = e->next)
-#define timers_foreach(t) for (t = timers; t; t = t->next)
 
-static void event_timer_insert(event_internal_t *t, int ms)
+static inline void timers_heap_place(event_internal_t *t, int idx)
+{
+    timers_heap[idx] = t;
+    t->heap_idx = idx;
+}
+
+static void timers_heap_sift_up(int idx)
 {
-    event_internal_t **iter;
+    event_internal_t *t = timers_heap[idx];
 
-    t->expire = platform_get_ticks_from_boot() + ms;
+    while (idx)
+    {
+        int parent = (idx - 1) >> 1;
+
+        if (!TIME_BEFORE(t->expire, timers_heap[parent]->expire))
+            break;
+
+        timers_heap_place(timers_heap[parent], idx);
+        idx = parent;
+    }
+    timers_heap_place(t, idx);
+}
+
+static void timers_heap_sift_down(int idx)
+{
+    event_internal_t *t = timers_heap[idx];
+
+    while (1)
+    {
+        int child = (idx << 1) + 1;
+
+        if (child >= timers_heap_count)
+            break;
+
+        if (child + 1 < timers_heap_count &&
+            TIME_BEFORE(timers_heap[child + 1]->expire,
+            timers_heap[child]->expire))
+        {
+            child++;
+        }
+
+        if (!TIME_BEFORE(timers_heap[child]->expire, t->expire))
+            break;
+
+        timers_heap_place(timers_heap[child], idx);
+        idx = child;
+    }
+    timers_heap_place(t, idx);
+}
+
+static void timers_heap_grow(void)
+{
+    event_internal_t **new_heap;
+    int new_size;
+
+    new_size = timers_heap_size ? timers_heap_size << 1 :
+        TIMERS_HEAP_INIT_SIZE;
+    new_heap = tmalloc(new_size * sizeof(event_internal_t *),
+        "Timers Heap");
+    if (timers_heap)
+    {
+        memcpy(new_heap, timers_heap, 
+            timers_heap_count * sizeof(event_internal_t *));
+        tfree(timers_heap);
+    }
+    timers_heap = new_heap;
+    timers_heap_size = new_size;
+}
+
+static void timers_heap_insert(event_internal_t *t)
+{
+    if (timers_heap_count == timers_heap_size)
+        timers_heap_grow();
+
+    timers_heap_place(t, timers_heap_count++);
+    timers_heap_sift_up(t->heap_idx);
+}
+
+static void timers_heap_remove(event_internal_t *t)
+{
+    int idx = t->heap_idx;
+    event_internal_t *last;
+
+    t->heap_idx = -1;
+    last = timers_heap[--timers_heap_count];
+    if (last == t)
+        return;
+
+    timers_heap_place(last, idx);
+    if (idx && TIME_BEFORE(last->expire, timers_heap[(idx - 1) >> 1]->expire))
+        timers_heap_sift_up(idx);
+    else
+        timers_heap_sift_down(idx);
+}
+
+static void timers_heap_free(void)
+{
+    tfree(timers_heap);
+    timers_heap = NULL;
+    timers_heap_size = timers_heap_count = 0;
+}
 
-    /* Bug: we do not properly handle wrap-around */
-    for (iter = &timers; *iter && (*iter)->expire < t->expire; 
-        iter = &(*iter)->next);
+static void timers_index_add(event_internal_t *t)
+{
+    event_internal_t **bucket = &timers_index[TIMERS_INDEX_HASH(t->event_id)];
+
+    t->index_next = *bucket;
+    *bucket = t;
+}
+
+static event_internal_t *timers_index_remove(int event_id)
+{
+    event_internal_t **iter, *t;
+
+    for (iter = &timers_index[TIMERS_INDEX_HASH(event_id)];
+        (t = *iter) && t->event_id != event_id; iter = &t->index_next);
 
-    t->next = *iter;
-    *iter = t;
+    if (t)
+        *iter = t->index_next;
+    return t;
+}
+
+static void event_timer_insert(event_internal_t *t, int ms)
+{
+    t->expire = platform_get_ticks_from_boot() + ms;
+    timers_heap_insert(t);
 }
 
 static event_internal_t *_event_timer_set(int ms, event_t *e)
@@ -96,6 +234,8 @@ static event_internal_t *_event_timer_set(int ms, event_t *e)
     n->event_id = g_event_id++;
     n->period = 0;
     n->flags = 0;
+    n->heap_idx = -1;
+    timers_index_add(n);
     event_timer_insert(n, ms);
     return n;
 }
@@ -114,68 +254,114 @@ int event_timer_set_period(int ms, event_t *e)
     return n->event_id;
 }
 
+static void timer_deleted_enqueue(event_internal_t *t)
+{
+    t->next = timers_deleted;
+    timers_deleted = t;
+}
+
+static void timer_del(event_internal_t *t)
+{
+    EVENT_SET_DELETED(t);
+
+    /* Timers in the currently expired batch are not in the heap. They will
+     * be moved to the deleted list when the batch reaches them.
+     */
+    if (t->heap_idx == -1)
+        return;
+
+    timers_heap_remove(t);
+    timer_deleted_enqueue(t);
+}
+
 void event_timer_del(int event_id)
 {
     event_internal_t *t;
 
-    timers_foreach(t)
-    {
-        if (t->event_id == event_id)
-            EVENT_SET_DELETED(t);
-    }
+    if (!(t = timers_index_remove(event_id)))
+        return;
+
+    timer_del(t);
 }
 
 void event_timer_del_all(void)
 {
-    event_internal_t *t;
+    int i;
 
-    timers_foreach(t)
-        EVENT_SET_DELETED(t);
+    for (i = 0; i < TIMERS_INDEX_SIZE; i++)
+    {
+        event_internal_t *t;
+
+        while ((t = timers_index[i]))
+        {
+            timers_index[i] = t->index_next;
+            timer_del(t);
+        }
+    }
 }
 
 static void timeout_process(void)
 {
-    event_internal_t **iter = &timers, *t;
+    event_internal_t *t, **tail = &timers_expired;
+    u64 now = platform_get_ticks_from_boot();
+
+    /* Collect all expired timers first, so that timers sharing a deadline
+     * fire together and callbacks scheduling new timers can't starve us.
+     */
+    while (timers_heap_count && !TIME_BEFORE(now, timers_heap[0]->expire))
+    {
+        t = timers_heap[0];
+        timers_heap_remove(t);
+        t->next = NULL;
+        *tail = t;
+        tail = &t->next;
+    }
 
-    while ((t = *iter))
+    while ((t = timers_expired))
     {
         event_t *e = t->e;
 
+        timers_expired = t->next;
+
         if (EVENT_IS_DELETED(t))
         {
-            iter = &(*iter)->next;
+            timer_deleted_enqueue(t);
             continue;
         }
 
-        if (platform_get_ticks_from_boot() < t->expire)
-            break;
-
         if (EVENT_IS_PERIODIC(t))
-        {
-            /* Remove from list and re-insert at the proper time */
-            *iter = (*iter)->next;
             event_timer_insert(t, t->period);
-        }
         else
+        {
+            timers_index_remove(t->event_id);
             EVENT_SET_DELETED(t);
+            timer_deleted_enqueue(t);
+        }
 
         e->trigger(e, 0 /* dummy */, 0 /* dummy */);
-
-        /* Go back to the start. We don't know what happend to the list
-         * while we ran the cb.
-         */
-        iter = &timers;
     }
 }
 
+void event_timer_slack_set(int ms)
+{
+    timers_slack = ms < 0 ? 0 : ms;
+}
+
 static void get_next_timeout(int *timeout)
 {
-    if (!timers)
+    s64 delta;
+
+    if (!timers_heap_count)
     {
         *timeout = 0;
         return;
     }
-    *timeout = timers->expire - platform_get_ticks_from_boot();
+    /* Allow the earliest timer to be late by up to timers_slack ms so that
+     * timers expiring in the slack window are handled in a single wakeup.
+     */
+    delta = (s64)(timers_heap[0]->expire + timers_slack -
+        platform_get_ticks_from_boot());
+    *timeout = delta < 0 ? -1 : delta > 0x7fffffff ? 0x7fffffff : (int)delta;
     tp_debug("Next timeout: %d ms\n", *timeout);
 }
 
@@ -339,23 +525,80 @@ static int watches_process(void)
     return more;
 }
 
+#ifdef CONFIG_EVENT_LOOP_STATS
+
+static inline u64 loop_stats_now(void)
+{
+    u32 sec, usec;
+
+    platform_get_time_from_boot(&sec, &usec);
+    return (u64)sec * 1000000 + usec;
+}
+
+/* Account the time passed since 'since' as busy/idle, return current time */
+static u64 loop_stats_busy(u64 since)
+{
+    u64 now = loop_stats_now();
+
+    loop_stats.busy_us += now - since;
+    return now;
+}
+
+static u64 loop_stats_idle(u64 since)
+{
+    u64 now = loop_stats_now();
+
+    loop_stats.idle_us += now - since;
+    loop_stats.sleeps++;
+    return now;
+}
+
+void event_loop_stats_get(event_loop_stats_t *stats)
+{
+    *stats = loop_stats;
+}
+
+void event_loop_stats_reset(void)
+{
+    loop_stats.busy_us = loop_stats.idle_us = 0;
+    loop_stats.iterations = loop_stats.sleeps = 0;
+}
+
+#else
+
+static inline u64 loop_stats_now(void) { return 0; }
+static inline u64 loop_stats_busy(u64 since) { return 0; }
+static inline u64 loop_stats_idle(u64 since) { return 0; }
+
+#endif
+
 int event_loop_single(int *next_timeout)
 {
     int timeout, more_watches;
+    u64 mark;
 
-    if (!watches && !timers)
+    if (!watches && !timers_heap_count)
         return 0;
 
+    mark = loop_stats_now();
+#ifdef CONFIG_EVENT_LOOP_STATS
+    loop_stats.iterations++;
+#endif
+
     more_watches = watches_process();
 
     get_next_timeout(&timeout);
 
-    if ((!timers || timeout > 0) && !more_watches)
+    if ((!timers_heap_count || timeout > 0) && !more_watches)
+    {
+        mark = loop_stats_busy(mark);
         platform.select(timeout);
+        mark = loop_stats_idle(mark);
+    }
 
     timeout_process();
 
-    event_purge_deleted(&timers);
+    event_purge_deleted(&timers_deleted);
     event_purge_deleted(&watches);
 
     if (next_timeout)
@@ -365,6 +608,8 @@ int event_loop_single(int *next_timeout)
          */
         get_next_timeout(next_timeout);
     }
+
+    loop_stats_busy(mark);
     return 1;
 }
 
@@ -372,8 +617,9 @@ void event_loop_uninit(void)
 {
     event_timer_del_all();
     event_watch_del_all();
-    event_purge_deleted(&timers);
+    event_purge_deleted(&timers_deleted);
     event_purge_deleted(&watches);
+    timers_heap_free();
 }
 
 void event_loop(void)
@@ -62,10 +62,27 @@ int event_timer_set_period(int ms, event_t *e);
 void event_timer_del(int id);
 void event_timer_del_all(void);
 
+/* Timers may be delayed by up to 'ms' in order to coalesce wakeups */
+void event_timer_slack_set(int ms);
+
 int event_loop_single(int *next_timeout);
 void event_loop(void);
 
 void event_loop_uninit(void);
 
+#ifdef CONFIG_EVENT_LOOP_STATS
+
+typedef struct {
+    u64 busy_us; /* Time spent processing events */
+    u64 idle_us; /* Time spent sleeping in platform select */
+    u32 iterations;
+    u32 sleeps;
+} event_loop_stats_t;
+
+void event_loop_stats_get(event_loop_stats_t *stats);
+void event_loop_stats_reset(void);
+
+#endif
+
 #endif
 
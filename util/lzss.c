@@ -0,0 +1,92 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/lzss.h"
+
+u32 lzss_size(const char *src)
+{
+    const unsigned char *p = (const unsigned char *)src;
+
+    return p[0] | (u32)p[1] << 8 | (u32)p[2] << 16 | (u32)p[3] << 24;
+}
+
+void lzss_stream_init(lzss_stream_t *s, const char *src, char *window,
+    int window_size)
+{
+    s->size = lzss_size(src);
+    s->in = (const unsigned char *)src + 4;
+    s->pos = 0;
+    s->flags = 1;
+    s->match_offset = s->match_len = 0;
+    s->window = (unsigned char *)window;
+    s->window_size = window_size;
+}
+
+int lzss_stream_read(lzss_stream_t *s, char *buf, int len)
+{
+    unsigned char c;
+    int n = 0;
+
+    while (n < len && s->pos < s->size)
+    {
+        if (s->match_len)
+        {
+            c = s->window[(s->pos - s->match_offset) % s->window_size];
+            s->match_len--;
+        }
+        else
+        {
+            /* The sentinel bit is all that is left once a group is done */
+            if (s->flags == 1)
+                s->flags = *s->in++ | 0x100;
+
+            if (!(s->flags & 1))
+            {
+                s->match_offset = (s->in[0] | (s->in[1] & 0xf0) << 4) + 1;
+                s->match_len = (s->in[1] & 0x0f) + LZSS_MIN_MATCH;
+                s->in += 2;
+                s->flags >>= 1;
+                continue;
+            }
+
+            c = *s->in++;
+            s->flags >>= 1;
+        }
+
+        s->window[s->pos % s->window_size] = c;
+        s->pos++;
+        buf[n++] = c;
+    }
+
+    return n;
+}
+
+void lzss_decompress(char *dst, const char *src)
+{
+    lzss_stream_t s;
+
+    /* The plain text itself serves as the window */
+    lzss_stream_init(&s, src, dst, lzss_size(src));
+    lzss_stream_read(&s, dst, s.size);
+}
@@ -0,0 +1,67 @@
+/* Copyright (c) 2013, Eyal Birger
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The name of the author may not be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef __LZSS_H__
+#define __LZSS_H__
+
+#include "util/tp_types.h"
+
+/* LZSS decoder for data produced by scripts/lzss_compress.c
+ *
+ * Format: plain text size (32 bit, little endian) followed by groups of up
+ * to 8 items. Each group starts with a flags byte, LSB first, a set bit
+ * marks a literal byte, a clear bit marks a 2 bytes back reference:
+ *   offset - 1 (12 bits, low byte first), length - 3 (4 bits).
+ */
+
+#define LZSS_MIN_MATCH 3
+#define LZSS_MAX_MATCH 18
+#define LZSS_MAX_WINDOW 4096
+
+typedef struct {
+    const unsigned char *in;
+    int size;
+    int pos;
+    int flags;
+    int match_offset;
+    int match_len;
+    /* Last window_size bytes decoded */
+    unsigned char *window;
+    int window_size;
+} lzss_stream_t;
+
+/* Plain text size of compressed data */
+u32 lzss_size(const char *src);
+
+/* window must hold the compression window size, or the whole plain text */
+void lzss_stream_init(lzss_stream_t *s, const char *src, char *window,
+    int window_size);
+
+/* Returns the number of bytes decoded, 0 at the end of the plain text */
+int lzss_stream_read(lzss_stream_t *s, char *buf, int len);
+
+/* Decode all of src to dst which must hold lzss_size(src) bytes */
+void lzss_decompress(char *dst, const char *src);
+
+#endif